@@ -0,0 +1,86 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+#include <nsp/nsp_InstallServices.hpp>
+#include <map>
+
+namespace bench {
+
+    // Stand-in for NCM/ES/NS: in memory mode placeholder data is only bounds-checked and discarded (so that only the pipeline itself is measured),
+    // while in file mode it is written to files in a directory (so that a real disk sits behind the write lanes, like the SD card or NAND would)
+
+    enum class FakeStorageMode {
+        Memory,
+        File
+    };
+
+    struct FakePlaceHolder {
+        NcmContentId cnt_id;
+        s64 size;
+        s64 written_size;
+        int fd;
+    };
+
+    struct FakeInstallServicesStats {
+        u32 content_storage_count;
+        u64 written_size;
+        u32 registered_count;
+        u32 meta_count;
+    };
+
+    class FakeInstallServices : public nsp::InstallServices {
+        private:
+            FakeStorageMode mode;
+            std::string dir;
+            std::map<std::string, FakePlaceHolder> placehlds;
+            std::map<std::string, s64> cnts;
+            FakeInstallServicesStats stats;
+            Lock lock;
+
+            std::string MakePath(const std::string &name);
+
+        public:
+            FakeInstallServices(const FakeStorageMode mode, const std::string &dir) : mode(mode), dir(dir), placehlds(), cnts(), stats(), lock() {}
+            ~FakeInstallServices();
+
+            Result Has(bool &out_has, const NcmContentId &cnt_id);
+            Result CreatePlaceHolder(const NcmContentId &cnt_id, const NcmPlaceHolderId &placehld_id, const s64 size);
+            Result DeletePlaceHolder(const NcmPlaceHolderId &placehld_id);
+            Result HasPlaceHolder(bool &out_has, const NcmPlaceHolderId &placehld_id);
+            Result GetPlaceHolderSize(s64 &out_size, const NcmPlaceHolderId &placehld_id);
+            Result GetPlaceHolderPath(char *out_path, const size_t out_path_size, const NcmPlaceHolderId &placehld_id);
+            Result WritePlaceHolder(const NcmPlaceHolderId &placehld_id, const u64 offset, const void *buf, const size_t size);
+            Result Register(const NcmContentId &cnt_id, const NcmPlaceHolderId &placehld_id);
+            void NotifyMetaSet();
+
+            FakeInstallServicesStats GetStats();
+
+            Result OpenContentStorage(const NcmStorageId storage_id, std::unique_ptr<nsp::ContentStorage> &out_cnt_storage) override;
+            Result OpenContentMetaDatabase(const NcmStorageId storage_id, std::unique_ptr<nsp::ContentMetaDatabase> &out_cnt_meta_db) override;
+            Result ImportTicket(const void *tik_buf, const size_t tik_size, const void *cert_buf, const size_t cert_size) override;
+            Result CountApplicationContentMeta(const u64 app_id, s32 &out_count) override;
+            Result ListApplicationRecordContentMeta(const u64 app_id, NsExtContentStorageMetaKey *out_keys, const s32 count, u32 &out_count) override;
+            Result DeleteApplicationRecord(const u64 app_id) override;
+            Result PushApplicationRecord(const u64 app_id, const NsExtContentStorageMetaKey *keys, const size_t count) override;
+    };
+
+}
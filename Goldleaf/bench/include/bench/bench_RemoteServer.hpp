@@ -0,0 +1,80 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+#include <usb/cf/cf_CommandFramework.hpp>
+
+namespace bench {
+
+    // Small C++ counterpart of Quark's command handling, serving a single host directory as the only drive, so that usb::cmd, usb::cf and fs::RemotePCExplorer
+    // can be exercised (and measured) on a host without a console or the Java client
+    // Like Quark, only one command is handled at a time (pipelined commands are just answered in order)
+
+    constexpr const char RemoteServerDriveName[] = "root";
+
+    struct RemoteServerOptions {
+        std::string root_dir;
+        u32 protocol_version;
+        u64 max_block_size;
+        usb::cf::Feature features;
+    };
+
+    struct RemoteServerStats {
+        u64 cmd_count;
+        u64 read_size;
+        u64 written_size;
+        u64 hashed_size;
+        // Actually transferred sizes, thus after compression
+        u64 sent_payload_size;
+        u64 received_payload_size;
+    };
+
+    class RemoteServer {
+        private:
+            usb::StreamTransport &transport;
+            RemoteServerOptions opts;
+            usb::cf::Feature features;
+            int read_fd;
+            int write_fd;
+            RemoteServerStats stats;
+
+            std::string MakeHostPath(const std::string &path);
+            void ResetNegotiatedState();
+
+            Result SendPayload(const void *buf, const size_t size);
+            Result ReceivePayload(void *buf, const size_t size);
+
+            Result StartFile(const std::string &path, const fs::FileMode mode);
+            void EndFile(const fs::FileMode mode);
+
+        public:
+            RemoteServer(usb::StreamTransport &transport, const RemoteServerOptions &opts) : transport(transport), opts(opts), features(usb::cf::Feature::None), read_fd(-1), write_fd(-1), stats() {}
+            ~RemoteServer();
+
+            // Handles commands until the connection is closed (or something invalid is received)
+            void Run();
+
+            inline RemoteServerStats GetStats() {
+                return this->stats;
+            }
+    };
+
+}
@@ -0,0 +1,32 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+#include <fs/fs_StdExplorer.hpp>
+#include <fs/fs_ChunkSizeTuner.hpp>
+
+// Shadows the actual fs/fs_FileSystem.hpp (whose SD card, NAND and drive explorers need fsdev/usbhsfs), the host SD card explorer is a plain StdExplorer
+
+namespace fs {
+
+    StdExplorer *GetSdCardExplorer();
+
+}
@@ -0,0 +1,289 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <functional>
+#include <memory>
+#include <mbedtls/aes.h>
+
+// Minimal host (Linux) stand-in for the parts of libnx used by the install pipeline, so that it can be built and benchmarked outside the console
+// Only what the pipeline (and the headers it includes) needs is here: anything else is meant to fail at build time
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+typedef u32 Result;
+typedef u32 Handle;
+
+#define FS_MAX_PATH 0x301
+#define SHA256_HASH_SIZE 0x20
+
+#define R_SUCCEEDED(res) ((res) == 0)
+#define R_FAILED(res) ((res) != 0)
+#define R_MODULE(res) ((res) & 0x1FF)
+#define R_DESCRIPTION(res) (((res) >> 9) & 0x1FFF)
+#define R_VALUE(res) ((res) & 0x3FFFFF)
+#define MAKERESULT(module, description) ((((module) & 0x1FF)) | ((description) & 0x1FFF) << 9)
+
+#define CUR_PROCESS_HANDLE 0xFFFF8001
+
+#define BIT(n) (1U << (n))
+#define NX_INLINE __attribute__((always_inline)) static inline
+#define NX_CONSTEXPR NX_INLINE constexpr
+
+enum {
+    Module_Libnx = 345
+};
+
+enum {
+    LibnxError_BadUsbCommsRead = 27
+};
+
+[[noreturn]] inline void diagAbortWithResult(Result res) {
+    std::abort();
+}
+
+// Synchronization
+
+typedef std::mutex Mutex;
+
+inline void mutexLock(Mutex *m) {
+    m->lock();
+}
+
+inline void mutexUnlock(Mutex *m) {
+    m->unlock();
+}
+
+struct UEvent {
+    bool signaled;
+    bool auto_clear;
+};
+
+struct Waiter {
+    UEvent *event;
+};
+
+void ueventCreate(UEvent *event, bool auto_clear);
+void ueventSignal(UEvent *event);
+void ueventClear(UEvent *event);
+
+inline Waiter waiterForUEvent(UEvent *event) {
+    return { event };
+}
+
+Result waitObjects(s32 *idx_out, const Waiter *objects, s32 num_objects, u64 timeout);
+
+inline Result waitSingle(Waiter w, u64 timeout) {
+    s32 idx;
+    return waitObjects(&idx, &w, 1, timeout);
+}
+
+// Threads
+
+typedef void (*ThreadFunc)(void*);
+
+struct Thread {
+    ThreadFunc entry;
+    void *arg;
+    void *impl;
+};
+
+Result threadCreate(Thread *t, ThreadFunc entry, void *arg, void *stack_mem, size_t stack_sz, int prio, int cpuid);
+Result threadStart(Thread *t);
+Result threadWaitForExit(Thread *t);
+Result threadClose(Thread *t);
+
+// Ticks (nanoseconds on the host, so the conversion is the identity)
+
+u64 armGetSystemTick();
+
+inline u64 armTicksToNs(u64 tick) {
+    return tick;
+}
+
+inline u64 armNsToTicks(u64 ns) {
+    return ns;
+}
+
+// Crypto
+
+struct Aes128CtrContext {
+    mbedtls_aes_context aes;
+    u8 ctr[0x10];
+    u8 enc_ctr_buffer[0x10];
+    size_t buffer_offset;
+};
+
+void aes128CtrContextCreate(Aes128CtrContext *out, const void *key, const void *ctr);
+void aes128CtrContextResetCtr(Aes128CtrContext *ctx, const void *ctr);
+void aes128CtrCrypt(Aes128CtrContext *ctx, void *dst, const void *src, size_t size);
+
+// Environment/applet/svc (only referenced by inline helpers in common headers)
+
+typedef enum {
+    AppletType_None = -2,
+    AppletType_Default = -1,
+    AppletType_Application = 0,
+    AppletType_SystemApplet = 1,
+    AppletType_LibraryApplet = 2,
+    AppletType_OverlayApplet = 3,
+    AppletType_SystemApplication = 4
+} AppletType;
+
+inline AppletType appletGetAppletType() {
+    return AppletType_Application;
+}
+
+inline bool envIsNso() {
+    return false;
+}
+
+typedef enum {
+    InfoType_ProgramId = 18
+} InfoType;
+
+inline Result svcGetInfo(u64 *out, u32 id0, Handle handle, u64 id1) {
+    *out = 0;
+    return 0;
+}
+
+typedef enum {
+    SetLanguage_JA = 0,
+    SetLanguage_ENUS = 1
+} SetLanguage;
+
+// FS
+
+struct AccountUid {
+    u64 uid[2];
+};
+
+struct FsFileSystem {
+    int dummy;
+};
+
+typedef enum {
+    FsSaveDataSpaceId_User = 1
+} FsSaveDataSpaceId;
+
+typedef enum {
+    FsSaveDataType_Account = 1,
+    FsSaveDataType_Device = 3
+} FsSaveDataType;
+
+struct FsSaveDataAttribute {
+    u64 application_id;
+    AccountUid uid;
+    u64 system_save_data_id;
+    u8 save_data_type;
+    u8 save_data_rank;
+    u16 save_data_index;
+    u32 pad_x24;
+    u64 unk_x28;
+    u64 unk_x30;
+    u64 unk_x38;
+};
+
+typedef enum {
+    FsCreateOption_BigFile = 1
+} FsCreateOption;
+
+inline Result fsOpenSaveDataFileSystem(FsFileSystem *out, FsSaveDataSpaceId save_data_space_id, const FsSaveDataAttribute *attr) {
+    return MAKERESULT(2, 1);
+}
+
+int fsdevCreateFile(const char *path, size_t size, u32 flags);
+int fsdevDeleteDirectoryRecursively(const char *path);
+Result fsdevSetConcatenationFileAttribute(const char *path);
+
+// NCM
+
+typedef enum {
+    NcmStorageId_None = 0,
+    NcmStorageId_Host = 1,
+    NcmStorageId_GameCard = 2,
+    NcmStorageId_BuiltInSystem = 3,
+    NcmStorageId_BuiltInUser = 4,
+    NcmStorageId_SdCard = 5,
+    NcmStorageId_Any = 6
+} NcmStorageId;
+
+typedef enum {
+    NcmContentType_Meta = 0,
+    NcmContentType_Program = 1,
+    NcmContentType_Data = 2,
+    NcmContentType_Control = 3,
+    NcmContentType_HtmlDocument = 4,
+    NcmContentType_LegalInformation = 5,
+    NcmContentType_DeltaFragment = 6
+} NcmContentType;
+
+typedef enum {
+    NcmContentMetaType_Unknown = 0,
+    NcmContentMetaType_Application = 0x80,
+    NcmContentMetaType_Patch = 0x81,
+    NcmContentMetaType_AddOnContent = 0x82
+} NcmContentMetaType;
+
+struct NcmContentId {
+    u8 c[0x10];
+};
+
+struct NcmPlaceHolderId {
+    u8 c[0x10];
+};
+
+struct NcmContentInfo {
+    NcmContentId content_id;
+    u32 size_low;
+    u8 size_high;
+    u8 attr;
+    u8 content_type;
+    u8 id_offset;
+};
+
+struct NcmContentMetaKey {
+    u64 id;
+    u32 version;
+    u8 type;
+    u8 install_type;
+    u8 padding[2];
+};
+
+inline void ncmContentInfoSizeToU64(const NcmContentInfo *info, u64 *out) {
+    *out = static_cast<u64>(info->size_low) | (static_cast<u64>(info->size_high) << 32);
+}
+
+inline void ncmU64ToContentInfoSize(const u64 size, NcmContentInfo *info) {
+    info->size_low = static_cast<u32>(size);
+    info->size_high = static_cast<u8>(size >> 32);
+}
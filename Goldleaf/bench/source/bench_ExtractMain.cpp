@@ -0,0 +1,304 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <fs/fs_PFS0.hpp>
+#include <fs/fs_StdExplorer.hpp>
+#include <filesystem>
+
+// Extracts a synthetic NSP (a PFS0 with a few big contents and some small files, like real ones) with fs::StdExplorer, preferably in a tmpfs:
+// checks that every file is extracted correctly, and compares PartitionFileSystem::ExtractAll (with and without concurrent writes) against saving each file with SaveFile
+
+namespace {
+
+    struct BenchOptions {
+        u32 content_count = 4;
+        u64 content_size = 512_MB;
+        std::string dir;
+    };
+
+    void PrintUsage(const char *argv0) {
+        fprintf(stderr, "Usage: %s [options]\n", argv0);
+        fprintf(stderr, "  --contents <n>          Number of contents in the package, each one half the size of the previous one (default: 4)\n");
+        fprintf(stderr, "  --content-size-mb <n>   Size of the biggest content (default: 512)\n");
+        fprintf(stderr, "  --dir <dir>             Directory to work in (default: a temporary one in /dev/shm)\n");
+    }
+
+    bool ParseOptions(const int argc, char **argv, BenchOptions &out_opts) {
+        for(int i = 1; i < argc; i++) {
+            const std::string opt = argv[i];
+            if((i + 1) >= argc) {
+                return false;
+            }
+            else if(opt == "--contents") {
+                out_opts.content_count = std::strtoul(argv[++i], nullptr, 10);
+            }
+            else if(opt == "--content-size-mb") {
+                out_opts.content_size = std::strtoull(argv[++i], nullptr, 10) * 1_MB;
+            }
+            else if(opt == "--dir") {
+                out_opts.dir = argv[++i];
+            }
+            else {
+                return false;
+            }
+        }
+
+        return out_opts.content_count > 0;
+    }
+
+    // Data only depends on the position in the package, so that extracted files can be checked without keeping anything around
+    void FillTestData(const u64 offset, u8 *buf, const size_t size) {
+        for(size_t i = 0; i < size; i++) {
+            const auto pos = offset + i;
+            auto x = (pos / sizeof(u64)) * 0x9E3779B97F4A7C15;
+            x ^= x >> 29;
+            buf[i] = static_cast<u8>(x >> ((pos % sizeof(u64)) * 8));
+        }
+    }
+
+    struct TestFile {
+        std::string name;
+        u64 size;
+    };
+
+    std::vector<TestFile> MakeTestFiles(const BenchOptions &opts) {
+        std::vector<TestFile> files;
+        for(u32 i = 0; i < opts.content_count; i++) {
+            char name[0x40] = {};
+            snprintf(name, sizeof(name), "%032x.nca", 0xC0DE0000 + i);
+            files.push_back({ name, std::max<u64>(opts.content_size >> i, 1_KB) });
+        }
+        files.push_back({ "c0de0000000000000000000000001000.cnmt.nca", 4_KB });
+        files.push_back({ "0100000000001000000000000000000a.tik", 0x2C0 });
+        files.push_back({ "0100000000001000000000000000000a.cert", 0x700 });
+        files.push_back({ "empty.bin", 0 });
+        return files;
+    }
+
+    bool CreateTestPackage(const std::vector<TestFile> &files, const std::string &path) {
+        std::string string_table;
+        std::vector<fs::PFS0::FileEntry> entries;
+        u64 data_size = 0;
+        for(const auto &file: files) {
+            entries.push_back({
+                .offset = data_size,
+                .size = file.size,
+                .string_table_offset = static_cast<u32>(string_table.length()),
+                .pad = 0
+            });
+            string_table += file.name;
+            string_table.push_back('\0');
+            data_size += file.size;
+        }
+        string_table.resize((string_table.length() + 0x1F) & ~0x1F, '\0');
+
+        const fs::PFS0::Header header = {
+            .magic = fs::PFS0::Magic,
+            .file_count = static_cast<u32>(files.size()),
+            .string_table_size = static_cast<u32>(string_table.length()),
+            .reserved = 0
+        };
+        auto f = fopen(path.c_str(), "wb");
+        if(f == nullptr) {
+            return false;
+        }
+        fwrite(&header, sizeof(header), 1, f);
+        fwrite(entries.data(), sizeof(fs::PFS0::FileEntry), entries.size(), f);
+        fwrite(string_table.data(), 1, string_table.length(), f);
+
+        std::vector<u8> buf(1_MB);
+        for(u64 offset = 0; offset < data_size; offset += buf.size()) {
+            const auto size = std::min<u64>(buf.size(), data_size - offset);
+            FillTestData(offset, buf.data(), size);
+            fwrite(buf.data(), 1, size, f);
+        }
+        fclose(f);
+        return true;
+    }
+
+    bool CheckExtractedFile(const std::string &path, const u64 data_offset, const u64 size) {
+        auto f = fopen(path.c_str(), "rb");
+        if(f == nullptr) {
+            return false;
+        }
+
+        std::vector<u8> buf(1_MB);
+        std::vector<u8> expected_buf(1_MB);
+        auto ok = true;
+        for(u64 offset = 0; offset < size; offset += buf.size()) {
+            const auto chunk_size = std::min<u64>(buf.size(), size - offset);
+            FillTestData(data_offset + offset, expected_buf.data(), chunk_size);
+            if((fread(buf.data(), 1, chunk_size, f) != chunk_size) || (memcmp(buf.data(), expected_buf.data(), chunk_size) != 0)) {
+                ok = false;
+                break;
+            }
+        }
+        // Nothing past the end either
+        if(ok && (fgetc(f) != EOF)) {
+            ok = false;
+        }
+        fclose(f);
+        return ok;
+    }
+
+    // Forces the sequential (single thread, started writes) path, as used for remote PCs
+    class SequentialStdExplorer : public fs::StdExplorer {
+        public:
+            virtual bool SupportsConcurrentWrites() override {
+                return false;
+            }
+    };
+
+    inline double ToMb(const u64 size) {
+        return (double)size / (double)1_MB;
+    }
+
+    inline double GetElapsedSeconds(const u64 start_tick) {
+        return (double)armTicksToNs(armGetSystemTick() - start_tick) / 1'000'000'000.0;
+    }
+
+    bool g_Failed = false;
+
+    void Check(const bool ok, const char *what) {
+        printf("  %-40s %s\n", what, ok ? "OK" : "FAILED");
+        if(!ok) {
+            g_Failed = true;
+        }
+    }
+
+    bool CheckExtractedFiles(fs::PFS0 &pfs0, const std::string &dir) {
+        for(u32 i = 0; i < pfs0.GetCount(); i++) {
+            // Data offsets are relative to the start of the package here, since that's what the test data depends on
+            const auto data_offset = pfs0.GetFileDataOffset(i) - pfs0.GetFileDataOffset(0);
+            if(!CheckExtractedFile(dir + "/" + pfs0.GetFile(i), data_offset, pfs0.GetFileSize(i))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    struct ExtractRun {
+        double secs;
+        u64 total_size;
+        bool progress_ok;
+    };
+
+    ExtractRun RunExtractAll(fs::PFS0 &pfs0, fs::Explorer *out_exp, const std::string &out_dir, Result &out_rc) {
+        u64 last_total_size = 0;
+        auto progress_ok = true;
+        const auto start_tick = armGetSystemTick();
+        out_rc = pfs0.ExtractAll(out_exp, out_dir, [&](const u32 idx, const u64 file_written_size, const u64 total_written_size) {
+            if((total_written_size < last_total_size) || (file_written_size > pfs0.GetFileSize(idx)) || (file_written_size > total_written_size)) {
+                progress_ok = false;
+            }
+            last_total_size = total_written_size;
+        });
+        return {
+            .secs = GetElapsedSeconds(start_tick),
+            .total_size = last_total_size,
+            .progress_ok = progress_ok
+        };
+    }
+
+}
+
+int main(int argc, char **argv) {
+    BenchOptions opts = {};
+    if(!ParseOptions(argc, argv, opts)) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    auto remove_dir = false;
+    if(opts.dir.empty()) {
+        char dir_template[] = "/dev/shm/gleaf-extract-XXXXXX";
+        const auto dir = mkdtemp(dir_template);
+        if(dir == nullptr) {
+            fprintf(stderr, "Unable to create a temporary directory in /dev/shm\n");
+            return 1;
+        }
+        opts.dir = dir;
+        remove_dir = true;
+    }
+
+    // Explorer paths need a mount name ('bench:/...'), which is just a directory here
+    std::error_code ec;
+    std::filesystem::create_directories(opts.dir + "/bench:", ec);
+    if(ec || (chdir(opts.dir.c_str()) != 0)) {
+        fprintf(stderr, "Unable to use '%s'\n", opts.dir.c_str());
+        return 1;
+    }
+
+    const auto files = MakeTestFiles(opts);
+    u64 total_size = 0;
+    for(const auto &file: files) {
+        total_size += file.size;
+    }
+    if(!CreateTestPackage(files, "bench:/test.nsp")) {
+        fprintf(stderr, "Unable to create the test package in '%s'\n", opts.dir.c_str());
+        return 1;
+    }
+
+    fs::StdExplorer exp;
+    exp.SetNames("bench", "Bench");
+    SequentialStdExplorer seq_exp;
+    seq_exp.SetNames("bench", "Bench");
+
+    printf("Extract bench: %.0f MB package with %zu files, in '%s'\n", ToMb(total_size), files.size(), opts.dir.c_str());
+    fs::PFS0 pfs0(&exp, "bench:/test.nsp");
+    Check(pfs0.IsOk() && (pfs0.GetCount() == files.size()), "Package");
+
+    // One file at a time through a single buffer, as the browser used to do
+    auto start_tick = armGetSystemTick();
+    std::filesystem::create_directories(opts.dir + "/bench:/save", ec);
+    for(u32 i = 0; i < pfs0.GetCount(); i++) {
+        pfs0.SaveFile(i, &exp, "bench:/save/" + pfs0.GetFile(i));
+    }
+    const auto save_secs = GetElapsedSeconds(start_tick);
+    Check(CheckExtractedFiles(pfs0, "bench:/save"), "SaveFile");
+    // Otherwise later runs would be slower, with the (memory-backed) directory holding several copies
+    exp.DeleteDirectory("bench:/save");
+
+    Result rc;
+    const auto seq_run = RunExtractAll(pfs0, &seq_exp, "bench:/seq", rc);
+    Check(R_SUCCEEDED(rc) && seq_run.progress_ok && (seq_run.total_size == total_size), "ExtractAll (sequential) progress");
+    Check(CheckExtractedFiles(pfs0, "bench:/seq"), "ExtractAll (sequential)");
+    exp.DeleteDirectory("bench:/seq");
+
+    const auto conc_run = RunExtractAll(pfs0, &exp, "bench:/extract", rc);
+    Check(R_SUCCEEDED(rc) && conc_run.progress_ok && (conc_run.total_size == total_size), "ExtractAll (concurrent) progress");
+    Check(CheckExtractedFiles(pfs0, "bench:/extract"), "ExtractAll (concurrent)");
+
+    // Extracting again over existing files must replace them, not append to them
+    const auto again_run = RunExtractAll(pfs0, &exp, "bench:/extract", rc);
+    Check(R_SUCCEEDED(rc) && (again_run.total_size == total_size) && CheckExtractedFiles(pfs0, "bench:/extract"), "ExtractAll over existing files");
+
+    printf("\n");
+    printf("SaveFile:                 %.0f MB in %.2f s (%.1f MB/s)\n", ToMb(total_size), save_secs, ToMb(total_size) / save_secs);
+    printf("ExtractAll (sequential):  %.0f MB in %.2f s (%.1f MB/s)\n", ToMb(total_size), seq_run.secs, ToMb(total_size) / seq_run.secs);
+    printf("ExtractAll (concurrent):  %.0f MB in %.2f s (%.1f MB/s, %.2fx SaveFile)\n", ToMb(total_size), conc_run.secs, ToMb(total_size) / conc_run.secs, save_secs / conc_run.secs);
+
+    if(remove_dir) {
+        chdir("/");
+        std::filesystem::remove_all(opts.dir, ec);
+    }
+    return g_Failed ? 1 : 0;
+}
@@ -0,0 +1,299 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <bench/bench_FakeInstallServices.hpp>
+#include <fcntl.h>
+
+namespace bench {
+
+    namespace {
+
+        // Same module/descriptions NCM uses
+        constexpr Result ResultPlaceHolderAlreadyExists = MAKERESULT(5, 2);
+        constexpr Result ResultPlaceHolderNotFound = MAKERESULT(5, 3);
+        constexpr Result ResultContentAlreadyExists = MAKERESULT(5, 4);
+        constexpr Result ResultInvalidOffset = MAKERESULT(5, 120);
+        constexpr Result ResultWriteToReadOnlyContentStorage = MAKERESULT(5, 280);
+
+        template<typename T>
+        inline std::string FormatId(const T &id) {
+            char id_str[2 * sizeof(id.c) + 1] = {};
+            for(u32 i = 0; i < sizeof(id.c); i++) {
+                snprintf(id_str + 2 * i, 3, "%02x", id.c[i]);
+            }
+            return id_str;
+        }
+
+        class FakeContentStorage : public nsp::ContentStorage {
+            private:
+                FakeInstallServices &svcs;
+
+            public:
+                FakeContentStorage(FakeInstallServices &svcs) : svcs(svcs) {}
+
+                Result Has(bool &out_has, const NcmContentId &cnt_id) override {
+                    return this->svcs.Has(out_has, cnt_id);
+                }
+
+                Result CreatePlaceHolder(const NcmContentId &cnt_id, const NcmPlaceHolderId &placehld_id, const s64 size) override {
+                    return this->svcs.CreatePlaceHolder(cnt_id, placehld_id, size);
+                }
+
+                Result DeletePlaceHolder(const NcmPlaceHolderId &placehld_id) override {
+                    return this->svcs.DeletePlaceHolder(placehld_id);
+                }
+
+                Result HasPlaceHolder(bool &out_has, const NcmPlaceHolderId &placehld_id) override {
+                    return this->svcs.HasPlaceHolder(out_has, placehld_id);
+                }
+
+                Result GetPlaceHolderSize(s64 &out_size, const NcmPlaceHolderId &placehld_id) override {
+                    return this->svcs.GetPlaceHolderSize(out_size, placehld_id);
+                }
+
+                Result GetPlaceHolderPath(char *out_path, const size_t out_path_size, const NcmPlaceHolderId &placehld_id) override {
+                    return this->svcs.GetPlaceHolderPath(out_path, out_path_size, placehld_id);
+                }
+
+                Result WritePlaceHolder(const NcmPlaceHolderId &placehld_id, const u64 offset, const void *buf, const size_t size) override {
+                    return this->svcs.WritePlaceHolder(placehld_id, offset, buf, size);
+                }
+
+                Result Register(const NcmContentId &cnt_id, const NcmPlaceHolderId &placehld_id) override {
+                    return this->svcs.Register(cnt_id, placehld_id);
+                }
+        };
+
+        class FakeContentMetaDatabase : public nsp::ContentMetaDatabase {
+            private:
+                FakeInstallServices &svcs;
+
+            public:
+                FakeContentMetaDatabase(FakeInstallServices &svcs) : svcs(svcs) {}
+
+                Result Set(const NcmContentMetaKey &meta_key, const void *data, const size_t size) override {
+                    this->svcs.NotifyMetaSet();
+                    return 0;
+                }
+
+                Result Commit() override {
+                    return 0;
+                }
+        };
+
+    }
+
+    std::string FakeInstallServices::MakePath(const std::string &name) {
+        return this->dir + "/" + name + ".nca";
+    }
+
+    FakeInstallServices::~FakeInstallServices() {
+        for(auto &[name, placehld]: this->placehlds) {
+            if(placehld.fd >= 0) {
+                close(placehld.fd);
+            }
+        }
+    }
+
+    Result FakeInstallServices::Has(bool &out_has, const NcmContentId &cnt_id) {
+        ScopedLock lk(this->lock);
+        out_has = this->cnts.contains(FormatId(cnt_id));
+        return 0;
+    }
+
+    Result FakeInstallServices::CreatePlaceHolder(const NcmContentId &cnt_id, const NcmPlaceHolderId &placehld_id, const s64 size) {
+        ScopedLock lk(this->lock);
+        const auto name = FormatId(placehld_id);
+        if(this->placehlds.contains(name)) {
+            return ResultPlaceHolderAlreadyExists;
+        }
+
+        auto fd = -1;
+        if(this->mode == FakeStorageMode::File) {
+            const auto path = this->MakePath(name);
+            fd = open(path.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+            if(fd < 0) {
+                return ResultWriteToReadOnlyContentStorage;
+            }
+            // Like NCM, the whole placeholder is allocated on creation
+            if(ftruncate(fd, size) != 0) {
+                close(fd);
+                return ResultWriteToReadOnlyContentStorage;
+            }
+        }
+
+        this->placehlds[name] = {
+            .cnt_id = cnt_id,
+            .size = size,
+            .written_size = 0,
+            .fd = fd
+        };
+        return 0;
+    }
+
+    Result FakeInstallServices::DeletePlaceHolder(const NcmPlaceHolderId &placehld_id) {
+        ScopedLock lk(this->lock);
+        const auto name = FormatId(placehld_id);
+        auto it = this->placehlds.find(name);
+        if(it == this->placehlds.end()) {
+            return ResultPlaceHolderNotFound;
+        }
+
+        if(it->second.fd >= 0) {
+            close(it->second.fd);
+            unlink(this->MakePath(name).c_str());
+        }
+        this->placehlds.erase(it);
+        return 0;
+    }
+
+    Result FakeInstallServices::HasPlaceHolder(bool &out_has, const NcmPlaceHolderId &placehld_id) {
+        ScopedLock lk(this->lock);
+        out_has = this->placehlds.contains(FormatId(placehld_id));
+        return 0;
+    }
+
+    Result FakeInstallServices::GetPlaceHolderSize(s64 &out_size, const NcmPlaceHolderId &placehld_id) {
+        ScopedLock lk(this->lock);
+        auto it = this->placehlds.find(FormatId(placehld_id));
+        if(it == this->placehlds.end()) {
+            return ResultPlaceHolderNotFound;
+        }
+
+        // Resumed installs rely on this being the actually written size
+        out_size = it->second.written_size;
+        return 0;
+    }
+
+    Result FakeInstallServices::GetPlaceHolderPath(char *out_path, const size_t out_path_size, const NcmPlaceHolderId &placehld_id) {
+        ScopedLock lk(this->lock);
+        const auto name = FormatId(placehld_id);
+        if(!this->placehlds.contains(name)) {
+            return ResultPlaceHolderNotFound;
+        }
+
+        snprintf(out_path, out_path_size, "%s", this->MakePath(name).c_str());
+        return 0;
+    }
+
+    Result FakeInstallServices::WritePlaceHolder(const NcmPlaceHolderId &placehld_id, const u64 offset, const void *buf, const size_t size) {
+        auto fd = -1;
+        {
+            ScopedLock lk(this->lock);
+            auto it = this->placehlds.find(FormatId(placehld_id));
+            if(it == this->placehlds.end()) {
+                return ResultPlaceHolderNotFound;
+            }
+
+            auto &placehld = it->second;
+            if((offset + size) > static_cast<u64>(placehld.size)) {
+                return ResultInvalidOffset;
+            }
+            placehld.written_size = std::max<s64>(placehld.written_size, offset + size);
+            this->stats.written_size += size;
+            fd = placehld.fd;
+        }
+
+        // Actual writes happen outside the lock, since different lanes write to different placeholders at once
+        if(fd >= 0) {
+            auto buf8 = reinterpret_cast<const u8*>(buf);
+            size_t done_size = 0;
+            while(done_size < size) {
+                const auto tmp_written_size = pwrite(fd, buf8 + done_size, size - done_size, offset + done_size);
+                if(tmp_written_size <= 0) {
+                    return ResultWriteToReadOnlyContentStorage;
+                }
+                done_size += tmp_written_size;
+            }
+        }
+        return 0;
+    }
+
+    Result FakeInstallServices::Register(const NcmContentId &cnt_id, const NcmPlaceHolderId &placehld_id) {
+        ScopedLock lk(this->lock);
+        const auto placehld_name = FormatId(placehld_id);
+        auto it = this->placehlds.find(placehld_name);
+        if(it == this->placehlds.end()) {
+            return ResultPlaceHolderNotFound;
+        }
+
+        const auto cnt_name = FormatId(cnt_id);
+        if(this->cnts.contains(cnt_name)) {
+            return ResultContentAlreadyExists;
+        }
+
+        if(it->second.fd >= 0) {
+            close(it->second.fd);
+            rename(this->MakePath(placehld_name).c_str(), this->MakePath(cnt_name).c_str());
+        }
+        this->cnts[cnt_name] = it->second.size;
+        this->placehlds.erase(it);
+        this->stats.registered_count++;
+        return 0;
+    }
+
+    void FakeInstallServices::NotifyMetaSet() {
+        ScopedLock lk(this->lock);
+        this->stats.meta_count++;
+    }
+
+    FakeInstallServicesStats FakeInstallServices::GetStats() {
+        ScopedLock lk(this->lock);
+        return this->stats;
+    }
+
+    Result FakeInstallServices::OpenContentStorage(const NcmStorageId storage_id, std::unique_ptr<nsp::ContentStorage> &out_cnt_storage) {
+        {
+            ScopedLock lk(this->lock);
+            this->stats.content_storage_count++;
+        }
+        out_cnt_storage = std::make_unique<FakeContentStorage>(*this);
+        return 0;
+    }
+
+    Result FakeInstallServices::OpenContentMetaDatabase(const NcmStorageId storage_id, std::unique_ptr<nsp::ContentMetaDatabase> &out_cnt_meta_db) {
+        out_cnt_meta_db = std::make_unique<FakeContentMetaDatabase>(*this);
+        return 0;
+    }
+
+    Result FakeInstallServices::ImportTicket(const void *tik_buf, const size_t tik_size, const void *cert_buf, const size_t cert_size) {
+        return 0;
+    }
+
+    Result FakeInstallServices::CountApplicationContentMeta(const u64 app_id, s32 &out_count) {
+        out_count = 0;
+        return 0;
+    }
+
+    Result FakeInstallServices::ListApplicationRecordContentMeta(const u64 app_id, NsExtContentStorageMetaKey *out_keys, const s32 count, u32 &out_count) {
+        out_count = 0;
+        return 0;
+    }
+
+    Result FakeInstallServices::DeleteApplicationRecord(const u64 app_id) {
+        return 0;
+    }
+
+    Result FakeInstallServices::PushApplicationRecord(const u64 app_id, const NsExtContentStorageMetaKey *keys, const size_t count) {
+        return 0;
+    }
+
+}
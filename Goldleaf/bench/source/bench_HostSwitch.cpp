@@ -0,0 +1,164 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <base.hpp>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
+#include <fcntl.h>
+#include <filesystem>
+
+// Host implementations of the libnx functions declared in the switch.h stand-in, plus the few Goldleaf base functions the pipeline uses
+
+namespace {
+
+    // A single lock/condition pair for every event keeps waiting on several of them (waitObjects) trivial, and contention is irrelevant at chunk granularity
+    std::mutex g_EventLock;
+    std::condition_variable g_EventCondition;
+
+    thread_local char g_LogBuffer[GLEAF_LOG_BUFFER_SIZE];
+
+}
+
+void ueventCreate(UEvent *event, bool auto_clear) {
+    std::scoped_lock lk(g_EventLock);
+    event->signaled = false;
+    event->auto_clear = auto_clear;
+}
+
+void ueventSignal(UEvent *event) {
+    {
+        std::scoped_lock lk(g_EventLock);
+        event->signaled = true;
+    }
+    g_EventCondition.notify_all();
+}
+
+void ueventClear(UEvent *event) {
+    std::scoped_lock lk(g_EventLock);
+    event->signaled = false;
+}
+
+Result waitObjects(s32 *idx_out, const Waiter *objects, s32 num_objects, u64 timeout) {
+    std::unique_lock lk(g_EventLock);
+    const auto find_signaled = [&]() {
+        for(s32 i = 0; i < num_objects; i++) {
+            auto event = objects[i].event;
+            if(event->signaled) {
+                if(event->auto_clear) {
+                    event->signaled = false;
+                }
+                *idx_out = i;
+                return true;
+            }
+        }
+        return false;
+    };
+
+    if(timeout == UINT64_MAX) {
+        g_EventCondition.wait(lk, find_signaled);
+        return 0;
+    }
+    else {
+        // Same value libnx returns on timeouts (KernelError_TimedOut)
+        return g_EventCondition.wait_for(lk, std::chrono::nanoseconds(timeout), find_signaled) ? 0 : MAKERESULT(1, 117);
+    }
+}
+
+Result threadCreate(Thread *t, ThreadFunc entry, void *arg, void *stack_mem, size_t stack_sz, int prio, int cpuid) {
+    t->entry = entry;
+    t->arg = arg;
+    t->impl = nullptr;
+    return 0;
+}
+
+Result threadStart(Thread *t) {
+    t->impl = new std::thread(t->entry, t->arg);
+    return 0;
+}
+
+Result threadWaitForExit(Thread *t) {
+    auto thr = reinterpret_cast<std::thread*>(t->impl);
+    if((thr != nullptr) && thr->joinable()) {
+        thr->join();
+    }
+    return 0;
+}
+
+Result threadClose(Thread *t) {
+    threadWaitForExit(t);
+    delete reinterpret_cast<std::thread*>(t->impl);
+    t->impl = nullptr;
+    return 0;
+}
+
+u64 armGetSystemTick() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void aes128CtrContextCreate(Aes128CtrContext *out, const void *key, const void *ctr) {
+    mbedtls_aes_init(&out->aes);
+    mbedtls_aes_setkey_enc(&out->aes, reinterpret_cast<const u8*>(key), 128);
+    aes128CtrContextResetCtr(out, ctr);
+}
+
+void aes128CtrContextResetCtr(Aes128CtrContext *ctx, const void *ctr) {
+    memcpy(ctx->ctr, ctr, sizeof(ctx->ctr));
+    memset(ctx->enc_ctr_buffer, 0, sizeof(ctx->enc_ctr_buffer));
+    ctx->buffer_offset = 0;
+}
+
+void aes128CtrCrypt(Aes128CtrContext *ctx, void *dst, const void *src, size_t size) {
+    mbedtls_aes_crypt_ctr(&ctx->aes, size, &ctx->buffer_offset, ctx->ctr, ctx->enc_ctr_buffer, reinterpret_cast<const u8*>(src), reinterpret_cast<u8*>(dst));
+}
+
+int fsdevCreateFile(const char *path, size_t size, u32 flags) {
+    const auto fd = open(path, O_CREAT | O_WRONLY, 0644);
+    if(fd < 0) {
+        return -1;
+    }
+    close(fd);
+    return 0;
+}
+
+int fsdevDeleteDirectoryRecursively(const char *path) {
+    std::error_code ec;
+    std::filesystem::remove_all(path, ec);
+    return ec ? -1 : 0;
+}
+
+Result fsdevSetConcatenationFileAttribute(const char *path) {
+    // Host filesystems have no file size limits to work around
+    return 0;
+}
+
+void SetThreadName(const std::string &name) {
+    // Linux thread names are limited to 15 characters
+    pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+}
+
+char *GetLogBuffer() {
+    return g_LogBuffer;
+}
+
+void LogImpl(const char *log_buf, const size_t log_buf_len) {
+    fwrite(log_buf, 1, log_buf_len, stderr);
+}
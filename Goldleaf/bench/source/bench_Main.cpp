@@ -0,0 +1,304 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <bench/bench_FakeInstallServices.hpp>
+#include <nsp/nsp_ContentWriter.hpp>
+#include <fs/fs_FileSystem.hpp>
+#include <mbedtls/sha256.h>
+#include <sys/resource.h>
+#include <thread>
+
+// Runs synthetic packages (any number of multi-GB contents) through the actual install write pipeline (nsp::WriteContents: write lanes, NCM writes,
+// hashing and work buffer pool), against fake NCM services, and reports throughput, queue depth and memory high-water mark
+
+namespace {
+
+    struct BenchOptions {
+        u32 cnt_count = 4;
+        u64 cnt_size = 1_GB;
+        u32 lane_count = 2;
+        size_t buffer_size = fs::DefaultWorkBufferSize;
+        size_t chunk_size = 0;
+        bool verify = false;
+        double source_mbps = 0.0;
+        std::string store_dir;
+        std::string report_path;
+    };
+
+    void PrintUsage(const char *argv0) {
+        fprintf(stderr, "Usage: %s [options]\n", argv0);
+        fprintf(stderr, "  --contents <n>         Number of contents (default: 4)\n");
+        fprintf(stderr, "  --content-size-mb <n>  Size of each content (default: 1024)\n");
+        fprintf(stderr, "  --lanes <n>            Write lanes (default: 2)\n");
+        fprintf(stderr, "  --buffer-kb <n>        Write buffer size (default: %zu)\n", fs::DefaultWorkBufferSize / 1_KB);
+        fprintf(stderr, "  --chunk-kb <n>         Source read chunk size (default: buffer size)\n");
+        fprintf(stderr, "  --verify               Hash written contents and verify them\n");
+        fprintf(stderr, "  --source-mbps <n>      Throttle the source to this speed, like USB/network sources (default: unlimited)\n");
+        fprintf(stderr, "  --store <dir>          Write contents to files in this directory instead of discarding them\n");
+        fprintf(stderr, "  --report <path>        Save the install report JSON here\n");
+    }
+
+    bool ParseOptions(const int argc, char **argv, BenchOptions &out_opts) {
+        for(int i = 1; i < argc; i++) {
+            const std::string opt = argv[i];
+            const auto has_value = (i + 1) < argc;
+            if(opt == "--verify") {
+                out_opts.verify = true;
+            }
+            else if(!has_value) {
+                return false;
+            }
+            else if(opt == "--contents") {
+                out_opts.cnt_count = std::strtoul(argv[++i], nullptr, 10);
+            }
+            else if(opt == "--content-size-mb") {
+                out_opts.cnt_size = std::strtoull(argv[++i], nullptr, 10) * 1_MB;
+            }
+            else if(opt == "--lanes") {
+                out_opts.lane_count = std::strtoul(argv[++i], nullptr, 10);
+            }
+            else if(opt == "--buffer-kb") {
+                out_opts.buffer_size = std::strtoull(argv[++i], nullptr, 10) * 1_KB;
+            }
+            else if(opt == "--chunk-kb") {
+                out_opts.chunk_size = std::strtoull(argv[++i], nullptr, 10) * 1_KB;
+            }
+            else if(opt == "--source-mbps") {
+                out_opts.source_mbps = std::strtod(argv[++i], nullptr);
+            }
+            else if(opt == "--store") {
+                out_opts.store_dir = argv[++i];
+            }
+            else if(opt == "--report") {
+                out_opts.report_path = argv[++i];
+            }
+            else {
+                return false;
+            }
+        }
+
+        if(out_opts.chunk_size == 0) {
+            out_opts.chunk_size = out_opts.buffer_size;
+        }
+        return (out_opts.cnt_count > 0) && (out_opts.cnt_size > 0) && (out_opts.lane_count > 0) && (out_opts.buffer_size > 0) && ((out_opts.buffer_size % sizeof(u64)) == 0) && ((out_opts.chunk_size % sizeof(u64)) == 0);
+    }
+
+    // Cheap, position-dependent data: every chunk of every content is different, so that hashing (and the disk in file mode) sees realistic data
+    void FillSyntheticData(const u32 cnt_idx, const u64 offset, void *buf, const u64 size) {
+        auto buf64 = reinterpret_cast<u64*>(buf);
+        const auto base_idx = (static_cast<u64>(cnt_idx) << 48) | (offset / sizeof(u64));
+        for(u64 i = 0; i < (size / sizeof(u64)); i++) {
+            auto x = (base_idx + i) * 0x9E3779B97F4A7C15;
+            buf64[i] = x ^ (x >> 29);
+        }
+        memset(reinterpret_cast<u8*>(buf) + (size / sizeof(u64)) * sizeof(u64), 0xFF, size % sizeof(u64));
+    }
+
+    class SyntheticContentReader : public nsp::ContentReader {
+        private:
+            size_t chunk_size;
+            double source_mbps;
+            u64 read_size;
+            u64 start_tick;
+
+        public:
+            SyntheticContentReader(const size_t chunk_size, const double source_mbps) : chunk_size(chunk_size), source_mbps(source_mbps), read_size(0), start_tick(0) {}
+
+            void Start() override {
+                this->start_tick = armGetSystemTick();
+            }
+
+            void End() override {}
+
+            u64 GetChunkSize(const u64 rem_size) override {
+                return std::min<u64>(rem_size, this->chunk_size);
+            }
+
+            u64 Read(const u32 entry_idx, const u64 offset, const u64 size, void *read_buf) override {
+                FillSyntheticData(entry_idx, offset, read_buf, size);
+                this->read_size += size;
+
+                if(this->source_mbps > 0.0) {
+                    const auto target_ns = static_cast<u64>(((double)this->read_size / (this->source_mbps * 1_MB)) * 1'000'000'000.0);
+                    const auto elapsed_ns = armTicksToNs(armGetSystemTick() - this->start_tick);
+                    if(target_ns > elapsed_ns) {
+                        std::this_thread::sleep_for(std::chrono::nanoseconds(target_ns - elapsed_ns));
+                    }
+                }
+                return size;
+            }
+    };
+
+    void ComputeSyntheticHash(const u32 cnt_idx, const u64 cnt_size, u8 *buf, const size_t buf_size, u8 (&out_hash)[SHA256_HASH_SIZE]) {
+        mbedtls_sha256_context sha_ctx;
+        mbedtls_sha256_init(&sha_ctx);
+        mbedtls_sha256_starts(&sha_ctx, 0);
+        u64 offset = 0;
+        while(offset < cnt_size) {
+            const auto size = std::min<u64>(buf_size, cnt_size - offset);
+            FillSyntheticData(cnt_idx, offset, buf, size);
+            mbedtls_sha256_update(&sha_ctx, buf, size);
+            offset += size;
+        }
+        mbedtls_sha256_finish(&sha_ctx, out_hash);
+        mbedtls_sha256_free(&sha_ctx);
+    }
+
+    template<typename T>
+    inline T MakeSyntheticId(const u32 idx, const u8 kind) {
+        T id = {};
+        id.c[0] = kind;
+        memcpy(id.c + sizeof(id.c) - sizeof(idx), &idx, sizeof(idx));
+        return id;
+    }
+
+    inline double ToMb(const u64 size) {
+        return (double)size / (double)1_MB;
+    }
+
+}
+
+fs::StdExplorer *fs::GetSdCardExplorer() {
+    static StdExplorer g_SdCardExplorer;
+    static std::once_flag g_Initialized;
+    std::call_once(g_Initialized, []() {
+        g_SdCardExplorer.SetNames("sdmc", "SdCard");
+    });
+    return &g_SdCardExplorer;
+}
+
+int main(int argc, char **argv) {
+    BenchOptions opts = {};
+    if(!ParseOptions(argc, argv, opts)) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    const auto storage_mode = opts.store_dir.empty() ? bench::FakeStorageMode::Memory : bench::FakeStorageMode::File;
+    bench::FakeInstallServices svcs(storage_mode, opts.store_dir);
+    std::unique_ptr<nsp::ContentStorage> cnt_storage;
+    GLEAF_RC_ASSERT(svcs.OpenContentStorage(NcmStorageId_SdCard, cnt_storage));
+
+    std::vector<std::array<u8, SHA256_HASH_SIZE>> cnt_hashes(opts.cnt_count);
+    if(opts.verify) {
+        printf("Precomputing content hashes...\n");
+        auto hash_buf = fs::AllocateWorkBuffer(opts.buffer_size);
+        for(u32 i = 0; i < opts.cnt_count; i++) {
+            u8 hash[SHA256_HASH_SIZE];
+            ComputeSyntheticHash(i, opts.cnt_size, hash_buf, opts.buffer_size, hash);
+            memcpy(cnt_hashes.at(i).data(), hash, sizeof(hash));
+        }
+        fs::DeleteWorkBuffer(hash_buf);
+    }
+
+    std::vector<nsp::ContentWriteEntry> entries;
+    for(u32 i = 0; i < opts.cnt_count; i++) {
+        const auto cnt_id = MakeSyntheticId<NcmContentId>(i, 0xC0);
+        const auto placehld_id = MakeSyntheticId<NcmPlaceHolderId>(i, 0xF0);
+        GLEAF_RC_ASSERT(cnt_storage->CreatePlaceHolder(cnt_id, placehld_id, opts.cnt_size));
+        entries.push_back({
+            .type = (i == 0) ? NcmContentType_Program : NcmContentType_Data,
+            .placehld_id = placehld_id,
+            .size = opts.cnt_size,
+            .written_size = 0,
+            .read_offset = 0,
+            .read_size = opts.cnt_size,
+            .compressed = false,
+            .expected_hash = opts.verify ? cnt_hashes.at(i).data() : nullptr
+        });
+    }
+
+    const auto total_size = static_cast<u64>(opts.cnt_count) * opts.cnt_size;
+    printf("Synthetic install: %u contents x %.0f MB (%.2f GB), %u lanes, %zu KB buffers, %zu KB chunks, %s storage, hashing %s\n", opts.cnt_count, ToMb(opts.cnt_size), (double)total_size / (double)1_GB, opts.lane_count, opts.buffer_size / 1_KB, opts.chunk_size / 1_KB, (storage_mode == bench::FakeStorageMode::Memory) ? "memory" : "file", opts.verify ? "on" : "off");
+
+    SyntheticContentReader reader(opts.chunk_size, opts.source_mbps);
+    const nsp::ContentWriteOptions write_opts = {
+        .storage_id = NcmStorageId_SdCard,
+        .lane_count = opts.lane_count,
+        .buffer_size = opts.buffer_size,
+        .on_start_write_fn = nullptr,
+        .on_content_write_fn = nullptr,
+        .on_content_commit_fn = nullptr,
+        .on_read_done_fn = nullptr
+    };
+
+    nsp::InstallStats stats;
+    u32 mismatch_entry_idx = 0;
+    stats.NotifyWriteStart();
+    const auto write_rc = nsp::WriteContents(svcs, *cnt_storage, entries, reader, write_opts, stats, mismatch_entry_idx);
+    stats.NotifyWriteEnd();
+    if(write_rc == rc::goldleaf::ResultContentHashMismatch) {
+        fprintf(stderr, "Content %u does not match its hash\n", mismatch_entry_idx);
+        return 1;
+    }
+    else if(R_FAILED(write_rc)) {
+        fprintf(stderr, "Write failed: 0x%X\n", write_rc);
+        return 1;
+    }
+
+    for(u32 i = 0; i < opts.cnt_count; i++) {
+        const auto register_start_tick = armGetSystemTick();
+        GLEAF_RC_ASSERT(cnt_storage->Register(MakeSyntheticId<NcmContentId>(i, 0xC0), entries.at(i).placehld_id));
+        stats.Record(nsp::InstallStage::Register, 0, armGetSystemTick() - register_start_tick);
+    }
+
+    nsp::InstallReport report = {
+        .package_path = "<synthetic>",
+        .package_size = total_size,
+        .storage_id = NcmStorageId_SdCard,
+        .write_lane_count = opts.lane_count,
+        .copy_buffer_size = opts.chunk_size,
+        .verify_content_hashes = opts.verify,
+        .completed = true,
+        .write_duration_ms = 0.0,
+        .avg_queue_depth = 0.0,
+        .max_queue_depth = 0,
+        .stages = {}
+    };
+    stats.FillReport(report);
+
+    const auto svcs_stats = svcs.GetStats();
+    const auto pool_stats = fs::GetWorkBufferPoolStats();
+    struct rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+
+    printf("\n");
+    printf("Written:          %.0f MB in %.1f ms (%u contents registered, %u storage sessions)\n", ToMb(svcs_stats.written_size), report.write_duration_ms, svcs_stats.registered_count, svcs_stats.content_storage_count);
+    printf("Throughput:       %.1f MB/s\n", (report.write_duration_ms > 0.0) ? (ToMb(svcs_stats.written_size) / (report.write_duration_ms / 1000.0)) : 0.0);
+    printf("Queue depth:      avg %.2f, max %u buffers\n", report.avg_queue_depth, report.max_queue_depth);
+    printf("Work buffers:     high-water %.1f MB (%lu checkouts, %lu reused)\n", ToMb(pool_stats.high_water_size), pool_stats.checkout_count, pool_stats.reuse_count);
+    printf("Max RSS:          %.1f MB\n", (double)usage.ru_maxrss / 1024.0);
+    printf("\n");
+    printf("%-16s %10s %8s %12s %12s %10s %10s\n", "Stage", "MB", "Chunks", "Busy (ms)", "MB/s", "p50 (ms)", "p99 (ms)");
+    for(const auto &stage: report.stages) {
+        printf("%-16s %10.0f %8lu %12.1f %12.1f %10.3f %10.3f\n", stage.stage.c_str(), ToMb(stage.size), stage.chunk_count, stage.busy_ms, stage.throughput_mbps, stage.p50_chunk_ms, stage.p99_chunk_ms);
+    }
+
+    if(!opts.report_path.empty()) {
+        const auto err = glz::write_file_json<PartialJsonOptions{}>(report, opts.report_path, std::string{});
+        if(err) {
+            fprintf(stderr, "Failed to save report to '%s'\n", opts.report_path.c_str());
+            return 1;
+        }
+        printf("\nSaved report to '%s'\n", opts.report_path.c_str());
+    }
+    return 0;
+}
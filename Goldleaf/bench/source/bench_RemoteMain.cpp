@@ -0,0 +1,406 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <bench/bench_RemoteServer.hpp>
+#include <fs/fs_RemotePCExplorer.hpp>
+#include <usb/usb_PipeTransport.hpp>
+#include <usb/usb_SocketTransport.hpp>
+#include <filesystem>
+#include <thread>
+
+// Runs the Remote PC command framework (usb::cmd, usb::cf and fs::RemotePCExplorer, exactly as Goldleaf uses them) against the reference server, over an
+// in-process pipe or a TCP socket: checks that files are listed, read, written, hashed, renamed and deleted correctly (and directory sizes), and reports read/write throughput
+
+namespace {
+
+    enum class BenchTransport {
+        Pipe,
+        Tcp
+    };
+
+    struct BenchOptions {
+        BenchTransport transport = BenchTransport::Pipe;
+        u16 port = 32101;
+        u64 file_size = 256_MB;
+        size_t block_size = fs::DefaultWorkBufferSize;
+        bool compressible = true;
+        bool legacy = false;
+        usb::cf::Feature features = usb::cf::SupportedFeatures;
+        std::string dir;
+        bool serve = false;
+    };
+
+    void PrintUsage(const char *argv0) {
+        fprintf(stderr, "Usage: %s [options]\n", argv0);
+        fprintf(stderr, "  --transport <pipe|tcp>  Connection between Goldleaf and the server (default: pipe)\n");
+        fprintf(stderr, "  --port <n>              TCP port (default: 32101)\n");
+        fprintf(stderr, "  --file-size-mb <n>      Size of the test file (default: 256)\n");
+        fprintf(stderr, "  --block-kb <n>          Read/write block size (default: %zu)\n", fs::DefaultWorkBufferSize / 1_KB);
+        fprintf(stderr, "  --random                Incompressible test data (default: half of it compresses well)\n");
+        fprintf(stderr, "  --legacy                Server without handshake support, like older Quark versions\n");
+        fprintf(stderr, "  --no-compression        Don't negotiate payload compression\n");
+        fprintf(stderr, "  --no-pipelining         Don't negotiate command pipelining\n");
+        fprintf(stderr, "  --no-hashing            Don't negotiate hashing on the server\n");
+        fprintf(stderr, "  --no-tree-stats         Don't negotiate directory sizes computed on the server\n");
+        fprintf(stderr, "  --dir <dir>             Directory served as the only drive (default: a temporary one)\n");
+        fprintf(stderr, "  --serve                 Only run the reference server on the TCP port, serving --dir\n");
+    }
+
+    bool ParseOptions(const int argc, char **argv, BenchOptions &out_opts) {
+        for(int i = 1; i < argc; i++) {
+            const std::string opt = argv[i];
+            const auto has_value = (i + 1) < argc;
+            if(opt == "--random") {
+                out_opts.compressible = false;
+            }
+            else if(opt == "--legacy") {
+                out_opts.legacy = true;
+            }
+            else if(opt == "--no-compression") {
+                out_opts.features = out_opts.features & ~usb::cf::Feature::Compression;
+            }
+            else if(opt == "--no-pipelining") {
+                out_opts.features = out_opts.features & ~usb::cf::Feature::Pipelining;
+            }
+            else if(opt == "--no-hashing") {
+                out_opts.features = out_opts.features & ~usb::cf::Feature::Hashing;
+            }
+            else if(opt == "--no-tree-stats") {
+                out_opts.features = out_opts.features & ~usb::cf::Feature::TreeStats;
+            }
+            else if(opt == "--serve") {
+                out_opts.serve = true;
+            }
+            else if(!has_value) {
+                return false;
+            }
+            else if(opt == "--transport") {
+                const std::string transport = argv[++i];
+                if(transport == "pipe") {
+                    out_opts.transport = BenchTransport::Pipe;
+                }
+                else if(transport == "tcp") {
+                    out_opts.transport = BenchTransport::Tcp;
+                }
+                else {
+                    return false;
+                }
+            }
+            else if(opt == "--port") {
+                out_opts.port = std::strtoul(argv[++i], nullptr, 10);
+            }
+            else if(opt == "--file-size-mb") {
+                out_opts.file_size = std::strtoull(argv[++i], nullptr, 10) * 1_MB;
+            }
+            else if(opt == "--block-kb") {
+                out_opts.block_size = std::strtoull(argv[++i], nullptr, 10) * 1_KB;
+            }
+            else if(opt == "--dir") {
+                out_opts.dir = argv[++i];
+            }
+            else {
+                return false;
+            }
+        }
+
+        return (out_opts.block_size > 0) && (!out_opts.serve || !out_opts.dir.empty());
+    }
+
+    // Every 1MB is either random-looking or a repeated text line, so that compression has something to do (unless everything is random)
+    void FillTestData(const bool compressible, const u64 offset, u8 *buf, const size_t size) {
+        constexpr char TextLine[] = "Goldleaf remote PC bench: the quick brown fox jumps over the lazy dog\n";
+        for(size_t i = 0; i < size; i++) {
+            const auto pos = offset + i;
+            if(compressible && (((pos / 1_MB) % 2) == 1)) {
+                buf[i] = TextLine[pos % (sizeof(TextLine) - 1)];
+            }
+            else {
+                auto x = (pos / sizeof(u64)) * 0x9E3779B97F4A7C15;
+                x ^= x >> 29;
+                buf[i] = static_cast<u8>(x >> ((pos % sizeof(u64)) * 8));
+            }
+        }
+    }
+
+    bool CreateTestFile(const BenchOptions &opts, const std::string &path) {
+        auto f = fopen(path.c_str(), "wb");
+        if(f == nullptr) {
+            return false;
+        }
+
+        std::vector<u8> buf(1_MB);
+        for(u64 offset = 0; offset < opts.file_size; offset += buf.size()) {
+            const auto size = std::min<u64>(buf.size(), opts.file_size - offset);
+            FillTestData(opts.compressible, offset, buf.data(), size);
+            fwrite(buf.data(), 1, size, f);
+        }
+        fclose(f);
+        return true;
+    }
+
+    inline double ToMb(const u64 size) {
+        return (double)size / (double)1_MB;
+    }
+
+    inline double GetElapsedSeconds(const u64 start_tick) {
+        return (double)armTicksToNs(armGetSystemTick() - start_tick) / 1'000'000'000.0;
+    }
+
+    struct ServerContext {
+        BenchOptions opts;
+        usb::StreamTransport *transport;
+        bench::RemoteServerStats stats;
+    };
+
+    void ServerMain(void *ctx_raw) {
+        auto ctx = reinterpret_cast<ServerContext*>(ctx_raw);
+
+        std::unique_ptr<usb::SocketTransport> sock_transport;
+        if(ctx->transport == nullptr) {
+            GLEAF_RC_ASSERT(usb::AcceptSocketTransport(ctx->opts.port, sock_transport));
+            ctx->transport = sock_transport.get();
+        }
+
+        const bench::RemoteServerOptions server_opts = {
+            .root_dir = ctx->opts.dir,
+            .protocol_version = ctx->opts.legacy ? 0 : usb::cf::ProtocolVersion,
+            .max_block_size = usb::cf::MaxBlockSize,
+            .features = ctx->opts.features
+        };
+        bench::RemoteServer server(*ctx->transport, server_opts);
+        server.Run();
+        ctx->stats = server.GetStats();
+    }
+
+    bool g_Failed = false;
+
+    void Check(const bool ok, const char *what) {
+        printf("  %-40s %s\n", what, ok ? "OK" : "FAILED");
+        if(!ok) {
+            g_Failed = true;
+        }
+    }
+
+    void RunClient(const BenchOptions &opts) {
+        const auto info = usb::cf::GetProtocolInfo();
+        if(info.IsLegacy()) {
+            printf("Protocol:         legacy (no handshake)\n");
+        }
+        else {
+            printf("Protocol:         version %u, max block size %.0f MB, features 0x%lX\n", info.version, ToMb(info.max_block_size), static_cast<u64>(info.features));
+        }
+
+        fs::RemotePCExplorer exp(bench::RemoteServerDriveName);
+        const std::string file_name = "test.bin";
+        const std::string copy_name = "copy.bin";
+        const auto file_path = exp.MakeFull(file_name);
+        const auto copy_path = exp.MakeFull(copy_name);
+
+        printf("\nChecks:\n");
+        const auto files = exp.GetFiles(exp.GetCwd());
+        const auto dirs = exp.GetDirectories(exp.GetCwd());
+        Check(std::find(files.begin(), files.end(), file_name) != files.end(), "Test file listed");
+        Check(std::find(dirs.begin(), dirs.end(), "sub") != dirs.end(), "Subdirectory listed");
+        Check(exp.IsFile(file_path) && exp.IsDirectory(exp.MakeFull("sub")) && !exp.Exists(exp.MakeFull("missing")), "Paths stat'd");
+        Check(exp.GetFileSize(file_path) == opts.file_size, "File size");
+
+        auto buf = fs::AllocateWorkBuffer(opts.block_size);
+        std::vector<u8> expected(opts.block_size);
+
+        // Read the whole file, verifying every block
+        auto read_ok = true;
+        auto start_tick = armGetSystemTick();
+        exp.StartFile(file_path, fs::FileMode::Read);
+        u64 offset = 0;
+        while(offset < opts.file_size) {
+            const auto size = std::min<u64>(opts.block_size, opts.file_size - offset);
+            const auto read_size = exp.ReadFile(file_path, offset, size, buf);
+            if(read_size != size) {
+                read_ok = false;
+                break;
+            }
+
+            FillTestData(opts.compressible, offset, expected.data(), size);
+            if(std::memcmp(buf, expected.data(), size) != 0) {
+                read_ok = false;
+                break;
+            }
+            offset += size;
+        }
+        exp.EndFile();
+        const auto read_secs = GetElapsedSeconds(start_tick);
+        Check(read_ok, "File read and verified");
+
+        // Write a copy of it, which is then checked on the host side
+        start_tick = armGetSystemTick();
+        exp.StartFile(copy_path, fs::FileMode::Write);
+        offset = 0;
+        while(offset < opts.file_size) {
+            const auto size = std::min<u64>(opts.block_size, opts.file_size - offset);
+            FillTestData(opts.compressible, offset, buf, size);
+            exp.WriteFile(copy_path, buf, size);
+            offset += size;
+        }
+        exp.EndFile();
+        const auto write_secs = GetElapsedSeconds(start_tick);
+
+        auto write_ok = std::filesystem::file_size(opts.dir + "/" + copy_name) == opts.file_size;
+        if(write_ok) {
+            auto f = fopen((opts.dir + "/" + copy_name).c_str(), "rb");
+            for(offset = 0; write_ok && (offset < opts.file_size); offset += opts.block_size) {
+                const auto size = std::min<u64>(opts.block_size, opts.file_size - offset);
+                FillTestData(opts.compressible, offset, expected.data(), size);
+                write_ok = (fread(buf, 1, size, f) == size) && (std::memcmp(buf, expected.data(), size) == 0);
+            }
+            fclose(f);
+        }
+        Check(write_ok, "File written and verified");
+
+        exp.RenameFile(copy_path, "renamed.bin");
+        Check(!exp.Exists(copy_path) && exp.IsFile(exp.MakeFull("renamed.bin")), "File renamed");
+        exp.DeleteFile(exp.MakeFull("renamed.bin"));
+        Check(!exp.Exists(exp.MakeFull("renamed.bin")), "File deleted");
+
+        fs::DeleteWorkBuffer(buf);
+
+        // Hashed by the server (when supported) and by reading the file through the (base) threaded implementation, which must match
+        fs::FileHash remote_hash = {};
+        fs::FileHash read_hash = {};
+        start_tick = armGetSystemTick();
+        const auto remote_hash_ok = exp.ComputeHash(file_path, 0, opts.file_size, fs::HashAlgorithm::Sha256, remote_hash, nullptr);
+        const auto remote_hash_secs = GetElapsedSeconds(start_tick);
+        start_tick = armGetSystemTick();
+        const auto read_hash_ok = exp.Explorer::ComputeHash(file_path, 0, opts.file_size, fs::HashAlgorithm::Sha256, read_hash, nullptr);
+        const auto read_hash_secs = GetElapsedSeconds(start_tick);
+        Check(remote_hash_ok && read_hash_ok && (remote_hash == read_hash), "File hashed");
+
+        const auto range_offset = opts.file_size / 3;
+        const auto range_size = opts.file_size / 2 + 123;
+        const auto remote_range_ok = exp.ComputeHash(file_path, range_offset, range_size, fs::HashAlgorithm::Sha256, remote_hash, nullptr);
+        const auto read_range_ok = exp.Explorer::ComputeHash(file_path, range_offset, range_size, fs::HashAlgorithm::Sha256, read_hash, nullptr);
+        Check(remote_range_ok && read_range_ok && (remote_hash == read_hash), "File range hashed");
+
+        // Computed by the server (when supported) and by walking the tree
+        start_tick = armGetSystemTick();
+        const auto remote_dir_size = exp.GetDirectorySize(exp.GetCwd());
+        const auto remote_dir_size_secs = GetElapsedSeconds(start_tick);
+        start_tick = armGetSystemTick();
+        const auto walked_dir_size = exp.Explorer::GetDirectorySize(exp.GetCwd());
+        const auto walked_dir_size_secs = GetElapsedSeconds(start_tick);
+        Check((remote_dir_size == walked_dir_size) && (remote_dir_size >= opts.file_size), "Directory size");
+
+        printf("\n");
+        printf("Read:             %.0f MB in %.2f s (%.1f MB/s)\n", ToMb(opts.file_size), read_secs, ToMb(opts.file_size) / read_secs);
+        printf("Write:            %.0f MB in %.2f s (%.1f MB/s)\n", ToMb(opts.file_size), write_secs, ToMb(opts.file_size) / write_secs);
+        printf("Hash:             %.2f s (%s), %.2f s reading the whole file\n", remote_hash_secs, usb::cf::IsFeatureSupported(usb::cf::Feature::Hashing) ? "on the server" : "reading the file", read_hash_secs);
+        printf("Directory size:   %.2f ms (%s), %.2f ms walking the tree\n", remote_dir_size_secs * 1000.0, exp.IsDirectorySizeFast() ? "on the server" : "walking the tree", walked_dir_size_secs * 1000.0);
+    }
+
+}
+
+int main(int argc, char **argv) {
+    BenchOptions opts = {};
+    if(!ParseOptions(argc, argv, opts)) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    ServerContext server_ctx = {
+        .opts = opts,
+        .transport = nullptr,
+        .stats = {}
+    };
+    if(opts.serve) {
+        printf("Serving '%s' on port %u...\n", opts.dir.c_str(), opts.port);
+        ServerMain(&server_ctx);
+        return 0;
+    }
+
+    auto remove_dir = false;
+    if(opts.dir.empty()) {
+        char dir_template[] = "/tmp/gleaf-remote-XXXXXX";
+        opts.dir = mkdtemp(dir_template);
+        remove_dir = true;
+    }
+    server_ctx.opts = opts;
+    // A few nested entries for directory sizes
+    std::filesystem::create_directories(opts.dir + "/sub/deep");
+    for(const auto &[name, size]: { std::pair<const char*, u64>("sub/a.bin", 1000), std::pair<const char*, u64>("sub/deep/b.bin", 12345) }) {
+        auto f = fopen((opts.dir + "/" + name).c_str(), "wb");
+        if(f != nullptr) {
+            ftruncate(fileno(f), size);
+            fclose(f);
+        }
+    }
+    if(!CreateTestFile(opts, opts.dir + "/test.bin")) {
+        fprintf(stderr, "Unable to create the test file in '%s'\n", opts.dir.c_str());
+        return 1;
+    }
+
+    usb::PipeConnection pipe_conn;
+    std::unique_ptr<usb::SocketTransport> sock_transport;
+    if(opts.transport == BenchTransport::Pipe) {
+        server_ctx.transport = &pipe_conn.GetServerEnd();
+    }
+
+    Thread server_thread;
+    GLEAF_RC_ASSERT(threadCreate(&server_thread, ServerMain, &server_ctx, nullptr, 512_KB, 0x1F, -2));
+    GLEAF_RC_ASSERT(threadStart(&server_thread));
+
+    if(opts.transport == BenchTransport::Pipe) {
+        usb::SetTransport(&pipe_conn.GetClientEnd());
+    }
+    else {
+        // The server might not be listening yet
+        for(u32 i = 0; i < 50; i++) {
+            if(R_SUCCEEDED(usb::ConnectSocketTransport("127.0.0.1", opts.port, sock_transport))) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        if(!sock_transport) {
+            fprintf(stderr, "Unable to connect to port %u\n", opts.port);
+            return 1;
+        }
+        usb::SetTransport(sock_transport.get());
+    }
+
+    printf("Remote PC bench: %.0f MB %s test file, %zu KB blocks, over %s\n", ToMb(opts.file_size), opts.compressible ? "(partially compressible)" : "(random)", opts.block_size / 1_KB, (opts.transport == BenchTransport::Pipe) ? "an in-process pipe" : "TCP");
+    RunClient(opts);
+
+    // Closing the connection makes the server stop
+    usb::SetTransport(nullptr);
+    if(opts.transport == BenchTransport::Pipe) {
+        pipe_conn.Close();
+    }
+    else {
+        sock_transport->Close();
+    }
+    threadWaitForExit(&server_thread);
+    threadClose(&server_thread);
+
+    printf("Server:           %lu commands, %.0f MB read (%.1f MB sent), %.0f MB written (%.1f MB received)\n", server_ctx.stats.cmd_count, ToMb(server_ctx.stats.read_size), ToMb(server_ctx.stats.sent_payload_size), ToMb(server_ctx.stats.written_size), ToMb(server_ctx.stats.received_payload_size));
+    if(remove_dir) {
+        std::error_code ec;
+        std::filesystem::remove_all(opts.dir, ec);
+    }
+    return g_Failed ? 1 : 0;
+}
@@ -0,0 +1,617 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <bench/bench_RemoteServer.hpp>
+#include <usb/cmd/cmd_Compression.hpp>
+#include <zstd.h>
+#include <mbedtls/sha256.h>
+#include <fcntl.h>
+#include <filesystem>
+
+namespace bench {
+
+    namespace {
+
+        // Same results Quark reports
+        constexpr Result ResultExceptionCaught = 0xBAF1;
+        constexpr Result ResultInvalidIndex = 0xBAF2;
+        constexpr Result ResultInvalidFileMode = 0xBAF3;
+        constexpr Result ResultSelectionCancelled = 0xBAF4;
+
+        class InBlockReader {
+            private:
+                const u8 *block;
+                size_t offset;
+
+            public:
+                InBlockReader(const u8 *block) : block(block), offset(0) {}
+
+                template<typename T>
+                T Read() {
+                    T t = {};
+                    if((this->offset + sizeof(T)) <= usb::cmd::BlockSize) {
+                        std::memcpy(&t, this->block + this->offset, sizeof(T));
+                        this->offset += sizeof(T);
+                    }
+                    return t;
+                }
+
+                std::string ReadString() {
+                    const auto len = std::min<size_t>(this->Read<u32>(), usb::cmd::BlockSize - this->offset);
+                    const std::string str(reinterpret_cast<const char*>(this->block + this->offset), len);
+                    this->offset += len;
+                    return str;
+                }
+        };
+
+        class OutBlockWriter {
+            private:
+                u8 block[usb::cmd::BlockSize];
+                size_t header_size;
+                size_t offset;
+
+            public:
+                OutBlockWriter(const bool tagged, const u32 tag) : block(), header_size(0), offset(0) {
+                    this->Write(tagged ? usb::cmd::OutputTaggedMagic : usb::cmd::OutputMagic);
+                    this->Write(rc::ResultSuccess);
+                    if(tagged) {
+                        this->Write(tag);
+                    }
+                    this->header_size = this->offset;
+                }
+
+                template<typename T>
+                void Write(const T &t) {
+                    if((this->offset + sizeof(T)) <= usb::cmd::BlockSize) {
+                        std::memcpy(this->block + this->offset, &t, sizeof(T));
+                        this->offset += sizeof(T);
+                    }
+                }
+
+                void WriteString(const std::string &str) {
+                    const auto len = std::min<size_t>(str.length(), usb::cmd::BlockSize - this->offset - sizeof(u32));
+                    this->Write(static_cast<u32>(len));
+                    std::memcpy(this->block + this->offset, str.data(), len);
+                    this->offset += len;
+                }
+
+                // Failed responses only have the header
+                void SetResult(const Result rc) {
+                    std::memcpy(this->block + sizeof(u32), &rc, sizeof(rc));
+                    if(R_FAILED(rc)) {
+                        std::memset(this->block + this->header_size, 0, usb::cmd::BlockSize - this->header_size);
+                    }
+                }
+
+                inline const u8 *GetBlock() {
+                    return this->block;
+                }
+        };
+
+        // Sorted, so that indices stay stable between commands
+        std::vector<std::filesystem::directory_entry> ListEntries(const std::string &dir) {
+            std::vector<std::filesystem::directory_entry> entries;
+            std::error_code ec;
+            for(const auto &entry: std::filesystem::directory_iterator(dir, ec)) {
+                if(entry.is_regular_file(ec) || entry.is_directory(ec)) {
+                    entries.push_back(entry);
+                }
+            }
+
+            std::sort(entries.begin(), entries.end(), [](const std::filesystem::directory_entry &a, const std::filesystem::directory_entry &b) {
+                return a.path().filename() < b.path().filename();
+            });
+            return entries;
+        }
+
+        std::vector<std::string> ListNames(const std::string &dir, const bool dirs) {
+            std::vector<std::string> names;
+            std::error_code ec;
+            for(const auto &entry: ListEntries(dir)) {
+                if(entry.is_directory(ec) == dirs) {
+                    names.push_back(entry.path().filename().string());
+                }
+            }
+            return names;
+        }
+
+        Result ComputeFileHash(const std::string &path, const u64 offset, const u64 size, const fs::HashAlgorithm algo, fs::FileHash &out_hash, u64 &out_hashed_size) {
+            GLEAF_RC_UNLESS(algo == fs::HashAlgorithm::Sha256, ResultExceptionCaught);
+            const auto fd = open(path.c_str(), O_RDONLY);
+            GLEAF_RC_UNLESS(fd >= 0, ResultExceptionCaught);
+            if(static_cast<u64>(lseek(fd, 0, SEEK_END)) < offset) {
+                close(fd);
+                return ResultExceptionCaught;
+            }
+
+            mbedtls_sha256_context sha_ctx;
+            mbedtls_sha256_init(&sha_ctx);
+            mbedtls_sha256_starts(&sha_ctx, 0);
+            std::vector<u8> buf(1_MB);
+            u64 hashed_size = 0;
+            while(hashed_size < size) {
+                const auto ret = pread(fd, buf.data(), std::min<u64>(buf.size(), size - hashed_size), offset + hashed_size);
+                if(ret <= 0) {
+                    break;
+                }
+                mbedtls_sha256_update(&sha_ctx, buf.data(), ret);
+                hashed_size += ret;
+            }
+            close(fd);
+
+            out_hash = {};
+            mbedtls_sha256_finish(&sha_ctx, out_hash.data());
+            mbedtls_sha256_free(&sha_ctx);
+            out_hashed_size = hashed_size;
+            GLEAF_RC_SUCCEED;
+        }
+
+        Result ComputeTreeStats(const std::string &dir, usb::cf::TreeStats &out_stats) {
+            std::error_code ec;
+            GLEAF_RC_UNLESS(std::filesystem::is_directory(dir, ec), ResultExceptionCaught);
+
+            // Like Quark: symlinked directories are counted but not followed, and unreadable ones are skipped
+            out_stats = {};
+            for(auto it = std::filesystem::recursive_directory_iterator(dir, std::filesystem::directory_options::skip_permission_denied, ec); !ec && (it != std::filesystem::recursive_directory_iterator()); it.increment(ec)) {
+                if(it->is_directory(ec)) {
+                    out_stats.dir_count++;
+                }
+                else if(it->is_regular_file(ec)) {
+                    out_stats.total_size += it->file_size(ec);
+                    out_stats.file_count++;
+                }
+            }
+            GLEAF_RC_SUCCEED;
+        }
+
+    }
+
+    RemoteServer::~RemoteServer() {
+        this->EndFile(fs::FileMode::Read);
+        this->EndFile(fs::FileMode::Write);
+    }
+
+    std::string RemoteServer::MakeHostPath(const std::string &path) {
+        // Everything is inside the only drive, whatever the drive name is
+        const auto root_end = path.find(':');
+        auto host_path = this->opts.root_dir;
+        const auto rel_path = (root_end != std::string::npos) ? path.substr(root_end + 1) : std::string();
+        if(!rel_path.empty() && (rel_path.front() != '/')) {
+            host_path += "/";
+        }
+        return host_path + rel_path;
+    }
+
+    void RemoteServer::ResetNegotiatedState() {
+        this->features = usb::cf::Feature::None;
+    }
+
+    Result RemoteServer::SendPayload(const void *buf, const size_t size) {
+        if(!((this->features & usb::cf::Feature::Compression) == usb::cf::Feature::Compression) || (size == 0)) {
+            this->stats.sent_payload_size += size;
+            return this->transport.WriteBytes(buf, size);
+        }
+
+        // Same layout as usb::cmd::WriteCompressedPayload
+        const auto buf8 = reinterpret_cast<const u8*>(buf);
+        const auto chunk_count = (size + usb::cmd::CompressionChunkSize - 1) / usb::cmd::CompressionChunkSize;
+        std::vector<u32> table(chunk_count);
+        std::vector<std::vector<u8>> chunks(chunk_count);
+        for(size_t i = 0; i < chunk_count; i++) {
+            const auto raw_chunk = buf8 + i * usb::cmd::CompressionChunkSize;
+            const auto raw_size = std::min(usb::cmd::CompressionChunkSize, size - i * usb::cmd::CompressionChunkSize);
+            auto &chunk = chunks.at(i);
+            chunk.resize(raw_size);
+            const auto ret = ZSTD_compress(chunk.data(), raw_size - 1, raw_chunk, raw_size, usb::cmd::CompressionLevel);
+            if(ZSTD_isError(ret)) {
+                std::memcpy(chunk.data(), raw_chunk, raw_size);
+            }
+            else {
+                chunk.resize(ret);
+            }
+            table.at(i) = chunk.size();
+            this->stats.sent_payload_size += chunk.size();
+        }
+        this->stats.sent_payload_size += table.size() * sizeof(u32);
+
+        GLEAF_RC_TRY(this->transport.WriteBytes(table.data(), table.size() * sizeof(u32)));
+        for(const auto &chunk: chunks) {
+            GLEAF_RC_TRY(this->transport.WriteBytes(chunk.data(), chunk.size()));
+        }
+        GLEAF_RC_SUCCEED;
+    }
+
+    Result RemoteServer::ReceivePayload(void *buf, const size_t size) {
+        if(!((this->features & usb::cf::Feature::Compression) == usb::cf::Feature::Compression) || (size == 0)) {
+            this->stats.received_payload_size += size;
+            return this->transport.ReadBytes(buf, size);
+        }
+
+        auto buf8 = reinterpret_cast<u8*>(buf);
+        const auto chunk_count = (size + usb::cmd::CompressionChunkSize - 1) / usb::cmd::CompressionChunkSize;
+        std::vector<u32> table(chunk_count);
+        GLEAF_RC_TRY(this->transport.ReadBytes(table.data(), table.size() * sizeof(u32)));
+        this->stats.received_payload_size += table.size() * sizeof(u32);
+
+        std::vector<u8> chunk;
+        for(size_t i = 0; i < chunk_count; i++) {
+            const auto raw_size = std::min(usb::cmd::CompressionChunkSize, size - i * usb::cmd::CompressionChunkSize);
+            const auto stored_size = table.at(i);
+            GLEAF_RC_UNLESS((stored_size > 0) && (stored_size <= raw_size), rc::goldleaf::ResultInvalidCompressedPayload);
+            this->stats.received_payload_size += stored_size;
+
+            auto raw_chunk = buf8 + i * usb::cmd::CompressionChunkSize;
+            if(stored_size == raw_size) {
+                GLEAF_RC_TRY(this->transport.ReadBytes(raw_chunk, raw_size));
+            }
+            else {
+                chunk.resize(stored_size);
+                GLEAF_RC_TRY(this->transport.ReadBytes(chunk.data(), stored_size));
+                const auto ret = ZSTD_decompress(raw_chunk, raw_size, chunk.data(), stored_size);
+                GLEAF_RC_UNLESS(!ZSTD_isError(ret) && (ret == raw_size), rc::goldleaf::ResultInvalidCompressedPayload);
+            }
+        }
+        GLEAF_RC_SUCCEED;
+    }
+
+    Result RemoteServer::StartFile(const std::string &path, const fs::FileMode mode) {
+        this->EndFile(mode);
+        switch(mode) {
+            case fs::FileMode::Read: {
+                this->read_fd = open(path.c_str(), O_RDONLY);
+                return (this->read_fd >= 0) ? rc::ResultSuccess : ResultExceptionCaught;
+            }
+            case fs::FileMode::Write:
+            case fs::FileMode::Append: {
+                this->write_fd = open(path.c_str(), O_WRONLY | O_CREAT | ((mode == fs::FileMode::Append) ? O_APPEND : O_TRUNC), 0644);
+                return (this->write_fd >= 0) ? rc::ResultSuccess : ResultExceptionCaught;
+            }
+            default: {
+                return ResultInvalidFileMode;
+            }
+        }
+    }
+
+    void RemoteServer::EndFile(const fs::FileMode mode) {
+        auto &fd = (mode == fs::FileMode::Read) ? this->read_fd : this->write_fd;
+        if(fd >= 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    void RemoteServer::Run() {
+        u8 in_block[usb::cmd::BlockSize];
+        while(R_SUCCEEDED(this->transport.ReadBytes(in_block, sizeof(in_block)))) {
+            InBlockReader in(in_block);
+            const auto magic = in.Read<u32>();
+            const auto tagged = magic == usb::cmd::InputTaggedMagic;
+            if(!tagged && (magic != usb::cmd::InputMagic)) {
+                GLEAF_WARN_FMT("Remote server: invalid command magic 0x%X", magic);
+                return;
+            }
+
+            const auto cmd_id = in.Read<u32>();
+            const auto tag = tagged ? in.Read<u32>() : 0;
+            this->stats.cmd_count++;
+
+            // Payloads (if any) follow the response block, and only for successful commands
+            auto rc = rc::ResultSuccess;
+            OutBlockWriter out(tagged, tag);
+            std::vector<u8> out_payload;
+            auto has_out_payload = false;
+            auto raw_out_payload = false;
+
+            switch(cmd_id) {
+                // GetDriveCount
+                case 1: {
+                    out.Write(static_cast<u32>(1));
+                    break;
+                }
+                // GetDriveInfo
+                case 2: {
+                    if(in.Read<u32>() == 0) {
+                        const auto space = std::filesystem::space(this->opts.root_dir);
+                        out.WriteString("Root");
+                        out.WriteString(RemoteServerDriveName);
+                        out.Write(static_cast<u64>(space.capacity));
+                        out.Write(static_cast<u64>(space.free));
+                    }
+                    else {
+                        rc = ResultInvalidIndex;
+                    }
+                    break;
+                }
+                // StatPath
+                case 3: {
+                    const auto path = in.ReadString();
+                    if((path == usb::cf::HandshakeProbePath) && (this->opts.protocol_version > 0)) {
+                        this->ResetNegotiatedState();
+                        out.Write(usb::cf::PathType::HandshakeSupported);
+                        out.Write(static_cast<u64>(0));
+                        break;
+                    }
+
+                    std::error_code ec;
+                    const auto host_path = this->MakeHostPath(path);
+                    auto type = usb::cf::PathType::Invalid;
+                    u64 file_size = 0;
+                    if(std::filesystem::is_regular_file(host_path, ec)) {
+                        type = usb::cf::PathType::File;
+                        file_size = std::filesystem::file_size(host_path, ec);
+                    }
+                    else if(std::filesystem::is_directory(host_path, ec)) {
+                        type = usb::cf::PathType::Directory;
+                    }
+                    out.Write(type);
+                    out.Write(file_size);
+                    break;
+                }
+                // GetFileCount, GetDirectoryCount
+                case 4:
+                case 6: {
+                    const auto names = ListNames(this->MakeHostPath(in.ReadString()), cmd_id == 6);
+                    out.Write(static_cast<u32>(names.size()));
+                    break;
+                }
+                // GetFile, GetDirectory
+                case 5:
+                case 7: {
+                    const auto names = ListNames(this->MakeHostPath(in.ReadString()), cmd_id == 7);
+                    const auto idx = in.Read<u32>();
+                    if(idx < names.size()) {
+                        out.WriteString(names.at(idx));
+                    }
+                    else {
+                        rc = ResultInvalidIndex;
+                    }
+                    break;
+                }
+                // StartFile
+                case 8: {
+                    const auto path = this->MakeHostPath(in.ReadString());
+                    rc = this->StartFile(path, in.Read<fs::FileMode>());
+                    break;
+                }
+                // ReadFile
+                case 9: {
+                    const auto path = this->MakeHostPath(in.ReadString());
+                    const auto offset = in.Read<u64>();
+                    const auto size = in.Read<u64>();
+
+                    auto fd = this->read_fd;
+                    if(fd < 0) {
+                        fd = open(path.c_str(), O_RDONLY);
+                    }
+                    if(fd < 0) {
+                        rc = ResultExceptionCaught;
+                        break;
+                    }
+
+                    // Like Quark, the whole requested size is always sent (past the end of the file is just zeros)
+                    out_payload.resize(size);
+                    u64 read_size = 0;
+                    while(read_size < size) {
+                        const auto ret = pread(fd, out_payload.data() + read_size, size - read_size, offset + read_size);
+                        if(ret <= 0) {
+                            break;
+                        }
+                        read_size += ret;
+                    }
+                    if(fd != this->read_fd) {
+                        close(fd);
+                    }
+
+                    this->stats.read_size += read_size;
+                    out.Write(read_size);
+                    has_out_payload = true;
+                    break;
+                }
+                // WriteFile
+                case 10: {
+                    const auto path = this->MakeHostPath(in.ReadString());
+                    const auto size = in.Read<u64>();
+
+                    std::vector<u8> data(size);
+                    if(R_FAILED(this->ReceivePayload(data.data(), size))) {
+                        return;
+                    }
+
+                    auto fd = this->write_fd;
+                    if(fd < 0) {
+                        fd = open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+                    }
+                    if(fd < 0) {
+                        rc = ResultExceptionCaught;
+                        break;
+                    }
+
+                    const auto ret = (fd == this->write_fd) ? write(fd, data.data(), size) : pwrite(fd, data.data(), size, 0);
+                    if(fd != this->write_fd) {
+                        close(fd);
+                    }
+                    if(ret != static_cast<ssize_t>(size)) {
+                        rc = ResultExceptionCaught;
+                        break;
+                    }
+
+                    this->stats.written_size += size;
+                    out.Write(size);
+                    break;
+                }
+                // EndFile
+                case 11: {
+                    const auto mode = in.Read<fs::FileMode>();
+                    if((mode == fs::FileMode::Read) || (mode == fs::FileMode::Write) || (mode == fs::FileMode::Append)) {
+                        this->EndFile(mode);
+                    }
+                    else {
+                        rc = ResultInvalidFileMode;
+                    }
+                    break;
+                }
+                // Create
+                case 12: {
+                    const auto path = this->MakeHostPath(in.ReadString());
+                    const auto type = in.Read<usb::cf::PathType>();
+                    if(type == usb::cf::PathType::File) {
+                        const auto fd = open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+                        if(fd >= 0) {
+                            close(fd);
+                        }
+                    }
+                    else if(type == usb::cf::PathType::Directory) {
+                        mkdir(path.c_str(), 0755);
+                    }
+                    break;
+                }
+                // Delete
+                case 13: {
+                    std::error_code ec;
+                    std::filesystem::remove_all(this->MakeHostPath(in.ReadString()), ec);
+                    break;
+                }
+                // Rename
+                case 14: {
+                    const std::filesystem::path path = this->MakeHostPath(in.ReadString());
+                    const auto new_name = in.ReadString();
+                    std::error_code ec;
+                    std::filesystem::rename(path, path.parent_path() / new_name, ec);
+                    break;
+                }
+                // GetSpecialPathCount
+                case 15: {
+                    out.Write(static_cast<u32>(0));
+                    break;
+                }
+                // GetSpecialPath
+                case 16: {
+                    rc = ResultInvalidIndex;
+                    break;
+                }
+                // SelectFile
+                case 17: {
+                    rc = ResultSelectionCancelled;
+                    break;
+                }
+                // ListDirectory
+                case 18: {
+                    const auto entries = ListEntries(this->MakeHostPath(in.ReadString()));
+                    std::error_code ec;
+                    for(const auto &entry: entries) {
+                        const auto is_dir = entry.is_directory(ec);
+                        const auto name = entry.path().filename().string();
+                        const auto mod_time = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::file_clock::to_sys(entry.last_write_time(ec)).time_since_epoch()).count();
+                        const u32 type = static_cast<u32>(is_dir ? usb::cf::PathType::Directory : usb::cf::PathType::File);
+                        const u64 size = is_dir ? 0 : entry.file_size(ec);
+                        const u32 name_len = name.length();
+                        const auto append = [&](const void *data, const size_t data_size) {
+                            const auto data8 = reinterpret_cast<const u8*>(data);
+                            out_payload.insert(out_payload.end(), data8, data8 + data_size);
+                        };
+                        append(&type, sizeof(type));
+                        append(&size, sizeof(size));
+                        append(&mod_time, sizeof(u64));
+                        append(&name_len, sizeof(name_len));
+                        append(name.data(), name_len);
+                    }
+
+                    out.Write(static_cast<u32>(entries.size()));
+                    out.Write(static_cast<u64>(out_payload.size()));
+                    has_out_payload = true;
+                    raw_out_payload = true;
+                    break;
+                }
+                // Handshake
+                case 19: {
+                    if(this->opts.protocol_version == 0) {
+                        GLEAF_WARN_FMT("Remote server: unsupported command %d", cmd_id);
+                        return;
+                    }
+
+                    in.Read<u32>();
+                    in.Read<u64>();
+                    this->features = this->opts.features & in.Read<usb::cf::Feature>();
+
+                    out.Write(this->opts.protocol_version);
+                    out.Write(this->opts.max_block_size);
+                    out.Write(this->opts.features);
+                    break;
+                }
+                // HashFile
+                case 20: {
+                    if((this->features & usb::cf::Feature::Hashing) != usb::cf::Feature::Hashing) {
+                        GLEAF_WARN_FMT("Remote server: unsupported command %d", cmd_id);
+                        return;
+                    }
+
+                    const auto path = this->MakeHostPath(in.ReadString());
+                    const auto offset = in.Read<u64>();
+                    const auto size = in.Read<u64>();
+                    const auto algo = in.Read<fs::HashAlgorithm>();
+
+                    fs::FileHash hash;
+                    u64 hashed_size = 0;
+                    rc = ComputeFileHash(path, offset, size, algo, hash, hashed_size);
+                    if(R_SUCCEEDED(rc)) {
+                        this->stats.hashed_size += hashed_size;
+                        out.Write(hash);
+                    }
+                    break;
+                }
+                // GetTreeStats
+                case 21: {
+                    if((this->features & usb::cf::Feature::TreeStats) != usb::cf::Feature::TreeStats) {
+                        GLEAF_WARN_FMT("Remote server: unsupported command %d", cmd_id);
+                        return;
+                    }
+
+                    usb::cf::TreeStats tree_stats;
+                    rc = ComputeTreeStats(this->MakeHostPath(in.ReadString()), tree_stats);
+                    if(R_SUCCEEDED(rc)) {
+                        out.Write(tree_stats.total_size);
+                        out.Write(tree_stats.file_count);
+                        out.Write(tree_stats.dir_count);
+                    }
+                    break;
+                }
+                default: {
+                    // Same as Quark, which just drops the connection
+                    GLEAF_WARN_FMT("Remote server: unsupported command %d", cmd_id);
+                    return;
+                }
+            }
+
+            out.SetResult(rc);
+            if(R_FAILED(this->transport.WriteBytes(out.GetBlock(), usb::cmd::BlockSize))) {
+                return;
+            }
+
+            if(R_SUCCEEDED(rc) && has_out_payload) {
+                const auto payload_rc = raw_out_payload ? this->transport.WriteBytes(out_payload.data(), out_payload.size()) : this->SendPayload(out_payload.data(), out_payload.size());
+                if(R_FAILED(payload_rc)) {
+                    return;
+                }
+            }
+        }
+    }
+
+}
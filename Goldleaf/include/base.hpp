@@ -121,6 +121,7 @@ inline constexpr size_t operator ""_GB(unsigned long long n) {
 #define GLEAF_PATH_LOG_FILE GLEAF_PATH_ROOT_DIR "/goldleaf.log"
 
 #define GLEAF_PATH_SETTINGS_FILE GLEAF_PATH_ROOT_DIR "/settings.json"
+#define GLEAF_PATH_INSTALL_JOURNAL_FILE GLEAF_PATH_ROOT_DIR "/install_journal.json"
 #define GLEAF_PATH_TEMP_UPDATE_NRO GLEAF_PATH_ROOT_DIR "/temp_update.nro"
 
 #define GLEAF_PATH_METADATA_DIR GLEAF_PATH_ROOT_DIR "/meta"
@@ -137,7 +138,6 @@ inline constexpr size_t operator ""_GB(unsigned long long n) {
 
 #define GLEAF_NAND_INSTALL_TEMP_DIR_NAME "gleaf-temp"
 #define GLEAF_PATH_NAND_INSTALL_TEMP_DIR "Contents/" GLEAF_NAND_INSTALL_TEMP_DIR_NAME
-#define GLEAF_FS_PATH_NAND_INSTALL_TEMP_DIR "@SystemContent://" GLEAF_NAND_INSTALL_TEMP_DIR_NAME
 
 #define GLEAF_DEFINE_FLAG_ENUM(enum_type, base_type) \
 inline constexpr enum_type operator|(const enum_type lhs, const enum_type rhs) { \
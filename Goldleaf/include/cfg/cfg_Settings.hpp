@@ -44,6 +44,9 @@ namespace cfg {
         }
     }
 
+    constexpr u32 DefaultInstallWriteLaneCount = 2;
+    constexpr u32 MaxInstallWriteLaneCount = 4;
+
     namespace json {
 
         struct GeneralSettings {
@@ -91,14 +94,24 @@ namespace cfg {
             }
         };
 
+        struct TunedChunkSize {
+            std::string source;
+            std::string destination;
+            size_t size;
+        };
+
         struct FsSettings {
             std::optional<bool> compute_directory_sizes;
             std::optional<bool> ignore_hidden_files;
+            std::optional<bool> adaptive_chunk_size;
+            std::optional<std::vector<TunedChunkSize>> tuned_chunk_sizes;
 
             static inline FsSettings MakeDefault() {
                 return {
                     .compute_directory_sizes = false,
-                    .ignore_hidden_files = false
+                    .ignore_hidden_files = false,
+                    .adaptive_chunk_size = true,
+                    .tuned_chunk_sizes = std::vector<TunedChunkSize>{}
                 };
             }
         };
@@ -107,12 +120,16 @@ namespace cfg {
             std::optional<bool> ignore_required_fw_version;
             std::optional<bool> show_deletion_prompt_after_install;
             std::optional<size_t> copy_buffer_max_size;
+            std::optional<u32> write_lane_count;
+            std::optional<bool> verify_content_hashes;
 
             static inline InstallsSettings MakeDefault() {
                 return {
                     .ignore_required_fw_version = true,
                     .show_deletion_prompt_after_install = true,
-                    .copy_buffer_max_size = 8_MB
+                    .copy_buffer_max_size = 8_MB,
+                    .write_lane_count = DefaultInstallWriteLaneCount,
+                    .verify_content_hashes = false
                 };
             }
         };
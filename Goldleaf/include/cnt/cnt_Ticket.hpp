@@ -131,6 +131,9 @@ namespace cnt {
     bool TryFindApplicationTicket(const u64 app_id, Ticket &out_tik);
     Result RemoveTicket(const Ticket &tik);
     TicketFile ReadTicket(const std::string &path);
+    bool ReadTicket(const u8 *tik_buf, const size_t tik_size, TicketFile &out_tik_file);
+    // Same layout as ticket files (signature, its data and the ticket data)
+    std::vector<u8> SerializeTicket(const TicketFile &tik_file);
     void SaveTicket(fs::Explorer *exp, const std::string &path, const TicketFile tik_file);
 
 }
@@ -20,13 +20,21 @@
 */
 
 #include <fs/fs_FileSystem.hpp>
+#include <cnt/cnt_Ticket.hpp>
 
 namespace expt {
 
-    using DecryptStartCallback = std::function<void(const double)>;
     using DecryptProgressCallback = std::function<void(const double)>;
 
-    Result DecryptCopyNax0ToNca(NcmContentStorage *cnt_storage, const NcmContentId cnt_id, const std::string &path, DecryptStartCallback dec_start_cb, DecryptProgressCallback dec_prog_cb);
+    using ContentWriteFunction = std::function<Result(const void*, const size_t)>;
+
+    // Reads a content's NCA in chunks (decrypting the NAX0 files of SD card contents), passing them to the write function
+    Result StreamContent(NcmContentStorage *cnt_storage, const NcmStorageId cnt_storage_id, const NcmContentId cnt_id, const fs::StorageKind dst_kind, ContentWriteFunction write_fn, DecryptProgressCallback prog_cb);
+
+    // The application's ticket, from the system's ES savedata
+    cnt::TicketFile ReadTicket(const u64 app_id);
+    // As used in ticket/certificate file names
+    std::string FormatRightsId(const cnt::TicketFile &tik_file);
     std::string ExportTicketCert(const u64 app_id, const bool export_cert);
     std::string GetContentIdPath(NcmContentStorage *cnt_storage, const NcmContentId cnt_id);
 
@@ -0,0 +1,77 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+#include <fs/fs_Explorer.hpp>
+
+namespace fs {
+
+    // Adaptive chunk sizes: the first seconds of a transfer are spent trying increasing chunk sizes (up to the buffer size the caller allocated),
+    // and the one with the best measured throughput is used for the rest of it and remembered (per source/destination storage kind) for later transfers
+
+    constexpr size_t ChunkSizeTunerMinSize = 512_KB;
+    constexpr u64 ChunkSizeTunerProbeTimeNs = 300'000'000;
+    constexpr u32 ChunkSizeTunerProbeMinChunkCount = 2;
+
+    const char *GetStorageKindName(const StorageKind kind);
+    StorageKind GetStorageKindForStorageId(const NcmStorageId storage_id);
+
+    // Transfers (usually running on worker threads) only keep what they learn in memory, this persists it to the settings and must be called from the UI thread
+    void SaveTunedChunkSizes();
+
+    // Makes transfers from/to this storage kind probe chunk sizes again (like after the remote PC reconnects, since it may be a different one or use a different port)
+    void ForgetTunedChunkSizes(const StorageKind kind);
+    void ForgetTunedChunkSizes();
+
+    class ChunkSizeTuner {
+        private:
+            StorageKind src_kind;
+            StorageKind dst_kind;
+            std::vector<size_t> probe_sizes;
+            u32 cur_probe_idx;
+            u64 probe_start_tick;
+            u64 probe_size;
+            u32 probe_chunk_count;
+            double best_throughput;
+            size_t best_chunk_size;
+            size_t chunk_size;
+            bool probing;
+            bool converged;
+
+            void FinishProbe();
+
+        public:
+            ChunkSizeTuner(const StorageKind src_kind, const StorageKind dst_kind, const size_t max_size);
+            ~ChunkSizeTuner();
+
+            inline size_t GetChunkSize() const {
+                return this->chunk_size;
+            }
+
+            inline size_t GetChunkSize(const u64 rem_size) const {
+                return std::min<u64>(rem_size, this->chunk_size);
+            }
+
+            // Must be called after each chunk is fully transferred (read and written), so that the elapsed time between calls measures it
+            void NotifyTransferred(const size_t size);
+    };
+
+}
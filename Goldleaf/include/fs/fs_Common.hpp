@@ -125,4 +125,24 @@ namespace fs {
         operator delete[](work_buf, WorkBufferAlign);
     }
 
+    // Work buffer pool: hot paths (installs, copies, exports...) check out buffers from here instead of allocating/freeing them on every chunk/file
+    // Buffers are grouped in power-of-two size classes, and returned buffers are cached for later checkouts (up to a per-class limit)
+
+    constexpr size_t WorkBufferPoolMinSize = WorkBufferAlignment;
+    constexpr size_t WorkBufferPoolMaxSize = 16_MB;
+    constexpr u32 WorkBufferPoolMaxCachedPerClass = 4;
+
+    struct WorkBufferPoolStats {
+        size_t checked_out_size;
+        size_t cached_size;
+        size_t high_water_size;
+        u64 checkout_count;
+        u64 reuse_count;
+    };
+
+    u8 *CheckoutWorkBuffer(const size_t size = DefaultWorkBufferSize);
+    void ReturnWorkBuffer(u8 *work_buf);
+    void TrimWorkBufferPool();
+    WorkBufferPoolStats GetWorkBufferPoolStats();
+
 }
@@ -35,6 +35,10 @@ namespace fs {
             inline UsbHsFsDevice &GetDrive() {
                 return this->drv;
             }
+
+            virtual StorageKind GetStorageKind() override {
+                return StorageKind::Drive;
+            }
     };
 
 }
@@ -31,6 +31,40 @@ namespace fs {
         Append
     };
 
+    enum class HashAlgorithm : u32 {
+        Sha256
+    };
+
+    constexpr size_t MaxHashSize = SHA256_HASH_SIZE;
+    using FileHash = std::array<u8, MaxHashSize>;
+    using HashProgressCallback = std::function<void(const size_t)>;
+
+    constexpr size_t GetHashSize(const HashAlgorithm algo) {
+        switch(algo) {
+            case HashAlgorithm::Sha256:
+                return SHA256_HASH_SIZE;
+        }
+        return 0;
+    }
+
+    // What an explorer (or NCM storage) physically is, which mostly determines how fast data can be moved from/to it
+    enum class StorageKind : u32 {
+        SdCard,
+        NAND,
+        Drive,
+        RemotePC,
+        Other
+    };
+
+    // A file written on its own, regardless of the explorer's started file
+    // Destroying it also closes it, but only closing it explicitly reports whether everything written actually made it to the file
+    class ConcurrentWriteFile {
+        public:
+            virtual ~ConcurrentWriteFile() {}
+            virtual u64 Write(const void *write_buf, const u64 size) = 0;
+            virtual Result Close() = 0;
+    };
+
     class Explorer {
         protected:
             std::string disp_name;
@@ -135,7 +169,27 @@ namespace fs {
 
             std::vector<std::string> ReadFileLines(const std::string &path, const u32 line_offset, const u32 line_count);
             std::vector<std::string> ReadFileFormatHex(const std::string &path, const u32 line_offset, const u32 line_count);
-            u64 GetDirectorySize(const std::string &path);
+            virtual u64 GetDirectorySize(const std::string &path);
+
+            // Whether the above is fast enough to always be used, instead of recursing through every subdirectory
+            virtual bool IsDirectorySizeFast() {
+                return false;
+            }
+
+            // Whether different files can be written from several threads at once, each one through its own concurrent write file
+            virtual bool SupportsConcurrentWrites() {
+                return false;
+            }
+
+            // Appends to an existing file, only for explorers supporting concurrent writes
+            virtual std::unique_ptr<ConcurrentWriteFile> OpenConcurrentWriteFile(const std::string &path) {
+                return nullptr;
+            }
+
+            // Hashes the given range of a file (clamped to its size), by default reading it on a thread and hashing it on another one
+            // No file may be started on this explorer, since the default implementation starts (and ends) the file itself
+            // The progress callback (if any) gets the size of every hashed chunk
+            virtual bool ComputeHash(const std::string &path, const u64 offset, const u64 size, const HashAlgorithm algo, FileHash &out_hash, HashProgressCallback prog_cb);
 
             inline void SetShouldWarnOnWriteAccess(const bool should_warn) {
                 this->warn_write = should_warn;
@@ -198,6 +252,10 @@ namespace fs {
 
             virtual u64 GetTotalSpace() = 0;
             virtual u64 GetFreeSpace() = 0;
+
+            virtual StorageKind GetStorageKind() {
+                return StorageKind::Other;
+            }
             virtual void SetArchiveBit(const std::string &path) = 0;
     };
 
@@ -39,6 +39,10 @@ namespace fs {
     class SdCardExplorer final : public FspExplorer {
         public:
             SdCardExplorer() : FspExplorer(*fsdevGetDeviceFileSystem("sdmc"), "SdCard", "sdmc") {}
+
+            virtual StorageKind GetStorageKind() override {
+                return StorageKind::SdCard;
+            }
     };
 
     class RomFsExplorer final : public FspExplorer {
@@ -63,6 +67,15 @@ namespace fs {
             NANDExplorer(const Partition part);
             static FsFileSystem MountNANDFileSystem(const Partition part);
             static std::string GetNANDPartitionName(const Partition part);
+
+            virtual StorageKind GetStorageKind() override {
+                return StorageKind::NAND;
+            }
+
+            // Writes to system partitions are only done through started files, which get properly committed when ended
+            virtual bool SupportsConcurrentWrites() override {
+                return false;
+            }
     };
 
 }
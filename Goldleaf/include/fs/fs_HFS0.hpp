@@ -0,0 +1,63 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+#include <fs/fs_PartitionFileSystem.hpp>
+
+namespace fs {
+
+    // SHA-256 partition filesystem, as found in XCIs (cartridge images): same layout as a PFS0, but every file entry also holds a hash of its start
+
+    class HFS0 : public PartitionFileSystem {
+        public:
+            struct Header {
+                u32 magic;
+                u32 file_count;
+                u32 string_table_size;
+                u32 reserved;
+            };
+            static_assert(sizeof(Header) == 0x10);
+
+            struct FileEntry {
+                u64 offset;
+                u64 size;
+                u32 string_table_offset;
+                u32 hashed_size;
+                u64 reserved;
+                u8 hash[0x20];
+            };
+            static_assert(sizeof(FileEntry) == 0x40);
+
+            static constexpr u32 Magic = 0x30534648; // 'HFS0'
+
+            HFS0(fs::Explorer *explorer, const std::string &path, const u64 offset = 0);
+    };
+
+    constexpr u64 XciHeaderMagicOffset = 0x100;
+    constexpr u32 XciHeaderMagic = 0x44414548; // 'HEAD'
+    constexpr u64 XciRootPartitionOffsetOffset = 0x130;
+
+    constexpr const char XciSecurePartitionName[] = "secure";
+
+    // XCIs contain a root HFS0 whose files are the actual partitions (update, normal, secure...), each of them another HFS0
+    std::unique_ptr<HFS0> OpenXciPartition(fs::Explorer *exp, const std::string &path, const std::string &partition_name);
+
+}
@@ -20,11 +20,11 @@
 */
 
 #pragma once
-#include <fs/fs_FileSystem.hpp>
+#include <fs/fs_PartitionFileSystem.hpp>
 
 namespace fs {
 
-    class PFS0 {
+    class PFS0 : public PartitionFileSystem {
         public:
             struct Header {
                 u32 magic;
@@ -44,58 +44,7 @@ namespace fs {
 
             static constexpr u32 Magic = 0x30534650; // 'PFS0'
 
-            static constexpr u32 InvalidFileIndex = UINT32_MAX;
-
-            struct File {
-                FileEntry entry;
-                std::string name;
-            };
-
-        private:
-            std::string path;
-            fs::Explorer *exp;
-            u8 *string_table;
-            u32 header_size;
-            Header header;
-            std::vector<File> files;
-            bool ok;
-
-        public:
-            static constexpr inline bool IsValidFileIndex(u32 idx) {
-                return idx != InvalidFileIndex;
-            }
-            
-            static constexpr inline bool IsInvalidFileIndex(u32 idx) {
-                return idx == InvalidFileIndex;
-            }
-
             PFS0(fs::Explorer *explorer, const std::string &path);
-            ~PFS0();
-            
-            inline u32 GetCount() {
-                return this->header.file_count;
-            }
-            
-            std::string GetFile(const u32 idx);
-            
-            inline std::string GetPath() {
-                return this->path;
-            }
-            
-            u64 ReadFromFile(const u32 idx, const u64 offset, const u64 size, void *read_buf);
-            std::vector<std::string> GetFiles();
-            
-            inline bool IsOk() {
-                return this->ok;
-            }
-            
-            inline fs::Explorer *GetExplorer() {
-                return this->exp;
-            }
-
-            u64 GetFileSize(const u32 idx);
-            void SaveFile(const u32 idx, fs::Explorer *path_exp, const std::string &path);
-            u32 GetFileIndexByName(const std::string &file_name);
     };
 
 }
@@ -0,0 +1,164 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+#include <fs/fs_Explorer.hpp>
+
+namespace fs {
+
+    // Called (from the extracting thread) with the file being extracted, how much of it has been written and how much of all the files has been written
+    using ExtractProgressCallback = std::function<void(const u32, const u64, const u64)>;
+
+    // Common base of PFS0s (NSPs) and HFS0s (XCI partitions): both are just a flat list of files stored one after another, right after their header
+
+    class PartitionFileSystem {
+        public:
+            static constexpr u32 InvalidFileIndex = UINT32_MAX;
+
+            static constexpr inline bool IsValidFileIndex(u32 idx) {
+                return idx != InvalidFileIndex;
+            }
+            
+            static constexpr inline bool IsInvalidFileIndex(u32 idx) {
+                return idx == InvalidFileIndex;
+            }
+
+        protected:
+            // Enough for the header, entries and names of pretty much any NSP or XCI partition, so that they are loaded with a single read
+            static constexpr size_t InitialFileTableReadSize = 16_KB;
+            // Anything bigger is surely not a valid partition filesystem
+            static constexpr size_t MaxFileTableSize = 64_MB;
+
+            struct PartitionFile {
+                // Points into the (copied) string table
+                std::string_view name;
+                u64 offset;
+                u64 size;
+            };
+
+            std::string path;
+            fs::Explorer *exp;
+            u64 data_offset;
+            std::string string_table;
+            std::vector<PartitionFile> files;
+            // Open-addressing (linear probing) table of file indices, hashed by their case-insensitive name, at most half full
+            std::vector<u32> name_index;
+            bool ok;
+
+            PartitionFileSystem(fs::Explorer *exp, const std::string &path) : path(path), exp(exp), data_offset(0), string_table(), files(), name_index(), ok(false) {}
+
+            void BuildNameIndex();
+
+            // Loads the header, file entries and string table at the given offset (the underlying file must be already started)
+            template<typename Header, typename FileEntry>
+            bool LoadFileTable(const u64 offset, const u32 magic) {
+                std::vector<u8> table_buf(InitialFileTableReadSize);
+                const auto read_size = this->exp->ReadFile(this->path, offset, table_buf.size(), table_buf.data());
+                if(read_size < sizeof(Header)) {
+                    return false;
+                }
+
+                const auto header = reinterpret_cast<const Header*>(table_buf.data());
+                if(header->magic != magic) {
+                    return false;
+                }
+
+                const auto file_count = header->file_count;
+                const auto string_table_size = header->string_table_size;
+                const auto string_table_offset = sizeof(Header) + (static_cast<u64>(sizeof(FileEntry)) * file_count);
+                const auto table_size = string_table_offset + string_table_size;
+                if(table_size > MaxFileTableSize) {
+                    return false;
+                }
+
+                // Only read again if the initial guess was too small
+                if(read_size < table_size) {
+                    table_buf.resize(table_size);
+                    const auto rem_size = table_size - read_size;
+                    if(this->exp->ReadFile(this->path, offset + read_size, rem_size, table_buf.data() + read_size) != rem_size) {
+                        return false;
+                    }
+                }
+
+                this->string_table.assign(reinterpret_cast<const char*>(table_buf.data() + string_table_offset), string_table_size);
+                const auto entries = reinterpret_cast<const FileEntry*>(table_buf.data() + sizeof(Header));
+                this->files.clear();
+                this->files.reserve(file_count);
+                for(u32 i = 0; i < file_count; i++) {
+                    const auto &ent = entries[i];
+                    std::string_view name;
+                    if(ent.string_table_offset < string_table_size) {
+                        const auto name_str = this->string_table.data() + ent.string_table_offset;
+                        name = std::string_view(name_str, strnlen(name_str, string_table_size - ent.string_table_offset));
+                    }
+                    this->files.push_back({
+                        .name = name,
+                        .offset = ent.offset,
+                        .size = ent.size
+                    });
+                }
+
+                this->data_offset = offset + table_size;
+                this->BuildNameIndex();
+                return true;
+            }
+
+        public:
+            virtual ~PartitionFileSystem() {}
+
+            // Names point into this object's own string table
+            PartitionFileSystem(const PartitionFileSystem&) = delete;
+            PartitionFileSystem &operator=(const PartitionFileSystem&) = delete;
+
+            inline u32 GetCount() {
+                return this->files.size();
+            }
+            
+            std::string GetFile(const u32 idx);
+            
+            inline std::string GetPath() {
+                return this->path;
+            }
+            
+            u64 ReadFromFile(const u32 idx, const u64 offset, const u64 size, void *read_buf);
+            std::vector<std::string> GetFiles();
+            
+            inline bool IsOk() {
+                return this->ok;
+            }
+            
+            inline fs::Explorer *GetExplorer() {
+                return this->exp;
+            }
+
+            u64 GetFileSize(const u32 idx);
+            // Absolute offset of the file's data within the underlying file
+            u64 GetFileDataOffset(const u32 idx);
+            void SaveFile(const u32 idx, fs::Explorer *path_exp, const std::string &path);
+            u32 GetFileIndexByName(const std::string &file_name);
+
+            // Extracts the given files into a directory (created if needed), with their own names
+            // The files are read in the order they are stored, and if the destination supports it, several of them are written at once in separate threads
+            Result ExtractMany(const std::vector<u32> &idxs, fs::Explorer *out_exp, const std::string &out_dir, ExtractProgressCallback prog_cb);
+            Result ExtractAll(fs::Explorer *out_exp, const std::string &out_dir, ExtractProgressCallback prog_cb);
+    };
+
+}
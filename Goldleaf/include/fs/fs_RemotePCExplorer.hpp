@@ -21,10 +21,26 @@
 
 #pragma once
 #include <fs/fs_Explorer.hpp>
+#include <usb/cf/cf_CommandFramework.hpp>
 
 namespace fs {
 
     class RemotePCExplorer final : public Explorer {
+        private:
+            // Last bulk listing, kept until the next one or until something is modified through this explorer
+            std::string listing_dir;
+            std::vector<usb::cf::DirectoryEntry> listing;
+            bool listing_valid;
+            bool listing_files_pending;
+
+            bool UpdateListing(const std::string &full_dir);
+            const usb::cf::DirectoryEntry *FindListedEntry(const std::string &full_path);
+
+            inline void InvalidateListing() {
+                this->listing_valid = false;
+                this->listing_files_pending = false;
+            }
+
         public:
             RemotePCExplorer(const std::string &mount_name);
             virtual std::vector<std::string> GetDirectories(const std::string &path) override;
@@ -47,6 +63,16 @@ namespace fs {
             virtual u64 GetTotalSpace() override;
             virtual u64 GetFreeSpace() override;
             virtual void SetArchiveBit(const std::string &path) override;
+            virtual bool ComputeHash(const std::string &path, const u64 offset, const u64 size, const HashAlgorithm algo, FileHash &out_hash, HashProgressCallback prog_cb) override;
+            virtual u64 GetDirectorySize(const std::string &path) override;
+
+            virtual bool IsDirectorySizeFast() override {
+                return usb::cf::IsFeatureSupported(usb::cf::Feature::TreeStats);
+            }
+
+            virtual StorageKind GetStorageKind() override {
+                return StorageKind::RemotePC;
+            }
     };
 
 }
@@ -62,6 +62,13 @@ namespace fs {
             virtual u64 GetTotalSpace() override;
             virtual u64 GetFreeSpace() override;
             virtual void SetArchiveBit(const std::string &path) override;
+
+            // Concurrent write files are never committed, thus explorers which need commits can't support them
+            virtual bool SupportsConcurrentWrites() override {
+                return !static_cast<bool>(this->commit_fn);
+            }
+
+            virtual std::unique_ptr<ConcurrentWriteFile> OpenConcurrentWriteFile(const std::string &path) override;
     };
 
 }
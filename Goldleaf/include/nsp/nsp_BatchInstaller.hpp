@@ -0,0 +1,86 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+#include <nsp/nsp_Installer.hpp>
+
+namespace nsp {
+
+    struct BatchInstallJob {
+        std::string path;
+        std::string pres_path;
+        u64 size;
+    };
+
+    enum class BatchInstallJobStatus {
+        Installed,
+        Skipped,
+        PrepareFailed,
+        InstallFailed
+    };
+
+    struct BatchInstallProgress {
+        u32 job_idx;
+        u32 job_count;
+        u64 total_size;
+        u64 done_size;
+    };
+
+    using OnBatchJobStartFunction = std::function<void(const BatchInstallJob&, Installer&, const BatchInstallProgress&)>;
+    using OnBatchJobAlreadyInstalledFunction = std::function<bool(const BatchInstallJob&, Installer&)>;
+    using OnBatchStartWriteFunction = std::function<void(const ContentWriteProgress&, const BatchInstallProgress&)>;
+    using OnBatchContentWriteFunction = std::function<void(const ContentWriteProgress&, const BatchInstallProgress&)>;
+    using OnBatchJobFinishFunction = std::function<void(const BatchInstallJob&, Installer&, const BatchInstallJobStatus, const Result)>;
+
+    struct BatchInstallCallbacks {
+        OnBatchJobStartFunction on_job_start;
+        // Returns whether the already installed contents were removed and the job should be installed anyway
+        OnBatchJobAlreadyInstalledFunction on_job_already_installed;
+        OnBatchStartWriteFunction on_start_write;
+        OnBatchContentWriteFunction on_content_write;
+        OnBatchJobFinishFunction on_job_finish;
+    };
+
+    class BatchInstaller {
+        private:
+            fs::Explorer *exp;
+            NcmStorageId storage_id;
+            std::vector<BatchInstallJob> jobs;
+            u64 total_size;
+
+        public:
+            BatchInstaller(fs::Explorer *exp, const NcmStorageId storage_id) : exp(exp), storage_id(storage_id), jobs(), total_size(0) {}
+
+            void PushJob(const std::string &path, const std::string &pres_path);
+            Result CheckFreeSpace();
+
+            inline const std::vector<BatchInstallJob> &GetJobs() {
+                return this->jobs;
+            }
+
+            inline u64 GetTotalSize() {
+                return this->total_size;
+            }
+
+            Result Run(const BatchInstallCallbacks &callbacks);
+    };
+
+}
@@ -20,13 +20,47 @@
 */
 
 #pragma once
-#include <base.hpp>
+#include <fs/fs_Explorer.hpp>
 
 namespace nsp {
 
     using GenerateStartCallback = std::function<void(const double)>;
     using GenerateProgressCallback = std::function<void(const double)>;
 
+    // Generates an NSP in a single pass: every file size is known beforehand, so the PFS0 header is written first and file data is then streamed right after it, in the order files were added
+
+    class PackageBuilder {
+        private:
+            struct PackageFile {
+                std::string name;
+                u64 size;
+            };
+
+            std::string out_path;
+            fs::Explorer *out_exp;
+            std::vector<PackageFile> files;
+            u32 cur_file_idx;
+            u64 cur_file_written_size;
+            bool started;
+
+            void SkipWrittenFiles();
+
+        public:
+            PackageBuilder(const std::string &out_path);
+            ~PackageBuilder();
+
+            void AddFile(const std::string &name, const u64 size);
+            u64 GetTotalSize();
+
+            Result Start();
+            // Data of the current file (a write can't go past its end)
+            Result Write(const void *buf, const size_t size);
+            // Fails unless every file was fully written
+            Result Finish();
+            // Ends the package (if started) and deletes it
+            void Abort();
+    };
+
     bool GenerateFrom(const std::string &input_path, const std::string &output_nsp, GenerateStartCallback start_cb, GenerateProgressCallback prog_cb);
 
 }
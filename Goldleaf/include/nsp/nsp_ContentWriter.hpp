@@ -0,0 +1,93 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+#include <nsp/nsp_InstallServices.hpp>
+#include <nsp/nsp_InstallReport.hpp>
+
+namespace nsp {
+
+    struct ContentWriteProgressEntry {
+        NcmContentType type;
+        NcmPlaceHolderId placehld_id;
+        size_t cur_offset;
+        size_t size;
+    };
+    
+    struct ContentWriteProgress {
+        std::vector<ContentWriteProgressEntry> entries;
+        size_t written_size;
+        size_t hashed_size;
+
+        ContentWriteProgress() : entries(), written_size(0), hashed_size(0) {}
+    };
+
+    using OnStartWriteFunction = std::function<void(const ContentWriteProgress&)>;
+    using OnContentWriteFunction = std::function<void(const ContentWriteProgress&)>;
+    using OnContentCommitFunction = std::function<void(const std::vector<u64>&)>;
+    using OnReadDoneFunction = std::function<void()>;
+
+    struct ContentWriteEntry {
+        NcmContentType type;
+        NcmPlaceHolderId placehld_id;
+        // Size of the placeholder (the decompressed size for NCZs), and how much of it was already written (staged or resumed contents)
+        u64 size;
+        u64 written_size;
+        // Where (and how much) to read it from the source
+        u64 read_offset;
+        u64 read_size;
+        bool compressed;
+        // Only verified if set
+        const u8 *expected_hash;
+    };
+
+    // Where contents are read from: note that this is only used from a single thread, since explorers only support a single started file
+    // (and some of them, like remote PC ones, a single transfer at a time)
+
+    class ContentReader {
+        public:
+            virtual ~ContentReader() = default;
+
+            virtual void Start() = 0;
+            virtual void End() = 0;
+            virtual u64 GetChunkSize(const u64 rem_size) = 0;
+            virtual u64 Read(const u32 entry_idx, const u64 offset, const u64 size, void *read_buf) = 0;
+            // Called once each read chunk is queued for writing
+            virtual void NotifyQueued(const u64 size) {}
+    };
+
+    // Every callback is optional
+    struct ContentWriteOptions {
+        NcmStorageId storage_id;
+        u32 lane_count;
+        size_t buffer_size;
+        OnStartWriteFunction on_start_write_fn;
+        OnContentWriteFunction on_content_write_fn;
+        // Called with how much of each entry was actually written whenever that changes
+        OnContentCommitFunction on_content_commit_fn;
+        OnReadDoneFunction on_read_done_fn;
+    };
+
+    // Streams every entry from the reader into its (already created) placeholder, verifying the ones with an expected hash
+    // If any hash doesn't match, ResultContentHashMismatch is returned and the entry is set in out_mismatch_entry_idx
+    Result WriteContents(InstallServices &svcs, ContentStorage &cnt_storage, const std::vector<ContentWriteEntry> &entries, ContentReader &reader, const ContentWriteOptions &opts, InstallStats &stats, u32 &out_mismatch_entry_idx);
+
+}
@@ -0,0 +1,47 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+#include <base.hpp>
+
+namespace nsp {
+
+    // Interrupted installations leave their placeholders behind: the journal keeps track of how much of each one was actually written, so that retrying
+    // the same NSP can continue where it was left instead of starting over
+
+    struct InstallJournalContent {
+        std::string content_id;
+        u64 size;
+        u64 written_size;
+    };
+
+    struct InstallJournal {
+        std::string nsp_path;
+        u64 nsp_size;
+        u32 storage_id;
+        std::vector<InstallJournalContent> contents;
+    };
+
+    bool ReadInstallJournal(InstallJournal &out_journal);
+    void SaveInstallJournal(const InstallJournal &journal);
+    void DeleteInstallJournal();
+
+}
@@ -0,0 +1,105 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+#include <base.hpp>
+
+namespace nsp {
+
+    // Installs are timed per stage and per chunk, and a report of every install is saved to the reports directory, so that it's possible to tell
+    // whether a slow install was bound by the source, the write queue or NCM itself
+
+    enum class InstallStage : u32 {
+        PackageParse,
+        TicketImport,
+        MetaStaging,
+        SourceRead,
+        QueueWait,
+        ContentDecode,
+        NcmWrite,
+        ContentHash,
+        Register,
+        RecordUpdate,
+
+        Count
+    };
+
+    struct InstallStageReport {
+        std::string stage;
+        u64 size;
+        u64 chunk_count;
+        double busy_ms;
+        double throughput_mbps;
+        double p50_chunk_ms;
+        double p99_chunk_ms;
+    };
+
+    struct InstallReport {
+        std::string package_path;
+        u64 package_size;
+        u32 storage_id;
+        u32 write_lane_count;
+        u64 copy_buffer_size;
+        bool verify_content_hashes;
+        bool completed;
+        double write_duration_ms;
+        double avg_queue_depth;
+        u32 max_queue_depth;
+        std::vector<InstallStageReport> stages;
+    };
+
+    class InstallStats {
+        private:
+            struct StageStats {
+                u64 size;
+                std::vector<u64> chunk_ticks;
+            };
+
+            std::array<StageStats, static_cast<u32>(InstallStage::Count)> stages;
+            u64 write_start_tick;
+            u64 write_ticks;
+            u64 queue_depth_sum;
+            u64 queue_depth_sample_count;
+            u32 max_queue_depth;
+            Lock lock;
+
+        public:
+            InstallStats() : stages(), write_start_tick(0), write_ticks(0), queue_depth_sum(0), queue_depth_sample_count(0), max_queue_depth(0), lock() {}
+
+            // Stages run in different threads (reader, write lanes, decoders, hashers), all of them record here
+            void Record(const InstallStage stage, const u64 size, const u64 ticks);
+            // Sampled by the reader every time it queues a chunk: how many buffers are pending to be written
+            void RecordQueueDepth(const u32 pending_buffer_count);
+
+            inline void NotifyWriteStart() {
+                this->write_start_tick = armGetSystemTick();
+            }
+
+            inline void NotifyWriteEnd() {
+                this->write_ticks = armGetSystemTick() - this->write_start_tick;
+            }
+
+            void FillReport(InstallReport &out_report);
+    };
+
+    void SaveInstallReport(const InstallReport &report);
+
+}
@@ -0,0 +1,70 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+#include <base.hpp>
+
+namespace nsp {
+
+    // Every NCM/ES/NS call made by installations goes through these, so that the install pipeline can also run outside of the console (against fake services)
+
+    class ContentStorage {
+        public:
+            virtual ~ContentStorage() = default;
+
+            virtual Result Has(bool &out_has, const NcmContentId &cnt_id) = 0;
+            virtual Result CreatePlaceHolder(const NcmContentId &cnt_id, const NcmPlaceHolderId &placehld_id, const s64 size) = 0;
+            virtual Result DeletePlaceHolder(const NcmPlaceHolderId &placehld_id) = 0;
+            virtual Result HasPlaceHolder(bool &out_has, const NcmPlaceHolderId &placehld_id) = 0;
+            virtual Result GetPlaceHolderSize(s64 &out_size, const NcmPlaceHolderId &placehld_id) = 0;
+            virtual Result GetPlaceHolderPath(char *out_path, const size_t out_path_size, const NcmPlaceHolderId &placehld_id) = 0;
+            virtual Result WritePlaceHolder(const NcmPlaceHolderId &placehld_id, const u64 offset, const void *buf, const size_t size) = 0;
+            virtual Result Register(const NcmContentId &cnt_id, const NcmPlaceHolderId &placehld_id) = 0;
+    };
+
+    class ContentMetaDatabase {
+        public:
+            virtual ~ContentMetaDatabase() = default;
+
+            virtual Result Set(const NcmContentMetaKey &meta_key, const void *data, const size_t size) = 0;
+            virtual Result Commit() = 0;
+    };
+
+    class InstallServices {
+        public:
+            virtual ~InstallServices() = default;
+
+            // Each opened storage is a separate session, which can be used concurrently with the rest
+            virtual Result OpenContentStorage(const NcmStorageId storage_id, std::unique_ptr<ContentStorage> &out_cnt_storage) = 0;
+            virtual Result OpenContentMetaDatabase(const NcmStorageId storage_id, std::unique_ptr<ContentMetaDatabase> &out_cnt_meta_db) = 0;
+
+            virtual Result ImportTicket(const void *tik_buf, const size_t tik_size, const void *cert_buf, const size_t cert_size) = 0;
+
+            virtual Result CountApplicationContentMeta(const u64 app_id, s32 &out_count) = 0;
+            virtual Result ListApplicationRecordContentMeta(const u64 app_id, NsExtContentStorageMetaKey *out_keys, const s32 count, u32 &out_count) = 0;
+            virtual Result DeleteApplicationRecord(const u64 app_id) = 0;
+            virtual Result PushApplicationRecord(const u64 app_id, const NsExtContentStorageMetaKey *keys, const size_t count) = 0;
+    };
+
+    // Actual NCM/ES/NS services
+    InstallServices &GetSystemInstallServices();
+
+}
@@ -22,28 +22,23 @@
 #pragma once
 #include <fs/fs_FileSystem.hpp>
 #include <fs/fs_PFS0.hpp>
+#include <fs/fs_HFS0.hpp>
 #include <cnt/cnt_PackagedContentMeta.hpp>
 #include <cnt/cnt_Content.hpp>
 #include <cnt/cnt_Ticket.hpp>
+#include <nsp/nsp_InstallReport.hpp>
+#include <nsp/nsp_InstallServices.hpp>
+#include <nsp/nsp_ContentWriter.hpp>
 
 namespace nsp {
 
-    struct ContentWriteProgressEntry {
-        NcmContentType type;
-        NcmPlaceHolderId placehld_id;
-        size_t cur_offset;
-        size_t size;
-    };
-    
-    struct ContentWriteProgress {
-        std::vector<ContentWriteProgressEntry> entries;
-        size_t written_size;
-
-        ContentWriteProgress() : entries(), written_size(0) {}
-    };
+    // NSPs (and NSZs) are PFS0s, while XCIs (and XCZs) are installed straight from their secure partition
+    inline bool IsInstallablePackageExtension(const std::string &ext) {
+        return (ext == "nsp") || (ext == "nsz") || (ext == "xci") || (ext == "xcz");
+    }
 
-    using OnStartWriteFunction = std::function<void(const ContentWriteProgress&)>;
-    using OnContentWriteFunction = std::function<void(const ContentWriteProgress&)>;
+    // The files of an installable package (its PFS0, or the secure partition of XCIs)
+    std::unique_ptr<fs::PartitionFileSystem> OpenPackage(fs::Explorer *exp, const std::string &path);
 
     struct InstallableContent {
         NcmContentMetaKey meta_key;
@@ -57,32 +52,49 @@ namespace nsp {
 
     class Installer {
         private:
-            fs::PFS0 pfs0_file;
+            struct StagedContent {
+                NcmPlaceHolderId placehld_id;
+                u8 hash[SHA256_HASH_SIZE];
+            };
+
+            InstallServices &svcs;
+            std::unique_ptr<fs::PartitionFileSystem> pkg_fs;
             u8 keygen;
             cnt::TicketFile tik_file;
             cnt::PackagedContentMeta packaged_cnt_meta;
             NcmStorageId storage_id;
-            NcmContentStorage cnt_storage;
-            NcmContentMetaDatabase cnt_meta_db;
+            std::unique_ptr<ContentStorage> cnt_storage;
+            std::unique_ptr<ContentMetaDatabase> cnt_meta_db;
             u64 base_app_id;
-            u64 tik_file_size;
-            std::string tik_file_name;
-            u64 cert_file_size;
-            std::string cert_file_name;
+            std::vector<u8> tik_data;
+            std::vector<u8> cert_data;
             NcmContentInfo meta_cnt_info;
             std::vector<NcmContentInfo> contents;
             std::vector<InstallableContent> inst_contents;
+            std::vector<StagedContent> staged_cnts;
+            std::vector<NcmContentId> reserved_cnt_ids;
+            InstallStats stats;
+            InstallReport report;
+            bool report_pending;
+
+            bool ReserveContent(const NcmContentId &cnt_id);
+            void ReleaseContents();
+
+            Result StageContent(const u32 file_idx, const NcmContentInfo &cnt_info, char (&out_path)[FS_MAX_PATH]);
+            const StagedContent *FindStagedContent(const NcmContentId &cnt_id);
 
         public:
-            Installer(const std::string &path, fs::Explorer *exp, const NcmStorageId st_id) : pfs0_file(exp, path), storage_id(st_id), contents(), inst_contents() {}
+            Installer(const std::string &path, fs::Explorer *exp, const NcmStorageId st_id, InstallServices &svcs = GetSystemInstallServices());
             ~Installer();
     
+            // Size of the NCAs the package installs, only reading the package itself (neither NCM nor the installation are touched)
+            Result ComputeInstallSize(u64 &out_size);
             Result PrepareInstallation();
             Result InstallTicketCertificate();
             Result UpdateRecordAndContentMetas();
 
-            inline constexpr bool HasTicket() {
-                return this->tik_file_size > 0;
+            inline bool HasTicket() {
+                return !this->tik_data.empty();
             }
 
             inline const cnt::TicketFile &GetTicketFile() {
@@ -101,7 +113,7 @@ namespace nsp {
                 return this->contents;
             }
 
-            Result WriteContents(OnStartWriteFunction on_start_write_fn, OnContentWriteFunction on_content_write_fn);
+            Result WriteContents(OnStartWriteFunction on_start_write_fn, OnContentWriteFunction on_content_write_fn, OnReadDoneFunction on_read_done_fn = nullptr);
             void FinalizeInstallation();
     };
 
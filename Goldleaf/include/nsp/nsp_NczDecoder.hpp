@@ -0,0 +1,123 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+#include <base.hpp>
+#include <zstd.h>
+
+namespace nsp {
+
+    // NCZs (found in NSZ packages) are NCAs whose sections were decrypted and zstd-compressed: the NCA header is kept as-is,
+    // followed by the section table (with each section's keys), an optional block table and the compressed data itself
+
+    struct NczSectionHeader {
+        u64 magic;
+        u64 section_count;
+    };
+    static_assert(sizeof(NczSectionHeader) == 0x10);
+
+    struct NczSection {
+        u64 offset;
+        u64 size;
+        u64 crypto_type;
+        u64 pad;
+        u8 crypto_key[0x10];
+        u8 crypto_counter[0x10];
+    };
+    static_assert(sizeof(NczSection) == 0x40);
+
+    struct NczBlockHeader {
+        u64 magic;
+        u8 version;
+        u8 type;
+        u8 unused;
+        u8 block_size_exponent;
+        u32 block_count;
+        u64 decompressed_size;
+    };
+    static_assert(sizeof(NczBlockHeader) == 0x18);
+
+    constexpr u64 NczSectionHeaderMagic = 0x4E544345535A434E; // 'NCZSECTN'
+    constexpr u64 NczBlockHeaderMagic = 0x4B434F4C425A434E; // 'NCZBLOCK'
+    constexpr size_t NczNcaHeaderSize = 0x4000;
+    constexpr u32 NczMaxSectionCount = 0x10;
+
+    using NczOutputFunction = std::function<Result(const u8*, const size_t)>;
+
+    // Streaming decoder: compressed data is fed in order (in chunks of any size), and the resulting NCA data (re-encrypted) is emitted in order through the output function
+    class NczDecoder {
+        private:
+            enum class State {
+                NcaHeader,
+                SectionHeader,
+                Sections,
+                BlockHeaderMagic,
+                BlockHeader,
+                BlockSizes,
+                Data
+            };
+
+            struct SectionCrypto {
+                NczSection section;
+                Aes128CtrContext aes_ctx;
+            };
+
+            u64 nca_size;
+            NczOutputFunction output_fn;
+            State state;
+            std::vector<u8> header_buf;
+            size_t header_target_size;
+            std::vector<SectionCrypto> sections;
+            ZSTD_DCtx *dctx;
+            bool frame_done;
+            bool block_mode;
+            u64 block_size;
+            u64 block_data_size;
+            std::vector<u32> block_sizes;
+            u32 cur_block_idx;
+            u64 cur_block_rem_size;
+            bool cur_block_stored;
+            u8 *out_buf;
+            size_t out_buf_offset;
+            u64 nca_offset;
+
+            bool FillHeader(const u8 *&in_buf, size_t &in_size);
+            Result ParseSections();
+            void StartBlock();
+            Result DecompressData(const u8 *in_buf, const size_t in_size);
+            Result CopyData(const u8 *in_buf, const size_t in_size);
+            Result ProcessData(const u8 *in_buf, size_t in_size);
+            void EncryptData(u8 *buf, const size_t size, const u64 offset);
+            Result FlushOutput();
+
+        public:
+            NczDecoder(const u64 nca_size, NczOutputFunction output_fn);
+            ~NczDecoder();
+
+            Result Feed(const u8 *in_buf, size_t in_size);
+            Result Finish();
+    };
+
+    inline bool IsCompressedContentFile(const std::string &file_name) {
+        return (file_name.length() > __builtin_strlen(".ncz")) && (strcasecmp(file_name.c_str() + file_name.length() - __builtin_strlen(".ncz"), ".ncz") == 0);
+    }
+
+}
@@ -14,5 +14,14 @@ namespace goldleaf {
     R_DEFINE_ERROR_RESULT(InvalidMeta, 10);
     R_DEFINE_ERROR_RESULT(AssertionFailed, 11);
     R_DEFINE_ERROR_RESULT(InvalidNacpFormat1Decompression, 12);
+    R_DEFINE_ERROR_RESULT(ContentHashMismatch, 13);
+    R_DEFINE_ERROR_RESULT(InvalidNcz, 14);
+    R_DEFINE_ERROR_RESULT(InvalidCompressedPayload, 15);
+    R_DEFINE_ERROR_RESULT(TransportDisconnected, 16);
+    R_DEFINE_ERROR_RESULT(TransportConnectionFailed, 17);
+    R_DEFINE_ERROR_RESULT(PartitionFileReadFailed, 18);
+    R_DEFINE_ERROR_RESULT(PartitionFileWriteFailed, 19);
+    R_DEFINE_ERROR_RESULT(ContentReservedByOtherJob, 20);
+    R_DEFINE_ERROR_RESULT(FileWriteFailed, 21);
 
 }
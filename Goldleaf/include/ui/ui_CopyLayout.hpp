@@ -41,6 +41,8 @@ namespace ui {
             PU_SMART_CTOR(CopyLayout)
 
             void StartCopy(const std::string &path, const std::string &new_path);
+            void StartExtract(const std::string &path, const std::string &out_dir);
+            bool StartHash(const std::string &path, fs::FileHash &out_hash);
     };
 
 }
@@ -27,6 +27,7 @@
 #include <hos/hos_Common.hpp>
 #include <net/net_Network.hpp>
 #include <nsp/nsp_Installer.hpp>
+#include <nsp/nsp_BatchInstaller.hpp>
 #include <nsp/nsp_Builder.hpp>
 #include <cfg/cfg_Settings.hpp>
 #include <cfg/cfg_Strings.hpp>
@@ -29,12 +29,21 @@ namespace ui {
             std::vector<pu::ui::elm::TextBlock::Ref> content_info_texts;
             std::vector<pu::ui::elm::ProgressBar::Ref> content_p_bars;
             pu::ui::elm::TextBlock::Ref speed_info_text;
+            pu::ui::elm::TextBlock::Ref batch_info_text;
+            pu::ui::elm::ProgressBar::Ref batch_p_bar;
+            std::chrono::steady_clock::time_point last_progress_tp;
+
+            void PrepareContentProgress(const size_t cnt_count, const bool is_batch);
+            void StartContentProgress(const nsp::ContentWriteProgress &write_start);
+            void UpdateContentProgress(const nsp::ContentWriteProgress &write_progress, const size_t rem_size);
+            void UpdateBatchProgress(const nsp::BatchInstallProgress &batch_progress);
 
         public:
             InstallLayout();
             PU_SMART_CTOR(InstallLayout)
 
             bool StartInstall(const std::string &path, const std::string &pres_path, fs::Explorer *exp, const NcmStorageId storage_id, const bool omit_confirmation = false, const bool skip_if_already_installed = false);
+            bool StartBatchInstall(nsp::BatchInstaller &batch_installer, const bool skip_if_already_installed);
     };
 
 }
@@ -45,15 +45,19 @@ namespace ui {
 
             // FS
             pu::ui::elm::MenuItem::Ref compute_directory_sizes_item;
+            pu::ui::elm::MenuItem::Ref adaptive_chunk_size_item;
 
             void compute_directory_sizes_DefaultKey();
+            void adaptive_chunk_size_DefaultKey();
 
             // Installs
             pu::ui::elm::MenuItem::Ref ignore_required_fw_version_item;
             pu::ui::elm::MenuItem::Ref show_deletion_prompt_after_install_item;
+            pu::ui::elm::MenuItem::Ref verify_content_hashes_item;
 
             void ignore_required_fw_version_DefaultKey();
             void show_deletion_prompt_after_install_DefaultKey();
+            void verify_content_hashes_DefaultKey();
 
             // UI
             pu::ui::elm::MenuItem::Ref menu_stick_move_speed_item;
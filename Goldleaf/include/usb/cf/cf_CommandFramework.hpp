@@ -28,7 +28,57 @@ namespace usb::cf {
     enum class PathType : u32 {
         Invalid = 0,
         File = 1,
-        Directory = 2
+        Directory = 2,
+        HandshakeSupported = 3
+    };
+
+    enum class Feature : u64 {
+        None = 0,
+        BulkListing = BIT(0),
+        Compression = BIT(1),
+        Pipelining = BIT(2),
+        Hashing = BIT(3),
+        TreeStats = BIT(4)
+    };
+    GLEAF_DEFINE_FLAG_ENUM(Feature, u64);
+
+    constexpr u32 ProtocolVersion = 1;
+    constexpr u64 MaxBlockSize = 16_MB;
+    constexpr Feature SupportedFeatures = Feature::BulkListing | Feature::Compression | Feature::Pipelining | Feature::Hashing | Feature::TreeStats;
+
+    // Older Quark versions treat unknown command IDs as a broken connection, so the handshake command is only sent once the PC is known to support it
+    // The probe is a StatPath on a path no real filesystem can contain: older versions just report it as invalid, newer ones answer with a special path type
+    inline const std::string HandshakeProbePath = std::string("\0quark:handshake", 16);
+
+    struct ProtocolInfo {
+        u32 version;
+        u64 max_block_size;
+        Feature features;
+
+        inline bool IsLegacy() const {
+            return this->version == 0;
+        }
+
+        inline bool Supports(const Feature feature) const {
+            return (this->features & feature) == feature;
+        }
+    };
+
+    // Older PC clients accept any payload size, which is kept as it was
+    constexpr ProtocolInfo LegacyProtocolInfo = { 0, UINT64_MAX, Feature::None };
+
+    // Everything inside a directory (but not itself)
+    struct TreeStats {
+        u64 total_size;
+        u64 file_count;
+        u64 dir_count;
+    };
+
+    struct DirectoryEntry {
+        std::string name;
+        PathType type;
+        u64 size;
+        u64 mod_time;
     };
 
     inline Result GetDriveCount(u32 &out_count) {
@@ -99,6 +149,44 @@ namespace usb::cf {
         return cmd::ProcessCommand<17>(cmd::OutString(out_file));
     }
 
+    Result ListDirectory(const std::string &dir, std::vector<DirectoryEntry> &out_entries);
+
+    // Pipelined variants of the commands above, whose outputs are only valid after their response is completed
+
+    inline Result SubmitGetFile(cmd::CommandPipeline &pipeline, const std::string &dir, const u32 file_idx, std::string &out_file) {
+        return pipeline.Submit<5>(cmd::InString(dir), cmd::InValue(file_idx), cmd::OutString(out_file));
+    }
+
+    inline Result SubmitGetDirectory(cmd::CommandPipeline &pipeline, const std::string &dir, const u32 subdir_idx, std::string &out_subdir) {
+        return pipeline.Submit<7>(cmd::InString(dir), cmd::InValue(subdir_idx), cmd::OutString(out_subdir));
+    }
+
+    inline Result SubmitReadFile(cmd::CommandPipeline &pipeline, const std::string &file, const u64 offset, const u64 size, u64 &out_read_size, void *read_buf) {
+        return pipeline.Submit<9>(cmd::InString(file), cmd::InValue(offset), cmd::InValue(size), cmd::OutValue(out_read_size), cmd::OutBuffer(read_buf, size));
+    }
+
+    inline Result Handshake(const ProtocolInfo &info, ProtocolInfo &out_pc_info) {
+        return cmd::ProcessCommand<19>(cmd::InValue(info.version), cmd::InValue(info.max_block_size), cmd::InValue(info.features), cmd::OutValue(out_pc_info.version), cmd::OutValue(out_pc_info.max_block_size), cmd::OutValue(out_pc_info.features));
+    }
+
+    // Hashed on the PC itself (only with Feature::Hashing), the range being clamped to the file size; the hash is always MaxHashSize bytes, zero-padded
+    inline Result HashFile(const std::string &file, const u64 offset, const u64 size, const fs::HashAlgorithm algo, fs::FileHash &out_hash) {
+        return cmd::ProcessCommand<20>(cmd::InString(file), cmd::InValue(offset), cmd::InValue(size), cmd::InValue(algo), cmd::OutValue(out_hash));
+    }
+
+    // Computed on the PC itself (only with Feature::TreeStats), instead of walking the whole tree through the commands above
+    inline Result GetTreeStats(const std::string &dir, TreeStats &out_stats) {
+        return cmd::ProcessCommand<21>(cmd::InString(dir), cmd::OutValue(out_stats.total_size), cmd::OutValue(out_stats.file_count), cmd::OutValue(out_stats.dir_count));
+    }
+
     // TODO: add a SelectDirectory command?
 
+    // Negotiated with the PC on first use (lowest version and block size, common features)
+    ProtocolInfo GetProtocolInfo();
+    void ResetProtocolInfo();
+
+    inline bool IsFeatureSupported(const Feature feature) {
+        return GetProtocolInfo().Supports(feature);
+    }
+
 }
@@ -29,10 +29,17 @@ namespace usb::cmd {
     constexpr u32 InputMagic = 0x49434C47; // 'GLCI'
     constexpr u32 OutputMagic = 0x4F434C47; // 'GLCO'
 
+    // Tagged blocks carry a request tag (right after the command ID or the result), echoed back by the PC
+    constexpr u32 InputTaggedMagic = 0x49544C47; // 'GLTI'
+    constexpr u32 OutputTaggedMagic = 0x4F544C47; // 'GLTO'
+
     constexpr std::align_val_t Align = std::align_val_t(0x1000);
 
     constexpr size_t BlockSize = 0x1000;
 
+    // Sanity limit for buffers sized by the PC
+    constexpr size_t MaxDynamicBufferSize = 64_MB;
+
     struct BlockBase {
         size_t position;
         u8 *block_buf;
@@ -45,6 +52,9 @@ namespace usb::cmd {
 
         public:
             InCommandBlock(const u32 cmd_id);
+            InCommandBlock(const u32 cmd_id, const u32 tag);
+            InCommandBlock(const InCommandBlock&) = delete;
+            ~InCommandBlock();
         
             bool WriteBuffer(const void *buf, const size_t size);
             bool WriteString(const std::string &val);
@@ -59,6 +69,8 @@ namespace usb::cmd {
             }
 
             Result Send();
+            // The block is kept alive until this object is disposed, which must happen after the transfer is done or cancelled
+            Result Post(TransferQueue &queue);
     };
 
     class OutCommandBlock {
@@ -66,14 +78,24 @@ namespace usb::cmd {
             BlockBase base;
             u32 magic;
             Result res;
+            u32 tag;
 
         public:
             OutCommandBlock();
+            OutCommandBlock(const OutCommandBlock&) = delete;
+
+            ~OutCommandBlock() {
+                this->Cleanup();
+            }
 
             void Cleanup();
 
+            inline bool HasValidMagic() {
+                return (this->magic == OutputMagic) || (this->magic == OutputTaggedMagic);
+            }
+
             inline bool IsValid() {
-                if(this->magic != OutputMagic) {
+                if(!this->HasValidMagic()) {
                     return false;
                 }
                 else {
@@ -81,6 +103,10 @@ namespace usb::cmd {
                 }
             }
 
+            inline u32 GetTag() {
+                return this->tag;
+            }
+
             bool ReadBuffer(void *buf, const size_t size);
             bool ReadString(std::string &out_str);
 
@@ -174,6 +200,18 @@ namespace usb::cmd {
             bool ProcessAfterOut() override;
     };
 
+    // Buffers whose size is only known by the PC: it's sent (as a u64) in the response, and the buffer itself follows it
+    class OutDynamicBuffer : public CommandArgument {
+        private:
+            std::vector<u8> &buf;
+
+        public:
+            OutDynamicBuffer(std::vector<u8> &buf) : buf(buf) {}
+
+            bool ProcessOut(OutCommandBlock &block) override;
+            bool ProcessAfterOut() override;
+    };
+
     template<u32 CommandId, typename ...Args>
     inline Result ProcessCommand(Args &&...args) {
         InCommandBlock block(CommandId);
@@ -218,4 +256,112 @@ namespace usb::cmd {
         }
     }
 
+    // Buffers sent after the input block would block the link while earlier responses are still unread, so such commands can't be pipelined
+    template<typename T>
+    constexpr bool IsInPayloadArgument = std::is_same_v<T, InBuffer>;
+
+    class PendingCommandBase {
+        public:
+            virtual ~PendingCommandBase() = default;
+
+            virtual bool ProcessOut(OutCommandBlock &block) = 0;
+            virtual bool ProcessAfterOut() = 0;
+    };
+
+    template<typename ...Args>
+    class PendingCommand : public PendingCommandBase {
+        private:
+            std::tuple<Args...> args;
+
+        public:
+            PendingCommand(Args &&...args) : args(std::move(args)...) {}
+
+            bool ProcessOut(OutCommandBlock &block) override {
+                return std::apply([&](auto &...args) {
+                    auto out_ok = true;
+                    ((out_ok &= args.ProcessOut(block)), ...);
+                    return out_ok;
+                }, this->args);
+            }
+
+            bool ProcessAfterOut() override {
+                return std::apply([&](auto &...args) {
+                    auto after_out_ok = true;
+                    ((after_out_ok &= args.ProcessAfterOut()), ...);
+                    return after_out_ok;
+                }, this->args);
+            }
+    };
+
+    constexpr u32 MaxPipelinedCommandCount = 4;
+    static_assert(MaxPipelinedCommandCount <= MaxInFlightTransferCount);
+
+    // Sends several commands before their responses are received, which come back in the same order
+    // Untagged pipelines (for PCs not supporting pipelining) just allow a single pending command, behaving like ProcessCommand
+    class CommandPipeline {
+        private:
+            struct PipelinedCommand {
+                u32 tag;
+                std::unique_ptr<InCommandBlock> in_block;
+                std::unique_ptr<PendingCommandBase> cmd;
+            };
+
+            // Declared before the queue, so that input blocks are disposed after their transfers get cancelled
+            std::deque<PipelinedCommand> pending_cmds;
+            TransferQueue in_block_queue;
+            bool tagged;
+            u32 next_tag;
+
+            void Abort();
+
+        public:
+            CommandPipeline(const bool tagged) : pending_cmds(), in_block_queue(TransferDirection::Write), tagged(tagged), next_tag(0) {}
+            ~CommandPipeline();
+
+            inline u32 GetMaxPendingCount() {
+                return this->tagged ? MaxPipelinedCommandCount : 1;
+            }
+
+            inline bool IsFull() {
+                return this->pending_cmds.size() >= this->GetMaxPendingCount();
+            }
+
+            inline bool IsEmpty() {
+                return this->pending_cmds.empty();
+            }
+
+            template<u32 CommandId, typename ...Args>
+            inline Result Submit(Args &&...args) {
+                static_assert(!(IsInPayloadArgument<std::decay_t<Args>> || ...), "Commands sending buffers can't be pipelined");
+                if(this->IsFull()) {
+                    return 0xBAB6;
+                }
+
+                const auto tag = this->next_tag;
+                auto in_block = this->tagged ? std::make_unique<InCommandBlock>(CommandId, tag) : std::make_unique<InCommandBlock>(CommandId);
+                auto in_ok = in_block->IsOk();
+                ((in_ok &= args.ProcessIn(*in_block)), ...);
+                if(!in_ok) {
+                    return 0xBAB1;
+                }
+
+                const auto rc = in_block->Post(this->in_block_queue);
+                if(R_FAILED(rc)) {
+                    return rc;
+                }
+
+                this->pending_cmds.push_back({
+                    .tag = tag,
+                    .in_block = std::move(in_block),
+                    .cmd = std::make_unique<PendingCommand<std::decay_t<Args>...>>(std::move(args)...)
+                });
+                this->next_tag++;
+                return rc::ResultSuccess;
+            }
+
+            // Receives the response of the oldest pending command, returning its result
+            Result CompleteNext();
+            Result CompleteAll();
+    };
+
 }
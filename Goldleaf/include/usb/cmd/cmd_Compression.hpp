@@ -0,0 +1,42 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+#include <usb/usb_Base.hpp>
+
+namespace usb::cmd {
+
+    // Compressed payloads (only when negotiated with the PC) are split in chunks, each one compressed (zstd) on its own: a table with the stored size (u32) of every chunk
+    // is sent first, followed by the chunks themselves, all of them as separate transfers. Like with NCZ blocks, chunks which wouldn't get any smaller are stored uncompressed
+    // Empty payloads are always sent as they are
+    constexpr size_t CompressionChunkSize = StreamChunkSize;
+    constexpr int CompressionLevel = 1;
+
+    // Decompression runs on a thread in a different core than the one receiving chunks (so that it can keep up with the link)
+    constexpr s32 DecompressionThreadCpuId = 1;
+
+    void SetPayloadCompressionEnabled(const bool enabled);
+    bool IsPayloadCompressionEnabled();
+
+    Result ReadCompressedPayload(void *buf, const size_t size);
+    Result WriteCompressedPayload(const void *buf, const size_t size);
+
+}
@@ -22,16 +22,93 @@
 */
 
 #pragma once
-#include <base.hpp>
+#include <usb/usb_Transport.hpp>
 
 namespace usb {
 
+    // Brings up usb:ds and makes it the current transport (console only)
     Result Initialize();
     void Finalize();
 
+    // Whether the current transport is connected
     bool IsStateOk();
 
     Result Read(void *buf, const size_t size);
     Result Write(const void *buf, const size_t size);
 
+    // Buffers posted to usb:ds must be aligned like this
+    constexpr size_t BufferAlignment = 0x1000;
+    constexpr std::align_val_t BufferAlign = std::align_val_t(BufferAlignment);
+
+    // usb:ds reports the status of (at most) the last 8 URBs posted to an endpoint
+    constexpr u32 MaxInFlightTransferCount = 8;
+
+    // Called (in posting order) once each queued transfer is done, with its buffer and size
+    using TransferDoneFunction = std::function<void(u8*, const size_t)>;
+
+    // Keeps several transfers (URBs) queued on an endpoint, so that the next one is already posted when the previous one completes and the bus never idles between them
+    // Note that only a single queue may be active on each endpoint, and that every posted buffer must be aligned and must stay valid until it's done (or the queue is destroyed)
+    // Queues use the transport that was current when they were created
+    class TransferQueue {
+        private:
+            struct PendingTransfer {
+                u32 transfer_id;
+                u8 *buf;
+                size_t size;
+                TransferDoneFunction done_fn;
+            };
+
+            Transport *transport;
+            TransferDirection dir;
+            std::deque<PendingTransfer> pending_transfers;
+
+        public:
+            TransferQueue(const TransferDirection dir);
+            ~TransferQueue();
+
+            Result Post(void *buf, const size_t size, TransferDoneFunction done_fn = nullptr);
+            // Waits for the oldest pending transfer, and calls its done function
+            Result WaitNext();
+            Result WaitAll();
+            // Cancels every pending transfer (their done functions are not called)
+            void Cancel();
+
+            inline u32 GetPendingCount() {
+                return this->pending_transfers.size();
+            }
+    };
+
+    // Streams are a single host transfer split in chunks, with several of them in flight: each chunk is consumed/filled while the next ones are being transferred
+    // Like any other transfer, empty streams still post a single (empty) one
+    constexpr size_t StreamChunkSize = 1_MB;
+    constexpr u32 StreamInFlightCount = 3;
+    static_assert(StreamInFlightCount <= MaxInFlightTransferCount);
+
+    using StreamReadFunction = std::function<void(const u8*, const size_t)>;
+    using StreamWriteFunction = std::function<void(u8*, const size_t)>;
+
+    // Each received chunk is passed (in order) to the read function
+    Result ReadStream(const size_t size, StreamReadFunction read_fn);
+    // Each chunk is filled by the write function right before it's posted
+    Result WriteStream(const size_t size, StreamWriteFunction write_fn);
+
+    // Whether the buffer can be posted as it is with the current transport
+    inline bool IsBufferAligned(const void *buf) {
+        auto transport = GetTransport();
+        const auto alignment = (transport != nullptr) ? transport->GetBufferAlignment() : BufferAlignment;
+        return (reinterpret_cast<uintptr_t>(buf) % alignment) == 0;
+    }
+
+    // Aligned buffers are transferred in place (chunks are posted straight from/to them), without any copies
+    Result ReadStream(void *buf, const size_t size);
+    Result WriteStream(const void *buf, const size_t size);
+
+    // Unlike streams, every chunk here is a separate host transfer with its own size (still with several of them in flight)
+    // The buffer function returns the (aligned) buffer each chunk is transferred with, given its index and size
+    using ChunkBufferFunction = std::function<u8*(const u32, const size_t)>;
+
+    // Each received chunk is passed (in order) to the done function
+    Result ReadChunks(const std::vector<size_t> &chunk_sizes, ChunkBufferFunction buf_fn, TransferDoneFunction done_fn);
+    Result WriteChunks(const std::vector<size_t> &chunk_sizes, ChunkBufferFunction buf_fn);
+
 }
@@ -0,0 +1,100 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+#include <usb/usb_Transport.hpp>
+
+namespace usb {
+
+    constexpr size_t DefaultPipeCapacity = 8_MB;
+
+    // One direction of an in-process pipe: a ring buffer where writers wait for free space and readers wait for data
+    class Pipe {
+        private:
+            u8 *buf;
+            size_t capacity;
+            size_t read_offset;
+            size_t data_size;
+            bool closed;
+            Lock lock;
+            UEvent data_event;
+            UEvent space_event;
+
+        public:
+            Pipe(const size_t capacity);
+            ~Pipe();
+
+            Result Read(void *buf, const size_t size);
+            Result Write(const void *buf, const size_t size);
+
+            // Wakes up (and fails) anyone waiting on the pipe, and any later reads/writes
+            void Close();
+            bool IsClosed();
+    };
+
+    class PipeTransport final : public StreamTransport {
+        private:
+            Pipe &in_pipe;
+            Pipe &out_pipe;
+
+        public:
+            PipeTransport(Pipe &in_pipe, Pipe &out_pipe) : in_pipe(in_pipe), out_pipe(out_pipe) {}
+
+            virtual bool IsConnected() override {
+                return !this->in_pipe.IsClosed() && !this->out_pipe.IsClosed();
+            }
+
+            virtual Result ReadBytes(void *buf, const size_t size) override {
+                return this->in_pipe.Read(buf, size);
+            }
+
+            virtual Result WriteBytes(const void *buf, const size_t size) override {
+                return this->out_pipe.Write(buf, size);
+            }
+    };
+
+    // Both ends of an in-process connection, where whatever is written to one end is read from the other one
+    // Each end is meant to be used from a different thread (like Goldleaf in one of them, and a PC server in the other one)
+    class PipeConnection {
+        private:
+            Pipe client_to_server;
+            Pipe server_to_client;
+            PipeTransport client_end;
+            PipeTransport server_end;
+
+        public:
+            PipeConnection(const size_t capacity = DefaultPipeCapacity) : client_to_server(capacity), server_to_client(capacity), client_end(server_to_client, client_to_server), server_end(client_to_server, server_to_client) {}
+
+            inline PipeTransport &GetClientEnd() {
+                return this->client_end;
+            }
+
+            inline PipeTransport &GetServerEnd() {
+                return this->server_end;
+            }
+
+            inline void Close() {
+                this->client_to_server.Close();
+                this->server_to_client.Close();
+            }
+    };
+
+}
@@ -0,0 +1,50 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+#include <usb/usb_Transport.hpp>
+
+namespace usb {
+
+    // Over a connected TCP socket (which is closed along with the transport)
+    class SocketTransport final : public StreamTransport {
+        private:
+            int sock_fd;
+
+        public:
+            SocketTransport(const int sock_fd) : sock_fd(sock_fd) {}
+            ~SocketTransport();
+
+            virtual bool IsConnected() override {
+                return this->sock_fd >= 0;
+            }
+
+            virtual Result ReadBytes(void *buf, const size_t size) override;
+            virtual Result WriteBytes(const void *buf, const size_t size) override;
+
+            void Close();
+    };
+
+    Result ConnectSocketTransport(const std::string &host, const u16 port, std::unique_ptr<SocketTransport> &out_transport);
+    // Waits for a single connection on the given port
+    Result AcceptSocketTransport(const u16 port, std::unique_ptr<SocketTransport> &out_transport);
+
+}
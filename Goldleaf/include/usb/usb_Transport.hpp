@@ -0,0 +1,91 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+#include <base.hpp>
+#include <deque>
+
+namespace usb {
+
+    enum class TransferDirection {
+        Read,
+        Write
+    };
+
+    // Everything usb::cmd sends or receives goes through a transport: usb:ds on the console, but any ordered and reliable connection works the same way
+    // (TCP sockets, in-process pipes) so that the command framework can also run and be tested on a host
+    // Transfers in each direction complete in the order they were posted, and posted buffers must stay valid until they're done (or cancelled)
+    class Transport {
+        public:
+            virtual ~Transport() = default;
+
+            virtual bool IsConnected() = 0;
+
+            virtual Result PostTransfer(const TransferDirection dir, void *buf, const size_t size, u32 &out_transfer_id) = 0;
+            virtual Result WaitTransfer(const TransferDirection dir, const u32 transfer_id, size_t &out_transferred_size) = 0;
+            virtual void CancelTransfers(const TransferDirection dir) = 0;
+
+            // Buffers not aligned like this are transferred through (aligned) bounce buffers
+            virtual size_t GetBufferAlignment() = 0;
+    };
+
+    // Transports over a plain byte stream, where transfer boundaries don't exist: writes are done right when they're posted, and reads once they're waited for
+    // (which is still in posting order, since reads are only ever waited for in that order)
+    class StreamTransport : public Transport {
+        private:
+            struct PendingTransfer {
+                u32 transfer_id;
+                u8 *buf;
+                size_t size;
+            };
+
+            std::deque<PendingTransfer> pending_reads;
+            std::deque<PendingTransfer> pending_writes;
+            u32 next_transfer_id;
+
+            inline std::deque<PendingTransfer> &GetPendingTransfers(const TransferDirection dir) {
+                return (dir == TransferDirection::Read) ? this->pending_reads : this->pending_writes;
+            }
+
+        public:
+            StreamTransport() : pending_reads(), pending_writes(), next_transfer_id(0) {}
+
+            // Both block until the whole buffer is transferred (or the connection fails)
+            virtual Result ReadBytes(void *buf, const size_t size) = 0;
+            virtual Result WriteBytes(const void *buf, const size_t size) = 0;
+
+            virtual Result PostTransfer(const TransferDirection dir, void *buf, const size_t size, u32 &out_transfer_id) override;
+            virtual Result WaitTransfer(const TransferDirection dir, const u32 transfer_id, size_t &out_transferred_size) override;
+            virtual void CancelTransfers(const TransferDirection dir) override;
+
+            virtual size_t GetBufferAlignment() override {
+                return 1;
+            }
+    };
+
+    // The transport used from now on (by transfers started after this), which isn't owned
+    void SetTransport(Transport *transport);
+    Transport *GetTransport();
+
+    // The usb:ds transport (console only), which usb::Initialize makes the current one
+    Transport &GetDsTransport();
+
+}
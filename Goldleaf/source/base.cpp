@@ -227,7 +227,8 @@ u32 RandomFromRange(const u32 min, const u32 max) {
 void EnsureDirectories() {
     auto nand_sys_exp = fs::GetNANDSystemExplorer();
     auto sd_exp = fs::GetSdCardExplorer();
-    nand_sys_exp->EmptyDirectory(GLEAF_PATH_NAND_INSTALL_TEMP_DIR);
+    // Installs no longer stage anything here, just clean up after older versions
+    nand_sys_exp->DeleteDirectory(GLEAF_PATH_NAND_INSTALL_TEMP_DIR);
 
     sd_exp->CreateDirectory(GLEAF_PATH_ROOT_DIR);
     sd_exp->CreateDirectory(GLEAF_PATH_METADATA_DIR);
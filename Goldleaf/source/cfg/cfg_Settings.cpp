@@ -173,6 +173,11 @@ namespace cfg {
 
         _CFG_CLAMP_FS_BUFFER_SIZE(installs, copy_buffer_max_size);
         _CFG_CLAMP_FS_BUFFER_SIZE(exports, decrypt_buffer_max_size);
+
+        auto &write_lane_count = this->json_settings.installs.value().write_lane_count;
+        if(write_lane_count.has_value()) {
+            write_lane_count = std::clamp(write_lane_count.value(), 1u, MaxInstallWriteLaneCount);
+        }
     }
 
     void Settings::Save() {
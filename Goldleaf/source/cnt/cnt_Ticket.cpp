@@ -181,13 +181,38 @@ namespace cnt {
         return tik_file;
     }
 
+    bool ReadTicket(const u8 *tik_buf, const size_t tik_size, TicketFile &out_tik_file) {
+        if(tik_size < sizeof(out_tik_file.signature)) {
+            return false;
+        }
+        memcpy(&out_tik_file.signature, tik_buf, sizeof(out_tik_file.signature));
+
+        const auto tik_sig_data_size = GetTicketSignatureDataSize(out_tik_file.signature);
+        if((tik_sig_data_size == 0) || (tik_sig_data_size > sizeof(out_tik_file.signature_data)) || (tik_size < out_tik_file.GetFullSize())) {
+            return false;
+        }
+        memcpy(out_tik_file.signature_data, tik_buf + sizeof(out_tik_file.signature), tik_sig_data_size);
+
+        const auto tik_data_offset = GetTicketSignatureSize(out_tik_file.signature);
+        memcpy(&out_tik_file.data, tik_buf + tik_data_offset, sizeof(out_tik_file.data));
+        return true;
+    }
+
+    std::vector<u8> SerializeTicket(const TicketFile &tik_file) {
+        const auto sig_data_size = GetTicketSignatureDataSize(tik_file.signature);
+        std::vector<u8> tik_data(sizeof(tik_file.signature) + sig_data_size + sizeof(tik_file.data));
+        memcpy(tik_data.data(), &tik_file.signature, sizeof(tik_file.signature));
+        memcpy(tik_data.data() + sizeof(tik_file.signature), tik_file.signature_data, sig_data_size);
+        memcpy(tik_data.data() + sizeof(tik_file.signature) + sig_data_size, &tik_file.data, sizeof(tik_file.data));
+        return tik_data;
+    }
+
     void SaveTicket(fs::Explorer *exp, const std::string &path, const TicketFile tik_file) {
         exp->DeleteFile(path);
 
+        const auto tik_data = SerializeTicket(tik_file);
         exp->StartFile(path, fs::FileMode::Append);
-        exp->WriteFile(path, &tik_file.signature, sizeof(tik_file.signature));
-        exp->WriteFile(path, tik_file.signature_data, GetTicketSignatureDataSize(tik_file.signature));
-        exp->WriteFile(path, &tik_file.data, sizeof(tik_file.data));
+        exp->WriteFile(path, tik_data.data(), tik_data.size());
         exp->EndFile();
     }
 
@@ -32,87 +32,121 @@ FsStorage g_FatFsDumpBisStorage;
 
 namespace expt {
 
-    namespace {
-
-        cnt::TicketFile ReadTicket(const u64 app_id) {
-            cnt::TicketFile read_tik_file;
-
-            if(R_SUCCEEDED(fsOpenBisStorage(&g_FatFsDumpBisStorage, FsBisPartitionId_System))) {
-                FATFS fs;
-                GLEAF_ASSERT_TRUE(f_mount(&fs, "0", 1) == FR_OK);
-                FIL save;
-                GLEAF_ASSERT_TRUE(f_open(&save, "0:/save/80000000000000e1", FA_READ | FA_OPEN_EXISTING) == FR_OK);
-
-                u32 tmp_size = 0;
-                u8 tmp_tik_buf[0x400];
-                while(true) {
-                    const auto fr = f_read(&save, tmp_tik_buf, sizeof(tmp_tik_buf), &tmp_size);
-                    if(fr != FR_OK) {
-                        break;
-                    }
-                    if(tmp_size == 0) {
-                        break;
-                    }
+    cnt::TicketFile ReadTicket(const u64 app_id) {
+        cnt::TicketFile read_tik_file;
+
+        if(R_SUCCEEDED(fsOpenBisStorage(&g_FatFsDumpBisStorage, FsBisPartitionId_System))) {
+            FATFS fs;
+            GLEAF_ASSERT_TRUE(f_mount(&fs, "0", 1) == FR_OK);
+            FIL save;
+            GLEAF_ASSERT_TRUE(f_open(&save, "0:/save/80000000000000e1", FA_READ | FA_OPEN_EXISTING) == FR_OK);
+
+            u32 tmp_size = 0;
+            u8 tmp_tik_buf[0x400];
+            while(true) {
+                const auto fr = f_read(&save, tmp_tik_buf, sizeof(tmp_tik_buf), &tmp_size);
+                if(fr != FR_OK) {
+                    break;
+                }
+                if(tmp_size == 0) {
+                    break;
+                }
 
-                    const auto tik_sig = *reinterpret_cast<cnt::TicketSignature*>(tmp_tik_buf);
-                    if(cnt::IsValidTicketSignature(tik_sig)) {
-                        cnt::TicketFile tik_file = { .signature = tik_sig };
-                        const auto tik_sig_size = cnt::GetTicketSignatureSize(tik_file.signature);
-                        memcpy(tik_file.signature_data, tmp_tik_buf + sizeof(tik_file.signature), cnt::GetTicketSignatureDataSize(tik_file.signature));
-                        memcpy(&tik_file.data, tmp_tik_buf + tik_sig_size, sizeof(tik_file.data));
-
-                        if(app_id == esGetRightsIdApplicationId(&tik_file.data.rights_id)) {
-                            read_tik_file = tik_file;
-                            break;
-                        }
+                const auto tik_sig = *reinterpret_cast<cnt::TicketSignature*>(tmp_tik_buf);
+                if(cnt::IsValidTicketSignature(tik_sig)) {
+                    cnt::TicketFile tik_file = { .signature = tik_sig };
+                    const auto tik_sig_size = cnt::GetTicketSignatureSize(tik_file.signature);
+                    memcpy(tik_file.signature_data, tmp_tik_buf + sizeof(tik_file.signature), cnt::GetTicketSignatureDataSize(tik_file.signature));
+                    memcpy(&tik_file.data, tmp_tik_buf + tik_sig_size, sizeof(tik_file.data));
+
+                    if(app_id == esGetRightsIdApplicationId(&tik_file.data.rights_id)) {
+                        read_tik_file = tik_file;
+                        break;
                     }
                 }
-
-                f_close(&save);
-                f_mount(nullptr, "0", 1);
-                fsStorageClose(&g_FatFsDumpBisStorage);
             }
 
-            return read_tik_file;
+            f_close(&save);
+            f_mount(nullptr, "0", 1);
+            fsStorageClose(&g_FatFsDumpBisStorage);
         }
 
+        return read_tik_file;
     }
 
-    Result DecryptCopyNax0ToNca(NcmContentStorage *cnt_storage, const NcmContentId cnt_id, const std::string &path, DecryptStartCallback dec_start_cb, DecryptProgressCallback dec_prog_cb) {
+    Result StreamContent(NcmContentStorage *cnt_storage, const NcmStorageId cnt_storage_id, const NcmContentId cnt_id, const fs::StorageKind dst_kind, ContentWriteFunction write_fn, DecryptProgressCallback prog_cb) {
         s64 cnt_size = 0;
         GLEAF_RC_TRY(ncmContentStorageGetSizeFromContentId(cnt_storage, &cnt_size, &cnt_id));
         auto rem_size = static_cast<u64>(cnt_size);
-        auto exp = fs::GetExplorerForPath(path);
-        dec_start_cb((double)cnt_size);
-
-        auto data_buf = new u8[g_Settings.json_settings.exports.value().decrypt_buffer_max_size.value()]();
-        ScopeGuard on_exit([&]() {
-            delete[] data_buf;
-        });
-
-        s64 off = 0;
-        exp->StartFile(path, fs::FileMode::Write);
-        while(rem_size) {
-            const auto read_size = std::min(g_Settings.json_settings.exports.value().decrypt_buffer_max_size.value(), rem_size);
-            GLEAF_RC_TRY(ncmContentStorageReadContentIdFile(cnt_storage, data_buf, read_size, &cnt_id, off));
-            exp->WriteFile(path, data_buf, read_size);
-            rem_size -= read_size;
-            off += read_size;
-            dec_prog_cb((double)read_size);
+        u64 off = 0;
+
+        if(cnt_storage_id == NcmStorageId_SdCard) {
+            // SD card contents are NAX0 files, which NCM decrypts for us
+            const auto decrypt_buffer_size = g_Settings.json_settings.exports.value().decrypt_buffer_max_size.value();
+            auto data_buf = new u8[decrypt_buffer_size]();
+            ScopeGuard on_exit([&]() {
+                delete[] data_buf;
+            });
+            fs::ChunkSizeTuner tuner(fs::GetStorageKindForStorageId(cnt_storage_id), dst_kind, decrypt_buffer_size);
+
+            while(rem_size) {
+                const auto read_size = tuner.GetChunkSize(rem_size);
+                GLEAF_RC_TRY(ncmContentStorageReadContentIdFile(cnt_storage, data_buf, read_size, &cnt_id, off));
+                GLEAF_RC_TRY(write_fn(data_buf, read_size));
+                tuner.NotifyTransferred(read_size);
+                rem_size -= read_size;
+                off += read_size;
+                prog_cb((double)read_size);
+            }
+        }
+        else {
+            // NAND contents are plain NCAs, which are read straight from the partition
+            fs::Explorer *nand_exp = nullptr;
+            if(cnt_storage_id == NcmStorageId_BuiltInSystem) {
+                nand_exp = fs::GetNANDSystemExplorer();
+            }
+            else if(cnt_storage_id == NcmStorageId_BuiltInUser) {
+                nand_exp = fs::GetNANDUserExplorer();
+            }
+            else {
+                return rc::goldleaf::ResultUnableToLocateContents;
+            }
+
+            const auto cnt_ncm_path = GetContentIdPath(cnt_storage, cnt_id);
+            const auto cnt_path = nand_exp->MakeAbsolute("Contents/" + cnt_ncm_path.substr(cnt_ncm_path.find("://") + __builtin_strlen("://")));
+            auto work_buf = fs::CheckoutWorkBuffer();
+            fs::ChunkSizeTuner tuner(nand_exp->GetStorageKind(), dst_kind, fs::DefaultWorkBufferSize);
+            nand_exp->StartFile(cnt_path, fs::FileMode::Read);
+            ScopeGuard on_exit([&]() {
+                nand_exp->EndFile();
+                fs::ReturnWorkBuffer(work_buf);
+            });
+
+            while(rem_size) {
+                const auto read_size = nand_exp->ReadFile(cnt_path, off, tuner.GetChunkSize(rem_size), work_buf);
+                GLEAF_RC_UNLESS(read_size > 0, rc::goldleaf::ResultUnableToLocateContents);
+                GLEAF_RC_TRY(write_fn(work_buf, read_size));
+                tuner.NotifyTransferred(read_size);
+                rem_size -= read_size;
+                off += read_size;
+                prog_cb((double)read_size);
+            }
         }
-        exp->EndFile();
-        
+
         GLEAF_RC_SUCCEED;
     }
 
-    std::string ExportTicketCert(const u64 app_id, const bool export_cert) {
-        const auto tik_file = ReadTicket(app_id);
-
+    std::string FormatRightsId(const cnt::TicketFile &tik_file) {
         std::stringstream rights_id_strm;
         for(u32 i = 0; i < sizeof(tik_file.data.rights_id.id); i++) {
             rights_id_strm << std::setw(2) << std::setfill('0') << std::hex << static_cast<u32>(tik_file.data.rights_id.fs_id.c[i]);
         }
-        const auto fmt_rights_id = rights_id_strm.str();
+        return rights_id_strm.str();
+    }
+
+    std::string ExportTicketCert(const u64 app_id, const bool export_cert) {
+        const auto tik_file = ReadTicket(app_id);
+        const auto fmt_rights_id = FormatRightsId(tik_file);
 
         const auto fmt_app_id = util::FormatApplicationId(esGetRightsIdApplicationId(&tik_file.data.rights_id));
 
@@ -0,0 +1,215 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <fs/fs_ChunkSizeTuner.hpp>
+#include <cfg/cfg_Settings.hpp>
+
+extern cfg::Settings g_Settings;
+
+namespace fs {
+
+    namespace {
+
+        // Any throughput this much lower than the best one so far means that bigger chunks won't get any better
+        constexpr double ProbeStopThroughputRatio = 0.9;
+
+        // Guards both the learned sizes not saved yet and the ones in the settings
+        Lock g_TunedChunkSizesLock;
+        std::vector<cfg::json::TunedChunkSize> g_PendingTunedChunkSizes;
+
+        std::optional<size_t> FindTunedChunkSize(const std::vector<cfg::json::TunedChunkSize> &tuned_sizes, const std::string &src_name, const std::string &dst_name) {
+            for(const auto &tuned_size: tuned_sizes) {
+                if((tuned_size.source == src_name) && (tuned_size.destination == dst_name)) {
+                    return tuned_size.size;
+                }
+            }
+            return std::nullopt;
+        }
+
+        std::optional<size_t> FindTunedChunkSize(const StorageKind src_kind, const StorageKind dst_kind) {
+            ScopedLock lk(g_TunedChunkSizesLock);
+            const auto src_name = GetStorageKindName(src_kind);
+            const auto dst_name = GetStorageKindName(dst_kind);
+
+            const auto pending_size = FindTunedChunkSize(g_PendingTunedChunkSizes, src_name, dst_name);
+            if(pending_size.has_value()) {
+                return pending_size;
+            }
+
+            const auto &fs_settings = g_Settings.json_settings.fs.value();
+            if(fs_settings.tuned_chunk_sizes.has_value()) {
+                return FindTunedChunkSize(fs_settings.tuned_chunk_sizes.value(), src_name, dst_name);
+            }
+            return std::nullopt;
+        }
+
+        void UpdateTunedChunkSize(std::vector<cfg::json::TunedChunkSize> &tuned_sizes, const cfg::json::TunedChunkSize &new_tuned_size) {
+            auto it = std::find_if(tuned_sizes.begin(), tuned_sizes.end(), [&](const cfg::json::TunedChunkSize &tuned_size) {
+                return (tuned_size.source == new_tuned_size.source) && (tuned_size.destination == new_tuned_size.destination);
+            });
+            if(it != tuned_sizes.end()) {
+                it->size = new_tuned_size.size;
+            }
+            else {
+                tuned_sizes.push_back(new_tuned_size);
+            }
+        }
+
+    }
+
+    const char *GetStorageKindName(const StorageKind kind) {
+        switch(kind) {
+            case StorageKind::SdCard: return "sd_card";
+            case StorageKind::NAND: return "nand";
+            case StorageKind::Drive: return "drive";
+            case StorageKind::RemotePC: return "remote_pc";
+            default: return "other";
+        }
+    }
+
+    StorageKind GetStorageKindForStorageId(const NcmStorageId storage_id) {
+        switch(storage_id) {
+            case NcmStorageId_SdCard: return StorageKind::SdCard;
+            case NcmStorageId_BuiltInSystem:
+            case NcmStorageId_BuiltInUser: return StorageKind::NAND;
+            default: return StorageKind::Other;
+        }
+    }
+
+    void SaveTunedChunkSizes() {
+        ScopedLock lk(g_TunedChunkSizesLock);
+        if(g_PendingTunedChunkSizes.empty()) {
+            return;
+        }
+
+        auto &fs_settings = g_Settings.json_settings.fs.value();
+        if(!fs_settings.tuned_chunk_sizes.has_value()) {
+            fs_settings.tuned_chunk_sizes = std::vector<cfg::json::TunedChunkSize>{};
+        }
+        for(const auto &tuned_size: g_PendingTunedChunkSizes) {
+            UpdateTunedChunkSize(fs_settings.tuned_chunk_sizes.value(), tuned_size);
+        }
+        g_PendingTunedChunkSizes.clear();
+        g_Settings.Save();
+    }
+
+    void ForgetTunedChunkSizes(const StorageKind kind) {
+        ScopedLock lk(g_TunedChunkSizesLock);
+        const std::string kind_name = GetStorageKindName(kind);
+        const auto involves_kind = [&](const cfg::json::TunedChunkSize &tuned_size) {
+            return (tuned_size.source == kind_name) || (tuned_size.destination == kind_name);
+        };
+
+        std::erase_if(g_PendingTunedChunkSizes, involves_kind);
+        auto &fs_settings = g_Settings.json_settings.fs.value();
+        if(fs_settings.tuned_chunk_sizes.has_value() && (std::erase_if(fs_settings.tuned_chunk_sizes.value(), involves_kind) > 0)) {
+            g_Settings.Save();
+        }
+    }
+
+    void ForgetTunedChunkSizes() {
+        // The caller is expected to save the settings afterwards
+        ScopedLock lk(g_TunedChunkSizesLock);
+        g_PendingTunedChunkSizes.clear();
+        g_Settings.json_settings.fs.value().tuned_chunk_sizes = std::vector<cfg::json::TunedChunkSize>{};
+    }
+
+    ChunkSizeTuner::ChunkSizeTuner(const StorageKind src_kind, const StorageKind dst_kind, const size_t max_size) : src_kind(src_kind), dst_kind(dst_kind), probe_sizes(), cur_probe_idx(0), probe_start_tick(0), probe_size(0), probe_chunk_count(0), best_throughput(0.0), best_chunk_size(max_size), chunk_size(max_size), probing(false), converged(false) {
+        if(!g_Settings.json_settings.fs.value().adaptive_chunk_size.value_or(true)) {
+            return;
+        }
+
+        const auto tuned_size = FindTunedChunkSize(src_kind, dst_kind);
+        if(tuned_size.has_value()) {
+            // The buffer size setting may have been lowered since this was learned
+            this->chunk_size = std::clamp(tuned_size.value(), std::min(ChunkSizeTunerMinSize, max_size), max_size);
+            return;
+        }
+
+        for(auto size = ChunkSizeTunerMinSize; size < max_size; size *= 2) {
+            this->probe_sizes.push_back(size);
+        }
+        this->probe_sizes.push_back(max_size);
+
+        if(this->probe_sizes.size() > 1) {
+            this->chunk_size = this->probe_sizes.front();
+            this->probing = true;
+        }
+    }
+
+    ChunkSizeTuner::~ChunkSizeTuner() {
+        // Transfers which ended before probing finished don't teach anything
+        if(this->converged) {
+            ScopedLock lk(g_TunedChunkSizesLock);
+            UpdateTunedChunkSize(g_PendingTunedChunkSizes, {
+                .source = GetStorageKindName(this->src_kind),
+                .destination = GetStorageKindName(this->dst_kind),
+                .size = this->chunk_size
+            });
+        }
+    }
+
+    void ChunkSizeTuner::FinishProbe() {
+        const auto elapsed_s = (double)armTicksToNs(armGetSystemTick() - this->probe_start_tick) / 1'000'000'000.0;
+        const auto throughput = (double)this->probe_size / elapsed_s;
+        GLEAF_LOG_FMT("Chunk size 0x%lX (%s -> %s): %.2f MB/s", this->chunk_size, GetStorageKindName(this->src_kind), GetStorageKindName(this->dst_kind), throughput / (double)1_MB);
+
+        const auto keep_probing = throughput >= (this->best_throughput * ProbeStopThroughputRatio);
+        if(throughput > this->best_throughput) {
+            this->best_throughput = throughput;
+            this->best_chunk_size = this->chunk_size;
+        }
+
+        this->cur_probe_idx++;
+        if(keep_probing && (this->cur_probe_idx < this->probe_sizes.size())) {
+            this->chunk_size = this->probe_sizes.at(this->cur_probe_idx);
+            this->probe_start_tick = 0;
+            this->probe_size = 0;
+            this->probe_chunk_count = 0;
+        }
+        else {
+            this->chunk_size = this->best_chunk_size;
+            this->probing = false;
+            this->converged = true;
+            GLEAF_LOG_FMT("Tuned chunk size (%s -> %s): 0x%lX", GetStorageKindName(this->src_kind), GetStorageKindName(this->dst_kind), this->chunk_size);
+        }
+    }
+
+    void ChunkSizeTuner::NotifyTransferred(const size_t size) {
+        if(!this->probing) {
+            return;
+        }
+
+        // The first chunk of every probed size is left out, since it still overlaps with the previous size (or with the transfer's setup)
+        if(this->probe_start_tick == 0) {
+            this->probe_start_tick = armGetSystemTick();
+            return;
+        }
+
+        this->probe_size += size;
+        this->probe_chunk_count++;
+        const auto elapsed_ns = armTicksToNs(armGetSystemTick() - this->probe_start_tick);
+        if((this->probe_chunk_count >= ChunkSizeTunerProbeMinChunkCount) && (elapsed_ns >= ChunkSizeTunerProbeTimeNs)) {
+            this->FinishProbe();
+        }
+    }
+
+}
@@ -0,0 +1,130 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <fs/fs_FileSystem.hpp>
+
+namespace fs {
+
+    // Copies can go to any other (mounted) explorer, so they're kept apart from the rest of the explorer code
+
+    void Explorer::CopyFile(const std::string &path, const std::string &new_path) {
+        const auto full_path = this->MakeFull(path);
+        auto exp = GetExplorerForPath(new_path);
+        const auto full_new_path = exp->MakeFull(new_path);
+        auto work_buf = CheckoutWorkBuffer();
+        ChunkSizeTuner tuner(this->GetStorageKind(), exp->GetStorageKind(), DefaultWorkBufferSize);
+        auto rem_size = this->GetFileSize(full_path);
+        u64 offset = 0;
+        this->StartFile(full_path, fs::FileMode::Read);
+        exp->StartFile(full_new_path, fs::FileMode::Write);
+        while(rem_size) {
+            const auto read_size = this->ReadFile(full_path, offset, tuner.GetChunkSize(rem_size), work_buf);
+            rem_size -= read_size;
+            offset += read_size;
+            exp->WriteFile(new_path, work_buf, read_size);
+            tuner.NotifyTransferred(read_size);
+        }
+        ReturnWorkBuffer(work_buf);
+        this->EndFile();
+        exp->EndFile();
+    }
+
+    void Explorer::CopyDirectory(const std::string &dir, const std::string &new_dir) {
+        const auto full_dir = this->MakeFull(dir);
+        auto exp = GetExplorerForPath(new_dir);
+        const auto full_new_dir = exp->MakeFull(new_dir);
+        exp->CreateDirectory(full_new_dir);
+        const auto dirs = this->GetDirectories(full_dir);
+        for(const auto &sub_dir: dirs) {
+            const auto from = full_dir + "/" + sub_dir;
+            const auto to = full_new_dir + "/" + sub_dir;
+            this->CopyDirectory(from, to);
+        }
+        const auto files = this->GetFiles(full_dir);
+        for(const auto &sub_file: files) {
+            const auto from = full_dir + "/" + sub_file;
+            const auto to = full_new_dir + "/" + sub_file;
+            this->CopyFile(from, to);
+        }
+    }
+
+    void Explorer::CopyFileProgress(const std::string &path, const std::string &new_path, CopyFileStartCallback start_cb, CopyFileProgressCallback prog_cb) {
+        const auto full_path = this->MakeFull(path);
+        auto exp = GetExplorerForPath(new_path);
+        const auto full_new_path = exp->MakeFull(new_path);
+        auto work_buf = CheckoutWorkBuffer();
+        ChunkSizeTuner tuner(this->GetStorageKind(), exp->GetStorageKind(), DefaultWorkBufferSize);
+        const auto file_size = this->GetFileSize(full_path);
+        start_cb(file_size);
+        auto rem_size = file_size;
+        u64 offset = 0;
+        this->StartFile(full_path, fs::FileMode::Read);
+        exp->StartFile(full_new_path, fs::FileMode::Write);
+        while(rem_size) {
+            const auto read_size = this->ReadFile(full_path, offset, tuner.GetChunkSize(rem_size), work_buf);
+            rem_size -= read_size;
+            offset += read_size;
+            exp->WriteFile(full_new_path, work_buf, read_size);
+            tuner.NotifyTransferred(read_size);
+            prog_cb(read_size);
+        }
+        ReturnWorkBuffer(work_buf);
+        this->EndFile();
+        exp->EndFile();
+    }
+
+    namespace {
+
+        void DoCopyDirectoryProgress(Explorer *exp, u64 &cur_done_size, const u64 total_size, const std::string &dir, const std::string &new_dir, CopyDirectoryFileStartCallback file_start_cb, CopyDirectoryFileProgressCallback file_prog_cb) {
+            const auto full_dir = exp->MakeFull(dir);
+            auto new_exp = GetExplorerForPath(new_dir);
+            const auto full_new_dir = new_exp->MakeFull(new_dir);
+            new_exp->CreateDirectory(full_new_dir);
+
+            for(const auto &copy_file_name: exp->GetFiles(full_dir)) {
+                const auto copy_file = full_dir + "/" + copy_file_name;
+                const auto new_file = full_new_dir + "/" + copy_file_name;
+                exp->CopyFileProgress(copy_file, new_file, [&](const size_t file_size) {
+                    file_start_cb(file_size, copy_file, new_file);
+                }, [&](const size_t cur_rw_size) {
+                    file_prog_cb(cur_rw_size);
+                });
+                cur_done_size += exp->GetFileSize(copy_file);
+            }
+
+            for(const auto &copy_dir_name: exp->GetDirectories(full_dir)) {
+                const auto copy_dir = full_dir + "/" + copy_dir_name;
+                const auto new_dir = full_new_dir + "/" + copy_dir_name;
+                DoCopyDirectoryProgress(exp, cur_done_size, total_size, copy_dir, new_dir, file_start_cb, file_prog_cb);
+            }
+        }
+
+    }
+
+    void Explorer::CopyDirectoryProgress(const std::string &dir, const std::string &new_dir, CopyDirectoryStartCallback start_cb, CopyDirectoryFileStartCallback file_start_cb, CopyDirectoryFileProgressCallback file_prog_cb) {
+        u64 cur_done_size = 0;
+        const auto total_size = this->GetDirectorySize(dir);
+        start_cb(total_size);
+
+        DoCopyDirectoryProgress(this, cur_done_size, total_size, dir, new_dir, file_start_cb, file_prog_cb);
+    }
+
+}
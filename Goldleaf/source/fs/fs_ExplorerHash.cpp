@@ -0,0 +1,209 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <fs/fs_Explorer.hpp>
+#include <mbedtls/sha256.h>
+
+namespace fs {
+
+    namespace {
+
+        // Reading (in the caller's thread) and hashing (in a separate one) happen at the same time, through a small ring of work buffers
+        // Hashes are inherently sequential, so this is as parallel as hashing a single range gets
+
+        constexpr u32 HashBufferCount = 3;
+
+        struct HashBuffer {
+            u8 *buf;
+            size_t size;
+        };
+
+        class FileHasher {
+            private:
+                mbedtls_sha256_context sha_ctx;
+                std::array<HashBuffer, HashBufferCount> buffers;
+                u32 buffer_head;
+                u32 buffer_tail;
+                u32 buffer_count;
+                Lock buffer_lock;
+                UEvent buffer_free_event;
+                UEvent buffer_ready_event;
+                bool done;
+                Thread thread;
+                bool thread_started;
+
+                HashBuffer *AcquireReadyBuffer() {
+                    while(true) {
+                        {
+                            ScopedLock buffer_lock(this->buffer_lock);
+                            if(this->buffer_count > 0) {
+                                return std::addressof(this->buffers.at(this->buffer_head));
+                            }
+                            if(this->done) {
+                                return nullptr;
+                            }
+                        }
+
+                        waitSingle(waiterForUEvent(&this->buffer_ready_event), UINT64_MAX);
+                    }
+                }
+
+                void ReleaseHashedBuffer() {
+                    {
+                        ScopedLock buffer_lock(this->buffer_lock);
+                        this->buffer_head = (this->buffer_head + 1) % this->buffers.size();
+                        this->buffer_count--;
+                    }
+                    ueventSignal(&this->buffer_free_event);
+                }
+
+                static void Main(void *hasher_raw) {
+                    auto hasher = reinterpret_cast<FileHasher*>(hasher_raw);
+                    while(true) {
+                        auto buf = hasher->AcquireReadyBuffer();
+                        if(buf == nullptr) {
+                            break;
+                        }
+
+                        mbedtls_sha256_update(&hasher->sha_ctx, buf->buf, buf->size);
+                        hasher->ReleaseHashedBuffer();
+                    }
+                }
+
+            public:
+                FileHasher(const size_t buffer_size) : buffers(), buffer_head(0), buffer_tail(0), buffer_count(0), buffer_lock(), done(false), thread(), thread_started(false) {
+                    for(auto &buf: this->buffers) {
+                        buf = {
+                            .buf = CheckoutWorkBuffer(buffer_size),
+                            .size = 0
+                        };
+                    }
+
+                    ueventCreate(&this->buffer_free_event, true);
+                    ueventCreate(&this->buffer_ready_event, true);
+                    mbedtls_sha256_init(&this->sha_ctx);
+                    mbedtls_sha256_starts(&this->sha_ctx, 0);
+                }
+
+                ~FileHasher() {
+                    this->Finish();
+                    mbedtls_sha256_free(&this->sha_ctx);
+                    for(auto &buf: this->buffers) {
+                        ReturnWorkBuffer(buf.buf);
+                    }
+                }
+
+                Result Start() {
+                    GLEAF_RC_TRY(threadCreate(&this->thread, Main, reinterpret_cast<void*>(this), nullptr, 128_KB, 0x1F, -2));
+                    GLEAF_RC_TRY(threadStart(&this->thread));
+                    this->thread_started = true;
+                    GLEAF_RC_SUCCEED;
+                }
+
+                // Once finished, everything committed has been hashed
+                void Finish() {
+                    if(this->thread_started) {
+                        {
+                            ScopedLock buffer_lock(this->buffer_lock);
+                            this->done = true;
+                        }
+                        ueventSignal(&this->buffer_ready_event);
+
+                        threadWaitForExit(&this->thread);
+                        threadClose(&this->thread);
+                        this->thread_started = false;
+                    }
+                }
+
+                u8 *AcquireFreeBuffer() {
+                    while(true) {
+                        {
+                            ScopedLock buffer_lock(this->buffer_lock);
+                            if(this->buffer_count < this->buffers.size()) {
+                                return this->buffers.at(this->buffer_tail).buf;
+                            }
+                        }
+
+                        waitSingle(waiterForUEvent(&this->buffer_free_event), UINT64_MAX);
+                    }
+                }
+
+                void CommitBuffer(const size_t size) {
+                    {
+                        ScopedLock buffer_lock(this->buffer_lock);
+                        this->buffers.at(this->buffer_tail).size = size;
+                        this->buffer_tail = (this->buffer_tail + 1) % this->buffers.size();
+                        this->buffer_count++;
+                    }
+                    ueventSignal(&this->buffer_ready_event);
+                }
+
+                void GetHash(FileHash &out_hash) {
+                    this->Finish();
+                    mbedtls_sha256_finish(&this->sha_ctx, out_hash.data());
+                }
+        };
+
+    }
+
+    bool Explorer::ComputeHash(const std::string &path, const u64 offset, const u64 size, const HashAlgorithm algo, FileHash &out_hash, HashProgressCallback prog_cb) {
+        if(algo != HashAlgorithm::Sha256) {
+            return false;
+        }
+        GLEAF_ASSERT_TRUE(!this->HasStartedFile());
+
+        const auto full_path = this->MakeFull(path);
+        const auto file_size = this->GetFileSize(full_path);
+        if(offset > file_size) {
+            return false;
+        }
+
+        FileHasher hasher(DefaultWorkBufferSize);
+        if(R_FAILED(hasher.Start())) {
+            return false;
+        }
+
+        auto rem_size = std::min(size, file_size - offset);
+        auto cur_offset = offset;
+        auto ok = true;
+        this->StartFile(full_path, FileMode::Read);
+        while(rem_size > 0) {
+            auto buf = hasher.AcquireFreeBuffer();
+            const auto read_size = this->ReadFile(full_path, cur_offset, std::min<u64>(rem_size, DefaultWorkBufferSize), buf);
+            if(read_size == 0) {
+                ok = false;
+                break;
+            }
+
+            hasher.CommitBuffer(read_size);
+            cur_offset += read_size;
+            rem_size -= read_size;
+            if(prog_cb) {
+                prog_cb(read_size);
+            }
+        }
+        this->EndFile();
+
+        hasher.GetHash(out_hash);
+        return ok;
+    }
+
+}
@@ -160,6 +160,10 @@ namespace fs {
             DeleteExplorer(exp);
         }
         g_MountedExplorers.clear();
+
+        const auto pool_stats = GetWorkBufferPoolStats();
+        GLEAF_LOG_FMT("Work buffer pool: high-water size 0x%lX, %ld checkouts (%ld reused)", pool_stats.high_water_size, pool_stats.checkout_count, pool_stats.reuse_count);
+        TrimWorkBufferPool();
     }
 
     void RegisterMountedExplorer(Explorer *exp) {
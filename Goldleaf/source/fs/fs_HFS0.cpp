@@ -0,0 +1,60 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <fs/fs_HFS0.hpp>
+
+namespace fs {
+
+    HFS0::HFS0(fs::Explorer *exp, const std::string &path, const u64 offset) : PartitionFileSystem(exp, path) {
+        this->exp->StartFile(this->path, fs::FileMode::Read);
+        this->ok = this->LoadFileTable<Header, FileEntry>(offset, Magic);
+        this->exp->EndFile();
+    }
+
+    std::unique_ptr<HFS0> OpenXciPartition(fs::Explorer *exp, const std::string &path, const std::string &partition_name) {
+        u32 magic = 0;
+        u64 root_offset = 0;
+        exp->StartFile(path, fs::FileMode::Read);
+        exp->ReadFile(path, XciHeaderMagicOffset, sizeof(magic), &magic);
+        exp->ReadFile(path, XciRootPartitionOffsetOffset, sizeof(root_offset), &root_offset);
+        exp->EndFile();
+        if(magic != XciHeaderMagic) {
+            return nullptr;
+        }
+
+        HFS0 root_hfs0(exp, path, root_offset);
+        if(!root_hfs0.IsOk()) {
+            return nullptr;
+        }
+
+        const auto partition_idx = root_hfs0.GetFileIndexByName(partition_name);
+        if(HFS0::IsInvalidFileIndex(partition_idx)) {
+            return nullptr;
+        }
+
+        auto partition = std::make_unique<HFS0>(exp, path, root_hfs0.GetFileDataOffset(partition_idx));
+        if(!partition->IsOk()) {
+            return nullptr;
+        }
+        return partition;
+    }
+
+}
@@ -0,0 +1,148 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <fs/fs_PartitionFileSystem.hpp>
+
+namespace fs {
+
+    namespace {
+
+        // FNV-1a, case-insensitive (names are compared with strcasecmp semantics)
+        u32 HashFileName(const std::string_view name) {
+            u32 hash = 0x811C9DC5;
+            for(const auto ch: name) {
+                hash ^= static_cast<u8>(std::tolower(static_cast<u8>(ch)));
+                hash *= 0x01000193;
+            }
+            return hash;
+        }
+
+        inline bool FileNamesEqual(const std::string_view a, const std::string_view b) {
+            return (a.length() == b.length()) && (strncasecmp(a.data(), b.data(), a.length()) == 0);
+        }
+
+    }
+
+    void PartitionFileSystem::BuildNameIndex() {
+        size_t index_size = 8;
+        while(index_size < (this->files.size() * 2)) {
+            index_size *= 2;
+        }
+        this->name_index.assign(index_size, InvalidFileIndex);
+
+        const auto mask = index_size - 1;
+        for(u32 i = 0; i < this->files.size(); i++) {
+            const auto name = this->files[i].name;
+            for(auto slot = HashFileName(name) & mask; true; slot = (slot + 1) & mask) {
+                const auto slot_idx = this->name_index[slot];
+                if(IsInvalidFileIndex(slot_idx)) {
+                    this->name_index[slot] = i;
+                    break;
+                }
+
+                // With repeated names, the first one is the one found (as the former linear search did)
+                if(FileNamesEqual(this->files[slot_idx].name, name)) {
+                    break;
+                }
+            }
+        }
+    }
+
+    std::string PartitionFileSystem::GetFile(const u32 idx) {
+        if(IsInvalidFileIndex(idx) || (idx >= this->files.size())) {
+            return "";
+        }
+        else {
+            return std::string(this->files[idx].name);
+        }
+    }
+
+    u64 PartitionFileSystem::ReadFromFile(const u32 idx, const u64 offset, const u64 size, void *read_buf) {
+        return this->exp->ReadFile(this->path, (this->data_offset + this->files[idx].offset + offset), size, read_buf);
+    }
+
+    std::vector<std::string> PartitionFileSystem::GetFiles() {
+        std::vector<std::string> file_names;
+        file_names.reserve(this->files.size());
+        for(const auto &file: this->files) {
+            file_names.push_back(std::string(file.name));
+        }
+        return file_names;
+    }
+
+    u64 PartitionFileSystem::GetFileSize(const u32 idx) {
+        if(IsInvalidFileIndex(idx) || (idx >= this->files.size())) {
+            return 0;
+        }
+        else {
+            return this->files[idx].size;
+        }
+    }
+
+    u64 PartitionFileSystem::GetFileDataOffset(const u32 idx) {
+        if(IsInvalidFileIndex(idx) || (idx >= this->files.size())) {
+            return 0;
+        }
+        else {
+            return this->data_offset + this->files[idx].offset;
+        }
+    }
+
+    void PartitionFileSystem::SaveFile(const u32 idx, fs::Explorer *path_exp, const std::string &path) {
+        if(IsInvalidFileIndex(idx) || (idx >= this->files.size())) {
+            return;
+        }
+
+        const auto file_size = this->GetFileSize(idx);
+        auto work_buf = fs::CheckoutWorkBuffer();
+        auto rem_size = file_size;
+        u64 off = 0;
+        path_exp->DeleteFile(path);
+        path_exp->CreateFile(path);
+        this->exp->StartFile(this->path, fs::FileMode::Read);
+        path_exp->StartFile(path, fs::FileMode::Write);
+        while(rem_size) {
+            const auto read_size = this->ReadFromFile(idx, off, std::min(fs::DefaultWorkBufferSize, rem_size), work_buf);
+            path_exp->WriteFile(path, work_buf, read_size);
+            off += read_size;
+            rem_size -= read_size;
+        }
+        this->exp->EndFile();
+        path_exp->EndFile();
+        fs::ReturnWorkBuffer(work_buf);
+    }
+
+    u32 PartitionFileSystem::GetFileIndexByName(const std::string &file_name) {
+        if(this->name_index.empty()) {
+            return InvalidFileIndex;
+        }
+
+        // The index is never full, so there's always an empty slot ending the probing
+        const auto mask = this->name_index.size() - 1;
+        for(auto slot = HashFileName(file_name) & mask; true; slot = (slot + 1) & mask) {
+            const auto idx = this->name_index[slot];
+            if(IsInvalidFileIndex(idx) || FileNamesEqual(this->files[idx].name, file_name)) {
+                return idx;
+            }
+        }
+    }
+
+}
@@ -0,0 +1,375 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <fs/fs_PartitionFileSystem.hpp>
+#include <atomic>
+
+namespace fs {
+
+    namespace {
+
+        // Extracted files are read in the order they are stored (in the caller's thread) and handed to a few writer lanes, each one writing a file at a time from its own pair of buffers
+        // The next chunk is read while the previous one is being written, and small files get written while a big one is still being read
+
+        constexpr u32 ExtractLaneCount = 2;
+        constexpr u32 ExtractLaneBufferCount = 2;
+
+        struct ExtractJob {
+            u32 idx;
+            std::string path;
+            std::atomic_uint64_t written_size;
+        };
+
+        struct ExtractBuffer {
+            u8 *buf;
+            size_t size;
+            ExtractJob *job;
+        };
+
+        class ExtractLane {
+            private:
+                Explorer *exp;
+                std::atomic_uint64_t &total_written_size;
+                std::array<ExtractBuffer, ExtractLaneBufferCount> buffers;
+                u32 buffer_head;
+                u32 buffer_tail;
+                u32 buffer_count;
+                Lock buffer_lock;
+                UEvent buffer_free_event;
+                UEvent buffer_ready_event;
+                bool done;
+                bool failed;
+                Thread thread;
+                bool thread_started;
+
+                ExtractBuffer *AcquireReadyBuffer() {
+                    while(true) {
+                        {
+                            ScopedLock buffer_lock(this->buffer_lock);
+                            if(this->buffer_count > 0) {
+                                return std::addressof(this->buffers.at(this->buffer_head));
+                            }
+                            if(this->done) {
+                                return nullptr;
+                            }
+                        }
+
+                        waitSingle(waiterForUEvent(&this->buffer_ready_event), UINT64_MAX);
+                    }
+                }
+
+                void ReleaseWrittenBuffer(const bool write_ok) {
+                    {
+                        ScopedLock buffer_lock(this->buffer_lock);
+                        this->buffer_head = (this->buffer_head + 1) % this->buffers.size();
+                        this->buffer_count--;
+                        if(!write_ok) {
+                            this->failed = true;
+                        }
+                    }
+                    ueventSignal(&this->buffer_free_event);
+                }
+
+                static void Main(void *lane_raw) {
+                    auto lane = reinterpret_cast<ExtractLane*>(lane_raw);
+
+                    // Every file is entirely handed to a single lane, one after another, so it's kept open until the next one arrives
+                    ExtractJob *cur_job = nullptr;
+                    std::unique_ptr<ConcurrentWriteFile> cur_file;
+                    while(true) {
+                        auto buf = lane->AcquireReadyBuffer();
+                        if(buf == nullptr) {
+                            break;
+                        }
+
+                        // After a failure buffers are just released, so that the reader never stays waiting for a free one
+                        auto write_ok = false;
+                        if(!lane->HasFailed()) {
+                            if(buf->job != cur_job) {
+                                // Writes are only known to have made it to the file once it's closed, a failed close leaves no file to write to
+                                const auto close_ok = (cur_file == nullptr) || R_SUCCEEDED(cur_file->Close());
+                                cur_file.reset();
+                                cur_job = buf->job;
+                                if(close_ok) {
+                                    cur_file = lane->exp->OpenConcurrentWriteFile(cur_job->path);
+                                }
+                            }
+
+                            const auto write_size = (cur_file != nullptr) ? cur_file->Write(buf->buf, buf->size) : 0;
+                            write_ok = write_size == buf->size;
+                            if(write_ok) {
+                                buf->job->written_size += write_size;
+                                lane->total_written_size += write_size;
+                            }
+                        }
+                        lane->ReleaseWrittenBuffer(write_ok);
+                    }
+
+                    // The lane only finishes once the last file is closed, thus its result is known before the extraction is reported
+                    if((cur_file != nullptr) && R_FAILED(cur_file->Close())) {
+                        ScopedLock buffer_lock(lane->buffer_lock);
+                        lane->failed = true;
+                    }
+                }
+
+            public:
+                ExtractLane(Explorer *exp, std::atomic_uint64_t &total_written_size, const size_t buffer_size) : exp(exp), total_written_size(total_written_size), buffers(), buffer_head(0), buffer_tail(0), buffer_count(0), buffer_lock(), done(false), failed(false), thread(), thread_started(false) {
+                    for(auto &buf: this->buffers) {
+                        buf = {
+                            .buf = CheckoutWorkBuffer(buffer_size),
+                            .size = 0,
+                            .job = nullptr
+                        };
+                    }
+
+                    ueventCreate(&this->buffer_free_event, true);
+                    ueventCreate(&this->buffer_ready_event, true);
+                }
+
+                ~ExtractLane() {
+                    this->Finish();
+                    for(auto &buf: this->buffers) {
+                        ReturnWorkBuffer(buf.buf);
+                    }
+                }
+
+                Result Start() {
+                    GLEAF_RC_TRY(threadCreate(&this->thread, Main, reinterpret_cast<void*>(this), nullptr, 128_KB, 0x1F, -2));
+                    GLEAF_RC_TRY(threadStart(&this->thread));
+                    this->thread_started = true;
+                    GLEAF_RC_SUCCEED;
+                }
+
+                // Once finished, everything committed has been written (or the lane failed)
+                void Finish() {
+                    if(this->thread_started) {
+                        {
+                            ScopedLock buffer_lock(this->buffer_lock);
+                            this->done = true;
+                        }
+                        ueventSignal(&this->buffer_ready_event);
+
+                        threadWaitForExit(&this->thread);
+                        threadClose(&this->thread);
+                        this->thread_started = false;
+                    }
+                }
+
+                bool HasFailed() {
+                    ScopedLock buffer_lock(this->buffer_lock);
+                    return this->failed;
+                }
+
+                u8 *AcquireFreeBuffer() {
+                    while(true) {
+                        {
+                            ScopedLock buffer_lock(this->buffer_lock);
+                            if(this->buffer_count < this->buffers.size()) {
+                                return this->buffers.at(this->buffer_tail).buf;
+                            }
+                        }
+
+                        waitSingle(waiterForUEvent(&this->buffer_free_event), UINT64_MAX);
+                    }
+                }
+
+                void CommitBuffer(ExtractJob *job, const size_t size) {
+                    {
+                        ScopedLock buffer_lock(this->buffer_lock);
+                        auto &buf = this->buffers.at(this->buffer_tail);
+                        buf.size = size;
+                        buf.job = job;
+                        this->buffer_tail = (this->buffer_tail + 1) % this->buffers.size();
+                        this->buffer_count++;
+                    }
+                    ueventSignal(&this->buffer_ready_event);
+                }
+        };
+
+        // Names come straight from the package, so they must not be able to point anywhere but the output directory
+        bool IsValidExtractFileName(const std::string_view name) {
+            return !name.empty() && (name != ".") && (name != "..") && (name.find_first_of("/\\:") == std::string_view::npos);
+        }
+
+        void PrepareExtractFile(Explorer *out_exp, const std::string &path, const u64 size) {
+            out_exp->DeleteFile(path);
+            // Same as with copies, big files in the SD card need to be concatenation files
+            if((size >= 4_GB) && (out_exp->GetStorageKind() == StorageKind::SdCard)) {
+                CreateConcatenationFile(path);
+            }
+            else {
+                out_exp->CreateFile(path);
+            }
+        }
+
+        Result ExtractConcurrent(PartitionFileSystem &pfs, const std::vector<ExtractJob*> &jobs, Explorer *out_exp, ExtractProgressCallback &prog_cb) {
+            std::atomic_uint64_t total_written_size = 0;
+            std::vector<std::unique_ptr<ExtractLane>> lanes;
+            const auto lane_count = std::min<size_t>(ExtractLaneCount, jobs.size());
+            for(u32 i = 0; i < lane_count; i++) {
+                auto &lane = lanes.emplace_back(std::make_unique<ExtractLane>(out_exp, total_written_size, DefaultWorkBufferSize));
+                GLEAF_RC_TRY(lane->Start());
+            }
+
+            auto exp = pfs.GetExplorer();
+            auto rc = rc::ResultSuccess;
+            exp->StartFile(pfs.GetPath(), FileMode::Read);
+            for(u32 i = 0; i < jobs.size(); i++) {
+                auto job = jobs.at(i);
+                auto &lane = *lanes.at(i % lane_count);
+                const auto file_size = pfs.GetFileSize(job->idx);
+                u64 offset = 0;
+                while(offset < file_size) {
+                    auto buf = lane.AcquireFreeBuffer();
+                    if(lane.HasFailed()) {
+                        rc = rc::goldleaf::ResultPartitionFileWriteFailed;
+                        break;
+                    }
+
+                    const auto read_size = pfs.ReadFromFile(job->idx, offset, std::min<u64>(file_size - offset, DefaultWorkBufferSize), buf);
+                    if(read_size == 0) {
+                        rc = rc::goldleaf::ResultPartitionFileReadFailed;
+                        break;
+                    }
+
+                    lane.CommitBuffer(job, read_size);
+                    offset += read_size;
+                    prog_cb(job->idx, job->written_size, total_written_size);
+                }
+
+                if(R_FAILED(rc)) {
+                    break;
+                }
+            }
+            exp->EndFile();
+
+            for(auto &lane: lanes) {
+                lane->Finish();
+                if(R_SUCCEEDED(rc) && lane->HasFailed()) {
+                    rc = rc::goldleaf::ResultPartitionFileWriteFailed;
+                }
+            }
+
+            if(R_SUCCEEDED(rc)) {
+                const auto last_job = jobs.back();
+                prog_cb(last_job->idx, last_job->written_size, total_written_size);
+            }
+            return rc;
+        }
+
+        Result ExtractSequential(PartitionFileSystem &pfs, const std::vector<ExtractJob*> &jobs, Explorer *out_exp, ExtractProgressCallback &prog_cb) {
+            auto exp = pfs.GetExplorer();
+            auto work_buf = CheckoutWorkBuffer();
+            u64 total_written_size = 0;
+            auto rc = rc::ResultSuccess;
+
+            // Explorers only have a single started file, thus reads can't be started when extracting to the same explorer
+            const auto start_read = exp != out_exp;
+            if(start_read) {
+                exp->StartFile(pfs.GetPath(), FileMode::Read);
+            }
+            for(auto job: jobs) {
+                const auto file_size = pfs.GetFileSize(job->idx);
+                u64 offset = 0;
+                out_exp->StartFile(job->path, FileMode::Write);
+                while(offset < file_size) {
+                    const auto read_size = pfs.ReadFromFile(job->idx, offset, std::min<u64>(file_size - offset, DefaultWorkBufferSize), work_buf);
+                    if(read_size == 0) {
+                        rc = rc::goldleaf::ResultPartitionFileReadFailed;
+                        break;
+                    }
+                    if(out_exp->WriteFile(job->path, work_buf, read_size) != read_size) {
+                        rc = rc::goldleaf::ResultPartitionFileWriteFailed;
+                        break;
+                    }
+
+                    offset += read_size;
+                    total_written_size += read_size;
+                    prog_cb(job->idx, offset, total_written_size);
+                }
+                out_exp->EndFile();
+
+                if(R_FAILED(rc)) {
+                    break;
+                }
+            }
+            if(start_read) {
+                exp->EndFile();
+            }
+
+            ReturnWorkBuffer(work_buf);
+            return rc;
+        }
+
+    }
+
+    Result PartitionFileSystem::ExtractMany(const std::vector<u32> &idxs, fs::Explorer *out_exp, const std::string &out_dir, ExtractProgressCallback prog_cb) {
+        // Checked before anything is created, so that invalid packages don't leave half-prepared output behind
+        for(const auto idx: idxs) {
+            GLEAF_RC_UNLESS(idx < this->files.size(), rc::goldleaf::ResultPartitionFileReadFailed);
+            GLEAF_RC_UNLESS(IsValidExtractFileName(this->files.at(idx).name), rc::goldleaf::ResultInvalidNsp);
+        }
+
+        const auto full_out_dir = out_exp->MakeFull(out_dir);
+        if(!out_exp->IsDirectory(full_out_dir)) {
+            out_exp->CreateDirectory(full_out_dir);
+        }
+
+        std::vector<ExtractJob> jobs(idxs.size());
+        std::vector<ExtractJob*> sorted_jobs;
+        sorted_jobs.reserve(jobs.size());
+        for(u32 i = 0; i < idxs.size(); i++) {
+            const auto idx = idxs.at(i);
+            auto &job = jobs.at(i);
+            job.idx = idx;
+            job.path = full_out_dir + "/" + std::string(this->files.at(idx).name);
+            job.written_size = 0;
+            PrepareExtractFile(out_exp, job.path, this->files.at(idx).size);
+            sorted_jobs.push_back(std::addressof(job));
+        }
+
+        if(sorted_jobs.empty()) {
+            GLEAF_RC_SUCCEED;
+        }
+
+        // Reading in storage order avoids seeking back and forth, which remote PCs and drives are particularly slow at
+        std::stable_sort(sorted_jobs.begin(), sorted_jobs.end(), [&](const ExtractJob *a, const ExtractJob *b) {
+            return this->files.at(a->idx).offset < this->files.at(b->idx).offset;
+        });
+
+        if(out_exp->SupportsConcurrentWrites()) {
+            return ExtractConcurrent(*this, sorted_jobs, out_exp, prog_cb);
+        }
+        else {
+            return ExtractSequential(*this, sorted_jobs, out_exp, prog_cb);
+        }
+    }
+
+    Result PartitionFileSystem::ExtractAll(fs::Explorer *out_exp, const std::string &out_dir, ExtractProgressCallback prog_cb) {
+        std::vector<u32> idxs;
+        idxs.reserve(this->files.size());
+        for(u32 i = 0; i < this->files.size(); i++) {
+            idxs.push_back(i);
+        }
+        return this->ExtractMany(idxs, out_exp, out_dir, prog_cb);
+    }
+
+}
@@ -24,7 +24,246 @@
 
 namespace fs {
 
-    RemotePCExplorer::RemotePCExplorer(const std::string &mount_name) {
+    namespace {
+
+        inline std::string NormalizeListingPath(const std::string &path) {
+            auto norm_path = path;
+            while(!norm_path.empty() && (norm_path.back() == '/')) {
+                norm_path.pop_back();
+            }
+            return norm_path;
+        }
+
+        std::vector<std::string> GetListedNames(const std::vector<usb::cf::DirectoryEntry> &listing, const usb::cf::PathType type) {
+            std::vector<std::string> names;
+            for(const auto &entry: listing) {
+                if(entry.type == type) {
+                    names.push_back(entry.name);
+                }
+            }
+            return names;
+        }
+
+        using SubmitGetEntryFunction = Result(*)(usb::cmd::CommandPipeline&, const std::string&, const u32, std::string&);
+
+        // Entries are requested one by one (for PCs not supporting bulk listing), pipelining the requests if possible
+        std::vector<std::string> GetEntriesByIndex(const std::string &full_path, const u32 entry_count, SubmitGetEntryFunction submit_fn) {
+            std::vector<std::string> entries(entry_count);
+            std::vector<bool> entries_ok(entry_count, false);
+            {
+                usb::cmd::CommandPipeline pipeline(usb::cf::IsFeatureSupported(usb::cf::Feature::Pipelining));
+                u32 completed_count = 0;
+                for(u32 i = 0; i < entry_count; i++) {
+                    if(pipeline.IsFull()) {
+                        entries_ok[completed_count] = R_SUCCEEDED(pipeline.CompleteNext());
+                        completed_count++;
+                    }
+                    if(R_FAILED(submit_fn(pipeline, full_path, i, entries[i]))) {
+                        break;
+                    }
+                }
+                while(!pipeline.IsEmpty()) {
+                    entries_ok[completed_count] = R_SUCCEEDED(pipeline.CompleteNext());
+                    completed_count++;
+                }
+            }
+
+            std::vector<std::string> ok_entries;
+            ok_entries.reserve(entry_count);
+            for(u32 i = 0; i < entry_count; i++) {
+                if(entries_ok[i]) {
+                    ok_entries.push_back(std::move(entries[i]));
+                }
+            }
+            return ok_entries;
+        }
+
+        // Installs (and copies) read files sequentially, so once a file is started for reading the next chunks are requested ahead (pipelined) into a ring of buffers,
+        // and reads are served from them as they arrive. Reads elsewhere (backwards or past the requested chunks) restart the stream at the new offset
+        constexpr size_t ReadAheadChunkSize = 2_MB;
+        constexpr u32 ReadAheadChunkCount = usb::cmd::MaxPipelinedCommandCount;
+
+        class ReadAheadStream {
+            private:
+                struct Chunk {
+                    u8 *buf;
+                    u64 offset;
+                    u64 size;
+                    u64 read_size;
+                    bool done;
+                };
+
+                std::string path;
+                u64 file_size;
+                size_t chunk_size;
+                u8 *ring_buf;
+                std::vector<u8*> free_bufs;
+                // Declared before the pipeline, since pending commands write into them
+                std::deque<Chunk> chunks;
+                usb::cmd::CommandPipeline pipeline;
+                u64 cur_offset;
+                u64 next_offset;
+                bool failed;
+
+                void Fill() {
+                    while((this->next_offset < this->file_size) && !this->free_bufs.empty() && !this->pipeline.IsFull()) {
+                        const auto chunk_size = std::min<u64>(this->chunk_size, this->file_size - this->next_offset);
+                        auto &chunk = this->chunks.emplace_back(Chunk {
+                            .buf = this->free_bufs.back(),
+                            .offset = this->next_offset,
+                            .size = chunk_size,
+                            .read_size = 0,
+                            .done = false
+                        });
+                        if(R_FAILED(usb::cf::SubmitReadFile(this->pipeline, this->path, chunk.offset, chunk.size, chunk.read_size, chunk.buf))) {
+                            this->chunks.pop_back();
+                            this->failed = true;
+                            break;
+                        }
+
+                        this->free_bufs.pop_back();
+                        this->next_offset += chunk_size;
+                    }
+                }
+
+                bool CompleteFrontChunk() {
+                    auto &chunk = this->chunks.front();
+                    if(!chunk.done) {
+                        // Responses arrive in order, so the next one is always for the oldest chunk not done yet
+                        if(R_FAILED(this->pipeline.CompleteNext())) {
+                            this->failed = true;
+                            return false;
+                        }
+                        chunk.done = true;
+                    }
+                    return true;
+                }
+
+                void PopFrontChunk() {
+                    this->free_bufs.push_back(this->chunks.front().buf);
+                    this->chunks.pop_front();
+                }
+
+                void Restart(const u64 offset) {
+                    this->pipeline.CompleteAll();
+                    while(!this->chunks.empty()) {
+                        this->PopFrontChunk();
+                    }
+                    this->cur_offset = offset;
+                    this->next_offset = offset;
+                }
+
+                void Seek(const u64 offset) {
+                    if((offset < this->cur_offset) || (offset >= this->next_offset)) {
+                        this->Restart(offset);
+                        return;
+                    }
+
+                    // Skipping forward within the requested chunks: just drop the ones before the new offset
+                    while(!this->chunks.empty() && ((this->chunks.front().offset + this->chunks.front().size) <= offset)) {
+                        if(!this->CompleteFrontChunk()) {
+                            return;
+                        }
+                        this->PopFrontChunk();
+                    }
+                    this->cur_offset = offset;
+                }
+
+            public:
+                ReadAheadStream(const std::string &path, const u64 file_size, const size_t chunk_size) : path(path), file_size(file_size), chunk_size(chunk_size), ring_buf(fs::CheckoutWorkBuffer(chunk_size * ReadAheadChunkCount)), free_bufs(), chunks(), pipeline(true), cur_offset(0), next_offset(0), failed(false) {
+                    for(u32 i = 0; i < ReadAheadChunkCount; i++) {
+                        this->free_bufs.push_back(this->ring_buf + i * chunk_size);
+                    }
+                }
+
+                ~ReadAheadStream() {
+                    this->pipeline.CompleteAll();
+                    fs::ReturnWorkBuffer(this->ring_buf);
+                }
+
+                inline const std::string &GetPath() {
+                    return this->path;
+                }
+
+                inline bool HasFailed() {
+                    return this->failed;
+                }
+
+                u64 Read(const u64 offset, const u64 size, u8 *read_buf) {
+                    if(offset != this->cur_offset) {
+                        this->Seek(offset);
+                    }
+
+                    u64 total_read_size = 0;
+                    while((total_read_size < size) && !this->failed) {
+                        this->Fill();
+                        if(this->chunks.empty() || !this->CompleteFrontChunk()) {
+                            break;
+                        }
+
+                        const auto &chunk = this->chunks.front();
+                        const auto chunk_end = chunk.offset + chunk.read_size;
+                        if(this->cur_offset < chunk_end) {
+                            const auto copy_size = std::min(size - total_read_size, chunk_end - this->cur_offset);
+                            std::memcpy(read_buf + total_read_size, chunk.buf + (this->cur_offset - chunk.offset), copy_size);
+                            total_read_size += copy_size;
+                            this->cur_offset += copy_size;
+                        }
+
+                        if(this->cur_offset >= chunk_end) {
+                            const auto short_read = chunk.read_size < chunk.size;
+                            this->PopFrontChunk();
+                            if(short_read) {
+                                // The file got smaller: whatever was requested after this is meaningless
+                                this->file_size = this->cur_offset;
+                                this->Restart(this->cur_offset);
+                                break;
+                            }
+                        }
+                    }
+                    return total_read_size;
+                }
+        };
+
+        // The USB link is shared by every remote PC explorer, so any other command must wait until the stream is stopped
+        std::unique_ptr<ReadAheadStream> g_ReadAheadStream;
+
+        inline void StopReadAhead() {
+            g_ReadAheadStream.reset();
+        }
+
+    }
+
+    bool RemotePCExplorer::UpdateListing(const std::string &full_dir) {
+        this->InvalidateListing();
+        if(R_SUCCEEDED(usb::cf::ListDirectory(full_dir, this->listing))) {
+            this->listing_dir = NormalizeListingPath(full_dir);
+            this->listing_valid = true;
+        }
+        return this->listing_valid;
+    }
+
+    const usb::cf::DirectoryEntry *RemotePCExplorer::FindListedEntry(const std::string &full_path) {
+        if(!this->listing_valid) {
+            return nullptr;
+        }
+
+        const auto norm_path = NormalizeListingPath(full_path);
+        const auto name_start = norm_path.find_last_of('/');
+        if((name_start == std::string::npos) || (norm_path.substr(0, name_start) != this->listing_dir)) {
+            return nullptr;
+        }
+
+        const auto name = norm_path.substr(name_start + 1);
+        for(const auto &entry: this->listing) {
+            if(entry.name == name) {
+                return std::addressof(entry);
+            }
+        }
+        return nullptr;
+    }
+
+    RemotePCExplorer::RemotePCExplorer(const std::string &mount_name) : listing_valid(false), listing_files_pending(false) {
         this->SetNames(mount_name, mount_name);
     }
 
@@ -32,15 +271,17 @@ namespace fs {
         std::vector<std::string> dirs;
         const auto full_path = this->MakeFull(path);
 
+        StopReadAhead();
+
+        // Directories are typically listed right before files (see Explorer::GetContents), so the same listing is reused for the next GetFiles
+        if(usb::cf::IsFeatureSupported(usb::cf::Feature::BulkListing) && this->UpdateListing(full_path)) {
+            this->listing_files_pending = true;
+            return GetListedNames(this->listing, usb::cf::PathType::Directory);
+        }
+
         u32 dir_count = 0;
         if(R_SUCCEEDED(usb::cf::GetDirectoryCount(full_path, dir_count))) {
-            dirs.reserve(dir_count);
-            for(u32 i = 0; i < dir_count; i++) {
-                std::string dir;
-                if(R_SUCCEEDED(usb::cf::GetDirectory(full_path, i, dir))) {
-                    dirs.push_back(dir);
-                }
-            }
+            dirs = GetEntriesByIndex(full_path, dir_count, usb::cf::SubmitGetDirectory);
         }
         return dirs;
     }
@@ -48,16 +289,19 @@ namespace fs {
     std::vector<std::string> RemotePCExplorer::GetFiles(const std::string &path) {
         std::vector<std::string> files;
         const auto full_path = this->MakeFull(path);
+        StopReadAhead();
+
+        if(usb::cf::IsFeatureSupported(usb::cf::Feature::BulkListing)) {
+            const auto reuse_listing = this->listing_valid && this->listing_files_pending && (this->listing_dir == NormalizeListingPath(full_path));
+            this->listing_files_pending = false;
+            if(reuse_listing || this->UpdateListing(full_path)) {
+                return GetListedNames(this->listing, usb::cf::PathType::File);
+            }
+        }
 
         u32 file_count;
         if(R_SUCCEEDED(usb::cf::GetFileCount(full_path, file_count))) {
-            files.reserve(file_count);
-            for(u32 i = 0; i < file_count; i++) {
-                std::string file;
-                if(R_SUCCEEDED(usb::cf::GetFile(full_path, i, file))) {
-                    files.push_back(file);
-                }
-            }
+            files = GetEntriesByIndex(full_path, file_count, usb::cf::SubmitGetFile);
         }
         return files;
     }
@@ -69,7 +313,11 @@ namespace fs {
 
     bool RemotePCExplorer::Exists(const std::string &path) {
         const auto full_path = this->MakeFull(path);
+        if(this->FindListedEntry(full_path) != nullptr) {
+            return true;
+        }
 
+        StopReadAhead();
         usb::cf::PathType type;
         size_t tmp_file_size;
         if(R_SUCCEEDED(usb::cf::StatPath(full_path, type, tmp_file_size))) {
@@ -82,7 +330,11 @@ namespace fs {
 
     bool RemotePCExplorer::IsFile(const std::string &path) {
         const auto full_path = this->MakeFull(path);
+        if(const auto entry = this->FindListedEntry(full_path); entry != nullptr) {
+            return entry->type == usb::cf::PathType::File;
+        }
 
+        StopReadAhead();
         usb::cf::PathType type;
         size_t tmp_file_size;
         if(R_SUCCEEDED(usb::cf::StatPath(full_path, type, tmp_file_size))) {
@@ -95,7 +347,11 @@ namespace fs {
 
     bool RemotePCExplorer::IsDirectory(const std::string &path) {
         const auto full_path = this->MakeFull(path);
+        if(const auto entry = this->FindListedEntry(full_path); entry != nullptr) {
+            return entry->type == usb::cf::PathType::Directory;
+        }
 
+        StopReadAhead();
         usb::cf::PathType type;
         size_t tmp_file_size;
         if(R_SUCCEEDED(usb::cf::StatPath(full_path, type, tmp_file_size))) {
@@ -108,77 +364,161 @@ namespace fs {
 
     void RemotePCExplorer::CreateFile(const std::string &path) {
         const auto full_path = this->MakeFull(path);
+        this->InvalidateListing();
+        StopReadAhead();
 
         usb::cf::Create(full_path, usb::cf::PathType::File);
     }
 
     void RemotePCExplorer::CreateDirectory(const std::string &path) {
         const auto full_path = this->MakeFull(path);
+        this->InvalidateListing();
+        StopReadAhead();
 
         usb::cf::Create(full_path, usb::cf::PathType::Directory);
     }
 
     void RemotePCExplorer::RenameFile(const std::string &path, const std::string &new_name) {
         const auto full_path = this->MakeFull(path);
+        this->InvalidateListing();
+        StopReadAhead();
 
         usb::cf::Rename(full_path, new_name);
     }
 
     void RemotePCExplorer::RenameDirectory(const std::string &path, const std::string &new_name) {
         const auto full_path = this->MakeFull(path);
+        this->InvalidateListing();
+        StopReadAhead();
 
         usb::cf::Rename(full_path, new_name);
     }
 
     void RemotePCExplorer::DeleteFile(const std::string &path) {
         const auto full_path = this->MakeFull(path);
+        this->InvalidateListing();
+        StopReadAhead();
 
         usb::cf::Delete(full_path);
     }
 
     void RemotePCExplorer::DeleteDirectory(const std::string &path) {
         const auto full_path = this->MakeFull(path);
+        this->InvalidateListing();
+        StopReadAhead();
 
         usb::cf::Delete(full_path);
     }
 
     void RemotePCExplorer::StartFileImpl(const std::string &path, const FileMode mode) {
         const auto full_path = this->MakeFull(path);
+        if(mode != FileMode::Read) {
+            this->InvalidateListing();
+        }
+
+        // Without pipelining nothing can be requested ahead
+        const auto info = usb::cf::GetProtocolInfo();
+        const auto read_ahead = (mode == FileMode::Read) && info.Supports(usb::cf::Feature::Pipelining);
+        const auto file_size = read_ahead ? this->GetFileSize(full_path) : 0;
 
+        StopReadAhead();
         usb::cf::StartFile(full_path, mode);
+        if(read_ahead) {
+            g_ReadAheadStream = std::make_unique<ReadAheadStream>(full_path, file_size, std::min<u64>(ReadAheadChunkSize, info.max_block_size));
+        }
     }
 
     void RemotePCExplorer::EndFileImpl(const FileMode mode) {
+        StopReadAhead();
         usb::cf::EndFile(mode);
     }
 
     u64 RemotePCExplorer::ReadFile(const std::string &path, const u64 offset, const u64 size, void *read_buf) {
         const auto full_path = this->MakeFull(path);
+        if(g_ReadAheadStream) {
+            if(g_ReadAheadStream->GetPath() == full_path) {
+                const auto read_size = g_ReadAheadStream->Read(offset, size, reinterpret_cast<u8*>(read_buf));
+                if(!g_ReadAheadStream->HasFailed()) {
+                    return read_size;
+                }
 
-        u64 read_size;
-        if(R_SUCCEEDED(usb::cf::ReadFile(full_path, offset, size, read_size, read_buf))) {
-            return read_size;
+                GLEAF_WARN_FMT("Read-ahead failed for '%s', reading it directly", full_path.c_str());
+                StopReadAhead();
+                return read_size + this->ReadFile(path, offset + read_size, size - read_size, reinterpret_cast<u8*>(read_buf) + read_size);
+            }
+
+            StopReadAhead();
         }
-        else {
-            return 0;
+
+        // Requests bigger than what the PC accepts are split into several (pipelined, if possible) commands
+        const auto max_block_size = usb::cf::GetProtocolInfo().max_block_size;
+        // (not rounding up by adding, since older Quark versions have no limit at all)
+        const auto block_count = (size / max_block_size) + (((size % max_block_size) != 0) ? 1 : 0);
+        auto read_buf_u8 = reinterpret_cast<u8*>(read_buf);
+        std::vector<u64> read_sizes(block_count, 0);
+        u64 total_read_size = 0;
+
+        usb::cmd::CommandPipeline pipeline(usb::cf::IsFeatureSupported(usb::cf::Feature::Pipelining));
+        u64 submitted_count = 0;
+        u64 completed_count = 0;
+        while(completed_count < block_count) {
+            while((submitted_count < block_count) && !pipeline.IsFull()) {
+                const auto block_offset = submitted_count * max_block_size;
+                const auto block_size = std::min(size - block_offset, max_block_size);
+                if(R_FAILED(usb::cf::SubmitReadFile(pipeline, full_path, offset + block_offset, block_size, read_sizes[submitted_count], read_buf_u8 + block_offset))) {
+                    break;
+                }
+                submitted_count++;
+            }
+            if(pipeline.IsEmpty()) {
+                break;
+            }
+
+            if(R_FAILED(pipeline.CompleteNext())) {
+                break;
+            }
+
+            // Reaching the end of the file: pending reads past it (if any) are just completed on pipeline disposal
+            const auto block_size = std::min(size - completed_count * max_block_size, max_block_size);
+            total_read_size += read_sizes[completed_count];
+            completed_count++;
+            if(read_sizes[completed_count - 1] < block_size) {
+                break;
+            }
         }
+        return total_read_size;
     }
 
     u64 RemotePCExplorer::WriteFile(const std::string &path, const void *write_buf, const u64 size) {
         const auto full_path = this->MakeFull(path);
+        this->InvalidateListing();
+        StopReadAhead();
+
+        const auto max_block_size = usb::cf::GetProtocolInfo().max_block_size;
+        auto write_buf_u8 = reinterpret_cast<const u8*>(write_buf);
+        u64 total_write_size = 0;
+        while(total_write_size < size) {
+            const auto block_size = std::min(size - total_write_size, max_block_size);
+            u64 write_size;
+            if(R_FAILED(usb::cf::WriteFile(full_path, block_size, write_size, write_buf_u8 + total_write_size))) {
+                break;
+            }
 
-        u64 write_size;
-        if(R_SUCCEEDED(usb::cf::WriteFile(full_path, size, write_size, write_buf))) {
-            return write_size;
-        }
-        else {
-            return 0;
+            total_write_size += write_size;
+            if(write_size < block_size) {
+                break;
+            }
         }
+        return total_write_size;
     }
 
     u64 RemotePCExplorer::GetFileSize(const std::string &path) {
         const auto full_path = this->MakeFull(path);
-        
+        if(const auto entry = this->FindListedEntry(full_path); entry != nullptr) {
+            return entry->size;
+        }
+
+        StopReadAhead();
         usb::cf::PathType tmp_type;
         size_t file_size;
         if(R_SUCCEEDED(usb::cf::StatPath(full_path, tmp_type, file_size))) {
@@ -203,4 +543,33 @@ namespace fs {
         // Non-HOS operating systems don't handle archive bit for what we want, so this is stubbed
     }
 
+    bool RemotePCExplorer::ComputeHash(const std::string &path, const u64 offset, const u64 size, const HashAlgorithm algo, FileHash &out_hash, HashProgressCallback prog_cb) {
+        // Much faster to let the PC hash it than to transfer the whole file, when supported
+        if(!usb::cf::IsFeatureSupported(usb::cf::Feature::Hashing)) {
+            return Explorer::ComputeHash(path, offset, size, algo, out_hash, prog_cb);
+        }
+
+        // The PC hashes it within a single command, so there is no progress to report
+
+        const auto full_path = this->MakeFull(path);
+        StopReadAhead();
+        return R_SUCCEEDED(usb::cf::HashFile(full_path, offset, size, algo, out_hash));
+    }
+
+    u64 RemotePCExplorer::GetDirectorySize(const std::string &path) {
+        // A single command instead of a few per file and subdirectory, when supported
+        if(!usb::cf::IsFeatureSupported(usb::cf::Feature::TreeStats)) {
+            return Explorer::GetDirectorySize(path);
+        }
+
+        const auto full_path = this->MakeFull(path);
+        usb::cf::TreeStats stats;
+        if(R_SUCCEEDED(usb::cf::GetTreeStats(full_path, stats))) {
+            return stats.total_size;
+        }
+        else {
+            return 0;
+        }
+    }
+
 }
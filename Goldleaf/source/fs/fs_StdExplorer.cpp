@@ -24,6 +24,37 @@
 
 namespace fs {
 
+    namespace {
+
+        class StdConcurrentWriteFile : public ConcurrentWriteFile {
+            private:
+                FILE *file_obj;
+
+            public:
+                StdConcurrentWriteFile(FILE *file_obj) : file_obj(file_obj) {}
+
+                ~StdConcurrentWriteFile() {
+                    if(this->file_obj != nullptr) {
+                        fclose(this->file_obj);
+                    }
+                }
+
+                u64 Write(const void *write_buf, const u64 size) override {
+                    return fwrite(write_buf, 1, size, this->file_obj);
+                }
+
+                Result Close() override {
+                    // Buffered data is only written (and thus can only fail) here
+                    const auto flush_ok = fflush(this->file_obj) == 0;
+                    const auto close_ok = fclose(this->file_obj) == 0;
+                    this->file_obj = nullptr;
+                    GLEAF_RC_UNLESS(flush_ok && close_ok, rc::goldleaf::ResultFileWriteFailed);
+                    GLEAF_RC_SUCCEED;
+                }
+        };
+
+    }
+
     StdExplorer::StdExplorer() : r_file_obj(nullptr), w_file_obj(nullptr) {
         this->commit_fn = {};
     }
@@ -239,6 +270,15 @@ namespace fs {
         return write_size;
     }
 
+    std::unique_ptr<ConcurrentWriteFile> StdExplorer::OpenConcurrentWriteFile(const std::string &path) {
+        const auto full_path = this->MakeFull(path);
+        auto file_obj = fopen(full_path.c_str(), "ab");
+        if(file_obj == nullptr) {
+            return nullptr;
+        }
+        return std::make_unique<StdConcurrentWriteFile>(file_obj);
+    }
+
     u64 StdExplorer::GetFileSize(const std::string &path) {
         u64 file_size = 0;
         const auto full_path = this->MakeFull(path);
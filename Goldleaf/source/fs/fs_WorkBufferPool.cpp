@@ -0,0 +1,128 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <fs/fs_Common.hpp>
+
+namespace fs {
+
+    namespace {
+
+        constexpr u32 WorkBufferPoolClassCount = __builtin_ctzl(WorkBufferPoolMaxSize / WorkBufferPoolMinSize) + 1;
+        constexpr u32 WorkBufferPoolUnpooledClass = UINT32_MAX;
+
+        Lock g_WorkBufferPoolLock;
+        std::vector<u8*> g_WorkBufferPoolCachedBuffers[WorkBufferPoolClassCount];
+        std::unordered_map<u8*, size_t> g_WorkBufferPoolCheckedOutSizes;
+        WorkBufferPoolStats g_WorkBufferPoolStats = {};
+
+        inline u32 GetWorkBufferPoolClass(const size_t size) {
+            if(size > WorkBufferPoolMaxSize) {
+                return WorkBufferPoolUnpooledClass;
+            }
+
+            u32 pool_class = 0;
+            while((WorkBufferPoolMinSize << pool_class) < size) {
+                pool_class++;
+            }
+            return pool_class;
+        }
+
+        inline constexpr size_t GetWorkBufferPoolClassSize(const u32 pool_class) {
+            return WorkBufferPoolMinSize << pool_class;
+        }
+
+    }
+
+    u8 *CheckoutWorkBuffer(const size_t size) {
+        ScopedLock pool_lock(g_WorkBufferPoolLock);
+
+        const auto pool_class = GetWorkBufferPoolClass(size);
+        const auto alloc_size = (pool_class == WorkBufferPoolUnpooledClass) ? size : GetWorkBufferPoolClassSize(pool_class);
+        g_WorkBufferPoolStats.checkout_count++;
+
+        u8 *work_buf = nullptr;
+        if(pool_class != WorkBufferPoolUnpooledClass) {
+            auto &cached_bufs = g_WorkBufferPoolCachedBuffers[pool_class];
+            if(!cached_bufs.empty()) {
+                work_buf = cached_bufs.back();
+                cached_bufs.pop_back();
+                g_WorkBufferPoolStats.cached_size -= alloc_size;
+                g_WorkBufferPoolStats.reuse_count++;
+            }
+        }
+        if(work_buf == nullptr) {
+            work_buf = AllocateWorkBuffer(alloc_size);
+        }
+
+        g_WorkBufferPoolCheckedOutSizes[work_buf] = alloc_size;
+        g_WorkBufferPoolStats.checked_out_size += alloc_size;
+        g_WorkBufferPoolStats.high_water_size = std::max(g_WorkBufferPoolStats.high_water_size, g_WorkBufferPoolStats.checked_out_size + g_WorkBufferPoolStats.cached_size);
+        return work_buf;
+    }
+
+    void ReturnWorkBuffer(u8 *work_buf) {
+        if(work_buf == nullptr) {
+            return;
+        }
+
+        ScopedLock pool_lock(g_WorkBufferPoolLock);
+
+        auto it = g_WorkBufferPoolCheckedOutSizes.find(work_buf);
+        GLEAF_ASSERT_TRUE(it != g_WorkBufferPoolCheckedOutSizes.end());
+        const auto alloc_size = it->second;
+        g_WorkBufferPoolCheckedOutSizes.erase(it);
+        g_WorkBufferPoolStats.checked_out_size -= alloc_size;
+
+        const auto pool_class = GetWorkBufferPoolClass(alloc_size);
+        if(pool_class == WorkBufferPoolUnpooledClass) {
+            // Buffers bigger than any size class are never cached
+            DeleteWorkBuffer(work_buf);
+            return;
+        }
+
+        auto &cached_bufs = g_WorkBufferPoolCachedBuffers[pool_class];
+        if(cached_bufs.size() < WorkBufferPoolMaxCachedPerClass) {
+            cached_bufs.push_back(work_buf);
+            g_WorkBufferPoolStats.cached_size += alloc_size;
+        }
+        else {
+            DeleteWorkBuffer(work_buf);
+        }
+    }
+
+    void TrimWorkBufferPool() {
+        ScopedLock pool_lock(g_WorkBufferPoolLock);
+
+        for(u32 i = 0; i < WorkBufferPoolClassCount; i++) {
+            for(auto work_buf: g_WorkBufferPoolCachedBuffers[i]) {
+                DeleteWorkBuffer(work_buf);
+            }
+            g_WorkBufferPoolCachedBuffers[i].clear();
+        }
+        g_WorkBufferPoolStats.cached_size = 0;
+    }
+
+    WorkBufferPoolStats GetWorkBufferPoolStats() {
+        ScopedLock pool_lock(g_WorkBufferPoolLock);
+        return g_WorkBufferPoolStats;
+    }
+
+}
@@ -0,0 +1,156 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <nsp/nsp_BatchInstaller.hpp>
+
+namespace nsp {
+
+    void BatchInstaller::PushJob(const std::string &path, const std::string &pres_path) {
+        const auto size = this->exp->GetFileSize(path);
+        this->jobs.push_back({
+            .path = path,
+            .pres_path = pres_path,
+            .size = size
+        });
+        this->total_size += size;
+    }
+
+    Result BatchInstaller::CheckFreeSpace() {
+        // Package sizes aren't enough here, since NSZ/XCZ contents get bigger once installed
+        u64 install_size = 0;
+        for(const auto &job: this->jobs) {
+            Installer installer(job.path, this->exp, this->storage_id);
+            u64 job_install_size = 0;
+            if(R_FAILED(installer.ComputeInstallSize(job_install_size))) {
+                // This job will fail to prepare anyway (and be reported then), so don't fail the entire batch here
+                job_install_size = job.size;
+            }
+            install_size += job_install_size;
+        }
+
+        const auto free_space = fs::GetFreeSpaceForPartition(fs::GetPartitionFromStorageId(this->storage_id));
+        GLEAF_RC_UNLESS(free_space >= install_size, rc::goldleaf::ResultNotEnoughSize);
+        GLEAF_RC_SUCCEED;
+    }
+
+    Result BatchInstaller::Run(const BatchInstallCallbacks &callbacks) {
+        // A single check for the whole batch, instead of finding out halfway through it
+        GLEAF_RC_TRY(this->CheckFreeSpace());
+
+        BatchInstallProgress progress = {
+            .job_idx = 0,
+            .job_count = static_cast<u32>(this->jobs.size()),
+            .total_size = this->total_size,
+            .done_size = 0
+        };
+
+        std::unique_ptr<Installer> next_installer;
+        auto next_prepare_rc = rc::ResultSuccess;
+        auto next_prepared_early = false;
+        const auto prepare_job = [&](const u32 job_idx) {
+            const auto &job = this->jobs.at(job_idx);
+            next_installer = std::make_unique<Installer>(job.path, this->exp, this->storage_id);
+            next_prepare_rc = next_installer->PrepareInstallation();
+        };
+
+        if(!this->jobs.empty()) {
+            prepare_job(0);
+        }
+        for(u32 i = 0; i < this->jobs.size(); i++) {
+            const auto &job = this->jobs.at(i);
+            const auto has_next_job = (i + 1) < this->jobs.size();
+            progress.job_idx = i;
+            const auto job_base_done_size = progress.done_size;
+
+            auto installer = std::move(next_installer);
+            auto rc = next_prepare_rc;
+            if((rc == rc::goldleaf::ResultContentReservedByOtherJob) && next_prepared_early) {
+                // Preparing while the previous package was still being written clashed with it (packages sharing contents), so retry now that it's done
+                installer.reset();
+                prepare_job(i);
+                installer = std::move(next_installer);
+                rc = next_prepare_rc;
+            }
+            next_prepared_early = false;
+
+            auto status = BatchInstallJobStatus::PrepareFailed;
+            if(rc == rc::goldleaf::ResultContentAlreadyInstalled) {
+                if(callbacks.on_job_already_installed(job, *installer)) {
+                    installer->FinalizeInstallation();
+                    rc = installer->PrepareInstallation();
+                }
+                else {
+                    status = BatchInstallJobStatus::Skipped;
+                }
+            }
+
+            if(status != BatchInstallJobStatus::Skipped) {
+                if(R_SUCCEEDED(rc)) {
+                    rc = installer->InstallTicketCertificate();
+                }
+                if(R_SUCCEEDED(rc)) {
+                    status = BatchInstallJobStatus::InstallFailed;
+                    callbacks.on_job_start(job, *installer, progress);
+                    rc = installer->WriteContents([&](const ContentWriteProgress &write_start) {
+                        callbacks.on_start_write(write_start, progress);
+                    }, [&](const ContentWriteProgress &write_progress) {
+                        u64 job_done_size = 0;
+                        u64 job_cnt_size = 0;
+                        for(const auto &entry: write_progress.entries) {
+                            job_done_size += entry.cur_offset;
+                            job_cnt_size += entry.size;
+                        }
+
+                        // Contents of NSZs are bigger than the package itself once decompressed, so this is scaled to the package size
+                        if(job_cnt_size > 0) {
+                            progress.done_size = job_base_done_size + static_cast<u64>((double)job.size * ((double)job_done_size / (double)job_cnt_size));
+                        }
+                        callbacks.on_content_write(write_progress, progress);
+                    }, [&]() {
+                        // The source is no longer needed by this job, so the next one can be prepared while this one's remaining data is written
+                        if(has_next_job) {
+                            prepare_job(i + 1);
+                            next_prepared_early = true;
+                        }
+                    });
+                }
+                if(R_SUCCEEDED(rc)) {
+                    rc = installer->UpdateRecordAndContentMetas();
+                }
+                if(R_SUCCEEDED(rc)) {
+                    status = BatchInstallJobStatus::Installed;
+                }
+            }
+
+            progress.done_size = job_base_done_size + job.size;
+            callbacks.on_job_finish(job, *installer, status, rc);
+
+            // Finalize this job before preparing the next one (if it wasn't already), so that its reserved contents are released
+            installer.reset();
+            if(has_next_job && !next_installer) {
+                prepare_job(i + 1);
+            }
+        }
+
+        GLEAF_RC_SUCCEED;
+    }
+
+}
@@ -25,62 +25,158 @@
 
 namespace nsp {
 
-    bool GenerateFrom(const std::string &input_path, const std::string &output_nsp, GenerateStartCallback start_cb, GenerateProgressCallback prog_cb) {
-        auto exp = fs::GetExplorerForPath(input_path);
-        const auto files = exp->GetFiles(input_path);
-        fs::PFS0::Header header = {
+    PackageBuilder::PackageBuilder(const std::string &out_path) : out_path(out_path), out_exp(fs::GetExplorerForPath(out_path)), files(), cur_file_idx(0), cur_file_written_size(0), started(false) {}
+
+    PackageBuilder::~PackageBuilder() {
+        if(this->started) {
+            this->out_exp->EndFile();
+        }
+    }
+
+    void PackageBuilder::SkipWrittenFiles() {
+        while((this->cur_file_idx < this->files.size()) && (this->cur_file_written_size == this->files.at(this->cur_file_idx).size)) {
+            this->cur_file_idx++;
+            this->cur_file_written_size = 0;
+        }
+    }
+
+    void PackageBuilder::AddFile(const std::string &name, const u64 size) {
+        this->files.push_back({
+            .name = name,
+            .size = size
+        });
+    }
+
+    u64 PackageBuilder::GetTotalSize() {
+        u64 total_size = 0;
+        for(const auto &file: this->files) {
+            total_size += file.size;
+        }
+        return total_size;
+    }
+
+    Result PackageBuilder::Start() {
+        GLEAF_RC_UNLESS(!this->started, rc::goldleaf::ResultUnableToBuildNsp);
+
+        std::string string_table;
+        std::vector<fs::PFS0::FileEntry> entries;
+        entries.reserve(this->files.size());
+        u64 base_offset = 0;
+        for(const auto &file: this->files) {
+            entries.push_back({
+                .offset = base_offset,
+                .size = file.size,
+                .string_table_offset = static_cast<u32>(string_table.length()),
+                .pad = 0
+            });
+            base_offset += file.size;
+            string_table += file.name;
+            string_table.push_back('\0'); // NUL terminated!
+        }
+        string_table.resize((string_table.length() + 0x1F) & ~0x1F, '\0');
+
+        const fs::PFS0::Header header = {
             .magic = fs::PFS0::Magic,
-            .file_count = static_cast<u32>(files.size()),
+            .file_count = static_cast<u32>(this->files.size()),
+            .string_table_size = static_cast<u32>(string_table.length()),
+            .reserved = 0
         };
 
-        const size_t string_table_max_size = files.size() * FS_MAX_PATH;
-        auto string_table_buf = fs::AllocateWorkBuffer(string_table_max_size);
-        size_t string_table_size = 0;
-        std::vector<fs::PFS0::File> file_entries;
-        size_t base_offset = 0;
-        for(auto &file: files) {
-            fs::PFS0::File entry = {};
-            entry.entry.offset = base_offset;
-            entry.entry.string_table_offset = string_table_size;
-            const auto file_size = exp->GetFileSize(input_path + "/" + file);
-            entry.entry.size = file_size;
-            entry.name = file;
-            base_offset += file_size;
-            strcpy(reinterpret_cast<char*>(string_table_buf) + string_table_size, file.c_str());
-            string_table_size += file.length() + 1; // NUL terminated!
-            file_entries.push_back(entry);
+        // Everything before the file data is written at once
+        const auto entries_size = entries.size() * sizeof(fs::PFS0::FileEntry);
+        std::vector<u8> header_buf(sizeof(header) + entries_size + string_table.length());
+        memcpy(header_buf.data(), &header, sizeof(header));
+        memcpy(header_buf.data() + sizeof(header), entries.data(), entries_size);
+        memcpy(header_buf.data() + sizeof(header) + entries_size, string_table.data(), string_table.length());
+
+        this->out_exp->StartFile(this->out_path, fs::FileMode::Write);
+        this->started = true;
+        GLEAF_RC_UNLESS(this->out_exp->WriteFile(this->out_path, header_buf.data(), header_buf.size()) == header_buf.size(), rc::goldleaf::ResultUnableToBuildNsp);
+
+        this->cur_file_idx = 0;
+        this->cur_file_written_size = 0;
+        this->SkipWrittenFiles();
+        GLEAF_RC_SUCCEED;
+    }
+
+    Result PackageBuilder::Write(const void *buf, const size_t size) {
+        GLEAF_RC_UNLESS(this->started && (this->cur_file_idx < this->files.size()), rc::goldleaf::ResultUnableToBuildNsp);
+        GLEAF_RC_UNLESS(size <= (this->files.at(this->cur_file_idx).size - this->cur_file_written_size), rc::goldleaf::ResultUnableToBuildNsp);
+        GLEAF_RC_UNLESS(this->out_exp->WriteFile(this->out_path, buf, size) == size, rc::goldleaf::ResultUnableToBuildNsp);
+
+        this->cur_file_written_size += size;
+        this->SkipWrittenFiles();
+        GLEAF_RC_SUCCEED;
+    }
+
+    Result PackageBuilder::Finish() {
+        GLEAF_RC_UNLESS(this->started, rc::goldleaf::ResultUnableToBuildNsp);
+        this->out_exp->EndFile();
+        this->started = false;
+
+        GLEAF_RC_UNLESS(this->cur_file_idx == this->files.size(), rc::goldleaf::ResultUnableToBuildNsp);
+        GLEAF_RC_SUCCEED;
+    }
+
+    void PackageBuilder::Abort() {
+        // The package can't be deleted while it's still open
+        if(this->started) {
+            this->out_exp->EndFile();
+            this->started = false;
         }
-        string_table_size = (string_table_size + 0x1F) &~ 0x1F;
-        header.string_table_size = string_table_size;
+        this->out_exp->DeleteFile(this->out_path);
+    }
 
+    bool GenerateFrom(const std::string &input_path, const std::string &output_nsp, GenerateStartCallback start_cb, GenerateProgressCallback prog_cb) {
+        auto exp = fs::GetExplorerForPath(input_path);
         auto out_exp = fs::GetExplorerForPath(output_nsp);
-        out_exp->StartFile(output_nsp, fs::FileMode::Write);
-        out_exp->WriteFile(output_nsp, &header, sizeof(header));
-        for(const auto &entry: file_entries) {
-            out_exp->WriteFile(output_nsp, &entry.entry, sizeof(entry.entry));
+        const auto files = exp->GetFiles(input_path);
+        PackageBuilder builder(output_nsp);
+        for(const auto &file: files) {
+            builder.AddFile(file, exp->GetFileSize(input_path + "/" + file));
+        }
+        if(R_FAILED(builder.Start())) {
+            return false;
         }
-        out_exp->WriteFile(output_nsp, string_table_buf, string_table_size);
-        fs::DeleteWorkBuffer(string_table_buf);
-
-        start_cb((double)base_offset);
-        for(const auto &entry: file_entries) {
-            auto rem_size = entry.entry.size;
-            auto work_buf = fs::AllocateWorkBuffer();
-            size_t off = 0;
-            const auto entry_path = input_path + "/" + entry.name;
-            exp->StartFile(entry_path, fs::FileMode::Read);
+
+        start_cb((double)builder.GetTotalSize());
+        auto work_buf = fs::CheckoutWorkBuffer();
+        fs::ChunkSizeTuner tuner(exp->GetStorageKind(), out_exp->GetStorageKind(), fs::DefaultWorkBufferSize);
+        // Explorers only have a single started file, which is the package itself when both are the same
+        const auto start_read = exp != out_exp;
+        auto ok = true;
+        for(const auto &file: files) {
+            const auto file_path = input_path + "/" + file;
+            auto rem_size = exp->GetFileSize(file_path);
+            u64 off = 0;
+            if(start_read) {
+                exp->StartFile(file_path, fs::FileMode::Read);
+            }
             while(rem_size > 0) {
-                const auto read_size = exp->ReadFile(entry_path, off, std::min(rem_size, fs::DefaultWorkBufferSize), work_buf);
-                out_exp->WriteFile(output_nsp, work_buf, read_size);
+                const auto read_size = exp->ReadFile(file_path, off, tuner.GetChunkSize(rem_size), work_buf);
+                if((read_size == 0) || R_FAILED(builder.Write(work_buf, read_size))) {
+                    ok = false;
+                    break;
+                }
+                tuner.NotifyTransferred(read_size);
                 off += read_size;
                 rem_size -= read_size;
                 prog_cb((double)read_size);
             }
-            exp->EndFile();
-            fs::DeleteWorkBuffer(work_buf);
+            if(start_read) {
+                exp->EndFile();
+            }
+
+            if(!ok) {
+                break;
+            }
+        }
+        fs::ReturnWorkBuffer(work_buf);
+
+        if(R_FAILED(builder.Finish())) {
+            ok = false;
         }
-        out_exp->EndFile();
-        return true;
+        return ok;
     }
 
 }
@@ -0,0 +1,928 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <nsp/nsp_ContentWriter.hpp>
+#include <nsp/nsp_NczDecoder.hpp>
+#include <fs/fs_Common.hpp>
+#include <mbedtls/sha256.h>
+#include <atomic>
+
+namespace nsp {
+
+    namespace {
+
+        // Contents are written through several lanes, each one with its own NCM session and writer thread, so that different placeholders are written concurrently
+        // Every lane reads chunks into a fixed ring of preallocated buffers: once every buffer of a lane is pending the reader moves on to other lanes (or blocks until
+        // some lane frees a buffer), so memory usage during installs is bounded regardless of how fast the source is compared to NCM
+        constexpr u32 ContentWriteBufferCount = 4;
+        constexpr u32 MinContentWriteLaneBufferCount = 2;
+        constexpr u32 ContentDecodeBufferCount = 2;
+
+        struct ContentWriteBuffer {
+            u32 cnt_id;
+            u8 *buf;
+            size_t size;
+        };
+
+        struct ContentHashState {
+            bool verify;
+            u8 expected_hash[SHA256_HASH_SIZE];
+            mbedtls_sha256_context sha_ctx;
+        };
+
+        class ContentWriteContext;
+
+        // Where the reader puts what it reads: either straight into a write lane, or into the decoding stage in front of it
+
+        class ContentWriteSink {
+            public:
+                virtual ~ContentWriteSink() = default;
+
+                // Reader side: never blocks, returns nullptr if every buffer is still pending
+                virtual ContentWriteBuffer *TryAcquireFreeBuffer() = 0;
+                virtual Waiter GetFreeBufferWaiter() = 0;
+                virtual void WakeReader() = 0;
+                virtual void CommitBuffer(const u32 cnt_id, const size_t size) = 0;
+                // Buffers holding data not yet fully written (what the reader is ahead of the writers)
+                virtual u32 GetPendingBufferCount() = 0;
+        };
+
+        class ContentWriteLane : public ContentWriteSink {
+            private:
+                ContentWriteContext *ctx;
+                ContentStorage &cnt_storage;
+                std::unique_ptr<ContentStorage> own_cnt_storage;
+                bool hash_enabled;
+                std::vector<ContentWriteBuffer> buffers;
+                u32 buffer_head;
+                u32 buffer_hash_head;
+                u32 buffer_tail;
+                u32 buffer_count;
+                u32 buffer_ready_count;
+                Lock buffer_lock;
+                UEvent buffer_free_event;
+                UEvent buffer_ready_event;
+                UEvent buffer_written_event;
+                bool done;
+                bool write_done;
+                Thread thread;
+                bool thread_started;
+                Thread hash_thread;
+                bool hash_thread_started;
+
+                // Buffers go through the ring as free -> ready (read, pending to be written) -> written (pending to be hashed, only when verifying) -> free
+
+                ContentWriteBuffer *AcquireReadyBuffer() {
+                    while(true) {
+                        {
+                            ScopedLock buffer_lock(this->buffer_lock);
+                            if(this->buffer_ready_count > 0) {
+                                return std::addressof(this->buffers.at(this->buffer_head));
+                            }
+                            if(this->done) {
+                                return nullptr;
+                            }
+                        }
+
+                        waitSingle(waiterForUEvent(&this->buffer_ready_event), UINT64_MAX);
+                    }
+                }
+
+                void ReleaseWrittenBuffer() {
+                    {
+                        ScopedLock buffer_lock(this->buffer_lock);
+                        this->buffer_head = (this->buffer_head + 1) % this->buffers.size();
+                        this->buffer_ready_count--;
+                        if(!this->hash_enabled) {
+                            this->buffer_hash_head = this->buffer_head;
+                            this->buffer_count--;
+                        }
+                    }
+                    ueventSignal(this->hash_enabled ? &this->buffer_written_event : &this->buffer_free_event);
+                }
+
+                ContentWriteBuffer *AcquireWrittenBuffer() {
+                    while(true) {
+                        {
+                            ScopedLock buffer_lock(this->buffer_lock);
+                            if(this->buffer_count > this->buffer_ready_count) {
+                                return std::addressof(this->buffers.at(this->buffer_hash_head));
+                            }
+                            if(this->write_done) {
+                                return nullptr;
+                            }
+                        }
+
+                        waitSingle(waiterForUEvent(&this->buffer_written_event), UINT64_MAX);
+                    }
+                }
+
+                void ReleaseHashedBuffer() {
+                    {
+                        ScopedLock buffer_lock(this->buffer_lock);
+                        this->buffer_hash_head = (this->buffer_hash_head + 1) % this->buffers.size();
+                        this->buffer_count--;
+                    }
+                    ueventSignal(&this->buffer_free_event);
+                }
+
+                void NotifyWriteDone() {
+                    {
+                        ScopedLock buffer_lock(this->buffer_lock);
+                        this->write_done = true;
+                    }
+                    ueventSignal(&this->buffer_written_event);
+                }
+
+                static void Main(void *lane_raw);
+                static void HashMain(void *lane_raw);
+
+            public:
+                ContentWriteLane(ContentWriteContext *ctx, ContentStorage &cnt_storage, std::unique_ptr<ContentStorage> own_cnt_storage, const bool hash_enabled, const u32 buffer_count, const size_t buffer_size) : ctx(ctx), cnt_storage(own_cnt_storage ? *own_cnt_storage : cnt_storage), own_cnt_storage(std::move(own_cnt_storage)), hash_enabled(hash_enabled), buffers(), buffer_head(0), buffer_hash_head(0), buffer_tail(0), buffer_count(0), buffer_ready_count(0), buffer_lock(), done(false), write_done(false), thread(), thread_started(false), hash_thread(), hash_thread_started(false) {
+                    this->buffers.reserve(buffer_count);
+                    for(u32 i = 0; i < buffer_count; i++) {
+                        this->buffers.push_back({
+                            .cnt_id = 0,
+                            .buf = fs::CheckoutWorkBuffer(buffer_size),
+                            .size = 0
+                        });
+                    }
+
+                    ueventCreate(&this->buffer_free_event, true);
+                    ueventCreate(&this->buffer_ready_event, true);
+                    ueventCreate(&this->buffer_written_event, true);
+                }
+
+                ~ContentWriteLane() {
+                    this->Finish();
+                    for(auto &buf: this->buffers) {
+                        fs::ReturnWorkBuffer(buf.buf);
+                    }
+                }
+
+                Result Start() {
+                    GLEAF_RC_TRY(threadCreate(&this->thread, Main, reinterpret_cast<void*>(this), nullptr, 512_KB, 0x1F, -2));
+                    GLEAF_RC_TRY(threadStart(&this->thread));
+                    this->thread_started = true;
+
+                    if(this->hash_enabled) {
+                        GLEAF_RC_TRY(threadCreate(&this->hash_thread, HashMain, reinterpret_cast<void*>(this), nullptr, 512_KB, 0x1F, -2));
+                        GLEAF_RC_TRY(threadStart(&this->hash_thread));
+                        this->hash_thread_started = true;
+                    }
+                    GLEAF_RC_SUCCEED;
+                }
+
+                void Finish() {
+                    if(this->thread_started) {
+                        {
+                            ScopedLock buffer_lock(this->buffer_lock);
+                            this->done = true;
+                        }
+                        ueventSignal(&this->buffer_ready_event);
+
+                        threadWaitForExit(&this->thread);
+                        threadClose(&this->thread);
+                        this->thread_started = false;
+                    }
+
+                    if(this->hash_thread_started) {
+                        // The writer thread always notifies this before exiting, but it might not have even started
+                        this->NotifyWriteDone();
+
+                        threadWaitForExit(&this->hash_thread);
+                        threadClose(&this->hash_thread);
+                        this->hash_thread_started = false;
+                    }
+                }
+
+                ContentWriteBuffer *TryAcquireFreeBuffer() override {
+                    ScopedLock buffer_lock(this->buffer_lock);
+                    if(this->buffer_count < this->buffers.size()) {
+                        return std::addressof(this->buffers.at(this->buffer_tail));
+                    }
+                    else {
+                        return nullptr;
+                    }
+                }
+
+                Waiter GetFreeBufferWaiter() override {
+                    return waiterForUEvent(&this->buffer_free_event);
+                }
+
+                void WakeReader() override {
+                    ueventSignal(&this->buffer_free_event);
+                }
+
+                void CommitBuffer(const u32 cnt_id, const size_t size) override {
+                    {
+                        ScopedLock buffer_lock(this->buffer_lock);
+                        auto &buf = this->buffers.at(this->buffer_tail);
+                        buf.cnt_id = cnt_id;
+                        buf.size = size;
+                        this->buffer_tail = (this->buffer_tail + 1) % this->buffers.size();
+                        this->buffer_count++;
+                        this->buffer_ready_count++;
+                    }
+                    ueventSignal(&this->buffer_ready_event);
+                }
+
+                u32 GetPendingBufferCount() override {
+                    ScopedLock buffer_lock(this->buffer_lock);
+                    return this->buffer_count;
+                }
+        };
+
+        // NCZ contents are decompressed (and encrypted back) by a dedicated thread in front of each lane, so that reading, decoding and writing all happen at the same time
+        // Lanes only support a single producer, so when a package has any NCZs every content goes through this stage (plain ones are simply copied through)
+
+        class ContentDecodeStage : public ContentWriteSink {
+            private:
+                ContentWriteContext *ctx;
+                ContentWriteLane &lane;
+                size_t lane_buffer_size;
+                std::vector<ContentWriteBuffer> buffers;
+                u32 buffer_head;
+                u32 buffer_tail;
+                u32 buffer_count;
+                Lock buffer_lock;
+                UEvent buffer_free_event;
+                UEvent buffer_ready_event;
+                bool done;
+                Thread thread;
+                bool thread_started;
+                std::optional<u32> cur_cnt_id;
+                std::unique_ptr<NczDecoder> cur_decoder;
+                ContentWriteBuffer *out_buf;
+                size_t out_buf_offset;
+
+                ContentWriteBuffer *AcquireReadyBuffer() {
+                    while(true) {
+                        {
+                            ScopedLock buffer_lock(this->buffer_lock);
+                            if(this->buffer_count > 0) {
+                                return std::addressof(this->buffers.at(this->buffer_head));
+                            }
+                            if(this->done) {
+                                return nullptr;
+                            }
+                        }
+
+                        waitSingle(waiterForUEvent(&this->buffer_ready_event), UINT64_MAX);
+                    }
+                }
+
+                void ReleaseDecodedBuffer() {
+                    {
+                        ScopedLock buffer_lock(this->buffer_lock);
+                        this->buffer_head = (this->buffer_head + 1) % this->buffers.size();
+                        this->buffer_count--;
+                    }
+                    ueventSignal(&this->buffer_free_event);
+                }
+
+                ContentWriteBuffer *AcquireLaneBuffer();
+                Result Output(const u8 *buf, const size_t size);
+                void StartContent(const u32 cnt_id);
+                Result FinishContent();
+                Result DecodeBuffer(const ContentWriteBuffer &buf);
+
+                static void Main(void *stage_raw);
+
+            public:
+                ContentDecodeStage(ContentWriteContext *ctx, ContentWriteLane &lane, const u32 buffer_count, const size_t buffer_size) : ctx(ctx), lane(lane), lane_buffer_size(buffer_size), buffers(), buffer_head(0), buffer_tail(0), buffer_count(0), buffer_lock(), done(false), thread(), thread_started(false), cur_cnt_id(), cur_decoder(), out_buf(nullptr), out_buf_offset(0) {
+                    this->buffers.reserve(buffer_count);
+                    for(u32 i = 0; i < buffer_count; i++) {
+                        this->buffers.push_back({
+                            .cnt_id = 0,
+                            .buf = fs::CheckoutWorkBuffer(buffer_size),
+                            .size = 0
+                        });
+                    }
+
+                    ueventCreate(&this->buffer_free_event, true);
+                    ueventCreate(&this->buffer_ready_event, true);
+                }
+
+                ~ContentDecodeStage() {
+                    this->Finish();
+                    for(auto &buf: this->buffers) {
+                        fs::ReturnWorkBuffer(buf.buf);
+                    }
+                }
+
+                Result Start() {
+                    GLEAF_RC_TRY(threadCreate(&this->thread, Main, reinterpret_cast<void*>(this), nullptr, 512_KB, 0x1F, -2));
+                    GLEAF_RC_TRY(threadStart(&this->thread));
+                    this->thread_started = true;
+                    GLEAF_RC_SUCCEED;
+                }
+
+                void Finish() {
+                    if(this->thread_started) {
+                        {
+                            ScopedLock buffer_lock(this->buffer_lock);
+                            this->done = true;
+                        }
+                        ueventSignal(&this->buffer_ready_event);
+
+                        threadWaitForExit(&this->thread);
+                        threadClose(&this->thread);
+                        this->thread_started = false;
+                    }
+                }
+
+                ContentWriteBuffer *TryAcquireFreeBuffer() override {
+                    ScopedLock buffer_lock(this->buffer_lock);
+                    if(this->buffer_count < this->buffers.size()) {
+                        return std::addressof(this->buffers.at(this->buffer_tail));
+                    }
+                    else {
+                        return nullptr;
+                    }
+                }
+
+                Waiter GetFreeBufferWaiter() override {
+                    return waiterForUEvent(&this->buffer_free_event);
+                }
+
+                void WakeReader() override {
+                    ueventSignal(&this->buffer_free_event);
+                }
+
+                void CommitBuffer(const u32 cnt_id, const size_t size) override {
+                    {
+                        ScopedLock buffer_lock(this->buffer_lock);
+                        auto &buf = this->buffers.at(this->buffer_tail);
+                        buf.cnt_id = cnt_id;
+                        buf.size = size;
+                        this->buffer_tail = (this->buffer_tail + 1) % this->buffers.size();
+                        this->buffer_count++;
+                    }
+                    ueventSignal(&this->buffer_ready_event);
+                }
+
+                u32 GetPendingBufferCount() override {
+                    u32 pending_count;
+                    {
+                        ScopedLock buffer_lock(this->buffer_lock);
+                        pending_count = this->buffer_count;
+                    }
+                    return pending_count + this->lane.GetPendingBufferCount();
+                }
+        };
+
+        class ContentWriteContext {
+            private:
+                OnContentWriteFunction on_content_write_fn;
+                InstallStats &stats;
+                std::vector<std::unique_ptr<ContentWriteLane>> lanes;
+                std::vector<std::unique_ptr<ContentDecodeStage>> decode_stages;
+                ContentWriteProgress write_progress;
+                std::vector<u64> committed_sizes;
+                std::vector<bool> compressed_cnts;
+                Lock write_progress_lock;
+                // Each content is hashed by a single lane's hash thread, in order, so its state is never accessed concurrently
+                std::vector<ContentHashState> hash_states;
+                std::atomic_uint64_t hashed_size;
+                std::atomic_uint64_t hash_ticks;
+                Result last_rc;
+                Lock last_rc_lock;
+                std::atomic_bool aborted;
+
+            public:
+                ContentWriteContext(OnContentWriteFunction on_content_write_fn, InstallStats &stats) : on_content_write_fn(on_content_write_fn), stats(stats), lanes(), decode_stages(), write_progress(), committed_sizes(), compressed_cnts(), write_progress_lock(), hash_states(), hashed_size(0), hash_ticks(0), last_rc(rc::ResultSuccess), last_rc_lock(), aborted(false) {}
+
+                ~ContentWriteContext() {
+                    this->FinishLanes();
+                    for(auto &hash_state: this->hash_states) {
+                        if(hash_state.verify) {
+                            mbedtls_sha256_free(&hash_state.sha_ctx);
+                        }
+                    }
+                }
+
+                Result CreateLanes(InstallServices &svcs, ContentStorage &cnt_storage, const NcmStorageId storage_id, const u32 lane_count, const size_t buffer_size) {
+                    // Verifying needs an extra buffer per lane, so that reading, writing and hashing can all progress at the same time
+                    const auto hash_enabled = this->IsHashing();
+                    const auto lane_buffer_count = std::max(MinContentWriteLaneBufferCount, ContentWriteBufferCount / lane_count) + (hash_enabled ? 1 : 0);
+                    for(u32 i = 0; i < lane_count; i++) {
+                        // The first lane reuses the installer's storage, the rest open their own sessions so that NCM can handle their writes in parallel
+                        std::unique_ptr<ContentStorage> lane_cnt_storage;
+                        if(i > 0) {
+                            GLEAF_RC_TRY(svcs.OpenContentStorage(storage_id, lane_cnt_storage));
+                        }
+                        this->lanes.push_back(std::make_unique<ContentWriteLane>(this, cnt_storage, std::move(lane_cnt_storage), hash_enabled, lane_buffer_count, buffer_size));
+                        if(this->IsDecoding()) {
+                            this->decode_stages.push_back(std::make_unique<ContentDecodeStage>(this, *this->lanes.back(), ContentDecodeBufferCount, buffer_size));
+                        }
+                    }
+                    GLEAF_RC_SUCCEED;
+                }
+
+                Result StartLanes() {
+                    for(auto &lane: this->lanes) {
+                        GLEAF_RC_TRY(lane->Start());
+                    }
+                    for(auto &decode_stage: this->decode_stages) {
+                        GLEAF_RC_TRY(decode_stage->Start());
+                    }
+                    GLEAF_RC_SUCCEED;
+                }
+
+                void FinishLanes() {
+                    // Decode stages flush their remaining output to their lanes, so they must finish first
+                    for(auto &decode_stage: this->decode_stages) {
+                        decode_stage->Finish();
+                    }
+                    for(auto &lane: this->lanes) {
+                        lane->Finish();
+                    }
+                }
+
+                inline u32 GetLaneCount() {
+                    return this->lanes.size();
+                }
+
+                inline ContentWriteSink &GetSink(const u32 lane_idx) {
+                    if(this->decode_stages.empty()) {
+                        return *this->lanes.at(lane_idx);
+                    }
+                    else {
+                        return *this->decode_stages.at(lane_idx);
+                    }
+                }
+
+                u32 RegisterContent(const NcmContentType type, const NcmPlaceHolderId placehld_id, const size_t total_size, const size_t cur_offset, const bool compressed) {
+                    ScopedLock progress_lock(this->write_progress_lock);
+
+                    const auto cnt_id = this->write_progress.entries.size();
+                    this->write_progress.entries.push_back({
+                        .type = type,
+                        .placehld_id = placehld_id,
+                        .cur_offset = cur_offset,
+                        .size = total_size
+                    });
+                    this->committed_sizes.push_back(cur_offset);
+                    this->compressed_cnts.push_back(compressed);
+                    return cnt_id;
+                }
+
+                bool IsDecoding() {
+                    return std::find(this->compressed_cnts.begin(), this->compressed_cnts.end(), true) != this->compressed_cnts.end();
+                }
+
+                inline bool IsContentCompressed(const u32 cnt_id) {
+                    return this->compressed_cnts.at(cnt_id);
+                }
+
+                size_t GetContentSize(const u32 cnt_id) {
+                    ScopedLock progress_lock(this->write_progress_lock);
+                    return this->write_progress.entries.at(cnt_id).size;
+                }
+
+                // Must be called for every content, right after registering it
+                void RegisterContentHash(const u8 *expected_hash) {
+                    auto &hash_state = this->hash_states.emplace_back();
+                    hash_state.verify = expected_hash != nullptr;
+                    if(hash_state.verify) {
+                        memcpy(hash_state.expected_hash, expected_hash, sizeof(hash_state.expected_hash));
+                        mbedtls_sha256_init(&hash_state.sha_ctx);
+                        mbedtls_sha256_starts(&hash_state.sha_ctx, 0);
+                    }
+                }
+
+                bool IsHashing() {
+                    return std::find_if(this->hash_states.begin(), this->hash_states.end(), [](const ContentHashState &hash_state) -> bool {
+                        return hash_state.verify;
+                    }) != this->hash_states.end();
+                }
+
+                void HashBuffer(const ContentWriteBuffer &buf) {
+                    auto &hash_state = this->hash_states.at(buf.cnt_id);
+                    if(hash_state.verify) {
+                        const auto start_tick = armGetSystemTick();
+                        mbedtls_sha256_update(&hash_state.sha_ctx, buf.buf, buf.size);
+                        const auto ticks = armGetSystemTick() - start_tick;
+                        this->hash_ticks += ticks;
+                        this->stats.Record(InstallStage::ContentHash, buf.size, ticks);
+                        this->hashed_size += buf.size;
+
+                        ScopedLock progress_lock(this->write_progress_lock);
+                        this->write_progress.hashed_size += buf.size;
+                    }
+                }
+
+                bool VerifyContentHash(const u32 cnt_id) {
+                    auto &hash_state = this->hash_states.at(cnt_id);
+                    if(!hash_state.verify) {
+                        return true;
+                    }
+
+                    u8 hash[SHA256_HASH_SIZE] = {};
+                    mbedtls_sha256_finish(&hash_state.sha_ctx, hash);
+                    return memcmp(hash, hash_state.expected_hash, sizeof(hash)) == 0;
+                }
+
+                void LogHashThroughput() {
+                    const auto hash_ns = armTicksToNs(this->hash_ticks);
+                    if(hash_ns > 0) {
+                        // Time actually spent hashing (summed for all lanes), which is what would bound installs if hashing was ever slower than writing
+                        const auto throughput_mbps = ((double)this->hashed_size / (1024.0 * 1024.0)) / ((double)hash_ns / 1'000'000'000.0);
+                        GLEAF_LOG_FMT("Verified 0x%lX bytes, hashing throughput: %.2f MB/s", this->hashed_size.load(), throughput_mbps);
+                    }
+                }
+
+                bool UpdateCommittedSizes(std::vector<u64> &committed_sizes) {
+                    ScopedLock progress_lock(this->write_progress_lock);
+
+                    auto changed = false;
+                    committed_sizes.resize(this->committed_sizes.size());
+                    for(u32 i = 0; i < this->committed_sizes.size(); i++) {
+                        if(committed_sizes.at(i) != this->committed_sizes.at(i)) {
+                            committed_sizes.at(i) = this->committed_sizes.at(i);
+                            changed = true;
+                        }
+                    }
+                    return changed;
+                }
+
+                u32 GetPendingBufferCount() {
+                    u32 pending_count = 0;
+                    for(u32 i = 0; i < this->lanes.size(); i++) {
+                        pending_count += this->GetSink(i).GetPendingBufferCount();
+                    }
+                    return pending_count;
+                }
+
+                Result WriteBuffer(ContentStorage &cnt_storage, const ContentWriteBuffer &buf) {
+                    NcmPlaceHolderId placehld_id;
+                    size_t offset;
+                    {
+                        ScopedLock progress_lock(this->write_progress_lock);
+                        auto &cnt_entry = this->write_progress.entries.at(buf.cnt_id);
+                        placehld_id = cnt_entry.placehld_id;
+                        offset = cnt_entry.cur_offset;
+                        cnt_entry.cur_offset += buf.size;
+                        this->write_progress.written_size += buf.size;
+                    }
+                    const auto start_tick = armGetSystemTick();
+                    const auto rc = cnt_storage.WritePlaceHolder(placehld_id, offset, buf.buf, buf.size);
+                    this->stats.Record(InstallStage::NcmWrite, buf.size, armGetSystemTick() - start_tick);
+
+                    if(R_SUCCEEDED(rc)) {
+                        // Each content is written by a single lane, in order, so whatever was committed is always a contiguous range from the start
+                        ScopedLock progress_lock(this->write_progress_lock);
+                        this->committed_sizes.at(buf.cnt_id) += buf.size;
+                    }
+                    else {
+                        this->NotifyFailure(rc);
+                    }
+                    return rc;
+                }
+
+                void NotifyFailure(const Result rc) {
+                    {
+                        // Keep the first failure, later ones are most likely a consequence of it
+                        ScopedLock rc_lock(this->last_rc_lock);
+                        if(R_SUCCEEDED(this->last_rc)) {
+                            this->last_rc = rc;
+                        }
+                    }
+                    this->SignalAborted();
+                }
+
+                void SignalAborted() {
+                    this->aborted = true;
+                    for(auto &lane: this->lanes) {
+                        lane->WakeReader();
+                    }
+                    for(auto &decode_stage: this->decode_stages) {
+                        decode_stage->WakeReader();
+                    }
+                }
+
+                inline bool IsAborted() {
+                    return this->aborted;
+                }
+
+                inline InstallStats &GetStats() {
+                    return this->stats;
+                }
+
+                Result GetLastResult() {
+                    ScopedLock rc_lock(this->last_rc_lock);
+                    return this->last_rc;
+                }
+
+                void NotifyUpdateProgress() {
+                    ScopedLock progress_lock(this->write_progress_lock);
+                    if(this->on_content_write_fn) {
+                        this->on_content_write_fn(this->write_progress);
+                    }
+                    this->write_progress.written_size = 0;
+                    this->write_progress.hashed_size = 0;
+                }
+
+                void NotifyStart(OnStartWriteFunction on_start_write_fn) {
+                    if(on_start_write_fn) {
+                        on_start_write_fn(this->write_progress);
+                    }
+                }
+        };
+
+        void ContentWriteLane::Main(void *lane_raw) {
+            SetThreadName("nsp.ContentWriteThread");
+            auto lane = reinterpret_cast<ContentWriteLane*>(lane_raw);
+
+            while(true) {
+                auto buf = lane->AcquireReadyBuffer();
+                if(buf == nullptr) {
+                    break;
+                }
+
+                const auto rc = lane->ctx->WriteBuffer(lane->cnt_storage, *buf);
+                lane->ReleaseWrittenBuffer();
+                if(R_FAILED(rc)) {
+                    break;
+                }
+            }
+
+            lane->NotifyWriteDone();
+        }
+
+        void ContentWriteLane::HashMain(void *lane_raw) {
+            SetThreadName("nsp.ContentHashThread");
+            auto lane = reinterpret_cast<ContentWriteLane*>(lane_raw);
+
+            while(true) {
+                auto buf = lane->AcquireWrittenBuffer();
+                if(buf == nullptr) {
+                    break;
+                }
+
+                lane->ctx->HashBuffer(*buf);
+                lane->ReleaseHashedBuffer();
+            }
+        }
+
+        ContentWriteBuffer *ContentDecodeStage::AcquireLaneBuffer() {
+            // The lane wakes us up when aborting too
+            while(!this->ctx->IsAborted()) {
+                auto buf = this->lane.TryAcquireFreeBuffer();
+                if(buf != nullptr) {
+                    return buf;
+                }
+
+                waitSingle(this->lane.GetFreeBufferWaiter(), UINT64_MAX);
+            }
+            return nullptr;
+        }
+
+        Result ContentDecodeStage::Output(const u8 *buf, const size_t size) {
+            size_t offset = 0;
+            while(offset < size) {
+                if(this->out_buf == nullptr) {
+                    this->out_buf = this->AcquireLaneBuffer();
+                    GLEAF_RC_UNLESS(this->out_buf != nullptr, this->ctx->GetLastResult());
+                    this->out_buf_offset = 0;
+                }
+
+                const auto copy_size = std::min(size - offset, this->lane_buffer_size - this->out_buf_offset);
+                memcpy(this->out_buf->buf + this->out_buf_offset, buf + offset, copy_size);
+                this->out_buf_offset += copy_size;
+                offset += copy_size;
+
+                if(this->out_buf_offset == this->lane_buffer_size) {
+                    this->lane.CommitBuffer(this->cur_cnt_id.value(), this->out_buf_offset);
+                    this->out_buf = nullptr;
+                }
+            }
+            GLEAF_RC_SUCCEED;
+        }
+
+        void ContentDecodeStage::StartContent(const u32 cnt_id) {
+            this->cur_cnt_id = cnt_id;
+            if(this->ctx->IsContentCompressed(cnt_id)) {
+                this->cur_decoder = std::make_unique<NczDecoder>(this->ctx->GetContentSize(cnt_id), [this](const u8 *buf, const size_t size) -> Result {
+                    return this->Output(buf, size);
+                });
+            }
+        }
+
+        Result ContentDecodeStage::FinishContent() {
+            if(this->cur_decoder) {
+                const auto rc = this->cur_decoder->Finish();
+                this->cur_decoder.reset();
+                GLEAF_RC_TRY(rc);
+            }
+
+            // Lane buffers only hold data of a single content, so the last (partial) one is committed here
+            if(this->out_buf != nullptr) {
+                this->lane.CommitBuffer(this->cur_cnt_id.value(), this->out_buf_offset);
+                this->out_buf = nullptr;
+            }
+            this->cur_cnt_id.reset();
+            GLEAF_RC_SUCCEED;
+        }
+
+        Result ContentDecodeStage::DecodeBuffer(const ContentWriteBuffer &buf) {
+            if(this->cur_cnt_id != buf.cnt_id) {
+                GLEAF_RC_TRY(this->FinishContent());
+                this->StartContent(buf.cnt_id);
+            }
+
+            if(this->cur_decoder) {
+                // Blocking on full lanes is part of this too, which is what would bound installs if writing was the bottleneck
+                const auto start_tick = armGetSystemTick();
+                const auto rc = this->cur_decoder->Feed(buf.buf, buf.size);
+                this->ctx->GetStats().Record(InstallStage::ContentDecode, buf.size, armGetSystemTick() - start_tick);
+                return rc;
+            }
+            else {
+                return this->Output(buf.buf, buf.size);
+            }
+        }
+
+        void ContentDecodeStage::Main(void *stage_raw) {
+            SetThreadName("nsp.ContentDecodeThread");
+            auto stage = reinterpret_cast<ContentDecodeStage*>(stage_raw);
+
+            auto rc = rc::ResultSuccess;
+            while(true) {
+                auto buf = stage->AcquireReadyBuffer();
+                if(buf == nullptr) {
+                    break;
+                }
+
+                rc = stage->DecodeBuffer(*buf);
+                stage->ReleaseDecodedBuffer();
+                if(R_FAILED(rc)) {
+                    break;
+                }
+            }
+
+            if(R_SUCCEEDED(rc)) {
+                rc = stage->FinishContent();
+            }
+            if(R_FAILED(rc)) {
+                stage->ctx->NotifyFailure(rc);
+            }
+        }
+
+    }
+
+    Result WriteContents(InstallServices &svcs, ContentStorage &cnt_storage, const std::vector<ContentWriteEntry> &entries, ContentReader &reader, const ContentWriteOptions &opts, InstallStats &stats, u32 &out_mismatch_entry_idx) {
+        ContentWriteContext write_ctx(opts.on_content_write_fn, stats);
+        std::vector<u32> entry_cnt_ids;
+        for(const auto &entry: entries) {
+            entry_cnt_ids.push_back(write_ctx.RegisterContent(entry.type, entry.placehld_id, entry.size, entry.written_size, entry.compressed));
+            write_ctx.RegisterContentHash(entry.expected_hash);
+        }
+
+        const auto lane_count = std::clamp<u32>(opts.lane_count, 1, std::max<u32>(entries.size(), 1));
+        GLEAF_RC_TRY(write_ctx.CreateLanes(svcs, cnt_storage, opts.storage_id, lane_count, opts.buffer_size));
+        write_ctx.NotifyStart(opts.on_start_write_fn);
+        GLEAF_RC_TRY(write_ctx.StartLanes());
+
+        // Each lane is assigned one content at a time, and the reader goes round-robin through the lanes with free buffers, so that contents are streamed in parallel
+        struct ContentReadState {
+            u32 entry_idx;
+            u64 offset;
+            u64 rem_size;
+        };
+        std::vector<std::optional<ContentReadState>> lane_read_states(lane_count);
+        u32 next_entry_idx = 0;
+        const auto assign_next_content = [&](const u32 lane_idx) {
+            lane_read_states.at(lane_idx).reset();
+            while(next_entry_idx < entries.size()) {
+                const auto entry_idx = next_entry_idx++;
+                const auto &entry = entries.at(entry_idx);
+                if(entry.read_offset < entry.read_size) {
+                    lane_read_states.at(lane_idx) = ContentReadState {
+                        .entry_idx = entry_idx,
+                        .offset = entry.read_offset,
+                        .rem_size = entry.read_size - entry.read_offset
+                    };
+                    break;
+                }
+            }
+        };
+        for(u32 i = 0; i < lane_count; i++) {
+            assign_next_content(i);
+        }
+
+        reader.Start();
+        auto reader_started = true;
+        ScopeGuard end_reader([&]() {
+            if(reader_started) {
+                reader.End();
+            }
+        });
+
+        std::vector<u64> committed_sizes;
+        u32 cur_lane_idx = 0;
+        while(true) {
+            // Lanes free buffers as soon as they are committed, so this is checked after every written chunk
+            if(write_ctx.UpdateCommittedSizes(committed_sizes) && opts.on_content_commit_fn) {
+                opts.on_content_commit_fn(committed_sizes);
+            }
+
+            GLEAF_RC_UNLESS(!write_ctx.IsAborted(), write_ctx.GetLastResult());
+
+            std::vector<Waiter> lane_waiters;
+            ContentWriteBuffer *write_buf = nullptr;
+            u32 write_lane_idx = 0;
+            for(u32 i = 0; i < lane_count; i++) {
+                const auto lane_idx = (cur_lane_idx + i) % lane_count;
+                if(lane_read_states.at(lane_idx).has_value()) {
+                    auto &sink = write_ctx.GetSink(lane_idx);
+                    write_buf = sink.TryAcquireFreeBuffer();
+                    if(write_buf != nullptr) {
+                        write_lane_idx = lane_idx;
+                        break;
+                    }
+                    lane_waiters.push_back(sink.GetFreeBufferWaiter());
+                }
+            }
+
+            if(write_buf == nullptr) {
+                if(lane_waiters.empty()) {
+                    // Every content was already read
+                    break;
+                }
+
+                const auto wait_start_tick = armGetSystemTick();
+                s32 tmp_idx;
+                waitObjects(&tmp_idx, lane_waiters.data(), static_cast<s32>(lane_waiters.size()), UINT64_MAX);
+                stats.Record(InstallStage::QueueWait, 0, armGetSystemTick() - wait_start_tick);
+                continue;
+            }
+
+            auto &read_state = lane_read_states.at(write_lane_idx).value();
+            const auto read_size = std::min<u64>(reader.GetChunkSize(read_state.rem_size), opts.buffer_size);
+            const auto read_start_tick = armGetSystemTick();
+            const auto tmp_read_size = reader.Read(read_state.entry_idx, read_state.offset, read_size, write_buf->buf);
+            stats.Record(InstallStage::SourceRead, tmp_read_size, armGetSystemTick() - read_start_tick);
+            GLEAF_RC_UNLESS(tmp_read_size > 0, rc::goldleaf::ResultInvalidNsp);
+            write_ctx.GetSink(write_lane_idx).CommitBuffer(entry_cnt_ids.at(read_state.entry_idx), tmp_read_size);
+            reader.NotifyQueued(tmp_read_size);
+            stats.RecordQueueDepth(write_ctx.GetPendingBufferCount());
+
+            read_state.offset += tmp_read_size;
+            read_state.rem_size -= tmp_read_size;
+            if(read_state.rem_size == 0) {
+                assign_next_content(write_lane_idx);
+            }
+            cur_lane_idx = (write_lane_idx + 1) % lane_count;
+
+            write_ctx.NotifyUpdateProgress();
+        }
+
+        reader.End();
+        reader_started = false;
+
+        // Nothing else will be read, so the source may already be used elsewhere (like preparing the next installation) while the lanes finish writing
+        if(opts.on_read_done_fn) {
+            opts.on_read_done_fn();
+        }
+
+        write_ctx.FinishLanes();
+        GLEAF_RC_TRY(write_ctx.GetLastResult());
+        write_ctx.NotifyUpdateProgress();
+        if(write_ctx.UpdateCommittedSizes(committed_sizes) && opts.on_content_commit_fn) {
+            opts.on_content_commit_fn(committed_sizes);
+        }
+
+        if(write_ctx.IsHashing()) {
+            for(u32 i = 0; i < entries.size(); i++) {
+                if(!write_ctx.VerifyContentHash(entry_cnt_ids.at(i))) {
+                    out_mismatch_entry_idx = i;
+                    return rc::goldleaf::ResultContentHashMismatch;
+                }
+            }
+            write_ctx.LogHashThroughput();
+        }
+
+        GLEAF_RC_SUCCEED;
+    }
+
+}
@@ -0,0 +1,54 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <nsp/nsp_InstallJournal.hpp>
+#include <fs/fs_FileSystem.hpp>
+
+namespace nsp {
+
+    bool ReadInstallJournal(InstallJournal &out_journal) {
+        auto sd_exp = fs::GetSdCardExplorer();
+        if(!sd_exp->IsFile(GLEAF_PATH_INSTALL_JOURNAL_FILE)) {
+            return false;
+        }
+
+        const auto err = glz::read_file_json<PartialJsonOptions{}>(out_journal, "sdmc:/" GLEAF_PATH_INSTALL_JOURNAL_FILE, std::string{});
+        if(err) {
+            GLEAF_WARN_FMT("Failed to read install journal JSON: %d (%s)", (u32)err.ec, err.custom_error_message.data());
+            return false;
+        }
+        return true;
+    }
+
+    void SaveInstallJournal(const InstallJournal &journal) {
+        // Not being able to save it just means the install can't be resumed, no need to fail
+        const auto err = glz::write_file_json<PartialJsonOptions{}>(journal, "sdmc:/" GLEAF_PATH_INSTALL_JOURNAL_FILE, std::string{});
+        if(err) {
+            GLEAF_WARN_FMT("Failed to save install journal JSON: %d (%s)", (u32)err.ec, err.custom_error_message.data());
+        }
+    }
+
+    void DeleteInstallJournal() {
+        auto sd_exp = fs::GetSdCardExplorer();
+        sd_exp->DeleteFile(GLEAF_PATH_INSTALL_JOURNAL_FILE);
+    }
+
+}
@@ -0,0 +1,124 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <nsp/nsp_InstallReport.hpp>
+#include <fs/fs_FileSystem.hpp>
+
+namespace nsp {
+
+    namespace {
+
+        constexpr const char *InstallStageNames[] = {
+            "package_parse",
+            "ticket_import",
+            "meta_staging",
+            "source_read",
+            "queue_wait",
+            "content_decode",
+            "ncm_write",
+            "content_hash",
+            "register",
+            "record_update"
+        };
+        static_assert(std::size(InstallStageNames) == static_cast<u32>(InstallStage::Count));
+
+        // Small packages in a batch can finish within the same second, so report names also have a counter
+        u32 g_SavedReportCount = 0;
+
+        inline double TicksToMs(const u64 ticks) {
+            return (double)armTicksToNs(ticks) / 1'000'000.0;
+        }
+
+        u64 GetPercentileTicks(std::vector<u64> &sorted_ticks, const u32 percentile) {
+            if(sorted_ticks.empty()) {
+                return 0;
+            }
+
+            const auto idx = std::min<size_t>((sorted_ticks.size() * percentile) / 100, sorted_ticks.size() - 1);
+            return sorted_ticks.at(idx);
+        }
+
+    }
+
+    void InstallStats::Record(const InstallStage stage, const u64 size, const u64 ticks) {
+        ScopedLock lk(this->lock);
+        auto &stage_stats = this->stages.at(static_cast<u32>(stage));
+        stage_stats.size += size;
+        stage_stats.chunk_ticks.push_back(ticks);
+    }
+
+    void InstallStats::RecordQueueDepth(const u32 pending_buffer_count) {
+        ScopedLock lk(this->lock);
+        this->queue_depth_sum += pending_buffer_count;
+        this->queue_depth_sample_count++;
+        this->max_queue_depth = std::max(this->max_queue_depth, pending_buffer_count);
+    }
+
+    void InstallStats::FillReport(InstallReport &out_report) {
+        ScopedLock lk(this->lock);
+        out_report.write_duration_ms = TicksToMs(this->write_ticks);
+        out_report.avg_queue_depth = (this->queue_depth_sample_count > 0) ? ((double)this->queue_depth_sum / (double)this->queue_depth_sample_count) : 0.0;
+        out_report.max_queue_depth = this->max_queue_depth;
+        out_report.stages.clear();
+        for(u32 i = 0; i < this->stages.size(); i++) {
+            auto &stage_stats = this->stages.at(i);
+            if(stage_stats.chunk_ticks.empty()) {
+                continue;
+            }
+
+            u64 busy_ticks = 0;
+            for(const auto ticks: stage_stats.chunk_ticks) {
+                busy_ticks += ticks;
+            }
+            std::sort(stage_stats.chunk_ticks.begin(), stage_stats.chunk_ticks.end());
+
+            // Busy time is summed over every thread running the stage, so the throughput is the one of a single thread
+            const auto busy_ms = TicksToMs(busy_ticks);
+            out_report.stages.push_back({
+                .stage = InstallStageNames[i],
+                .size = stage_stats.size,
+                .chunk_count = stage_stats.chunk_ticks.size(),
+                .busy_ms = busy_ms,
+                .throughput_mbps = ((stage_stats.size > 0) && (busy_ms > 0.0)) ? (((double)stage_stats.size / (1024.0 * 1024.0)) / (busy_ms / 1000.0)) : 0.0,
+                .p50_chunk_ms = TicksToMs(GetPercentileTicks(stage_stats.chunk_ticks, 50)),
+                .p99_chunk_ms = TicksToMs(GetPercentileTicks(stage_stats.chunk_ticks, 99))
+            });
+        }
+    }
+
+    void SaveInstallReport(const InstallReport &report) {
+        const auto posix_time = time(nullptr);
+        const auto local_time = localtime(&posix_time);
+        char report_time[0x40] = {};
+        strftime(report_time, sizeof(report_time), "%Y%m%d_%H%M%S", local_time);
+        const auto report_name = "install_" + std::string(report_time) + "_" + std::to_string(g_SavedReportCount++) + ".json";
+
+        const auto report_path = fs::GetSdCardExplorer()->MakeAbsolute(GLEAF_PATH_REPORTS_DIR "/" + report_name);
+        const auto err = glz::write_file_json<PartialJsonOptions{}>(report, report_path, std::string{});
+        if(err) {
+            GLEAF_WARN_FMT("Failed to save install report JSON: %d (%s)", (u32)err.ec, err.custom_error_message.data());
+        }
+        else {
+            GLEAF_LOG_FMT("Saved install report to '%s'", report_path.c_str());
+        }
+    }
+
+}
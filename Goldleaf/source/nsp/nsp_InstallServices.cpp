@@ -0,0 +1,137 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <nsp/nsp_InstallServices.hpp>
+
+namespace nsp {
+
+    namespace {
+
+        class SystemContentStorage : public ContentStorage {
+            private:
+                NcmContentStorage cnt_storage;
+
+            public:
+                SystemContentStorage(NcmContentStorage cnt_storage) : cnt_storage(cnt_storage) {}
+
+                ~SystemContentStorage() {
+                    ncmContentStorageClose(&this->cnt_storage);
+                }
+
+                Result Has(bool &out_has, const NcmContentId &cnt_id) override {
+                    return ncmContentStorageHas(&this->cnt_storage, &out_has, &cnt_id);
+                }
+
+                Result CreatePlaceHolder(const NcmContentId &cnt_id, const NcmPlaceHolderId &placehld_id, const s64 size) override {
+                    return ncmContentStorageCreatePlaceHolder(&this->cnt_storage, &cnt_id, &placehld_id, size);
+                }
+
+                Result DeletePlaceHolder(const NcmPlaceHolderId &placehld_id) override {
+                    return ncmContentStorageDeletePlaceHolder(&this->cnt_storage, &placehld_id);
+                }
+
+                Result HasPlaceHolder(bool &out_has, const NcmPlaceHolderId &placehld_id) override {
+                    return ncmContentStorageHasPlaceHolder(&this->cnt_storage, &out_has, &placehld_id);
+                }
+
+                Result GetPlaceHolderSize(s64 &out_size, const NcmPlaceHolderId &placehld_id) override {
+                    return ncmContentStorageGetSizeFromPlaceHolderId(&this->cnt_storage, &out_size, &placehld_id);
+                }
+
+                Result GetPlaceHolderPath(char *out_path, const size_t out_path_size, const NcmPlaceHolderId &placehld_id) override {
+                    return ncmContentStorageGetPlaceHolderPath(&this->cnt_storage, out_path, out_path_size, &placehld_id);
+                }
+
+                Result WritePlaceHolder(const NcmPlaceHolderId &placehld_id, const u64 offset, const void *buf, const size_t size) override {
+                    return ncmContentStorageWritePlaceHolder(&this->cnt_storage, &placehld_id, offset, buf, size);
+                }
+
+                Result Register(const NcmContentId &cnt_id, const NcmPlaceHolderId &placehld_id) override {
+                    return ncmContentStorageRegister(&this->cnt_storage, &cnt_id, &placehld_id);
+                }
+        };
+
+        class SystemContentMetaDatabase : public ContentMetaDatabase {
+            private:
+                NcmContentMetaDatabase cnt_meta_db;
+
+            public:
+                SystemContentMetaDatabase(NcmContentMetaDatabase cnt_meta_db) : cnt_meta_db(cnt_meta_db) {}
+
+                ~SystemContentMetaDatabase() {
+                    ncmContentMetaDatabaseClose(&this->cnt_meta_db);
+                }
+
+                Result Set(const NcmContentMetaKey &meta_key, const void *data, const size_t size) override {
+                    return ncmContentMetaDatabaseSet(&this->cnt_meta_db, &meta_key, data, size);
+                }
+
+                Result Commit() override {
+                    return ncmContentMetaDatabaseCommit(&this->cnt_meta_db);
+                }
+        };
+
+        class SystemInstallServices : public InstallServices {
+            public:
+                Result OpenContentStorage(const NcmStorageId storage_id, std::unique_ptr<ContentStorage> &out_cnt_storage) override {
+                    NcmContentStorage cnt_storage;
+                    GLEAF_RC_TRY(ncmOpenContentStorage(&cnt_storage, storage_id));
+                    out_cnt_storage = std::make_unique<SystemContentStorage>(cnt_storage);
+                    GLEAF_RC_SUCCEED;
+                }
+
+                Result OpenContentMetaDatabase(const NcmStorageId storage_id, std::unique_ptr<ContentMetaDatabase> &out_cnt_meta_db) override {
+                    NcmContentMetaDatabase cnt_meta_db;
+                    GLEAF_RC_TRY(ncmOpenContentMetaDatabase(&cnt_meta_db, storage_id));
+                    out_cnt_meta_db = std::make_unique<SystemContentMetaDatabase>(cnt_meta_db);
+                    GLEAF_RC_SUCCEED;
+                }
+
+                Result ImportTicket(const void *tik_buf, const size_t tik_size, const void *cert_buf, const size_t cert_size) override {
+                    return esImportTicket(tik_buf, tik_size, cert_buf, cert_size);
+                }
+
+                Result CountApplicationContentMeta(const u64 app_id, s32 &out_count) override {
+                    return nsCountApplicationContentMeta(app_id, &out_count);
+                }
+
+                Result ListApplicationRecordContentMeta(const u64 app_id, NsExtContentStorageMetaKey *out_keys, const s32 count, u32 &out_count) override {
+                    return nsextListApplicationRecordContentMeta(0, app_id, out_keys, count, &out_count);
+                }
+
+                Result DeleteApplicationRecord(const u64 app_id) override {
+                    return nsextDeleteApplicationRecord(app_id);
+                }
+
+                Result PushApplicationRecord(const u64 app_id, const NsExtContentStorageMetaKey *keys, const size_t count) override {
+                    return nsextPushApplicationRecord(app_id, NsExtApplicationEvent_Present, keys, count);
+                }
+        };
+
+        SystemInstallServices g_SystemInstallServices;
+
+    }
+
+    InstallServices &GetSystemInstallServices() {
+        return g_SystemInstallServices;
+    }
+
+}
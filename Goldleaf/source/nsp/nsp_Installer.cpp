@@ -20,12 +20,16 @@
 */
 
 #include <nsp/nsp_Installer.hpp>
+#include <nsp/nsp_InstallJournal.hpp>
+#include <nsp/nsp_NczDecoder.hpp>
+#include <nsp/nsp_ContentWriter.hpp>
 #include <fs/fs_FileSystem.hpp>
 #include <util/util_String.hpp>
 #include <hos/hos_Common.hpp>
 #include <es/es_CommonCertificate.hpp>
 #include <cfg/cfg_Settings.hpp>
 #include <ui/ui_MainApplication.hpp>
+#include <mbedtls/sha256.h>
 
 extern ui::MainApplication::Ref g_MainApplication;
 extern cfg::Settings g_Settings;
@@ -34,166 +38,288 @@ namespace nsp {
 
     namespace {
 
-        struct ContentWriteBuffer {
-            u32 cnt_id;
-            u8 *buf;
-            size_t size;
-
-            ContentWriteBuffer() {}
-            
-            ContentWriteBuffer(const u32 cnt_id, u8 *buf, const size_t size) {
-                this->cnt_id = cnt_id;
-                this->buf = buf;
-                this->size = size;
-            }
-        };
+        // Contents whose placeholders are being written by some installer: pipelined installations may prepare a package while the previous one is still being written,
+        // and packages sharing contents (duplicates, mostly) must not recreate placeholders another installer is writing to
+        Lock g_ReservedContentIdsLock;
+        std::vector<NcmContentId> g_ReservedContentIds;
 
-        class ContentWriteContext {
-            private:
-                OnContentWriteFunction on_content_write_fn;
-                NcmContentStorage cnt_storage;
-                std::queue<ContentWriteBuffer> buffer_queue;
-                Lock buffer_queue_lock;
-                ContentWriteProgress write_progress;
-                Lock write_progress_lock;
-                Result last_rc;
-                Lock last_rc_lock;
-                std::atomic_bool done;
+        u32 FindContentFileIndex(fs::PartitionFileSystem &pkg_fs, const NcmContentInfo &cnt_info, bool &out_compressed) {
+            const auto cnt_id_str = util::FormatContentId(cnt_info.content_id);
+            out_compressed = false;
+            if(cnt_info.content_type == NcmContentType_Meta) {
+                return pkg_fs.GetFileIndexByName(cnt_id_str + ".cnmt.nca");
+            }
 
-            public:
-                enum class Status {
-                    Done,
-                    BufferQueueAvailable,
-                    BufferQueueEmpty
-                };
+            const auto nca_file_idx = pkg_fs.GetFileIndexByName(cnt_id_str + ".nca");
+            if(fs::PartitionFileSystem::IsValidFileIndex(nca_file_idx)) {
+                return nca_file_idx;
+            }
 
-                ContentWriteContext(OnContentWriteFunction on_content_write_fn, NcmContentStorage cnt_storage) : on_content_write_fn(on_content_write_fn), cnt_storage(cnt_storage), buffer_queue(), buffer_queue_lock(), write_progress(), write_progress_lock(), last_rc(rc::ResultSuccess), last_rc_lock(), done(false) {}
+            // NSZ packages
+            out_compressed = true;
+            return pkg_fs.GetFileIndexByName(cnt_id_str + ".ncz");
+        }
 
-                void EmplaceBuffer(const u32 cnt_id, u8 *buf, const size_t size) {
-                    ScopedLock queue_lock(this->buffer_queue_lock);
-                    this->buffer_queue.emplace(cnt_id, buf, size);
+        const u8 *FindPackagedContentHash(const cnt::PackagedContentMeta &packaged_cnt_meta, const NcmContentId &cnt_id) {
+            for(const auto &packaged_cnt: packaged_cnt_meta.contents) {
+                if(memcmp(packaged_cnt.info.content_id.c, cnt_id.c, sizeof(cnt_id.c)) == 0) {
+                    return packaged_cnt.hash;
                 }
+            }
+            return nullptr;
+        }
 
-                Status GetStatus() {
-                    ScopedLock queue_lock(this->buffer_queue_lock);
-                    if(this->buffer_queue.empty()) {
-                        if(this->done) {
-                            return Status::Done;
-                        }
-                        else {
-                            return Status::BufferQueueEmpty;
-                        }
-                    }
-                    else {
-                        return Status::BufferQueueAvailable;
-                    }
-                }
+        Result ReadCompressedContentSize(fs::PartitionFileSystem &pkg_fs, const u32 file_idx, u64 &out_size) {
+            NczSectionHeader section_header;
+            GLEAF_RC_UNLESS(pkg_fs.ReadFromFile(file_idx, NczNcaHeaderSize, sizeof(section_header), &section_header) == sizeof(section_header), rc::goldleaf::ResultInvalidNcz);
+            GLEAF_RC_UNLESS(section_header.magic == NczSectionHeaderMagic, rc::goldleaf::ResultInvalidNcz);
+            GLEAF_RC_UNLESS(section_header.section_count <= NczMaxSectionCount, rc::goldleaf::ResultInvalidNcz);
 
-                u32 RegisterContent(const NcmContentType type, const NcmPlaceHolderId placehld_id, const size_t total_size) {
-                    ScopedLock progress_lock(this->write_progress_lock);
-
-                    const auto cnt_id = this->write_progress.entries.size();
-                    this->write_progress.entries.push_back({
-                        .type = type,
-                        .placehld_id = placehld_id,
-                        .cur_offset = 0,
-                        .size = total_size
-                    });
-                    return cnt_id;
-                }
+            std::vector<NczSection> sections(section_header.section_count);
+            const auto sections_size = sections.size() * sizeof(NczSection);
+            GLEAF_RC_UNLESS(pkg_fs.ReadFromFile(file_idx, NczNcaHeaderSize + sizeof(section_header), sections_size, sections.data()) == sections_size, rc::goldleaf::ResultInvalidNcz);
 
-                Result PopHandleNextBuffer() {
-                    // Ensure two buffers are not written at the same time
-                    // TODO: multi-thread/multiple NCM instances...?
-                    ScopedLock queue_lock(this->buffer_queue_lock);
-                    const auto buf = this->buffer_queue.front();
-                    this->buffer_queue.pop();
-
-                    NcmPlaceHolderId placehld_id;
-                    size_t offset;
-                    {
-                        ScopedLock progress_lock(this->write_progress_lock);
-                        auto &cnt_entry = this->write_progress.entries.at(buf.cnt_id);
-                        placehld_id = cnt_entry.placehld_id;
-                        offset = cnt_entry.cur_offset;
-                        cnt_entry.cur_offset += buf.size;
-                        this->write_progress.written_size += buf.size;
+            // The decompressed NCA ends where its last section does
+            u64 nca_size = NczNcaHeaderSize;
+            for(const auto &section: sections) {
+                nca_size = std::max(nca_size, section.offset + section.size);
+            }
+            out_size = nca_size;
+            GLEAF_RC_SUCCEED;
+        }
+
+        u64 GetResumableWrittenSize(ContentStorage &cnt_storage, const InstallJournal &journal, const NcmContentId &cnt_id, const NcmPlaceHolderId &placehld_id, const u64 size) {
+            const auto cnt_id_str = util::FormatContentId(cnt_id);
+            for(const auto &journal_cnt: journal.contents) {
+                if((journal_cnt.content_id == cnt_id_str) && (journal_cnt.size == size) && (journal_cnt.written_size <= size)) {
+                    // The placeholder must still be there, and must be the one we created for this content
+                    bool has_placehld = false;
+                    if(R_FAILED(cnt_storage.HasPlaceHolder(has_placehld, placehld_id)) || !has_placehld) {
+                        return 0;
                     }
-                    const auto rc = ncmContentStorageWritePlaceHolder(&this->cnt_storage, &placehld_id, offset, buf.buf, buf.size);
-                    fs::DeleteWorkBuffer(buf.buf);
 
-                    {
-                        ScopedLock rc_lock(this->last_rc_lock);
-                        this->last_rc = rc;
+                    s64 placehld_size = 0;
+                    if(R_FAILED(cnt_storage.GetPlaceHolderSize(placehld_size, placehld_id)) || (static_cast<u64>(placehld_size) != size)) {
+                        return 0;
                     }
-                    return rc;
-                }
 
-                void SignalDone() {
-                    this->done = true;
+                    return journal_cnt.written_size;
                 }
+            }
+
+            return 0;
+        }
+
+        class PackageContentReader : public ContentReader {
+            private:
+                fs::PartitionFileSystem &pkg_fs;
+                const std::vector<u32> &file_idxs;
+                // Lane buffers are allocated with the maximum size, while the reader tunes how much of them it fills each time
+                fs::ChunkSizeTuner tuner;
 
-                Result GetLastResult() {
-                    ScopedLock rc_lock(this->last_rc_lock);
-                    return this->last_rc;
+            public:
+                PackageContentReader(fs::PartitionFileSystem &pkg_fs, const std::vector<u32> &file_idxs, const NcmStorageId storage_id, const size_t buffer_size) : pkg_fs(pkg_fs), file_idxs(file_idxs), tuner(pkg_fs.GetExplorer()->GetStorageKind(), fs::GetStorageKindForStorageId(storage_id), buffer_size) {}
+
+                void Start() override {
+                    this->pkg_fs.GetExplorer()->StartFile(this->pkg_fs.GetPath(), fs::FileMode::Read);
                 }
 
-                void NotifyUpdateProgress() {
-                    ScopedLock progress_lock(this->write_progress_lock);
-                    this->on_content_write_fn(this->write_progress);
-                    this->write_progress.written_size = 0;
+                void End() override {
+                    this->pkg_fs.GetExplorer()->EndFile();
                 }
 
-                void NotifyStart(OnStartWriteFunction on_start_write_fn) {
-                    on_start_write_fn(this->write_progress);
+                u64 GetChunkSize(const u64 rem_size) override {
+                    return this->tuner.GetChunkSize(rem_size);
                 }
-        };
 
-        void ContentWriteMain(void *ctx_raw) {
-            SetThreadName("nsp.ContentWriteThread");
-            auto ctx = reinterpret_cast<ContentWriteContext*>(ctx_raw);
+                u64 Read(const u32 entry_idx, const u64 offset, const u64 size, void *read_buf) override {
+                    return this->pkg_fs.ReadFromFile(this->file_idxs.at(entry_idx), offset, size, read_buf);
+                }
 
-            while(true) {
-                const auto status = ctx->GetStatus();
-                if(status == ContentWriteContext::Status::Done) {
-                    break;
+                void NotifyQueued(const u64 size) override {
+                    this->tuner.NotifyTransferred(size);
                 }
-                else if(status == ContentWriteContext::Status::BufferQueueAvailable) {
-                    const auto rc = ctx->PopHandleNextBuffer();
-                    if(R_FAILED(rc)) {
-                        ctx->SignalDone();
-                        break;
-                    }
+
+                inline size_t GetTunedChunkSize() {
+                    return this->tuner.GetChunkSize();
                 }
+        };
 
-                svcSleepThread(100'000ul);
-            }
+    }
+
+    std::unique_ptr<fs::PartitionFileSystem> OpenPackage(fs::Explorer *exp, const std::string &path) {
+        const auto ext = LowerCaseString(fs::GetExtension(path));
+        if((ext == "xci") || (ext == "xcz")) {
+            // Only the secure partition has the contents to install
+            return fs::OpenXciPartition(exp, path, fs::XciSecurePartitionName);
+        }
+        else {
+            return std::make_unique<fs::PFS0>(exp, path);
         }
+    }
 
+    Installer::Installer(const std::string &path, fs::Explorer *exp, const NcmStorageId st_id, InstallServices &svcs) : svcs(svcs), pkg_fs(), storage_id(st_id), cnt_storage(), cnt_meta_db(), contents(), inst_contents(), staged_cnts(), reserved_cnt_ids(), stats(), report(), report_pending(false) {
+        const auto start_tick = armGetSystemTick();
+        this->pkg_fs = OpenPackage(exp, path);
+        this->stats.Record(InstallStage::PackageParse, 0, armGetSystemTick() - start_tick);
     }
 
     Installer::~Installer() {
         this->FinalizeInstallation();
     }
 
+    bool Installer::ReserveContent(const NcmContentId &cnt_id) {
+        const auto is_same_id = [&](const NcmContentId &reserved_cnt_id) -> bool {
+            return memcmp(reserved_cnt_id.c, cnt_id.c, sizeof(cnt_id.c)) == 0;
+        };
+        if(std::find_if(this->reserved_cnt_ids.begin(), this->reserved_cnt_ids.end(), is_same_id) != this->reserved_cnt_ids.end()) {
+            return true;
+        }
+
+        ScopedLock lk(g_ReservedContentIdsLock);
+        if(std::find_if(g_ReservedContentIds.begin(), g_ReservedContentIds.end(), is_same_id) != g_ReservedContentIds.end()) {
+            return false;
+        }
+        g_ReservedContentIds.push_back(cnt_id);
+        this->reserved_cnt_ids.push_back(cnt_id);
+        return true;
+    }
+
+    void Installer::ReleaseContents() {
+        ScopedLock lk(g_ReservedContentIdsLock);
+        for(const auto &cnt_id: this->reserved_cnt_ids) {
+            const auto it = std::find_if(g_ReservedContentIds.begin(), g_ReservedContentIds.end(), [&](const NcmContentId &reserved_cnt_id) -> bool {
+                return memcmp(reserved_cnt_id.c, cnt_id.c, sizeof(cnt_id.c)) == 0;
+            });
+            if(it != g_ReservedContentIds.end()) {
+                g_ReservedContentIds.erase(it);
+            }
+        }
+        this->reserved_cnt_ids.clear();
+    }
+
+    Result Installer::StageContent(const u32 file_idx, const NcmContentInfo &cnt_info, char (&out_path)[FS_MAX_PATH]) {
+        // Contents we need to parse before installing (meta, control) are written straight into their final placeholders and mounted from there,
+        // thus they are only written once (and WriteContents will simply skip them)
+        const auto start_tick = armGetSystemTick();
+        const auto &cnt_id = cnt_info.content_id;
+        NcmPlaceHolderId placehld_id = {};
+        memcpy(placehld_id.uuid.uuid, cnt_id.c, sizeof(placehld_id.uuid.uuid));
+        const auto file_size = this->pkg_fs->GetFileSize(file_idx);
+        const auto compressed = IsCompressedContentFile(this->pkg_fs->GetFile(file_idx));
+        u64 cnt_size = file_size;
+        if(compressed) {
+            ncmContentInfoSizeToU64(&cnt_info, &cnt_size);
+        }
+        GLEAF_RC_UNLESS(this->ReserveContent(cnt_id), rc::goldleaf::ResultContentReservedByOtherJob);
+
+        this->cnt_storage->DeletePlaceHolder(placehld_id);
+        GLEAF_RC_TRY(this->cnt_storage->CreatePlaceHolder(cnt_id, placehld_id, cnt_size));
+        auto &staged_cnt = this->staged_cnts.emplace_back();
+        staged_cnt.placehld_id = placehld_id;
+
+        // These are small, so (if verifying) they are just hashed here instead of through the hashing stage of WriteContents
+        mbedtls_sha256_context sha_ctx;
+        mbedtls_sha256_init(&sha_ctx);
+        mbedtls_sha256_starts(&sha_ctx, 0);
+
+        auto work_buf = fs::CheckoutWorkBuffer();
+        ScopeGuard on_exit([&]() {
+            fs::ReturnWorkBuffer(work_buf);
+            mbedtls_sha256_free(&sha_ctx);
+            this->pkg_fs->GetExplorer()->EndFile();
+        });
+
+        const auto verify_hashes = g_Settings.json_settings.installs.value().verify_content_hashes.value_or(false);
+        u64 write_offset = 0;
+        const auto write_fn = [&](const u8 *buf, const size_t size) -> Result {
+            GLEAF_RC_TRY(this->cnt_storage->WritePlaceHolder(placehld_id, write_offset, buf, size));
+            if(verify_hashes) {
+                mbedtls_sha256_update(&sha_ctx, buf, size);
+            }
+            write_offset += size;
+            GLEAF_RC_SUCCEED;
+        };
+
+        // These are small enough to be decoded right here too
+        std::unique_ptr<NczDecoder> decoder;
+        if(compressed) {
+            decoder = std::make_unique<NczDecoder>(cnt_size, write_fn);
+        }
+
+        this->pkg_fs->GetExplorer()->StartFile(this->pkg_fs->GetPath(), fs::FileMode::Read);
+        u64 offset = 0;
+        while(offset < file_size) {
+            const auto read_size = this->pkg_fs->ReadFromFile(file_idx, offset, std::min(file_size - offset, fs::DefaultWorkBufferSize), work_buf);
+            GLEAF_RC_UNLESS(read_size > 0, rc::goldleaf::ResultInvalidNsp);
+            if(decoder) {
+                GLEAF_RC_TRY(decoder->Feed(work_buf, read_size));
+            }
+            else {
+                GLEAF_RC_TRY(write_fn(work_buf, read_size));
+            }
+            offset += read_size;
+        }
+        if(decoder) {
+            GLEAF_RC_TRY(decoder->Finish());
+        }
+        mbedtls_sha256_finish(&sha_ctx, this->staged_cnts.back().hash);
+
+        GLEAF_RC_TRY(this->cnt_storage->GetPlaceHolderPath(out_path, sizeof(out_path), placehld_id));
+        this->stats.Record(InstallStage::MetaStaging, cnt_size, armGetSystemTick() - start_tick);
+        GLEAF_RC_SUCCEED;
+    }
+
+    const Installer::StagedContent *Installer::FindStagedContent(const NcmContentId &cnt_id) {
+        const auto it = std::find_if(this->staged_cnts.begin(), this->staged_cnts.end(), [&](const StagedContent &staged_cnt) -> bool {
+            return memcmp(staged_cnt.placehld_id.uuid.uuid, cnt_id.c, sizeof(staged_cnt.placehld_id.uuid.uuid)) == 0;
+        });
+        return (it != this->staged_cnts.end()) ? std::addressof(*it) : nullptr;
+    }
+
+    Result Installer::ComputeInstallSize(u64 &out_size) {
+        GLEAF_RC_UNLESS((this->pkg_fs != nullptr) && this->pkg_fs->IsOk(), rc::goldleaf::ResultInvalidNsp);
+
+        // Only the package itself is read (nothing is staged): NCAs are installed as they are, while NCZs are decompressed into the NCAs their sections describe
+        auto pkg_exp = this->pkg_fs->GetExplorer();
+        pkg_exp->StartFile(this->pkg_fs->GetPath(), fs::FileMode::Read);
+        ScopeGuard on_exit([&]() {
+            pkg_exp->EndFile();
+        });
+
+        u64 install_size = 0;
+        const auto pkg_files = this->pkg_fs->GetFiles();
+        for(u32 i = 0; i < pkg_files.size(); i++) {
+            const auto ext = LowerCaseString(fs::GetExtension(pkg_files.at(i)));
+            if(ext == "nca") {
+                install_size += this->pkg_fs->GetFileSize(i);
+            }
+            else if(ext == "ncz") {
+                u64 cnt_size = 0;
+                GLEAF_RC_TRY(ReadCompressedContentSize(*this->pkg_fs, i, cnt_size));
+                install_size += cnt_size;
+            }
+        }
+
+        out_size = install_size;
+        GLEAF_RC_SUCCEED;
+    }
+
     Result Installer::PrepareInstallation() {
-        GLEAF_RC_UNLESS(pfs0_file.IsOk(), rc::goldleaf::ResultInvalidNsp);
-        GLEAF_RC_TRY(ncmOpenContentStorage(&this->cnt_storage, this->storage_id));
-        GLEAF_RC_TRY(ncmOpenContentMetaDatabase(&this->cnt_meta_db, this->storage_id));
+        GLEAF_RC_UNLESS((this->pkg_fs != nullptr) && this->pkg_fs->IsOk(), rc::goldleaf::ResultInvalidNsp);
+        GLEAF_RC_TRY(this->svcs.OpenContentStorage(this->storage_id, this->cnt_storage));
+        GLEAF_RC_TRY(this->svcs.OpenContentMetaDatabase(this->storage_id, this->cnt_meta_db));
 
         std::string cnmt_nca_file_name;
-        auto cnmt_nca_file_idx = fs::PFS0::InvalidFileIndex;
+        auto cnmt_nca_file_idx = fs::PartitionFileSystem::InvalidFileIndex;
         u64 cnmt_nca_file_size = 0;
-        auto tik_file_idx = fs::PFS0::InvalidFileIndex;
-        this->tik_file_size = 0;
-        auto cert_file_idx = fs::PFS0::InvalidFileIndex;
-        const auto pfs0_files = pfs0_file.GetFiles();
-        for(u32 i = 0; i < pfs0_files.size(); i++) {
-            const auto file = pfs0_files.at(i);
+        auto tik_file_idx = fs::PartitionFileSystem::InvalidFileIndex;
+        auto cert_file_idx = fs::PartitionFileSystem::InvalidFileIndex;
+        const auto pkg_files = this->pkg_fs->GetFiles();
+        for(u32 i = 0; i < pkg_files.size(); i++) {
+            const auto file = pkg_files.at(i);
             if(fs::GetExtension(file) == "tik") {
-                this->tik_file_name = file;
                 tik_file_idx = i;
-                this->tik_file_size = pfs0_file.GetFileSize(i);
             }
             else if(fs::GetExtension(file) == "cert") {
                 cert_file_idx = i;
@@ -203,33 +329,40 @@ namespace nsp {
                     if(file.substr(file.length() - __builtin_strlen("cnmt.nca")) == "cnmt.nca") {
                         cnmt_nca_file_name = file;
                         cnmt_nca_file_idx = i;
-                        cnmt_nca_file_size = pfs0_file.GetFileSize(i);
+                        cnmt_nca_file_size = this->pkg_fs->GetFileSize(i);
                     }
                 }
             }
         }
-        GLEAF_RC_UNLESS(fs::PFS0::IsValidFileIndex(cnmt_nca_file_idx), rc::goldleaf::ResultMetaNotFound);
+        GLEAF_RC_UNLESS(fs::PartitionFileSystem::IsValidFileIndex(cnmt_nca_file_idx), rc::goldleaf::ResultMetaNotFound);
         GLEAF_RC_UNLESS(cnmt_nca_file_size > 0, rc::goldleaf::ResultMetaNotFound);
         const auto cnmt_nca_content_id = fs::GetBaseName(cnmt_nca_file_name);
 
-        auto nand_sys_explorer = fs::GetNANDSystemExplorer();
-        nand_sys_explorer->CreateDirectory(GLEAF_PATH_NAND_INSTALL_TEMP_DIR);
-
+        // Tickets and certificates are tiny, just keep them in memory until they are imported
+        this->tik_data.clear();
+        this->cert_data.clear();
+        const auto tik_file_size = this->pkg_fs->GetFileSize(tik_file_idx);
         if(tik_file_size > 0) {
-            const auto tik_path = nand_sys_explorer->FullPathFor(GLEAF_PATH_NAND_INSTALL_TEMP_DIR "/" + tik_file_name);
-            this->pfs0_file.SaveFile(tik_file_idx, nand_sys_explorer, tik_path);
-            this->tik_file = cnt::ReadTicket(tik_path);
-
-            const auto cert_path = fs::GetFileName(tik_path) + ".cert";
-            this->pfs0_file.SaveFile(cert_file_idx, nand_sys_explorer, cert_path);
+            this->tik_data.resize(tik_file_size);
+            GLEAF_RC_UNLESS(this->pkg_fs->ReadFromFile(tik_file_idx, 0, tik_file_size, this->tik_data.data()) == tik_file_size, rc::goldleaf::ResultInvalidNsp);
+            GLEAF_RC_UNLESS(cnt::ReadTicket(this->tik_data.data(), this->tik_data.size(), this->tik_file), rc::goldleaf::ResultInvalidNsp);
+
+            const auto cert_file_size = this->pkg_fs->GetFileSize(cert_file_idx);
+            if(cert_file_size > 0) {
+                this->cert_data.resize(cert_file_size);
+                GLEAF_RC_UNLESS(this->pkg_fs->ReadFromFile(cert_file_idx, 0, cert_file_size, this->cert_data.data()) == cert_file_size, rc::goldleaf::ResultInvalidNsp);
+            }
         }
 
-        const auto cnmt_nca_temp_path = nand_sys_explorer->FullPathFor(GLEAF_PATH_NAND_INSTALL_TEMP_DIR "/" + cnmt_nca_file_name);
-        nand_sys_explorer->DeleteFile(cnmt_nca_temp_path);
-        pfs0_file.SaveFile(cnmt_nca_file_idx, nand_sys_explorer, cnmt_nca_temp_path);
+        this->meta_cnt_info = {
+            .content_id = util::GetContentId(cnmt_nca_content_id),
+            .content_type = NcmContentType_Meta,
+        };
+        ncmU64ToContentInfoSize(cnmt_nca_file_size, &this->meta_cnt_info);
 
         char cnmt_nca_content_path[FS_MAX_PATH] = {};
-        snprintf(cnmt_nca_content_path, sizeof(cnmt_nca_content_path), GLEAF_FS_PATH_NAND_INSTALL_TEMP_DIR "/%s", cnmt_nca_file_name.c_str());
+        GLEAF_RC_TRY(this->StageContent(cnmt_nca_file_idx, this->meta_cnt_info, cnmt_nca_content_path));
+
         FsRightsId tmp_rid;
         GLEAF_RC_TRY(fsGetRightsIdAndKeyGenerationByPath(cnmt_nca_content_path, FsContentAttributes_All, &this->keygen, &tmp_rid));
         const auto system_keygen = hos::GetSystemKeyGeneration();
@@ -260,12 +393,6 @@ namespace nsp {
             GLEAF_RC_UNLESS(cnt::ReadContentMeta(cnmt_read_buf, cnmt_file_size, this->packaged_cnt_meta), rc::goldleaf::ResultInvalidMeta);
         }
 
-        this->meta_cnt_info = {
-            .content_id = util::GetContentId(cnmt_nca_content_id),
-            .content_type = NcmContentType_Meta,
-        };
-        ncmU64ToContentInfoSize(cnmt_nca_file_size, &this->meta_cnt_info);
-
         this->inst_contents.clear();
         for(const auto &cnt: this->packaged_cnt_meta.contents) {
             if(cnt.info.content_type == NcmContentType_Program) {
@@ -292,8 +419,9 @@ namespace nsp {
 
         GLEAF_RC_UNLESS(!cnt::ExistsApplicationContent(this->packaged_cnt_meta.header.id, static_cast<NcmContentMetaType>(this->packaged_cnt_meta.header.type)).has_value(), rc::goldleaf::ResultContentAlreadyInstalled);
         
+        this->contents.clear();
         bool has_cnmt_installed = false;
-        GLEAF_RC_TRY(ncmContentStorageHas(&this->cnt_storage, &has_cnmt_installed, &this->meta_cnt_info.content_id));
+        GLEAF_RC_TRY(this->cnt_storage->Has(has_cnmt_installed, this->meta_cnt_info.content_id));
         if(!has_cnmt_installed) {
             this->contents.push_back(this->meta_cnt_info);
         }
@@ -305,14 +433,12 @@ namespace nsp {
             if(cnt.info.content_type == NcmContentType_Control) {
                 auto &cur_program = this->inst_contents.at(program_i);
                 const auto control_nca_content_id = util::FormatContentId(cnt.info.content_id);
-                const auto control_nca_file_name = control_nca_content_id + ".nca";
-                const auto control_nca_file_idx = this->pfs0_file.GetFileIndexByName(control_nca_file_name);
-                if(fs::PFS0::IsValidFileIndex(control_nca_file_idx)) {
-                    const auto control_nca_temp_path = nand_sys_explorer->MakeFull(GLEAF_PATH_NAND_INSTALL_TEMP_DIR "/" + control_nca_file_name);
-                    this->pfs0_file.SaveFile(control_nca_file_idx, nand_sys_explorer, control_nca_temp_path);
-
+                bool control_nca_compressed = false;
+                const auto control_nca_file_idx = FindContentFileIndex(*this->pkg_fs, cnt.info, control_nca_compressed);
+                if(fs::PartitionFileSystem::IsValidFileIndex(control_nca_file_idx)) {
                     char control_nca_content_path[FS_MAX_PATH] = {};
-                    snprintf(control_nca_content_path, sizeof(control_nca_content_path), GLEAF_FS_PATH_NAND_INSTALL_TEMP_DIR "/%s", control_nca_file_name.c_str());
+                    GLEAF_RC_TRY(this->StageContent(control_nca_file_idx, cnt.info, control_nca_content_path));
+
                     FsFileSystem control_nca_fs;
                     if(R_SUCCEEDED(fsOpenFileSystemWithId(&control_nca_fs, cur_program.meta_key.id, FsFileSystemType_ContentControl, control_nca_content_path, FsContentAttributes_All))) {
                         fs::FspExplorer control_nca_fs_obj(control_nca_fs, "nsp.ControlData");
@@ -348,56 +474,43 @@ namespace nsp {
     }
 
     Result Installer::InstallTicketCertificate() {
-        if(this->tik_file_size > 0) {
-            auto tik_buf = fs::AllocateWorkBuffer(this->tik_file_size);
-            ScopeGuard on_exit([&]() {
-                fs::DeleteWorkBuffer(tik_buf);
-            });
-
-            const auto tik_path = GLEAF_PATH_NAND_INSTALL_TEMP_DIR "/" + this->tik_file_name;
-            auto nand_sys_explorer = fs::GetNANDSystemExplorer();
-            nand_sys_explorer->ReadFile(tik_path, 0, this->tik_file.GetFullSize(), tik_buf);
-
-            auto tik_signature = *reinterpret_cast<cnt::TicketSignature*>(tik_buf);
-            auto tik_data = reinterpret_cast<cnt::TicketData*>(tik_buf + cnt::GetTicketSignatureSize(tik_signature));
+        if(this->HasTicket()) {
+            const auto start_tick = armGetSystemTick();
+            auto tik_buf = this->tik_data;
+            auto tik_signature = *reinterpret_cast<cnt::TicketSignature*>(tik_buf.data());
+            auto tik_data = reinterpret_cast<cnt::TicketData*>(tik_buf.data() + cnt::GetTicketSignatureSize(tik_signature));
 
             // Make temporary tickets permanent
             if(static_cast<bool>(tik_data->flags & cnt::TicketFlags::Temporary)) {
                 tik_data->flags = tik_data->flags & ~cnt::TicketFlags::Temporary;
             }
 
-            const auto cert_path = GLEAF_PATH_NAND_INSTALL_TEMP_DIR "/" + fs::GetFileName(this->tik_file_name) + ".cert";
-            if(nand_sys_explorer->IsFile(cert_path)) {
-                const auto cert_file_size = nand_sys_explorer->GetFileSize(cert_path);
-                auto cert_buf = fs::AllocateWorkBuffer(cert_file_size);
-                ScopeGuard on_exit([&]() {
-                    fs::DeleteWorkBuffer(cert_buf);
-                });
-                nand_sys_explorer->ReadFile(cert_path, 0, cert_file_size, cert_buf);
-
+            if(!this->cert_data.empty()) {
                 GLEAF_LOG_FMT("Importing ticket with cert!");
-                GLEAF_RC_TRY(esImportTicket(tik_buf, this->tik_file_size, cert_buf, cert_file_size));
+                GLEAF_RC_TRY(this->svcs.ImportTicket(tik_buf.data(), tik_buf.size(), this->cert_data.data(), this->cert_data.size()));
             }
             else {
                 GLEAF_LOG_FMT("Importing ticket!");
-                GLEAF_RC_TRY(esImportTicket(tik_buf, this->tik_file_size, es::CommonCertificateData, es::CommonCertificateSize));
+                GLEAF_RC_TRY(this->svcs.ImportTicket(tik_buf.data(), tik_buf.size(), es::CommonCertificateData, es::CommonCertificateSize));
             }
 
             // We installed a ticket, so we need to refresh the ticket list for future uses
             cnt::NotifyTicketsChanged();
+            this->stats.Record(InstallStage::TicketImport, tik_buf.size(), armGetSystemTick() - start_tick);
         }
         GLEAF_RC_SUCCEED;
     }
 
     Result Installer::UpdateRecordAndContentMetas() {
+        const auto start_tick = armGetSystemTick();
         const auto &main_program = this->inst_contents.front();
         const auto base_app_id = cnt::GetBaseApplicationId(main_program.meta_key.id, static_cast<NcmContentMetaType>(main_program.meta_key.type));
 
         u8 *meta_data;
         size_t meta_data_size;
         this->packaged_cnt_meta.CreateContentMetaForInstall(this->meta_cnt_info, meta_data, meta_data_size, g_Settings.json_settings.installs.value().ignore_required_fw_version.value());
-        GLEAF_RC_TRY(ncmContentMetaDatabaseSet(&this->cnt_meta_db, std::addressof(main_program.meta_key), meta_data, meta_data_size));
-        GLEAF_RC_TRY(ncmContentMetaDatabaseCommit(&this->cnt_meta_db));
+        GLEAF_RC_TRY(this->cnt_meta_db->Set(main_program.meta_key, meta_data, meta_data_size));
+        GLEAF_RC_TRY(this->cnt_meta_db->Commit());
         delete[] meta_data;
 
         // Already installed something, need to refresh the application list for future uses
@@ -405,7 +518,7 @@ namespace nsp {
         g_MainApplication->GetApplicationListLayout()->NotifyApplicationsChanged();
 
         s32 content_meta_count = 0;
-        GLEAF_RC_TRY_EXCEPT(nsCountApplicationContentMeta(base_app_id, &content_meta_count), rc::ns::ResultApplicationIdNotFound);
+        GLEAF_RC_TRY_EXCEPT(this->svcs.CountApplicationContentMeta(base_app_id, content_meta_count), rc::ns::ResultApplicationIdNotFound);
 
         std::vector<NsExtContentStorageMetaKey> content_storage_meta_keys;
         if(content_meta_count > 0) {
@@ -415,7 +528,7 @@ namespace nsp {
             });
 
             u32 real_count = 0;
-            GLEAF_RC_TRY(nsextListApplicationRecordContentMeta(0, base_app_id, cnt_storage_meta_key_buf, content_meta_count, &real_count));
+            GLEAF_RC_TRY(this->svcs.ListApplicationRecordContentMeta(base_app_id, cnt_storage_meta_key_buf, content_meta_count, real_count));
             content_storage_meta_keys.reserve(real_count);
             for(u32 i = 0; i < real_count; i++) {
                 content_storage_meta_keys.push_back(cnt_storage_meta_key_buf[i]);
@@ -427,135 +540,184 @@ namespace nsp {
             .storage_id = this->storage_id,
         };
         content_storage_meta_keys.push_back(cnt_storage_meta_key);
-        nsextDeleteApplicationRecord(base_app_id);
-        GLEAF_RC_TRY(nsextPushApplicationRecord(base_app_id, NsExtApplicationEvent_Present, content_storage_meta_keys.data(), content_storage_meta_keys.size()));
+        this->svcs.DeleteApplicationRecord(base_app_id);
+        GLEAF_RC_TRY(this->svcs.PushApplicationRecord(base_app_id, content_storage_meta_keys.data(), content_storage_meta_keys.size()));
 
+        this->stats.Record(InstallStage::RecordUpdate, 0, armGetSystemTick() - start_tick);
+        this->report.completed = true;
         GLEAF_RC_SUCCEED;
     }
 
-    Result Installer::WriteContents(OnStartWriteFunction on_start_write_fn, OnContentWriteFunction on_content_write_fn) {
-        auto nand_sys_explorer = fs::GetNANDSystemExplorer();
-        u64 total_size = 0;
-        u64 total_written_size = 0;
+    Result Installer::WriteContents(OnStartWriteFunction on_start_write_fn, OnContentWriteFunction on_content_write_fn, OnReadDoneFunction on_read_done_fn) {
+        auto pkg_exp = this->pkg_fs->GetExplorer();
         std::vector<u32> content_file_idxs;
+        std::vector<bool> content_compressed_flags;
         std::vector<NcmPlaceHolderId> content_placehld_ids;
-        std::vector<u32> content_write_idxs;
         for(const auto &cnt: this->contents) {
-            const auto content_file_name = util::FormatContentId(cnt.content_id) + ((cnt.content_type == NcmContentType_Meta) ? ".cnmt" : "") + ".nca";
-            const auto content_file_idx = this->pfs0_file.GetFileIndexByName(content_file_name);
-            GLEAF_RC_UNLESS(fs::PFS0::IsValidFileIndex(content_file_idx), rc::goldleaf::ResultInvalidNsp);
-            total_size += pfs0_file.GetFileSize(content_file_idx);
+            bool content_compressed = false;
+            const auto content_file_idx = FindContentFileIndex(*this->pkg_fs, cnt, content_compressed);
+            GLEAF_RC_UNLESS(fs::PartitionFileSystem::IsValidFileIndex(content_file_idx), rc::goldleaf::ResultInvalidNsp);
             content_file_idxs.push_back(content_file_idx);
+            content_compressed_flags.push_back(content_compressed);
         }
 
-        ContentWriteContext write_ctx(on_content_write_fn, this->cnt_storage);
+        const auto &installs_settings = g_Settings.json_settings.installs.value();
+        const auto copy_buffer_size = installs_settings.copy_buffer_max_size.value();
+        const auto lane_count = std::clamp<u32>(installs_settings.write_lane_count.value_or(cfg::DefaultInstallWriteLaneCount), 1, std::max<u32>(this->contents.size(), 1));
+        const auto verify_hashes = installs_settings.verify_content_hashes.value_or(false);
+
+        // If a previous attempt at installing this same NSP was interrupted, whatever it already wrote to its placeholders can be kept
+        InstallJournal journal = {
+            .nsp_path = pkg_exp->MakeAbsolute(this->pkg_fs->GetPath()),
+            .nsp_size = pkg_exp->GetFileSize(this->pkg_fs->GetPath()),
+            .storage_id = static_cast<u32>(this->storage_id),
+            .contents = {}
+        };
+        InstallJournal prev_journal = {};
+        const auto can_resume = ReadInstallJournal(prev_journal) && (prev_journal.nsp_path == journal.nsp_path) && (prev_journal.nsp_size == journal.nsp_size) && (prev_journal.storage_id == journal.storage_id);
+
+        // From now on this counts as an actual install, which gets reported whether it succeeds or not
+        this->report = {
+            .package_path = journal.nsp_path,
+            .package_size = journal.nsp_size,
+            .storage_id = journal.storage_id,
+            .write_lane_count = lane_count,
+            .copy_buffer_size = copy_buffer_size,
+            .verify_content_hashes = verify_hashes,
+            .completed = false,
+            .write_duration_ms = 0.0,
+            .avg_queue_depth = 0.0,
+            .max_queue_depth = 0,
+            .stages = {}
+        };
+        this->report_pending = true;
+        this->stats.NotifyWriteStart();
+        ScopeGuard on_write_end([&]() {
+            this->stats.NotifyWriteEnd();
+        });
+
+        std::vector<ContentWriteEntry> write_entries;
         for(u32 i = 0; i < this->contents.size(); i++) {
             const auto &cnt = this->contents.at(i);
             const auto content_file_idx = content_file_idxs.at(i);
-            const auto content_file_size = this->pfs0_file.GetFileSize(content_file_idx);
+            const auto content_file_size = this->pkg_fs->GetFileSize(content_file_idx);
+
+            // NCZs are written decompressed, thus their placeholders have the actual NCA size
+            const bool content_compressed = content_compressed_flags.at(i);
+            u64 content_size = content_file_size;
+            if(content_compressed) {
+                ncmContentInfoSizeToU64(&cnt, &content_size);
+            }
 
             NcmPlaceHolderId placehld_id = {};
             memcpy(placehld_id.uuid.uuid, cnt.content_id.c, sizeof(placehld_id.uuid.uuid));
             content_placehld_ids.push_back(placehld_id);
-            const auto cnt_id = write_ctx.RegisterContent(static_cast<NcmContentType>(cnt.content_type), placehld_id, content_file_size);
-            content_write_idxs.push_back(cnt_id);
-            ncmContentStorageDeletePlaceHolder(&this->cnt_storage, &placehld_id);
-            GLEAF_RC_TRY(ncmContentStorageCreatePlaceHolder(&this->cnt_storage, &cnt.content_id, &placehld_id, content_file_size));
-        }
 
-        write_ctx.NotifyStart(on_start_write_fn);
+            // The meta content isn't listed (nor hashed) in its own CNMT, hence there's nothing to verify it against
+            const auto expected_hash = verify_hashes ? FindPackagedContentHash(this->packaged_cnt_meta, cnt.content_id) : nullptr;
 
-        Thread cnt_write_thread;
-        GLEAF_RC_TRY(threadCreate(&cnt_write_thread, ContentWriteMain, reinterpret_cast<void*>(&write_ctx), nullptr, 1_MB, 0x1F, -2));
-        GLEAF_RC_TRY(threadStart(&cnt_write_thread));
-
-        for(u32 i = 0; i < this->contents.size(); i++) {
-            const auto &cnt = this->contents.at(i);
-            const auto content_file_idx = content_file_idxs.at(i);
-            const auto content_file_name = this->pfs0_file.GetFile(content_file_idx);
-            const auto content_file_size = this->pfs0_file.GetFileSize(content_file_idx);
-            const auto content_write_id = content_write_idxs.at(i);
-
-            u64 cur_written_size = 0;
-            auto rem_size = content_file_size;
-            const auto content_path = GLEAF_PATH_NAND_INSTALL_TEMP_DIR "/" + content_file_name;
-            switch(cnt.content_type) {
-                case NcmContentType_Meta:
-                case NcmContentType_Control: {
-                    nand_sys_explorer->StartFile(content_path, fs::FileMode::Read);
-                    break;
+            // Staged contents were already fully written (and hashed) to their placeholders while preparing the installation
+            u64 start_offset = content_size;
+            u64 read_offset = content_file_size;
+            const auto staged_cnt = this->FindStagedContent(cnt.content_id);
+            if(staged_cnt != nullptr) {
+                if(expected_hash != nullptr) {
+                    GLEAF_RC_UNLESS(memcmp(staged_cnt->hash, expected_hash, SHA256_HASH_SIZE) == 0, rc::goldleaf::ResultContentHashMismatch);
                 }
-                default: {
-                    pfs0_file.GetExplorer()->StartFile(pfs0_file.GetPath(), fs::FileMode::Read);
-                    break;
+            }
+            else {
+                GLEAF_RC_UNLESS(this->ReserveContent(cnt.content_id), rc::goldleaf::ResultContentReservedByOtherJob);
+                // Compressed data can't be resumed from an arbitrary NCA offset, those are always written from the start
+                // Neither can contents being verified, since the already written part can't be read back from the placeholder to hash it
+                start_offset = (can_resume && !content_compressed && (expected_hash == nullptr)) ? GetResumableWrittenSize(*this->cnt_storage, prev_journal, cnt.content_id, placehld_id, content_size) : 0;
+                read_offset = start_offset;
+                if(start_offset > 0) {
+                    GLEAF_LOG_FMT("Resuming content %s at 0x%lX/0x%lX", util::FormatContentId(cnt.content_id).c_str(), start_offset, content_size);
+                }
+                else {
+                    this->cnt_storage->DeletePlaceHolder(placehld_id);
+                    GLEAF_RC_TRY(this->cnt_storage->CreatePlaceHolder(cnt.content_id, placehld_id, content_size));
                 }
             }
 
-            while(rem_size) {
-                const auto last_rc = write_ctx.GetLastResult();
-                if(R_FAILED(last_rc)) {
-                    GLEAF_RC_TRY(threadWaitForExit(&cnt_write_thread));
-                    GLEAF_RC_TRY(threadClose(&cnt_write_thread));
-                    GLEAF_RC_TRY(last_rc);
-                }
+            write_entries.push_back({
+                .type = static_cast<NcmContentType>(cnt.content_type),
+                .placehld_id = placehld_id,
+                .size = content_size,
+                .written_size = start_offset,
+                .read_offset = read_offset,
+                .read_size = content_file_size,
+                .compressed = content_compressed,
+                .expected_hash = (staged_cnt == nullptr) ? expected_hash : nullptr
+            });
+            journal.contents.push_back({
+                .content_id = util::FormatContentId(cnt.content_id),
+                .size = content_size,
+                .written_size = start_offset
+            });
+        }
+        SaveInstallJournal(journal);
 
-                const auto read_size = std::min(rem_size, g_Settings.json_settings.installs.value().copy_buffer_max_size.value());
-                auto read_buf = fs::AllocateWorkBuffer(read_size);
-                u64 tmp_read_size = 0;
-                switch(cnt.content_type) {
-                    case NcmContentType_Meta:
-                    case NcmContentType_Control: {
-                        tmp_read_size = nand_sys_explorer->ReadFile(content_path, cur_written_size, read_size, read_buf);
-                        break;
-                    }
-                    default: {
-                        tmp_read_size = pfs0_file.ReadFromFile(content_file_idx, cur_written_size, read_size, read_buf);
-                        break;
-                    }
+        PackageContentReader reader(*this->pkg_fs, content_file_idxs, this->storage_id, copy_buffer_size);
+        const ContentWriteOptions write_opts = {
+            .storage_id = this->storage_id,
+            .lane_count = lane_count,
+            .buffer_size = copy_buffer_size,
+            .on_start_write_fn = on_start_write_fn,
+            .on_content_write_fn = on_content_write_fn,
+            .on_content_commit_fn = [&](const std::vector<u64> &committed_sizes) {
+                for(u32 i = 0; i < committed_sizes.size(); i++) {
+                    journal.contents.at(i).written_size = committed_sizes.at(i);
                 }
-                write_ctx.EmplaceBuffer(content_write_id, read_buf, read_size);
+                SaveInstallJournal(journal);
+            },
+            .on_read_done_fn = on_read_done_fn
+        };
 
-                cur_written_size += tmp_read_size;
-                rem_size -= tmp_read_size;
+        u32 mismatch_cnt_idx = 0;
+        const auto write_rc = nsp::WriteContents(this->svcs, *this->cnt_storage, write_entries, reader, write_opts, this->stats, mismatch_cnt_idx);
+        this->report.copy_buffer_size = reader.GetTunedChunkSize();
+        if(write_rc == rc::goldleaf::ResultContentHashMismatch) {
+            GLEAF_WARN_FMT("Hash mismatch for content %s", util::FormatContentId(this->contents.at(mismatch_cnt_idx).content_id).c_str());
 
-                write_ctx.NotifyUpdateProgress();
-            }
-            switch(cnt.content_type) {
-                case NcmContentType_Meta:
-                case NcmContentType_Control: {
-                    nand_sys_explorer->EndFile();
-                    break;
-                }
-                default: {
-                    pfs0_file.GetExplorer()->EndFile();
-                    break;
-                }
-            }
-            total_written_size += cur_written_size;
+            // Don't let a retry resume from the corrupted data
+            this->cnt_storage->DeletePlaceHolder(content_placehld_ids.at(mismatch_cnt_idx));
+            DeleteInstallJournal();
         }
-
-        write_ctx.SignalDone();
-        GLEAF_RC_TRY(threadWaitForExit(&cnt_write_thread));
-        GLEAF_RC_TRY(threadClose(&cnt_write_thread));
-        write_ctx.NotifyUpdateProgress();
+        GLEAF_RC_TRY(write_rc);
 
         for(u32 i = 0; i < this->contents.size(); i++) {
             const auto &cnt = this->contents.at(i);
             const auto content_placehld_id = content_placehld_ids.at(i);
 
-            GLEAF_RC_TRY(ncmContentStorageRegister(&this->cnt_storage, &cnt.content_id, &content_placehld_id));
-            ncmContentStorageDeletePlaceHolder(&this->cnt_storage, &content_placehld_id);
+            const auto register_start_tick = armGetSystemTick();
+            GLEAF_RC_TRY(this->cnt_storage->Register(cnt.content_id, content_placehld_id));
+            this->cnt_storage->DeletePlaceHolder(content_placehld_id);
+            this->stats.Record(InstallStage::Register, 0, armGetSystemTick() - register_start_tick);
         }
+        DeleteInstallJournal();
 
         GLEAF_RC_SUCCEED;
     }
 
     void Installer::FinalizeInstallation() {
-        ncmContentStorageClose(&this->cnt_storage);
-        ncmContentMetaDatabaseClose(&this->cnt_meta_db);
+        if(this->report_pending) {
+            this->stats.FillReport(this->report);
+            SaveInstallReport(this->report);
+            this->report_pending = false;
+        }
+
+        // Registered contents no longer have their placeholders, this only cleans up after failed/cancelled installations
+        if(this->cnt_storage) {
+            for(const auto &staged_cnt: this->staged_cnts) {
+                this->cnt_storage->DeletePlaceHolder(staged_cnt.placehld_id);
+            }
+        }
+        this->staged_cnts.clear();
+        this->ReleaseContents();
 
-        auto nand_sys_explorer = fs::GetNANDSystemExplorer();
-        nand_sys_explorer->DeleteDirectory(GLEAF_PATH_NAND_INSTALL_TEMP_DIR);
+        this->cnt_storage.reset();
+        this->cnt_meta_db.reset();
     }
 
 }
@@ -0,0 +1,318 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <nsp/nsp_NczDecoder.hpp>
+#include <fs/fs_Common.hpp>
+
+namespace nsp {
+
+    namespace {
+
+        constexpr size_t OutputBufferSize = 1_MB;
+
+        constexpr u8 MinBlockSizeExponent = 14;
+        constexpr u8 MaxBlockSizeExponent = 32;
+
+        enum class NczCryptoType : u64 {
+            None = 1,
+            Xts = 2,
+            Ctr = 3,
+            Bktr = 4
+        };
+
+    }
+
+    NczDecoder::NczDecoder(const u64 nca_size, NczOutputFunction output_fn) : nca_size(nca_size), output_fn(output_fn), state(State::NcaHeader), header_buf(), header_target_size(0), sections(), frame_done(true), block_mode(false), block_size(0), block_data_size(0), block_sizes(), cur_block_idx(0), cur_block_rem_size(0), cur_block_stored(false), out_buf_offset(0), nca_offset(0) {
+        this->dctx = ZSTD_createDCtx();
+        this->out_buf = fs::AllocateWorkBuffer(OutputBufferSize);
+    }
+
+    NczDecoder::~NczDecoder() {
+        ZSTD_freeDCtx(this->dctx);
+        fs::DeleteWorkBuffer(this->out_buf);
+    }
+
+    bool NczDecoder::FillHeader(const u8 *&in_buf, size_t &in_size) {
+        const auto copy_size = std::min(in_size, this->header_target_size - this->header_buf.size());
+        this->header_buf.insert(this->header_buf.end(), in_buf, in_buf + copy_size);
+        in_buf += copy_size;
+        in_size -= copy_size;
+        return this->header_buf.size() == this->header_target_size;
+    }
+
+    Result NczDecoder::ParseSections() {
+        const auto sections_data = reinterpret_cast<const NczSection*>(this->header_buf.data() + sizeof(NczSectionHeader));
+        const auto section_count = (this->header_buf.size() - sizeof(NczSectionHeader)) / sizeof(NczSection);
+        for(u32 i = 0; i < section_count; i++) {
+            const auto &section = sections_data[i];
+            const auto crypto_type = static_cast<NczCryptoType>(section.crypto_type);
+            GLEAF_RC_UNLESS((crypto_type == NczCryptoType::None) || (crypto_type == NczCryptoType::Ctr) || (crypto_type == NczCryptoType::Bktr), rc::goldleaf::ResultInvalidNcz);
+
+            auto &section_crypto = this->sections.emplace_back();
+            section_crypto.section = section;
+            aes128CtrContextCreate(&section_crypto.aes_ctx, section.crypto_key, section.crypto_counter);
+        }
+        GLEAF_RC_SUCCEED;
+    }
+
+    void NczDecoder::StartBlock() {
+        const auto block_offset = static_cast<u64>(this->cur_block_idx) * this->block_size;
+        this->cur_block_rem_size = this->block_sizes.at(this->cur_block_idx);
+
+        // Blocks which wouldn't get any smaller are stored uncompressed
+        const auto block_decompressed_size = std::min(this->block_size, this->block_data_size - block_offset);
+        this->cur_block_stored = this->cur_block_rem_size >= block_decompressed_size;
+        if(!this->cur_block_stored) {
+            ZSTD_DCtx_reset(this->dctx, ZSTD_reset_session_only);
+        }
+        this->frame_done = this->cur_block_stored;
+    }
+
+    Result NczDecoder::DecompressData(const u8 *in_buf, const size_t in_size) {
+        ZSTD_inBuffer in = { in_buf, in_size, 0 };
+        while(true) {
+            ZSTD_outBuffer out = { this->out_buf + this->out_buf_offset, OutputBufferSize - this->out_buf_offset, 0 };
+            const auto ret = ZSTD_decompressStream(this->dctx, &out, &in);
+            if(ZSTD_isError(ret)) {
+                GLEAF_WARN_FMT("NCZ zstd error: %s", ZSTD_getErrorName(ret));
+                return rc::goldleaf::ResultInvalidNcz;
+            }
+            this->frame_done = ret == 0;
+            this->out_buf_offset += out.pos;
+
+            const auto out_full = this->out_buf_offset == OutputBufferSize;
+            if(out_full) {
+                GLEAF_RC_TRY(this->FlushOutput());
+            }
+
+            // zstd might still have some output pending if the buffer got filled, even if all the input was consumed (unless the frame is already done)
+            if((in.pos == in.size) && (!out_full || this->frame_done)) {
+                break;
+            }
+        }
+        GLEAF_RC_SUCCEED;
+    }
+
+    Result NczDecoder::CopyData(const u8 *in_buf, const size_t in_size) {
+        size_t offset = 0;
+        while(offset < in_size) {
+            const auto copy_size = std::min(in_size - offset, OutputBufferSize - this->out_buf_offset);
+            memcpy(this->out_buf + this->out_buf_offset, in_buf + offset, copy_size);
+            this->out_buf_offset += copy_size;
+            offset += copy_size;
+
+            if(this->out_buf_offset == OutputBufferSize) {
+                GLEAF_RC_TRY(this->FlushOutput());
+            }
+        }
+        GLEAF_RC_SUCCEED;
+    }
+
+    Result NczDecoder::ProcessData(const u8 *in_buf, size_t in_size) {
+        if(!this->block_mode) {
+            // A single zstd stream follows
+            return this->DecompressData(in_buf, in_size);
+        }
+
+        // Every block is an independent zstd frame (or raw data), so each one is fed separately
+        while(in_size > 0) {
+            GLEAF_RC_UNLESS(this->cur_block_idx < this->block_sizes.size(), rc::goldleaf::ResultInvalidNcz);
+
+            const auto block_part_size = std::min<u64>(in_size, this->cur_block_rem_size);
+            if(this->cur_block_stored) {
+                GLEAF_RC_TRY(this->CopyData(in_buf, block_part_size));
+            }
+            else {
+                GLEAF_RC_TRY(this->DecompressData(in_buf, block_part_size));
+            }
+            in_buf += block_part_size;
+            in_size -= block_part_size;
+            this->cur_block_rem_size -= block_part_size;
+
+            if(this->cur_block_rem_size == 0) {
+                GLEAF_RC_UNLESS(this->frame_done, rc::goldleaf::ResultInvalidNcz);
+                this->cur_block_idx++;
+                if(this->cur_block_idx < this->block_sizes.size()) {
+                    this->StartBlock();
+                }
+            }
+        }
+        GLEAF_RC_SUCCEED;
+    }
+
+    void NczDecoder::EncryptData(u8 *buf, const size_t size, const u64 offset) {
+        // Sections were stored decrypted, thus they are encrypted back with their AES-CTR keys (data outside any section is kept as-is)
+        for(auto &section_crypto: this->sections) {
+            const auto &section = section_crypto.section;
+            if(static_cast<NczCryptoType>(section.crypto_type) == NczCryptoType::None) {
+                continue;
+            }
+
+            const auto start_offset = std::max(offset, section.offset);
+            const auto end_offset = std::min(offset + size, section.offset + section.size);
+            if(start_offset >= end_offset) {
+                continue;
+            }
+
+            u8 ctr[0x10] = {};
+            memcpy(ctr, section.crypto_counter, 8);
+            const auto ctr_offset = start_offset >> 4;
+            for(u32 i = 0; i < 8; i++) {
+                ctr[0x10 - i - 1] = static_cast<u8>(ctr_offset >> (i * 8));
+            }
+            aes128CtrContextResetCtr(&section_crypto.aes_ctx, ctr);
+
+            // Skip the keystream bytes before the actual offset within the first AES block
+            const auto block_offset = start_offset & 0xF;
+            if(block_offset > 0) {
+                u8 dummy[0x10] = {};
+                aes128CtrCrypt(&section_crypto.aes_ctx, dummy, dummy, block_offset);
+            }
+
+            auto section_buf = buf + (start_offset - offset);
+            aes128CtrCrypt(&section_crypto.aes_ctx, section_buf, section_buf, end_offset - start_offset);
+        }
+    }
+
+    Result NczDecoder::FlushOutput() {
+        if(this->out_buf_offset == 0) {
+            GLEAF_RC_SUCCEED;
+        }
+
+        GLEAF_RC_UNLESS((this->nca_offset + this->out_buf_offset) <= this->nca_size, rc::goldleaf::ResultInvalidNcz);
+        this->EncryptData(this->out_buf, this->out_buf_offset, this->nca_offset);
+        GLEAF_RC_TRY(this->output_fn(this->out_buf, this->out_buf_offset));
+
+        this->nca_offset += this->out_buf_offset;
+        this->out_buf_offset = 0;
+        GLEAF_RC_SUCCEED;
+    }
+
+    Result NczDecoder::Feed(const u8 *in_buf, size_t in_size) {
+        while(in_size > 0) {
+            switch(this->state) {
+                case State::NcaHeader: {
+                    // The header is kept encrypted, so it's just passed through
+                    const auto header_part_size = std::min<u64>(in_size, NczNcaHeaderSize - this->nca_offset);
+                    GLEAF_RC_UNLESS((this->nca_offset + header_part_size) <= this->nca_size, rc::goldleaf::ResultInvalidNcz);
+                    GLEAF_RC_TRY(this->output_fn(in_buf, header_part_size));
+                    this->nca_offset += header_part_size;
+                    in_buf += header_part_size;
+                    in_size -= header_part_size;
+
+                    if(this->nca_offset == NczNcaHeaderSize) {
+                        this->state = State::SectionHeader;
+                        this->header_target_size = sizeof(NczSectionHeader);
+                    }
+                    break;
+                }
+                case State::SectionHeader: {
+                    if(this->FillHeader(in_buf, in_size)) {
+                        const auto section_header = reinterpret_cast<const NczSectionHeader*>(this->header_buf.data());
+                        GLEAF_RC_UNLESS(section_header->magic == NczSectionHeaderMagic, rc::goldleaf::ResultInvalidNcz);
+                        GLEAF_RC_UNLESS(section_header->section_count <= NczMaxSectionCount, rc::goldleaf::ResultInvalidNcz);
+
+                        this->state = State::Sections;
+                        this->header_target_size += section_header->section_count * sizeof(NczSection);
+                    }
+                    break;
+                }
+                case State::Sections: {
+                    if(this->FillHeader(in_buf, in_size)) {
+                        GLEAF_RC_TRY(this->ParseSections());
+
+                        this->state = State::BlockHeaderMagic;
+                        this->header_buf.clear();
+                        this->header_target_size = sizeof(u64);
+                    }
+                    break;
+                }
+                case State::BlockHeaderMagic: {
+                    if(this->FillHeader(in_buf, in_size)) {
+                        if(*reinterpret_cast<const u64*>(this->header_buf.data()) == NczBlockHeaderMagic) {
+                            this->state = State::BlockHeader;
+                            this->header_target_size = sizeof(NczBlockHeader);
+                        }
+                        else {
+                            // No block header, these are already the first bytes of the zstd stream
+                            this->state = State::Data;
+                            this->frame_done = false;
+                            const auto stream_start = this->header_buf;
+                            this->header_buf.clear();
+                            GLEAF_RC_TRY(this->ProcessData(stream_start.data(), stream_start.size()));
+                        }
+                    }
+                    break;
+                }
+                case State::BlockHeader: {
+                    if(this->FillHeader(in_buf, in_size)) {
+                        const auto block_header = reinterpret_cast<const NczBlockHeader*>(this->header_buf.data());
+                        GLEAF_RC_UNLESS((block_header->block_size_exponent >= MinBlockSizeExponent) && (block_header->block_size_exponent <= MaxBlockSizeExponent), rc::goldleaf::ResultInvalidNcz);
+                        GLEAF_RC_UNLESS(block_header->block_count > 0, rc::goldleaf::ResultInvalidNcz);
+                        this->block_size = 1ul << block_header->block_size_exponent;
+                        this->block_data_size = block_header->decompressed_size;
+                        GLEAF_RC_UNLESS(this->block_data_size <= this->nca_size, rc::goldleaf::ResultInvalidNcz);
+                        GLEAF_RC_UNLESS(((this->block_data_size + this->block_size - 1) / this->block_size) == block_header->block_count, rc::goldleaf::ResultInvalidNcz);
+
+                        this->state = State::BlockSizes;
+                        this->header_target_size += block_header->block_count * sizeof(u32);
+                    }
+                    break;
+                }
+                case State::BlockSizes: {
+                    if(this->FillHeader(in_buf, in_size)) {
+                        const auto block_sizes_data = reinterpret_cast<const u32*>(this->header_buf.data() + sizeof(NczBlockHeader));
+                        const auto block_count = (this->header_buf.size() - sizeof(NczBlockHeader)) / sizeof(u32);
+                        this->block_sizes.assign(block_sizes_data, block_sizes_data + block_count);
+                        this->header_buf.clear();
+
+                        this->state = State::Data;
+                        this->block_mode = true;
+                        this->cur_block_idx = 0;
+                        this->StartBlock();
+                    }
+                    break;
+                }
+                case State::Data: {
+                    GLEAF_RC_TRY(this->ProcessData(in_buf, in_size));
+                    in_size = 0;
+                    break;
+                }
+            }
+        }
+
+        // Don't hold decoded data until the buffer is full, the output may be waiting for it
+        return this->FlushOutput();
+    }
+
+    Result NczDecoder::Finish() {
+        GLEAF_RC_UNLESS(this->state == State::Data, rc::goldleaf::ResultInvalidNcz);
+        GLEAF_RC_UNLESS(this->frame_done, rc::goldleaf::ResultInvalidNcz);
+        if(this->block_mode) {
+            GLEAF_RC_UNLESS(this->cur_block_idx == this->block_sizes.size(), rc::goldleaf::ResultInvalidNcz);
+        }
+
+        GLEAF_RC_TRY(this->FlushOutput());
+        GLEAF_RC_UNLESS(this->nca_offset == this->nca_size, rc::goldleaf::ResultInvalidNcz);
+        GLEAF_RC_SUCCEED;
+    }
+
+}
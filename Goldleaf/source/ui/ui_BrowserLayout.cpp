@@ -39,6 +39,14 @@ namespace ui {
             return !path.empty() && (path[0] == '.');
         }
 
+        std::string FormatHash(const fs::FileHash &hash, const fs::HashAlgorithm algo) {
+            std::stringstream strm;
+            for(u32 i = 0; i < fs::GetHashSize(algo); i++) {
+                strm << std::setw(2) << std::setfill('0') << std::hex << static_cast<u32>(hash[i]);
+            }
+            return strm.str();
+        }
+
     }
 
     void BrowserLayout::OnInput(const u64 keys_down, const u64 keys_up, const u64 keys_held, const pu::ui::TouchPoint touch_pos) {
@@ -103,7 +111,7 @@ namespace ui {
         const auto item_size = this->cur_exp->GetFileSize(full_item);
         std::string icon_path = "";
         auto msg = cfg::Strings.GetString(52) + " ";
-        if(ext == "nsp") {
+        if(nsp::IsInstallablePackageExtension(ext)) {
             msg += cfg::Strings.GetString(53);
         }
         else if(ext == "nro") {
@@ -128,10 +136,12 @@ namespace ui {
         msg += "\n\n" + cfg::Strings.GetString(64) + " " + fs::FormatSize(this->cur_exp->GetFileSize(full_item));
         const auto is_bin = this->cur_exp->IsFileBinary(full_item);
         std::vector<std::string> dialog_opts;
-        u32 option_count = 5;
-        if(ext == "nsp") {
+        u32 option_count = 6;
+        if(nsp::IsInstallablePackageExtension(ext)) {
             dialog_opts.push_back(cfg::Strings.GetString(65));
             option_count++;
+            dialog_opts.push_back(cfg::Strings.GetString(546));
+            option_count++;
         }
         else if(ext == "nro") {
             dialog_opts.push_back(cfg::Strings.GetString(66));
@@ -163,31 +173,37 @@ namespace ui {
         dialog_opts.push_back(cfg::Strings.GetString(73));
         dialog_opts.push_back(cfg::Strings.GetString(74));
         dialog_opts.push_back(cfg::Strings.GetString(75));
+        dialog_opts.push_back(cfg::Strings.GetString(550));
         dialog_opts.push_back(cfg::Strings.GetString(18));
         const auto option_1 = g_MainApplication->DisplayDialog(cfg::Strings.GetString(76), msg, dialog_opts, true, pu::sdl2::TextureHandle::New(pu::ui::render::LoadImageFromFile(icon_path)));
         if(option_1 < 0) {
             return;
         }
 
-        if(ext == "nsp") {
+        if(nsp::IsInstallablePackageExtension(ext)) {
             switch(option_1) {
                 case 0: {
                     const auto option_2 = g_MainApplication->DisplayDialog(cfg::Strings.GetString(77), cfg::Strings.GetString(78), { cfg::Strings.GetString(19), cfg::Strings.GetString(79), cfg::Strings.GetString(18) }, true);
                     if(option_2 < 0) {
                         return;
                     }
+                    // The install layout checks the free space itself, since the installed contents can be bigger than the package
                     const auto dst = (option_2 == 0) ? NcmStorageId_SdCard : NcmStorageId_BuiltInUser;
-                    const auto file_size = this->cur_exp->GetFileSize(full_item);
-                    const auto free_space = fs::GetFreeSpaceForPartition(fs::GetPartitionFromStorageId(dst));
-                    if(free_space < file_size) {
-                        HandleResult(rc::goldleaf::ResultNotEnoughSize, cfg::Strings.GetString(251));
-                        return;
-                    }
                     g_MainApplication->ShowLayout(g_MainApplication->GetInstallLayout());
                     g_MainApplication->GetInstallLayout()->StartInstall(full_item, pres_full_item, this->cur_exp, dst);
                     this->ResetMenuHead();
                     break;
                 }
+                case 1: {
+                    if(this->CheckWriteAccess()) {
+                        // Next to the package, in a directory named after it
+                        const auto out_dir = this->cur_exp->FullPathFor(fs::GetFileName(item));
+                        g_MainApplication->ShowLayout(g_MainApplication->GetCopyLayout());
+                        g_MainApplication->GetCopyLayout()->StartExtract(full_item, out_dir);
+                        this->UpdateElements(this->browse_menu->GetSelectedIndex());
+                    }
+                    break;
+                }
             }
         }
         else if(ext == "nro") {
@@ -429,10 +445,11 @@ namespace ui {
             }
         }
 
-        const auto view_option = option_count - 5;
-        const auto copy_option = option_count - 4;
-        const auto delete_option = option_count - 3;
-        const auto rename_option = option_count - 2;
+        const auto view_option = option_count - 6;
+        const auto copy_option = option_count - 5;
+        const auto delete_option = option_count - 4;
+        const auto rename_option = option_count - 3;
+        const auto hash_option = option_count - 2;
         if(option_1 == static_cast<s32>(view_option)) {
             if(item_size == 0) {
                 g_MainApplication->ShowNotification(cfg::Strings.GetString(481));
@@ -467,6 +484,17 @@ namespace ui {
                 }
             }
         }
+        else if(option_1 == static_cast<s32>(hash_option)) {
+            // Remote PC files are hashed by Quark itself, the rest are read and hashed here
+            fs::FileHash hash;
+            g_MainApplication->ShowLayout(g_MainApplication->GetCopyLayout());
+            if(g_MainApplication->GetCopyLayout()->StartHash(full_item, hash)) {
+                g_MainApplication->DisplayDialog(cfg::Strings.GetString(551), pres_full_item + "\n\n" + FormatHash(hash, fs::HashAlgorithm::Sha256), { cfg::Strings.GetString(234) }, true);
+            }
+            else {
+                g_MainApplication->ShowNotification(cfg::Strings.GetString(552));
+            }
+        }
     }
 
     void BrowserLayout::OnDirectorySelected(const std::string &item, const std::string &full_item, const std::string &pres_full_item) {
@@ -484,7 +512,7 @@ namespace ui {
 
             const auto path = full_item + "/" + file;
             const auto ext = LowerCaseString(fs::GetExtension(path));
-            if(ext == "nsp") {
+            if(nsp::IsInstallablePackageExtension(ext)) {
                 nsps.push_back(file);
             }
         }
@@ -495,8 +523,8 @@ namespace ui {
         extra_options.push_back(cfg::Strings.GetString(18));
 
         auto msg = cfg::Strings.GetString(134);
-        if(g_Settings.json_settings.fs.value().compute_directory_sizes.value()) {
-            // This can be pretty slow, so only do it if the user wants it
+        if(g_Settings.json_settings.fs.value().compute_directory_sizes.value() || this->cur_exp->IsDirectorySizeFast()) {
+            // This can be pretty slow, so only do it if the user wants it (or if it's computed elsewhere, like a PC)
             msg += "\n\n" + cfg::Strings.GetString(237) + " " + fs::FormatSize(this->cur_exp->GetDirectorySize(full_item));
         }
         const auto option_1 = g_MainApplication->DisplayDialog(cfg::Strings.GetString(135), msg, { cfg::Strings.GetString(415), cfg::Strings.GetString(73), cfg::Strings.GetString(74), cfg::Strings.GetString(75), cfg::Strings.GetString(280), cfg::Strings.GetString(18) }, true);
@@ -610,24 +638,14 @@ namespace ui {
                         // }
                         // const bool scan_subdirectories = (scan_subdirs == 0);
 
-                        bool any_installed = false;
+                        nsp::BatchInstaller batch_installer(this->cur_exp, dst);
                         for(const auto &nsp_name: nsps) {
-                            const auto nsp_path = full_item + "/" + nsp_name;
-                            const auto pres_nsp_path = pres_full_item + "/" + nsp_name;
-                            
-                            const auto file_size = this->cur_exp->GetFileSize(nsp_path);
-                            const auto free_space = fs::GetFreeSpaceForPartition(fs::GetPartitionFromStorageId(dst));
-                            if(free_space < file_size) {
-                                HandleResult(rc::goldleaf::ResultNotEnoughSize, cfg::Strings.GetString(251));
-                                return;
-                            }
-                            g_MainApplication->ShowLayout(g_MainApplication->GetInstallLayout());
-                            const auto installed = g_MainApplication->GetInstallLayout()->StartInstall(nsp_path, pres_nsp_path, this->cur_exp, dst, true, skip_if_installed);
-                            if(installed) {
-                                any_installed = true;
-                            }
+                            batch_installer.PushJob(full_item + "/" + nsp_name, pres_full_item + "/" + nsp_name);
                         }
 
+                        g_MainApplication->ShowLayout(g_MainApplication->GetInstallLayout());
+                        const auto any_installed = g_MainApplication->GetInstallLayout()->StartBatchInstall(batch_installer, skip_if_installed);
+
                         if(!any_installed) {
                             g_MainApplication->ShowNotification(cfg::Strings.GetString(530));
                         }
@@ -22,6 +22,7 @@
 #include <ui/ui_ContentExportLayout.hpp>
 #include <ui/ui_MainApplication.hpp>
 #include <expt/expt_Export.hpp>
+#include <es/es_CommonCertificate.hpp>
 
 extern ui::MainApplication::Ref g_MainApplication;
 extern cfg::Settings g_Settings;
@@ -70,13 +71,6 @@ namespace ui {
         this->Add(this->speed_info_text);
         
         auto sd_exp = fs::GetSdCardExplorer();
-        const auto out_dir = sd_exp->MakeAbsolute(GLEAF_PATH_EXPORT_TITLE_DIR "/" + format_app_id);
-        sd_exp->CreateDirectory(out_dir);
-        this->speed_info_text->SetText(cfg::Strings.GetString(192));
-        g_MainApplication->CallForRender();
-        if(has_tik) {
-            expt::ExportTicketCert(cnt_status.application_id, true);
-        }
         this->speed_info_text->SetText(cfg::Strings.GetString(193));
         g_MainApplication->CallForRender();
     
@@ -116,6 +110,48 @@ namespace ui {
             return;
         }
 
+        auto out_nsp = sd_exp->MakeAbsolute(GLEAF_PATH_EXPORT_TITLE_DIR "/");
+        u32 max_version = 0;
+        for(const auto &status: app.meta_status_list) {
+            if(status.version > max_version) {
+                max_version = status.version;
+            }
+        }
+        out_nsp += SanitizeExportName(app.cache.display_name) + " [" + format_app_id + "] [v" + std::to_string(max_version) + "].nsp";
+
+        // Every file size is known beforehand, so contents are streamed straight into the NSP (no NCA copies to pack afterwards)
+        nsp::PackageBuilder builder(out_nsp);
+        std::vector<u64> cnt_sizes;
+        u64 cnt_total_size = 0;
+        for(const auto &[cnt_is_meta, cnt_id] : export_cnts) {
+            s64 cnt_size = 0;
+            rc = ncmContentStorageGetSizeFromContentId(&cnt_storage, &cnt_size, &cnt_id);
+            if(R_FAILED(rc)) {
+                HandleResult(rc::goldleaf::ResultUnableToLocateContents, cfg::Strings.GetString(198));
+                return;
+            }
+            const auto cnt_name = util::FormatContentId(cnt_id) + (cnt_is_meta ? ".cnmt" : "") + ".nca";
+            builder.AddFile(cnt_name, cnt_size);
+            cnt_sizes.push_back(cnt_size);
+            cnt_total_size += cnt_size;
+        }
+
+        std::vector<u8> tik_data;
+        if(has_tik) {
+            this->speed_info_text->SetText(cfg::Strings.GetString(192));
+            g_MainApplication->CallForRender();
+            const auto tik_file = expt::ReadTicket(cnt_status.application_id);
+            tik_data = cnt::SerializeTicket(tik_file);
+            const auto fmt_rights_id = expt::FormatRightsId(tik_file);
+            builder.AddFile(fmt_rights_id + ".tik", tik_data.size());
+            builder.AddFile(fmt_rights_id + ".cert", es::CommonCertificateSize);
+        }
+
+        if(fs::GetFreeSpaceForPartition(fs::Partition::SdCard) < builder.GetTotalSize()) {
+            HandleResult(rc::goldleaf::ResultNotEnoughSize, cfg::Strings.GetString(198));
+            return;
+        }
+
         u32 cur_y = this->speed_info_text->GetY() + this->speed_info_text->GetHeight() + 35;
 
         constexpr auto cnts_per_column = 4;
@@ -141,6 +177,8 @@ namespace ui {
             auto p_bar = pu::ui::elm::ProgressBar::New(cur_x, cur_y, p_bar_width, 30, 0.0f);
             p_bar->SetProgressColor(g_Settings.GetColorScheme().progress_bar);
             p_bar->SetBackgroundColor(g_Settings.GetColorScheme().progress_bar_bg);
+            // The NSP bar only tracks the contents, the rest of it (header, ticket and certificate) is tiny in comparison
+            p_bar->SetMaxProgress((i < export_cnts.size()) ? cnt_sizes.at(i) : cnt_total_size);
             cur_y += p_bar->GetHeight() + 20;
 
             this->content_info_texts.push_back(info_text);
@@ -157,108 +195,46 @@ namespace ui {
         }
 
         hos::LockExit();
+        fs::CreateConcatenationFile(out_nsp);
+        rc = builder.Start();
+        const auto nsp_i = export_cnts.size();
         auto last_tp = std::chrono::steady_clock::now();
-        if(cnt_storage_id == NcmStorageId_SdCard) {
-            u32 i = 0;
-            for(const auto &[cnt_is_meta, cnt_id] : export_cnts) {
-                const auto cnt_name = util::FormatContentId(cnt_id) + (cnt_is_meta ? ".cnmt" : "") + ".nca";
-                const auto out_cnt_path = out_dir + "/" + cnt_name;
-                fs::CreateConcatenationFile(out_cnt_path);
-                const auto rc = expt::DecryptCopyNax0ToNca(&cnt_storage, cnt_id, out_cnt_path, [&](const double file_size) {
-                    this->content_p_bars.at(i)->SetMaxProgress(file_size);
-                }, [&](const double cur_rw_size) {
-                    const auto cur_tp = std::chrono::steady_clock::now();
-                    const auto time_diff = (double)std::chrono::duration_cast<std::chrono::milliseconds>(cur_tp - last_tp).count();
-                    last_tp = cur_tp;
-
-                    const auto speed_bps = (1000.0f / time_diff) * cur_rw_size;
-                    const auto speed_text =  cfg::Strings.GetString(458) + ": " + fs::FormatSize(speed_bps) + "/s, " + cfg::Strings.GetString(459) + ": " + util::FormatTime((u64)((1.0f / speed_bps) * (this->content_p_bars.at(i)->GetMaxProgress() - this->content_p_bars.at(i)->GetProgress())));
-                    this->speed_info_text->SetText(speed_text);
-
-                    this->content_p_bars.at(i)->IncrementProgress(cur_rw_size);
-                    g_MainApplication->CallForRender();
-                });
-                if(R_FAILED(rc)) {
-                    HandleResult(rc, cfg::Strings.GetString(198));
-                    return;
-                }
-                i++;
-            }
+        for(u32 i = 0; R_SUCCEEDED(rc) && (i < export_cnts.size()); i++) {
+            rc = expt::StreamContent(&cnt_storage, cnt_storage_id, export_cnts.at(i).second, fs::StorageKind::SdCard, [&](const void *buf, const size_t size) {
+                return builder.Write(buf, size);
+            }, [&](const double cur_rw_size) {
+                const auto cur_tp = std::chrono::steady_clock::now();
+                const auto time_diff = (double)std::chrono::duration_cast<std::chrono::milliseconds>(cur_tp - last_tp).count();
+                last_tp = cur_tp;
+
+                const auto speed_bps = (1000.0f / time_diff) * cur_rw_size;
+                const auto speed_text =  cfg::Strings.GetString(458) + ": " + fs::FormatSize(speed_bps) + "/s, " + cfg::Strings.GetString(459) + ": " + util::FormatTime((u64)((1.0f / speed_bps) * (this->content_p_bars.at(nsp_i)->GetMaxProgress() - this->content_p_bars.at(nsp_i)->GetProgress())));
+                this->speed_info_text->SetText(speed_text);
+
+                this->content_p_bars.at(i)->IncrementProgress(cur_rw_size);
+                this->content_p_bars.at(nsp_i)->IncrementProgress(cur_rw_size);
+                g_MainApplication->CallForRender();
+            });
         }
-        else {
-            fs::Explorer *nand_exp = nullptr;
-            if(cnt_storage_id == NcmStorageId_BuiltInSystem) {
-                nand_exp = fs::GetNANDSystemExplorer();
-            }
-            else if(cnt_storage_id == NcmStorageId_BuiltInUser) {
-                nand_exp = fs::GetNANDUserExplorer();
-            }
-            else {
-                hos::UnlockExit();
-                HandleResult(rc::goldleaf::ResultUnableToLocateContents, cfg::Strings.GetString(198));
-                return;
-            }
-
-            u32 i = 0;
-            for(const auto &[cnt_is_meta, cnt_id] : export_cnts) {
-                const auto cnt_name = util::FormatContentId(cnt_id) + (cnt_is_meta ? ".cnmt" : "") + ".nca";
-                const auto cnt_ncm_path = expt::GetContentIdPath(&cnt_storage, cnt_id);
-                const auto cnt_nand_path = nand_exp->FullPathFor("Contents/" + cnt_ncm_path.substr(__builtin_strlen("@UserContent://")));
-                const auto out_cnt_path = out_dir + "/" + cnt_name;
-                fs::CreateConcatenationFile(out_cnt_path);
-                fs::CopyFileProgress(cnt_nand_path, out_cnt_path, [&](const size_t file_size) {
-                    this->content_p_bars.at(i)->SetMaxProgress(file_size);
-                }, [&](const size_t cur_rw_size) {
-                    const auto cur_tp = std::chrono::steady_clock::now();
-                    const auto time_diff = (double)std::chrono::duration_cast<std::chrono::milliseconds>(cur_tp - last_tp).count();
-                    last_tp = cur_tp;
-
-                    const auto speed_bps = (1000.0f / time_diff) * cur_rw_size;
-                    const auto speed_text =  cfg::Strings.GetString(458) + ": " + fs::FormatSize(speed_bps) + "/s, " + cfg::Strings.GetString(459) + ": " + util::FormatTime((u64)((1.0f / speed_bps) * (this->content_p_bars.at(i)->GetMaxProgress() - this->content_p_bars.at(i)->GetProgress())));
-                    this->speed_info_text->SetText(speed_text);
-
-                    this->content_p_bars.at(i)->IncrementProgress(cur_rw_size);
-                    g_MainApplication->CallForRender();
-                });
-                i++;
+        if(R_SUCCEEDED(rc) && has_tik) {
+            rc = builder.Write(tik_data.data(), tik_data.size());
+            if(R_SUCCEEDED(rc)) {
+                rc = builder.Write(es::CommonCertificateData, es::CommonCertificateSize);
             }
         }
-
-        auto out_nsp = sd_exp->MakeAbsolute(GLEAF_PATH_EXPORT_TITLE_DIR "/");
-        u32 max_version = 0;
-        for(const auto &status: app.meta_status_list) {
-            if(status.version > max_version) {
-                max_version = status.version;
-            }
+        if(R_SUCCEEDED(rc)) {
+            rc = builder.Finish();
+        }
+        if(R_FAILED(rc)) {
+            builder.Abort();
         }
-        out_nsp += SanitizeExportName(app.cache.display_name) + " [" + format_app_id + "] [v" + std::to_string(max_version) + "].nsp";
-
-        fs::CreateConcatenationFile(out_nsp);
-        const auto nsp_i = export_cnts.size();
-        const auto ok = nsp::GenerateFrom(out_dir, out_nsp, [&](const size_t file_size) {
-            this->content_p_bars.at(nsp_i)->SetMaxProgress(file_size);
-        }, [&](const size_t cur_rw_size) {
-            const auto cur_tp = std::chrono::steady_clock::now();
-            const auto time_diff = (double)std::chrono::duration_cast<std::chrono::milliseconds>(cur_tp - last_tp).count();
-            last_tp = cur_tp;
-
-            const auto speed_bps = (1000.0f / time_diff) * cur_rw_size;
-            const auto speed_text =  cfg::Strings.GetString(458) + ": " + fs::FormatSize(speed_bps) + "/s, " + cfg::Strings.GetString(459) + ": " + util::FormatTime((u64)((1.0f / speed_bps) * (this->content_p_bars.at(nsp_i)->GetMaxProgress() - this->content_p_bars.at(nsp_i)->GetProgress())));
-            this->speed_info_text->SetText(speed_text);
-
-            this->content_p_bars.at(nsp_i)->IncrementProgress(cur_rw_size);
-            g_MainApplication->CallForRender();
-        });
         hos::UnlockExit();
-        sd_exp->EmptyDirectory(GLEAF_PATH_EXPORT_TEMP_DIR);
-        sd_exp->DeleteDirectory(out_dir);
-        if(ok) {
+
+        if(R_SUCCEEDED(rc)) {
             g_MainApplication->ShowNotification(cfg::Strings.GetString(197) + " '" + out_nsp + "'");
         }
         else {
-            HandleResult(rc::goldleaf::ResultUnableToBuildNsp, cfg::Strings.GetString(198));
-            sd_exp->EmptyDirectory(GLEAF_PATH_EXPORT_DIR);
-            EnsureDirectories();
+            HandleResult(rc, cfg::Strings.GetString(198));
         }
     }
 
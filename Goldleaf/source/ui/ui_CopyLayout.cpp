@@ -167,4 +167,117 @@ namespace ui {
         }
     }
 
+    void CopyLayout::StartExtract(const std::string &path, const std::string &out_dir) {
+        ScopeGuard on_exit([&]() {
+            g_MainApplication->ReturnToParentLayout();
+        });
+
+        auto exp = fs::GetExplorerForPath(path);
+        auto out_exp = fs::GetExplorerForPath(out_dir);
+        g_MainApplication->LoadCommonIconMenuData(true, cfg::Strings.GetString(546), CommonIconKind::NSP, cfg::Strings.GetString(547));
+
+        if(out_exp->IsDirectory(out_dir)) {
+            const auto option = g_MainApplication->DisplayDialog(cfg::Strings.GetString(135), cfg::Strings.GetString(471), { cfg::Strings.GetString(111), cfg::Strings.GetString(112), cfg::Strings.GetString(18) }, true);
+            if(option == 0) {
+                out_exp->DeleteDirectory(out_dir);
+            }
+            else if(option != 1) {
+                return;
+            }
+        }
+
+        auto pkg_fs = nsp::OpenPackage(exp, path);
+        if((pkg_fs == nullptr) || !pkg_fs->IsOk()) {
+            HandleResult(rc::goldleaf::ResultInvalidNsp, cfg::Strings.GetString(549));
+            return;
+        }
+
+        u64 total_size = 0;
+        for(u32 i = 0; i < pkg_fs->GetCount(); i++) {
+            total_size += pkg_fs->GetFileSize(i);
+        }
+
+        hos::LockExit();
+        this->copy_file_p_bar->SetVisible(true);
+        this->file_info_text->SetVisible(true);
+        this->copy_total_p_bar->SetMaxProgress(total_size);
+        this->copy_total_p_bar->SetProgress(0);
+        this->copy_file_src_info_text->SetText(exp->MakePresentablePath(path));
+
+        // Several files may be written at once, but progress is reported for the one being read
+        auto cur_idx = fs::PartitionFileSystem::InvalidFileIndex;
+        u64 last_total_written_size = 0;
+        auto last_tp = std::chrono::steady_clock::now();
+        const auto rc = pkg_fs->ExtractAll(out_exp, out_dir, [&](const u32 idx, const u64 file_written_size, const u64 total_written_size) {
+            if(idx != cur_idx) {
+                cur_idx = idx;
+                this->copy_file_dst_info_text->SetText(out_exp->MakePresentablePath(out_dir + "/" + pkg_fs->GetFile(idx)));
+                this->copy_file_p_bar->SetMaxProgress(pkg_fs->GetFileSize(idx));
+            }
+            this->copy_file_p_bar->SetProgress(file_written_size);
+            this->copy_total_p_bar->SetProgress(total_written_size);
+
+            const auto cur_tp = std::chrono::steady_clock::now();
+            const auto time_diff = (double)std::chrono::duration_cast<std::chrono::milliseconds>(cur_tp - last_tp).count();
+            if(time_diff > 0) {
+                last_tp = cur_tp;
+                // By elapsed time and written size, compute how much data has been written in 1 second
+                const auto speed_bps = (1000.0f / time_diff) * (double)(total_written_size - last_total_written_size);
+                last_total_written_size = total_written_size;
+                const auto speed_text = cfg::Strings.GetString(458) + ": " + fs::FormatSize(speed_bps) + "/s, " + cfg::Strings.GetString(459) + ": " + util::FormatTime((u64)((1.0f / speed_bps) * (total_size - total_written_size)));
+
+                this->copy_speed_eta_info_text->SetText(speed_text);
+            }
+
+            g_MainApplication->CallForRender();
+        });
+        hos::UnlockExit();
+
+        if(R_SUCCEEDED(rc)) {
+            g_MainApplication->ShowNotification(cfg::Strings.GetString(548));
+        }
+        else {
+            HandleResult(rc, cfg::Strings.GetString(549));
+        }
+    }
+
+    bool CopyLayout::StartHash(const std::string &path, fs::FileHash &out_hash) {
+        ScopeGuard on_exit([&]() {
+            g_MainApplication->ReturnToParentLayout();
+        });
+
+        auto exp = fs::GetExplorerForPath(path);
+        g_MainApplication->LoadCommonIconMenuData(true, cfg::Strings.GetString(550), CommonIconKind::BinaryFile, fs::GetBaseName(path));
+
+        const auto file_size = exp->GetFileSize(path);
+        hos::LockExit();
+        this->copy_file_p_bar->SetVisible(false);
+        this->file_info_text->SetVisible(false);
+        this->copy_total_p_bar->SetMaxProgress(file_size);
+        this->copy_total_p_bar->SetProgress(0);
+        this->copy_file_src_info_text->SetText(exp->MakePresentablePath(path));
+        this->copy_file_dst_info_text->SetText(cfg::Strings.GetString(551));
+        this->copy_speed_eta_info_text->SetText("");
+
+        auto last_tp = std::chrono::steady_clock::now();
+        const auto ok = exp->ComputeHash(path, 0, file_size, fs::HashAlgorithm::Sha256, out_hash, [&](const size_t cur_hashed_size) {
+            this->copy_total_p_bar->IncrementProgress(cur_hashed_size);
+
+            const auto cur_tp = std::chrono::steady_clock::now();
+            const auto time_diff = (double)std::chrono::duration_cast<std::chrono::milliseconds>(cur_tp - last_tp).count();
+            if(time_diff > 0) {
+                last_tp = cur_tp;
+                // By elapsed time and hashed size, compute how much data has been hashed in 1 second
+                const auto speed_bps = (1000.0f / time_diff) * (double)cur_hashed_size;
+                const auto speed_text = cfg::Strings.GetString(458) + ": " + fs::FormatSize(speed_bps) + "/s, " + cfg::Strings.GetString(459) + ": " + util::FormatTime((u64)((1.0f / speed_bps) * (this->copy_total_p_bar->GetMaxProgress() - this->copy_total_p_bar->GetProgress())));
+
+                this->copy_speed_eta_info_text->SetText(speed_text);
+            }
+
+            g_MainApplication->CallForRender();
+        });
+        hos::UnlockExit();
+        return ok;
+    }
+
 }
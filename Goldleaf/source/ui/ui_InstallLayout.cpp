@@ -242,6 +242,32 @@ namespace ui {
             }
         }
 
+        bool ConfirmReinstall(nsp::Installer &nsp_installer) {
+            const auto option = g_MainApplication->DisplayDialog(cfg::Strings.GetString(77), cfg::Strings.GetString(272) + "\n" + cfg::Strings.GetString(273) + "\n" + cfg::Strings.GetString(274), { cfg::Strings.GetString(111), cfg::Strings.GetString(18) }, true);
+            if(option != 0) {
+                return false;
+            }
+
+            for(const auto &program: nsp_installer.GetInstallablePrograms()) {
+                const auto program_id = program.meta_key.id;
+                GLEAF_WARN_FMT("Checking program %016lX...", program_id);
+                const auto program_app = cnt::ExistsApplicationContent(program_id, static_cast<NcmContentMetaType>(program.meta_key.type));
+                if(program_app.has_value()) {
+                    GLEAF_WARN_FMT("Removing program %016lX...", program_id);
+                    const auto &cnt_status = program_app.value().get().meta_status_list;
+                    const auto cnt_it = std::find_if(cnt_status.begin(), cnt_status.end(), [&](const NsApplicationContentMetaStatus &cnt_status) -> bool {
+                        return cnt_status.application_id == program_id;
+                    });
+                    if(cnt_it != cnt_status.end()) {
+                        GLEAF_WARN_FMT("Removing program %016lX actually...", program_id);
+                        const auto cnt_idx = std::distance(cnt_status.begin(), cnt_it);
+                        cnt::RemoveApplicationContentById(program_app.value().get(), cnt_idx);
+                    }
+                }
+            }
+            return true;
+        }
+
         void HandleInstallationFailure(const Result rc, nsp::Installer &nsp_installer) {
             for(const auto &program: nsp_installer.GetInstallablePrograms()) {
                 const auto program_id = program.meta_key.id;
@@ -266,10 +292,118 @@ namespace ui {
 
     }
 
+    void InstallLayout::PrepareContentProgress(const size_t cnt_count, const bool is_batch) {
+        g_MainApplication->ClearLayout(g_MainApplication->GetInstallLayout());
+        this->content_info_texts.clear();
+        this->content_p_bars.clear();
+        u32 cur_y = this->speed_info_text->GetY();
+        this->speed_info_text->SetVisible(false);
+        this->Add(this->speed_info_text);
+        cur_y += this->speed_info_text->GetHeight() + 25;
+
+        if(is_batch) {
+            this->batch_info_text->SetY(cur_y);
+            this->Add(this->batch_info_text);
+            cur_y += this->batch_info_text->GetHeight() + 15;
+            this->batch_p_bar->SetY(cur_y);
+            this->Add(this->batch_p_bar);
+            cur_y += this->batch_p_bar->GetHeight() + 35;
+        }
+
+        constexpr auto cnts_per_column = 4;
+        const auto column_count = (cnt_count + 3) / 4;
+        constexpr auto margin = 75;
+        const auto p_bar_width = (pu::ui::render::ScreenWidth - (column_count + 1) * margin) / column_count;
+
+        const auto base_column_y = cur_y;
+        auto cur_x = margin;
+        u32 j = 0;
+        for(u32 i = 0; i < cnt_count; i++) {
+            auto info_text = pu::ui::elm::TextBlock::New(cur_x, cur_y, "A");
+            info_text->SetColor(g_Settings.GetColorScheme().text);
+            cur_y += info_text->GetHeight() + 15;
+            info_text->SetVisible(false);
+            auto p_bar = pu::ui::elm::ProgressBar::New(cur_x, cur_y, p_bar_width, 40, 0.0f);
+            p_bar->SetProgressColor(g_Settings.GetColorScheme().progress_bar);
+            p_bar->SetBackgroundColor(g_Settings.GetColorScheme().progress_bar_bg);
+            cur_y += p_bar->GetHeight() + 25;
+            p_bar->SetVisible(false);
+
+            this->content_info_texts.push_back(info_text);
+            this->content_p_bars.push_back(p_bar);
+            this->Add(info_text);
+            this->Add(p_bar);
+
+            j++;
+            if(j >= cnts_per_column) {
+                j = 0;
+                cur_x += p_bar_width + margin;
+                cur_y = base_column_y;
+            }
+        }
+
+        this->last_progress_tp = std::chrono::steady_clock::now();
+    }
+
+    void InstallLayout::StartContentProgress(const nsp::ContentWriteProgress &write_start) {
+        u32 i = 0;
+        u32 cnt_counts[cnt::MaxContentCount] = {};
+        for(const auto &entry : write_start.entries) {
+            const u32 cnt_id = static_cast<u32>(entry.type);
+            const auto text = FormatContentType(entry.type) + ((cnt_counts[cnt_id] > 0) ? (" " + std::to_string(cnt_counts[cnt_id])) : "") + " (" + fs::FormatSize(entry.size) + ")";
+            cnt_counts[cnt_id]++;
+
+            this->content_info_texts.at(i)->SetText(text);
+            this->content_info_texts.at(i)->SetVisible(true);
+            this->content_p_bars.at(i)->SetMaxProgress((double)entry.size);
+            this->content_p_bars.at(i)->SetProgress((double)entry.cur_offset);
+            this->content_p_bars.at(i)->SetVisible(true);
+            i++;
+        }
+        this->speed_info_text->SetVisible(true);
+
+        g_MainApplication->CallForRender();
+    }
+
+    void InstallLayout::UpdateContentProgress(const nsp::ContentWriteProgress &write_progress, const size_t rem_size) {
+        const auto cur_tp = std::chrono::steady_clock::now();
+        const auto time_diff = (double)std::chrono::duration_cast<std::chrono::milliseconds>(cur_tp - this->last_progress_tp).count();
+        this->last_progress_tp = cur_tp;
+        // By elapsed time and written bytes, compute how much data has been written in 1 second
+        const auto speed_bps = (1000.0f / time_diff) * (double)(write_progress.written_size);
+        const auto hash_speed_bps = (1000.0f / time_diff) * (double)(write_progress.hashed_size);
+
+        u32 i = 0;
+        for(const auto &entry : write_progress.entries) {
+            this->content_p_bars.at(i)->SetProgress((double)entry.cur_offset);
+            i++;
+        }
+
+        auto speed_text =  cfg::Strings.GetString(458) + ": " + fs::FormatSize(speed_bps) + "/s, " + cfg::Strings.GetString(459) + ": " + util::FormatTime((u64)((1.0f / speed_bps) * (double)rem_size));
+        if(g_Settings.json_settings.installs.value().verify_content_hashes.value()) {
+            speed_text += ", " + cfg::Strings.GetString(543) + ": " + fs::FormatSize(hash_speed_bps) + "/s";
+        }
+        this->speed_info_text->SetText(speed_text);
+
+        g_MainApplication->CallForRender();
+    }
+
+    void InstallLayout::UpdateBatchProgress(const nsp::BatchInstallProgress &batch_progress) {
+        this->batch_info_text->SetText(cfg::Strings.GetString(542) + " " + std::to_string(batch_progress.job_idx + 1) + " / " + std::to_string(batch_progress.job_count) + " (" + fs::FormatSize(batch_progress.done_size) + " / " + fs::FormatSize(batch_progress.total_size) + ")");
+        this->batch_p_bar->SetMaxProgress((double)batch_progress.total_size);
+        this->batch_p_bar->SetProgress((double)batch_progress.done_size);
+    }
+
     InstallLayout::InstallLayout() : pu::ui::Layout() {
         this->speed_info_text = pu::ui::elm::TextBlock::New(0, 320, "...");
         this->speed_info_text->SetHorizontalAlign(pu::ui::elm::HorizontalAlign::Center);
         this->speed_info_text->SetColor(g_Settings.GetColorScheme().text);
+        this->batch_info_text = pu::ui::elm::TextBlock::New(0, 0, "...");
+        this->batch_info_text->SetHorizontalAlign(pu::ui::elm::HorizontalAlign::Center);
+        this->batch_info_text->SetColor(g_Settings.GetColorScheme().text);
+        this->batch_p_bar = pu::ui::elm::ProgressBar::New(75, 0, pu::ui::render::ScreenWidth - 2 * 75, 40, 0.0f);
+        this->batch_p_bar->SetProgressColor(g_Settings.GetColorScheme().progress_bar);
+        this->batch_p_bar->SetBackgroundColor(g_Settings.GetColorScheme().progress_bar_bg);
     }
 
     bool InstallLayout::StartInstall(const std::string &path, const std::string &pres_path, fs::Explorer *exp, const NcmStorageId storage_id, const bool omit_confirmation, const bool skip_if_already_installed) {
@@ -283,32 +417,25 @@ namespace ui {
 
         nsp::Installer nsp_installer(path, exp, storage_id);
 
-        auto rc = nsp_installer.PrepareInstallation();
+        // NSZ/XCZ contents get bigger once installed, so the package's own size isn't enough here
+        u64 install_size = 0;
+        auto rc = nsp_installer.ComputeInstallSize(install_size);
+        if(R_SUCCEEDED(rc) && (fs::GetFreeSpaceForPartition(fs::GetPartitionFromStorageId(storage_id)) < install_size)) {
+            rc = rc::goldleaf::ResultNotEnoughSize;
+        }
+        if(R_FAILED(rc)) {
+            HandleResult(rc, cfg::Strings.GetString(251));
+            return false;
+        }
+
+        rc = nsp_installer.PrepareInstallation();
         if(R_FAILED(rc)) {
             if(rc == rc::goldleaf::ResultContentAlreadyInstalled) {
                 if(skip_if_already_installed) {
                     return false;
                 }
 
-                const auto option = g_MainApplication->DisplayDialog(cfg::Strings.GetString(77), cfg::Strings.GetString(272) + "\n" + cfg::Strings.GetString(273) + "\n" + cfg::Strings.GetString(274), { cfg::Strings.GetString(111), cfg::Strings.GetString(18) }, true);
-                if(option == 0) {
-                    for(const auto &program: nsp_installer.GetInstallablePrograms()) {
-                        const auto program_id = program.meta_key.id;
-                        GLEAF_WARN_FMT("Checking program %016lX...", program_id);
-                        const auto program_app = cnt::ExistsApplicationContent(program_id, static_cast<NcmContentMetaType>(program.meta_key.type));
-                        if(program_app.has_value()) {
-                            GLEAF_WARN_FMT("Removing program %016lX...", program_id);
-                            const auto &cnt_status = program_app.value().get().meta_status_list;
-                            const auto cnt_it = std::find_if(cnt_status.begin(), cnt_status.end(), [&](const NsApplicationContentMetaStatus &cnt_status) -> bool {
-                                return cnt_status.application_id == program_id;
-                            });
-                            if(cnt_it != cnt_status.end()) {
-                                GLEAF_WARN_FMT("Removing program %016lX actually...", program_id);
-                                const auto cnt_idx = std::distance(cnt_status.begin(), cnt_it);
-                                cnt::RemoveApplicationContentById(program_app.value().get(), cnt_idx);
-                            }
-                        }
-                    }
+                if(ConfirmReinstall(nsp_installer)) {
                     nsp_installer.FinalizeInstallation();
                     rc = nsp_installer.PrepareInstallation();
                     if(R_FAILED(rc)) {
@@ -368,87 +495,17 @@ namespace ui {
 
             hos::LockExit();
 
-            g_MainApplication->ClearLayout(g_MainApplication->GetInstallLayout());
-            this->content_info_texts.clear();
-            this->content_p_bars.clear();
-            u32 cur_y = this->speed_info_text->GetY();
-            this->Add(this->speed_info_text);
-            cur_y += this->speed_info_text->GetHeight() + 25;
-
-            constexpr auto cnts_per_column = 4;
-            const auto &cnts = nsp_installer.GetContents();
-            const auto column_count = (cnts.size() + 3) / 4;
-            constexpr auto margin = 75;
-            const auto p_bar_width = (pu::ui::render::ScreenWidth - (column_count + 1) * margin) / column_count;
-
-            const auto base_column_y = cur_y;
-            auto cur_x = margin;
-            u32 j = 0;
-            for(u32 i = 0; i < cnts.size(); i++) {
-                auto info_text = pu::ui::elm::TextBlock::New(cur_x, cur_y, "A");
-                info_text->SetColor(g_Settings.GetColorScheme().text);
-                cur_y += info_text->GetHeight() + 15;
-                info_text->SetVisible(false);
-                auto p_bar = pu::ui::elm::ProgressBar::New(cur_x, cur_y, p_bar_width, 40, 0.0f);
-                p_bar->SetProgressColor(g_Settings.GetColorScheme().progress_bar);
-                p_bar->SetBackgroundColor(g_Settings.GetColorScheme().progress_bar_bg);
-                cur_y += p_bar->GetHeight() + 25;
-                p_bar->SetVisible(false);
-
-                this->content_info_texts.push_back(info_text);
-                this->content_p_bars.push_back(p_bar);
-                this->Add(info_text);
-                this->Add(p_bar);
-
-                j++;
-                if(j >= cnts_per_column) {
-                    j = 0;
-                    cur_x += p_bar_width + margin;
-                    cur_y = base_column_y;
-                }
-            }
-
-            auto last_tp = std::chrono::steady_clock::now();
-
+            this->PrepareContentProgress(nsp_installer.GetContents().size(), false);
             rc = nsp_installer.WriteContents([&](const nsp::ContentWriteProgress &write_start) {
-                u32 i = 0;
-                u32 cnt_counts[cnt::MaxContentCount] = {};
-                for(const auto &entry : write_start.entries) {
-                    const u32 cnt_id = static_cast<u32>(entry.type);
-                    const auto text = FormatContentType(entry.type) + ((cnt_counts[cnt_id] > 0) ? (" " + std::to_string(cnt_counts[cnt_id])) : "") + " (" + fs::FormatSize(entry.size) + ")";
-                    cnt_counts[cnt_id]++;
-
-                    this->content_info_texts.at(i)->SetText(text);
-                    this->content_info_texts.at(i)->SetVisible(true);
-                    this->content_p_bars.at(i)->SetMaxProgress((double)entry.size);
-                    this->content_p_bars.at(i)->SetVisible(true);
-                    i++;
-                }
-                this->speed_info_text->SetVisible(true);
-
-                g_MainApplication->CallForRender();
+                this->StartContentProgress(write_start);
             }, [&](const nsp::ContentWriteProgress &write_progress) {
-                const auto cur_tp = std::chrono::steady_clock::now();
-                const auto time_diff = (double)std::chrono::duration_cast<std::chrono::milliseconds>(cur_tp - last_tp).count();
-                last_tp = cur_tp;
-                // By elapsed time and written bytes, compute how much data has been written in 1 second
-                const auto speed_bps = (1000.0f / time_diff) * (double)(write_progress.written_size);
-
                 size_t cur_size = 0;
                 size_t total_size = 0;
-                u32 i = 0;
                 for(const auto &entry : write_progress.entries) {
                     cur_size += entry.cur_offset;
                     total_size += entry.size;
-
-                    this->content_p_bars.at(i)->SetProgress((double)entry.cur_offset);
-                    i++;
                 }
-
-                const auto speed_text =  cfg::Strings.GetString(458) + ": " + fs::FormatSize(speed_bps) + "/s, " + cfg::Strings.GetString(459) + ": " + util::FormatTime((u64)((1.0f / speed_bps) * (double)(total_size - cur_size)));
-                this->speed_info_text->SetText(speed_text);
-
-                g_MainApplication->CallForRender();
+                this->UpdateContentProgress(write_progress, total_size - cur_size);
             });
 
             rc = nsp_installer.UpdateRecordAndContentMetas();
@@ -475,4 +532,72 @@ namespace ui {
         return true;
     }
 
+    bool InstallLayout::StartBatchInstall(nsp::BatchInstaller &batch_installer, const bool skip_if_already_installed) {
+        g_MainApplication->LoadCommonIconMenuData(true, cfg::Strings.GetString(77), CommonIconKind::Storage, "");
+        ScopeGuard on_exit([&]() {
+            // Just in case
+            cnt::NotifyApplicationsChanged();
+            g_MainApplication->GetApplicationListLayout()->NotifyApplicationsChanged();
+            g_MainApplication->ReturnToParentLayout();
+        });
+
+        hos::LockExit();
+        ScopeGuard unlock_exit([&]() {
+            hos::UnlockExit();
+        });
+
+        bool any_installed = false;
+        const auto rc = batch_installer.Run({
+            .on_job_start = [&](const nsp::BatchInstallJob &job, nsp::Installer &nsp_installer, const nsp::BatchInstallProgress &batch_progress) {
+                g_MainApplication->LoadMenuHead(cfg::Strings.GetString(145) + " " + job.pres_path);
+                this->PrepareContentProgress(nsp_installer.GetContents().size(), true);
+                this->UpdateBatchProgress(batch_progress);
+            },
+            .on_job_already_installed = [&](const nsp::BatchInstallJob &job, nsp::Installer &nsp_installer) -> bool {
+                if(skip_if_already_installed) {
+                    return false;
+                }
+
+                g_MainApplication->LoadMenuHead(cfg::Strings.GetString(145) + " " + job.pres_path);
+                return ConfirmReinstall(nsp_installer);
+            },
+            .on_start_write = [&](const nsp::ContentWriteProgress &write_start, const nsp::BatchInstallProgress &batch_progress) {
+                this->UpdateBatchProgress(batch_progress);
+                this->StartContentProgress(write_start);
+            },
+            .on_content_write = [&](const nsp::ContentWriteProgress &write_progress, const nsp::BatchInstallProgress &batch_progress) {
+                this->UpdateBatchProgress(batch_progress);
+                this->UpdateContentProgress(write_progress, batch_progress.total_size - batch_progress.done_size);
+            },
+            .on_job_finish = [&](const nsp::BatchInstallJob &job, nsp::Installer &nsp_installer, const nsp::BatchInstallJobStatus status, const Result rc) {
+                switch(status) {
+                    case nsp::BatchInstallJobStatus::Installed: {
+                        any_installed = true;
+                        if(g_Settings.json_settings.installs.value().show_deletion_prompt_after_install.value()) {
+                            g_MainApplication->GetBrowserLayout()->PromptDeleteFile(job.path);
+                        }
+                        break;
+                    }
+                    case nsp::BatchInstallJobStatus::PrepareFailed: {
+                        // Nothing has been installed yet, so no need to rollback
+                        HandleResult(rc, cfg::Strings.GetString(251));
+                        break;
+                    }
+                    case nsp::BatchInstallJobStatus::InstallFailed: {
+                        HandleInstallationFailure(rc, nsp_installer);
+                        break;
+                    }
+                    default: {
+                        break;
+                    }
+                }
+            }
+        });
+        if(R_FAILED(rc)) {
+            HandleResult(rc, cfg::Strings.GetString(251));
+        }
+
+        return any_installed;
+    }
+
 }
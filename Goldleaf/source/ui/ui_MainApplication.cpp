@@ -21,6 +21,7 @@
 
 #include <ui/ui_MainApplication.hpp>
 #include <usb/usb_Base.hpp>
+#include <usb/cf/cf_CommandFramework.hpp>
 
 extern ui::MainApplication::Ref g_MainApplication;
 extern cfg::Settings g_Settings;
@@ -272,8 +273,17 @@ namespace ui {
             this->read_values_once = true;
         }
 
-        this->usb_ok = usb::IsStateOk();
+        const auto usb_ok = usb::IsStateOk();
+        if(this->usb_ok && !usb_ok) {
+            // The PC client might be a different one next time
+            usb::cf::ResetProtocolInfo();
+            fs::ForgetTunedChunkSizes(fs::StorageKind::RemotePC);
+        }
+        this->usb_ok = usb_ok;
         this->usb_img->SetVisible(this->usb_ok);
+
+        // Chunk sizes learned by transfers finished since the last frame
+        fs::SaveTunedChunkSizes();
         u32 conn_strength = 0;
         nifmGetInternetConnectionStatus(nullptr, &conn_strength, nullptr);
         if(conn_strength != this->cur_conn_strength) {
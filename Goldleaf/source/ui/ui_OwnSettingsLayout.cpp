@@ -133,6 +133,14 @@ namespace ui {
         SaveChanges(false);
     }
 
+    void OwnSettingsLayout::adaptive_chunk_size_DefaultKey() {
+        auto &fs_settings = g_Settings.json_settings.fs.value();
+        fs_settings.adaptive_chunk_size = !fs_settings.adaptive_chunk_size.value_or(true);
+        // Toggling this also forgets the learned sizes, so that they are probed again (useful after changing SD cards, drives...)
+        fs::ForgetTunedChunkSizes();
+        SaveChanges(false);
+    }
+
     void OwnSettingsLayout::ignore_required_fw_version_DefaultKey() {
         g_Settings.json_settings.installs.value().ignore_required_fw_version.value() = !g_Settings.json_settings.installs.value().ignore_required_fw_version.value();
         SaveChanges(false);
@@ -143,6 +151,11 @@ namespace ui {
         SaveChanges(false);
     }
 
+    void OwnSettingsLayout::verify_content_hashes_DefaultKey() {
+        g_Settings.json_settings.installs.value().verify_content_hashes.value() = !g_Settings.json_settings.installs.value().verify_content_hashes.value();
+        SaveChanges(false);
+    }
+
     void OwnSettingsLayout::menu_stick_move_speed_DefaultKey() {
         std::vector<std::string> speed_opts;
         for(u32 i = 0; i < static_cast<u32>(cfg::MenuStickMoveSpeed::Count); i++) {
@@ -229,6 +242,14 @@ namespace ui {
 
         this->settings_menu->AddItem(this->compute_directory_sizes_item);
 
+        const auto adaptive_chunk_size_name = cfg::Strings.GetString(545) + ": " + (g_Settings.json_settings.fs.value().adaptive_chunk_size.value_or(true) ? cfg::Strings.GetString(111) : cfg::Strings.GetString(112));
+        this->adaptive_chunk_size_item = pu::ui::elm::MenuItem::New(adaptive_chunk_size_name);
+        this->adaptive_chunk_size_item->SetIcon(GetCommonIcon(CommonIconKind::Settings));
+        this->adaptive_chunk_size_item->SetColor(g_Settings.GetColorScheme().text);
+        this->adaptive_chunk_size_item->AddOnKey(std::bind(&OwnSettingsLayout::adaptive_chunk_size_DefaultKey, this));
+
+        this->settings_menu->AddItem(this->adaptive_chunk_size_item);
+
         const auto ignore_required_fw_version_item_name = cfg::Strings.GetString(444) + ": " + (g_Settings.json_settings.installs.value().ignore_required_fw_version.value() ? cfg::Strings.GetString(111) : cfg::Strings.GetString(112));
         this->ignore_required_fw_version_item = pu::ui::elm::MenuItem::New(ignore_required_fw_version_item_name);
         this->ignore_required_fw_version_item->SetIcon(GetCommonIcon(CommonIconKind::Settings));
@@ -241,8 +262,15 @@ namespace ui {
         this->show_deletion_prompt_after_install_item->SetColor(g_Settings.GetColorScheme().text);
         this->show_deletion_prompt_after_install_item->AddOnKey(std::bind(&OwnSettingsLayout::show_deletion_prompt_after_install_DefaultKey, this));
 
+        const auto verify_content_hashes_name = cfg::Strings.GetString(544) + ": " + (g_Settings.json_settings.installs.value().verify_content_hashes.value() ? cfg::Strings.GetString(111) : cfg::Strings.GetString(112));
+        this->verify_content_hashes_item = pu::ui::elm::MenuItem::New(verify_content_hashes_name);
+        this->verify_content_hashes_item->SetIcon(GetCommonIcon(CommonIconKind::Settings));
+        this->verify_content_hashes_item->SetColor(g_Settings.GetColorScheme().text);
+        this->verify_content_hashes_item->AddOnKey(std::bind(&OwnSettingsLayout::verify_content_hashes_DefaultKey, this));
+
         this->settings_menu->AddItem(this->ignore_required_fw_version_item);
         this->settings_menu->AddItem(this->show_deletion_prompt_after_install_item);
+        this->settings_menu->AddItem(this->verify_content_hashes_item);
 
         std::string speed_fmt;
         GLEAF_ASSERT_TRUE(FormatMenuStickMoveSpeed(static_cast<cfg::MenuStickMoveSpeed>(g_Settings.json_settings.ui.value().menu_stick_move_speed.value()), speed_fmt));
@@ -55,6 +55,9 @@ namespace ui {
         this->paths.clear();
         this->paths_menu->ClearItems();
 
+        // Quark might have been restarted (or updated) since the last time
+        usb::cf::ResetProtocolInfo();
+
         u32 drive_count;
         auto rc = usb::cf::GetDriveCount(drive_count);
         if(R_SUCCEEDED(rc)) {
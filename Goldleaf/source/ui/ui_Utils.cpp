@@ -152,7 +152,7 @@ namespace ui {
     }
 
     pu::sdl2::TextureHandle::Ref GetCommonIconForExtension(const std::string &ext) {
-        if(ext == "nsp") {
+        if(nsp::IsInstallablePackageExtension(ext)) {
             return g_CommonIcons[static_cast<u32>(CommonIconKind::NSP)];
         }
         else if(ext == "nro") {
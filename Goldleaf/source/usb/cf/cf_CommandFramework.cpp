@@ -0,0 +1,131 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <usb/cf/cf_CommandFramework.hpp>
+#include <usb/cmd/cmd_Compression.hpp>
+
+namespace usb::cf {
+
+    namespace {
+
+        Lock g_ProtocolInfoLock;
+        bool g_ProtocolInfoNegotiated = false;
+        ProtocolInfo g_ProtocolInfo = LegacyProtocolInfo;
+
+        Result NegotiateProtocolInfo(ProtocolInfo &out_info) {
+            PathType type;
+            size_t tmp_size;
+            const auto rc = StatPath(HandshakeProbePath, type, tmp_size);
+            if(R_FAILED(rc)) {
+                return rc;
+            }
+
+            if(type != PathType::HandshakeSupported) {
+                out_info = LegacyProtocolInfo;
+                return rc::ResultSuccess;
+            }
+
+            const ProtocolInfo info = { ProtocolVersion, MaxBlockSize, SupportedFeatures };
+            ProtocolInfo pc_info = {};
+            const auto hs_rc = Handshake(info, pc_info);
+            if(R_FAILED(hs_rc)) {
+                return hs_rc;
+            }
+
+            out_info = {
+                .version = std::min(info.version, pc_info.version),
+                .max_block_size = std::min(info.max_block_size, pc_info.max_block_size),
+                .features = info.features & pc_info.features
+            };
+            return rc::ResultSuccess;
+        }
+
+        template<typename T>
+        inline bool ReadListingValue(const std::vector<u8> &data, size_t &offset, T &out_t) {
+            if((offset + sizeof(T)) > data.size()) {
+                return false;
+            }
+
+            std::memcpy(&out_t, data.data() + offset, sizeof(T));
+            offset += sizeof(T);
+            return true;
+        }
+
+    }
+
+    Result ListDirectory(const std::string &dir, std::vector<DirectoryEntry> &out_entries) {
+        u32 entry_count = 0;
+        std::vector<u8> listing_data;
+        const auto rc = cmd::ProcessCommand<18>(cmd::InString(dir), cmd::OutValue(entry_count), cmd::OutDynamicBuffer(listing_data));
+        if(R_FAILED(rc)) {
+            return rc;
+        }
+
+        // Each entry: type (u32), size (u64), modification time (u64, UNIX seconds), name length (u32), UTF-8 name
+        out_entries.clear();
+        out_entries.reserve(entry_count);
+        size_t offset = 0;
+        for(u32 i = 0; i < entry_count; i++) {
+            DirectoryEntry entry = {};
+            u32 name_len = 0;
+            if(!ReadListingValue(listing_data, offset, entry.type) || !ReadListingValue(listing_data, offset, entry.size) || !ReadListingValue(listing_data, offset, entry.mod_time) || !ReadListingValue(listing_data, offset, name_len)) {
+                return 0xBAB5;
+            }
+            if((offset + name_len) > listing_data.size()) {
+                return 0xBAB5;
+            }
+
+            entry.name.assign(reinterpret_cast<const char*>(listing_data.data() + offset), name_len);
+            offset += name_len;
+            out_entries.push_back(std::move(entry));
+        }
+
+        return rc::ResultSuccess;
+    }
+
+    ProtocolInfo GetProtocolInfo() {
+        ScopedLock lk(g_ProtocolInfoLock);
+
+        if(!g_ProtocolInfoNegotiated) {
+            ProtocolInfo info;
+            if(R_SUCCEEDED(NegotiateProtocolInfo(info))) {
+                g_ProtocolInfo = info;
+                g_ProtocolInfoNegotiated = true;
+                cmd::SetPayloadCompressionEnabled(info.Supports(Feature::Compression));
+                GLEAF_LOG_FMT("Remote PC protocol: version %d, max block size 0x%lX, features 0x%lX", info.version, info.max_block_size, static_cast<u64>(info.features));
+            }
+            else {
+                // Don't cache anything, the PC might not be connected yet
+                return LegacyProtocolInfo;
+            }
+        }
+
+        return g_ProtocolInfo;
+    }
+
+    void ResetProtocolInfo() {
+        ScopedLock lk(g_ProtocolInfoLock);
+        g_ProtocolInfoNegotiated = false;
+        g_ProtocolInfo = LegacyProtocolInfo;
+        cmd::SetPayloadCompressionEnabled(false);
+    }
+
+}
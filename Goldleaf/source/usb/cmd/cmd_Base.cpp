@@ -20,6 +20,7 @@
 */
 
 #include <usb/cmd/cmd_Base.hpp>
+#include <usb/cmd/cmd_Compression.hpp>
 
 namespace usb::cmd {
 
@@ -37,6 +38,31 @@ namespace usb::cmd {
         }
     }
 
+    InCommandBlock::InCommandBlock(const u32 cmd_id, const u32 tag) {
+        this->base.position = 0;
+        this->ok = true;
+        this->base.block_buf = new (Align) u8[BlockSize]();
+
+        if(!this->WriteValue(InputTaggedMagic)) {
+            this->ok = false;
+        }
+
+        if(!this->WriteValue(cmd_id)) {
+            this->ok = false;
+        }
+
+        if(!this->WriteValue(tag)) {
+            this->ok = false;
+        }
+    }
+
+    InCommandBlock::~InCommandBlock() {
+        if(this->base.block_buf != nullptr) {
+            operator delete[](this->base.block_buf, Align);
+            this->base.block_buf = nullptr;
+        }
+    }
+
     bool InCommandBlock::WriteString(const std::string &val) {
         const auto len = val.length();
         
@@ -69,9 +95,15 @@ namespace usb::cmd {
         return rc;
     }
 
+    Result InCommandBlock::Post(TransferQueue &queue) {
+        return queue.Post(this->base.block_buf, BlockSize);
+    }
+
     OutCommandBlock::OutCommandBlock() {
         this->base.position = 0;
         this->base.block_buf = new (Align) u8[BlockSize]();
+        this->magic = 0;
+        this->tag = 0;
         this->res = Read(this->base.block_buf, BlockSize);
         if(R_SUCCEEDED(this->res)) {
             if(!this->ReadValue(this->magic)) {
@@ -80,6 +112,11 @@ namespace usb::cmd {
             if(!this->ReadValue(this->res)) {
                 this->res = 0xBABA;
             }
+            if(this->magic == OutputTaggedMagic) {
+                if(!this->ReadValue(this->tag)) {
+                    this->res = 0xBABA;
+                }
+            }
         }
     }
 
@@ -118,21 +155,122 @@ namespace usb::cmd {
     }
 
     bool InBuffer::ProcessAfterIn() {
-        auto aligned_buf = new (Align) u8[this->size]();
-        memcpy(aligned_buf, this->buf, this->size);
+        if(IsPayloadCompressionEnabled() && (this->size > 0)) {
+            return R_SUCCEEDED(WriteCompressedPayload(this->buf, this->size));
+        }
+
+        // Aligned buffers (like the usual work buffers) are sent as they are, without any copies
+        if(IsBufferAligned(this->buf)) {
+            return R_SUCCEEDED(WriteStream(this->buf, this->size));
+        }
 
-        const auto ok = R_SUCCEEDED(Write(aligned_buf, this->size));
-        operator delete[](aligned_buf, Align);
-        return ok;
+        // Otherwise, each chunk is copied to a bounce buffer while the previous ones are still being sent
+        auto src_buf = reinterpret_cast<const u8*>(this->buf);
+        size_t offset = 0;
+        return R_SUCCEEDED(WriteStream(this->size, [&](u8 *chunk_buf, const size_t chunk_size) {
+            memcpy(chunk_buf, src_buf + offset, chunk_size);
+            offset += chunk_size;
+        }));
     }
 
     bool OutBuffer::ProcessAfterOut() {
-        auto aligned_buf = new (Align) u8[this->size]();
+        if(IsPayloadCompressionEnabled() && (this->size > 0)) {
+            return R_SUCCEEDED(ReadCompressedPayload(this->buf, this->size));
+        }
+
+        if(IsBufferAligned(this->buf)) {
+            return R_SUCCEEDED(ReadStream(this->buf, this->size));
+        }
+
+        // Otherwise, each chunk is copied from a bounce buffer while the next ones are already being received
+        auto dst_buf = reinterpret_cast<u8*>(this->buf);
+        size_t offset = 0;
+        return R_SUCCEEDED(ReadStream(this->size, [&](const u8 *chunk_buf, const size_t chunk_size) {
+            memcpy(dst_buf + offset, chunk_buf, chunk_size);
+            offset += chunk_size;
+        }));
+    }
 
-        const auto ok = R_SUCCEEDED(Read(aligned_buf, this->size));
-        memcpy(this->buf, aligned_buf, this->size);
-        operator delete[](aligned_buf, Align);
-        return ok;
+    bool OutDynamicBuffer::ProcessOut(OutCommandBlock &block) {
+        u64 size = 0;
+        if(!block.ReadValue(size) || (size > MaxDynamicBufferSize)) {
+            return false;
+        }
+
+        this->buf.resize(size);
+        return true;
+    }
+
+    bool OutDynamicBuffer::ProcessAfterOut() {
+        auto dst_buf = this->buf.data();
+        size_t offset = 0;
+        return R_SUCCEEDED(ReadStream(this->buf.size(), [&](const u8 *chunk_buf, const size_t chunk_size) {
+            memcpy(dst_buf + offset, chunk_buf, chunk_size);
+            offset += chunk_size;
+        }));
+    }
+
+    CommandPipeline::~CommandPipeline() {
+        this->CompleteAll();
+    }
+
+    void CommandPipeline::Abort() {
+        // Responses can't be matched with their commands anymore
+        this->in_block_queue.Cancel();
+        this->pending_cmds.clear();
+    }
+
+    Result CommandPipeline::CompleteNext() {
+        if(this->pending_cmds.empty()) {
+            return rc::ResultSuccess;
+        }
+
+        auto pipelined_cmd = std::move(this->pending_cmds.front());
+        this->pending_cmds.pop_front();
+
+        OutCommandBlock out_block = {};
+        if(!out_block.HasValidMagic()) {
+            this->Abort();
+            return R_FAILED(out_block.GetResult()) ? out_block.GetResult() : 0xBABA;
+        }
+        if(this->tagged && (out_block.GetTag() != pipelined_cmd.tag)) {
+            this->Abort();
+            return 0xBAB7;
+        }
+
+        // The PC already received the input block of any command it responded to, so this won't block
+        const auto rc = this->in_block_queue.WaitNext();
+        if(R_FAILED(rc)) {
+            this->Abort();
+            return rc;
+        }
+
+        if(out_block.IsValid()) {
+            if(!pipelined_cmd.cmd->ProcessOut(out_block)) {
+                this->Abort();
+                return 0xBAB3;
+            }
+
+            out_block.Cleanup();
+
+            if(!pipelined_cmd.cmd->ProcessAfterOut()) {
+                this->Abort();
+                return 0xBAB4;
+            }
+        }
+
+        return out_block.GetResult();
+    }
+
+    Result CommandPipeline::CompleteAll() {
+        auto rc = rc::ResultSuccess;
+        while(!this->pending_cmds.empty()) {
+            const auto cmd_rc = this->CompleteNext();
+            if(R_SUCCEEDED(rc)) {
+                rc = cmd_rc;
+            }
+        }
+        return rc;
     }
 
 }
@@ -0,0 +1,311 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <usb/cmd/cmd_Compression.hpp>
+#include <fs/fs_Common.hpp>
+#include <zstd.h>
+
+namespace usb::cmd {
+
+    namespace {
+
+        bool g_PayloadCompressionEnabled = false;
+
+        inline u32 GetChunkCount(const size_t size) {
+            return (size + CompressionChunkSize - 1) / CompressionChunkSize;
+        }
+
+        inline size_t GetRawChunkSize(const size_t size, const u32 chunk_idx) {
+            return std::min(CompressionChunkSize, size - chunk_idx * CompressionChunkSize);
+        }
+
+        constexpr u32 DecompressionSlotCount = StreamInFlightCount + 1;
+
+        // Compressed (or unaligned) chunks are received into a ring of slots, which are freed once the decompression thread is done with them
+        class ChunkDecompressor {
+            private:
+                struct Job {
+                    u32 slot_idx;
+                    const u8 *src;
+                    size_t stored_size;
+                    u8 *dst;
+                    size_t raw_size;
+                };
+
+                ZSTD_DCtx *dctx;
+                u8 *slots_buf;
+                bool slots_busy[DecompressionSlotCount];
+                std::deque<Job> jobs;
+                Lock job_lock;
+                UEvent job_event;
+                UEvent slot_free_event;
+                bool done;
+                bool failed;
+                bool use_thread;
+                Thread thread;
+                bool thread_started;
+
+                bool ProcessJob(const Job &job) {
+                    if(job.stored_size < job.raw_size) {
+                        const auto ret = ZSTD_decompressDCtx(this->dctx, job.dst, job.raw_size, job.src, job.stored_size);
+                        if(ZSTD_isError(ret) || (ret != job.raw_size)) {
+                            GLEAF_WARN_FMT("Compressed payload chunk error: %s", ZSTD_isError(ret) ? ZSTD_getErrorName(ret) : "size mismatch");
+                            return false;
+                        }
+                    }
+                    else {
+                        std::memcpy(job.dst, job.src, job.raw_size);
+                    }
+                    return true;
+                }
+
+                void ReleaseSlot(const u32 slot_idx, const bool ok) {
+                    {
+                        ScopedLock job_lock(this->job_lock);
+                        this->slots_busy[slot_idx] = false;
+                        if(!ok) {
+                            this->failed = true;
+                        }
+                    }
+                    ueventSignal(&this->slot_free_event);
+                }
+
+                static void Main(void *decompressor_raw) {
+                    auto decompressor = reinterpret_cast<ChunkDecompressor*>(decompressor_raw);
+                    while(true) {
+                        Job job;
+                        {
+                            ScopedLock job_lock(decompressor->job_lock);
+                            if(!decompressor->jobs.empty()) {
+                                job = decompressor->jobs.front();
+                                decompressor->jobs.pop_front();
+                            }
+                            else if(decompressor->done) {
+                                return;
+                            }
+                            else {
+                                job.src = nullptr;
+                            }
+                        }
+
+                        if(job.src == nullptr) {
+                            waitSingle(waiterForUEvent(&decompressor->job_event), UINT64_MAX);
+                            continue;
+                        }
+
+                        decompressor->ReleaseSlot(job.slot_idx, decompressor->ProcessJob(job));
+                    }
+                }
+
+            public:
+                ChunkDecompressor(const bool use_thread) : slots_busy(), jobs(), job_lock(), done(false), failed(false), use_thread(use_thread), thread(), thread_started(false) {
+                    this->dctx = ZSTD_createDCtx();
+                    this->slots_buf = fs::CheckoutWorkBuffer(DecompressionSlotCount * CompressionChunkSize);
+                    ueventCreate(&this->job_event, true);
+                    ueventCreate(&this->slot_free_event, true);
+                }
+
+                ~ChunkDecompressor() {
+                    this->Finish();
+                    fs::ReturnWorkBuffer(this->slots_buf);
+                    ZSTD_freeDCtx(this->dctx);
+                }
+
+                Result Start() {
+                    if(this->use_thread) {
+                        GLEAF_RC_TRY(threadCreate(&this->thread, Main, reinterpret_cast<void*>(this), nullptr, 64_KB, 0x2C, DecompressionThreadCpuId));
+                        GLEAF_RC_TRY(threadStart(&this->thread));
+                        this->thread_started = true;
+                    }
+                    GLEAF_RC_SUCCEED;
+                }
+
+                // Waits until every chunk is processed
+                Result Finish() {
+                    if(this->thread_started) {
+                        {
+                            ScopedLock job_lock(this->job_lock);
+                            this->done = true;
+                        }
+                        ueventSignal(&this->job_event);
+
+                        threadWaitForExit(&this->thread);
+                        threadClose(&this->thread);
+                        this->thread_started = false;
+                    }
+
+                    ScopedLock job_lock(this->job_lock);
+                    return this->failed ? rc::goldleaf::ResultInvalidCompressedPayload : rc::ResultSuccess;
+                }
+
+                u8 *AcquireSlot(const u32 chunk_idx) {
+                    const auto slot_idx = chunk_idx % DecompressionSlotCount;
+                    while(true) {
+                        {
+                            ScopedLock job_lock(this->job_lock);
+                            if(!this->slots_busy[slot_idx]) {
+                                this->slots_busy[slot_idx] = true;
+                                return this->slots_buf + slot_idx * CompressionChunkSize;
+                            }
+                        }
+
+                        waitSingle(waiterForUEvent(&this->slot_free_event), UINT64_MAX);
+                    }
+                }
+
+                void PushChunk(const u32 chunk_idx, const u8 *src, const size_t stored_size, u8 *dst, const size_t raw_size) {
+                    const Job job = {
+                        .slot_idx = chunk_idx % DecompressionSlotCount,
+                        .src = src,
+                        .stored_size = stored_size,
+                        .dst = dst,
+                        .raw_size = raw_size
+                    };
+
+                    if(this->use_thread) {
+                        {
+                            ScopedLock job_lock(this->job_lock);
+                            this->jobs.push_back(job);
+                        }
+                        ueventSignal(&this->job_event);
+                    }
+                    else {
+                        this->ReleaseSlot(job.slot_idx, this->ProcessJob(job));
+                    }
+                }
+        };
+
+        Result ReadChunkTable(const u32 chunk_count, const size_t size, std::vector<size_t> &out_stored_sizes) {
+            const auto table_size = chunk_count * sizeof(u32);
+            auto table_buf = fs::CheckoutWorkBuffer(table_size);
+            ScopeGuard table_guard([&]() {
+                fs::ReturnWorkBuffer(table_buf);
+            });
+            GLEAF_RC_TRY(Read(table_buf, table_size));
+
+            const auto table = reinterpret_cast<const u32*>(table_buf);
+            out_stored_sizes.clear();
+            out_stored_sizes.reserve(chunk_count);
+            for(u32 i = 0; i < chunk_count; i++) {
+                const auto stored_size = table[i];
+                GLEAF_RC_UNLESS((stored_size > 0) && (stored_size <= GetRawChunkSize(size, i)), rc::goldleaf::ResultInvalidCompressedPayload);
+                out_stored_sizes.push_back(stored_size);
+            }
+            GLEAF_RC_SUCCEED;
+        }
+
+    }
+
+    void SetPayloadCompressionEnabled(const bool enabled) {
+        g_PayloadCompressionEnabled = enabled;
+    }
+
+    bool IsPayloadCompressionEnabled() {
+        return g_PayloadCompressionEnabled;
+    }
+
+    Result ReadCompressedPayload(void *buf, const size_t size) {
+        const auto chunk_count = GetChunkCount(size);
+        std::vector<size_t> stored_sizes;
+        GLEAF_RC_TRY(ReadChunkTable(chunk_count, size, stored_sizes));
+
+        // Nothing would be done in parallel with a single chunk
+        ChunkDecompressor decompressor(chunk_count > 1);
+        GLEAF_RC_TRY(decompressor.Start());
+
+        // Raw chunks are received in place when possible
+        auto buf8 = reinterpret_cast<u8*>(buf);
+        const auto in_place = IsBufferAligned(buf);
+        const auto is_in_place_chunk = [&](const u32 chunk_idx) {
+            return in_place && (stored_sizes.at(chunk_idx) == GetRawChunkSize(size, chunk_idx));
+        };
+
+        u32 done_chunk_idx = 0;
+        const auto rc = ReadChunks(stored_sizes, [&](const u32 chunk_idx, const size_t chunk_size) {
+            if(is_in_place_chunk(chunk_idx)) {
+                return buf8 + chunk_idx * CompressionChunkSize;
+            }
+            else {
+                return decompressor.AcquireSlot(chunk_idx);
+            }
+        }, [&](u8 *chunk_buf, const size_t chunk_size) {
+            const auto chunk_idx = done_chunk_idx++;
+            if(!is_in_place_chunk(chunk_idx)) {
+                decompressor.PushChunk(chunk_idx, chunk_buf, chunk_size, buf8 + chunk_idx * CompressionChunkSize, GetRawChunkSize(size, chunk_idx));
+            }
+        });
+
+        const auto decompress_rc = decompressor.Finish();
+        GLEAF_RC_TRY(rc);
+        return decompress_rc;
+    }
+
+    Result WriteCompressedPayload(const void *buf, const size_t size) {
+        const auto chunk_count = GetChunkCount(size);
+        auto buf8 = reinterpret_cast<const u8*>(buf);
+        const auto in_place = IsBufferAligned(buf);
+
+        // Every chunk must be compressed before sending the table, so they are all staged here (unless sent raw in place)
+        auto stage_buf = fs::CheckoutWorkBuffer(chunk_count * CompressionChunkSize);
+        auto table_buf = fs::CheckoutWorkBuffer(chunk_count * sizeof(u32));
+        auto cctx = ZSTD_createCCtx();
+        ScopeGuard stage_guard([&]() {
+            ZSTD_freeCCtx(cctx);
+            fs::ReturnWorkBuffer(table_buf);
+            fs::ReturnWorkBuffer(stage_buf);
+        });
+
+        auto table = reinterpret_cast<u32*>(table_buf);
+        std::vector<size_t> stored_sizes;
+        std::vector<const u8*> chunk_bufs;
+        stored_sizes.reserve(chunk_count);
+        chunk_bufs.reserve(chunk_count);
+        for(u32 i = 0; i < chunk_count; i++) {
+            const auto raw_chunk = buf8 + i * CompressionChunkSize;
+            const auto raw_size = GetRawChunkSize(size, i);
+            auto stage_chunk = stage_buf + i * CompressionChunkSize;
+
+            // Not fitting in less than the raw size is the same as not getting any smaller
+            const auto ret = ZSTD_compressCCtx(cctx, stage_chunk, raw_size - 1, raw_chunk, raw_size, CompressionLevel);
+            if(!ZSTD_isError(ret)) {
+                stored_sizes.push_back(ret);
+                chunk_bufs.push_back(stage_chunk);
+            }
+            else {
+                stored_sizes.push_back(raw_size);
+                if(in_place) {
+                    chunk_bufs.push_back(raw_chunk);
+                }
+                else {
+                    std::memcpy(stage_chunk, raw_chunk, raw_size);
+                    chunk_bufs.push_back(stage_chunk);
+                }
+            }
+            table[i] = stored_sizes.back();
+        }
+
+        GLEAF_RC_TRY(Write(table_buf, chunk_count * sizeof(u32)));
+        return WriteChunks(stored_sizes, [&](const u32 chunk_idx, const size_t chunk_size) {
+            return const_cast<u8*>(chunk_bufs.at(chunk_idx));
+        });
+    }
+
+}
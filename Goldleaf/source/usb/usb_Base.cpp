@@ -20,377 +20,218 @@
 */
 
 #include <usb/usb_Base.hpp>
+#include <fs/fs_Common.hpp>
 
 namespace usb {
 
     namespace {
 
-        constexpr u32 DefaultInterfaceNumber = 0;
-        constexpr u32 HighSpeedMaxPacketLength = 0x200;
-        constexpr u32 SuperSpeedMaxPacketLength = 0x400;
+        inline size_t AlignUp(const size_t size, const size_t align) {
+            return (size + align - 1) & ~(align - 1);
+        }
 
-        constexpr UsbCommsInterfaceInfo InterfaceInfo = {
-            .bInterfaceClass = USB_CLASS_VENDOR_SPEC,
-            .bInterfaceSubClass = USB_CLASS_VENDOR_SPEC,
-            .bInterfaceProtocol = USB_CLASS_VENDOR_SPEC,
-        };
+        // Bounce buffers (for unaligned caller buffers) come from the work buffer pool, so that streams don't allocate on every payload
+        struct StreamBounceBuffers {
+            u8 *buf;
+            size_t chunk_size;
+            u32 count;
 
-        bool g_Initialized = false;
-        UsbDsInterface *g_Interface;
-        UsbDsEndpoint *g_EndpointIn;
-        UsbDsEndpoint *g_EndpointOut;
-
-        Result InitializeInterface5x() {
-            auto rc = rc::ResultSuccess;
-    
-            struct usb_interface_descriptor interface_descriptor = {
-                .bLength = USB_DT_INTERFACE_SIZE,
-                .bDescriptorType = USB_DT_INTERFACE,
-                .bInterfaceNumber = DefaultInterfaceNumber,
-                .bNumEndpoints = 2,
-                .bInterfaceClass = InterfaceInfo.bInterfaceClass,
-                .bInterfaceSubClass = InterfaceInfo.bInterfaceSubClass,
-                .bInterfaceProtocol = InterfaceInfo.bInterfaceProtocol,
-            };
-
-            struct usb_endpoint_descriptor endpoint_descriptor_in = {
-                .bLength = USB_DT_ENDPOINT_SIZE,
-                .bDescriptorType = USB_DT_ENDPOINT,
-                .bEndpointAddress = USB_ENDPOINT_IN,
-                .bmAttributes = USB_TRANSFER_TYPE_BULK,
-                .wMaxPacketSize = HighSpeedMaxPacketLength,
-            };
-
-            struct usb_endpoint_descriptor endpoint_descriptor_out = {
-                .bLength = USB_DT_ENDPOINT_SIZE,
-                .bDescriptorType = USB_DT_ENDPOINT,
-                .bEndpointAddress = USB_ENDPOINT_OUT,
-                .bmAttributes = USB_TRANSFER_TYPE_BULK,
-                .wMaxPacketSize = HighSpeedMaxPacketLength,
-            };
-            
-            struct usb_ss_endpoint_companion_descriptor endpoint_companion = {
-                .bLength = sizeof(struct usb_ss_endpoint_companion_descriptor),
-                .bDescriptorType = USB_DT_SS_ENDPOINT_COMPANION,
-                .bMaxBurst = 0x0F,
-                .bmAttributes = 0x00,
-                .wBytesPerInterval = 0x00,
-            };
-            
-            rc = usbDsRegisterInterface(&g_Interface);
-            if(R_FAILED(rc)) {
-                return rc;
+            StreamBounceBuffers(const size_t size) {
+                this->chunk_size = std::min(StreamChunkSize, AlignUp(std::max<size_t>(size, 1), BufferAlignment));
+                this->count = std::clamp<u32>((size + this->chunk_size - 1) / this->chunk_size, 1, StreamInFlightCount);
+                this->buf = fs::CheckoutWorkBuffer(this->chunk_size * this->count);
             }
-            
-            interface_descriptor.bInterfaceNumber = g_Interface->interface_index;
-            endpoint_descriptor_in.bEndpointAddress += interface_descriptor.bInterfaceNumber + 1;
-            endpoint_descriptor_out.bEndpointAddress += interface_descriptor.bInterfaceNumber + 1;
-
-            /*
-            // Full Speed Config
-            rc = usbDsInterface_AppendConfigurationData(interface->interface, UsbDeviceSpeed_Full, &interface_descriptor, USB_DT_INTERFACE_SIZE);
-            if(R_FAILED(rc)) {
-                return rc;
-            }
-            rc = usbDsInterface_AppendConfigurationData(interface->interface, UsbDeviceSpeed_Full, &endpoint_descriptor_in, USB_DT_ENDPOINT_SIZE);
-            if(R_FAILED(rc)) {
-                return rc;
-            }
-            rc = usbDsInterface_AppendConfigurationData(interface->interface, UsbDeviceSpeed_Full, &endpoint_descriptor_out, USB_DT_ENDPOINT_SIZE);
-            if(R_FAILED(rc)) {
-                return rc;
-            }
-            */
-            
-            // High Speed Config
-            endpoint_descriptor_in.wMaxPacketSize = HighSpeedMaxPacketLength;
-            endpoint_descriptor_out.wMaxPacketSize = HighSpeedMaxPacketLength;
-            rc = usbDsInterface_AppendConfigurationData(g_Interface, UsbDeviceSpeed_High, &interface_descriptor, USB_DT_INTERFACE_SIZE);
-            if(R_FAILED(rc)) {
-                return rc;
-            }
-            rc = usbDsInterface_AppendConfigurationData(g_Interface, UsbDeviceSpeed_High, &endpoint_descriptor_in, USB_DT_ENDPOINT_SIZE);
-            if(R_FAILED(rc)) {
-                return rc;
-            }
-            rc = usbDsInterface_AppendConfigurationData(g_Interface, UsbDeviceSpeed_High, &endpoint_descriptor_out, USB_DT_ENDPOINT_SIZE);
-            if(R_FAILED(rc)) {
-                return rc;
-            }
-            
-            // Super Speed Config
-            endpoint_descriptor_in.wMaxPacketSize = SuperSpeedMaxPacketLength;
-            endpoint_descriptor_out.wMaxPacketSize = SuperSpeedMaxPacketLength;
-            rc = usbDsInterface_AppendConfigurationData(g_Interface, UsbDeviceSpeed_Super, &interface_descriptor, USB_DT_INTERFACE_SIZE);
-            if(R_FAILED(rc)) {
-                return rc;
-            }
-            rc = usbDsInterface_AppendConfigurationData(g_Interface, UsbDeviceSpeed_Super, &endpoint_descriptor_in, USB_DT_ENDPOINT_SIZE);
-            if(R_FAILED(rc)) {
-                return rc;
-            }
-            rc = usbDsInterface_AppendConfigurationData(g_Interface, UsbDeviceSpeed_Super, &endpoint_companion, USB_DT_SS_ENDPOINT_COMPANION_SIZE);
-            if(R_FAILED(rc)) {
-                return rc;
-            }
-            rc = usbDsInterface_AppendConfigurationData(g_Interface, UsbDeviceSpeed_Super, &endpoint_descriptor_out, USB_DT_ENDPOINT_SIZE);
-            if(R_FAILED(rc)) {
-                return rc;
-            }
-            rc = usbDsInterface_AppendConfigurationData(g_Interface, UsbDeviceSpeed_Super, &endpoint_companion, USB_DT_SS_ENDPOINT_COMPANION_SIZE);
-            if(R_FAILED(rc)) {
-                return rc;
-            }
-            
-            //Setup endpoints.    
-            rc = usbDsInterface_RegisterEndpoint(g_Interface, &g_EndpointIn, endpoint_descriptor_in.bEndpointAddress);
-            if(R_FAILED(rc)) {
-                return rc;
-            }
-            
-            rc = usbDsInterface_RegisterEndpoint(g_Interface, &g_EndpointOut, endpoint_descriptor_out.bEndpointAddress);
-            if(R_FAILED(rc)) {
-                return rc;
+
+            ~StreamBounceBuffers() {
+                fs::ReturnWorkBuffer(this->buf);
             }
 
-            rc = usbDsInterface_EnableInterface(g_Interface);
-            if(R_FAILED(rc)) {
-                return rc;
+            inline u8 *GetChunkBuffer(const u32 chunk_idx) {
+                return this->buf + (chunk_idx % this->count) * this->chunk_size;
             }
-            
-            return rc;
-        }
+        };
 
+        // Returns the buffer the chunk at the given offset is transferred with
+        using PrepareChunkFunction = std::function<u8*(const u32, const size_t, const size_t)>;
+        using ChunkSizeFunction = std::function<size_t(const u32)>;
+
+        Result TransferChunks(const TransferDirection dir, const u32 chunk_count, ChunkSizeFunction size_fn, const u32 in_flight_count, PrepareChunkFunction prepare_fn, TransferDoneFunction done_fn) {
+            TransferQueue queue(dir);
+
+            size_t posted_size = 0;
+            u32 posted_chunk_count = 0;
+            while(true) {
+                while((posted_chunk_count < chunk_count) && (queue.GetPendingCount() < in_flight_count)) {
+                    const auto cur_chunk_size = size_fn(posted_chunk_count);
+                    auto chunk_buf = prepare_fn(posted_chunk_count, posted_size, cur_chunk_size);
+                    const auto rc = queue.Post(chunk_buf, cur_chunk_size, done_fn);
+                    if(R_FAILED(rc)) {
+                        return rc;
+                    }
+                    posted_size += cur_chunk_size;
+                    posted_chunk_count++;
+                }
 
-        Result InitializeInterface1x() {
-            auto rc = rc::ResultSuccess;
-
-            struct usb_interface_descriptor interface_descriptor = {
-                .bLength = USB_DT_INTERFACE_SIZE,
-                .bDescriptorType = USB_DT_INTERFACE,
-                .bInterfaceNumber = DefaultInterfaceNumber,
-                .bInterfaceClass = InterfaceInfo.bInterfaceClass,
-                .bInterfaceSubClass = InterfaceInfo.bInterfaceSubClass,
-                .bInterfaceProtocol = InterfaceInfo.bInterfaceProtocol,
-            };
-
-            struct usb_endpoint_descriptor endpoint_descriptor_in = {
-                .bLength = USB_DT_ENDPOINT_SIZE,
-                .bDescriptorType = USB_DT_ENDPOINT,
-                .bEndpointAddress = USB_ENDPOINT_IN,
-                .bmAttributes = USB_TRANSFER_TYPE_BULK,
-                .wMaxPacketSize = HighSpeedMaxPacketLength,
-            };
-
-            struct usb_endpoint_descriptor endpoint_descriptor_out = {
-                .bLength = USB_DT_ENDPOINT_SIZE,
-                .bDescriptorType = USB_DT_ENDPOINT,
-                .bEndpointAddress = USB_ENDPOINT_OUT,
-                .bmAttributes = USB_TRANSFER_TYPE_BULK,
-                .wMaxPacketSize = HighSpeedMaxPacketLength,
-            };
-
-            //Setup interface.
-            rc = usbDsGetDsInterface(&g_Interface, &interface_descriptor, "usb");
-            if(R_FAILED(rc)) {
-                return rc;
-            }
+                if(queue.GetPendingCount() == 0) {
+                    break;
+                }
 
-            //Setup endpoints.
-            rc = usbDsInterface_GetDsEndpoint(g_Interface, &g_EndpointIn, &endpoint_descriptor_in);//device->host
-            if(R_FAILED(rc)) {
-                return rc;
+                // Chunks are done in order, so (with bounce buffers) the one just done is the next one to be posted again
+                const auto rc = queue.WaitNext();
+                if(R_FAILED(rc)) {
+                    return rc;
+                }
             }
 
-            rc = usbDsInterface_GetDsEndpoint(g_Interface, &g_EndpointOut, &endpoint_descriptor_out);//host->device
-            if(R_FAILED(rc)) {
-                return rc;
-            }
+            return rc::ResultSuccess;
+        }
 
-            rc = usbDsInterface_EnableInterface(g_Interface);
-            if(R_FAILED(rc)) {
-                return rc;
-            }
+        Result TransferStream(const TransferDirection dir, const size_t size, const size_t chunk_size, const u32 in_flight_count, PrepareChunkFunction prepare_fn, TransferDoneFunction done_fn) {
+            const auto chunk_count = std::max<u32>((size + chunk_size - 1) / chunk_size, 1);
+            return TransferChunks(dir, chunk_count, [&](const u32 chunk_idx) {
+                return std::min(chunk_size, size - chunk_idx * chunk_size);
+            }, in_flight_count, prepare_fn, done_fn);
+        }
+
+    }
+
+    bool IsStateOk() {
+        auto transport = GetTransport();
+        return (transport != nullptr) && transport->IsConnected();
+    }
 
+    Result Read(void *buf, const size_t size) {
+        TransferQueue queue(TransferDirection::Read);
+        const auto rc = queue.Post(buf, size);
+        if(R_FAILED(rc)) {
             return rc;
         }
+        return queue.WaitAll();
+    }
 
-        inline Result InitializeInterface() {
-            if(hosversionAtLeast(5,0,0)) {
-                return InitializeInterface5x();
-            }
-            else {
-                return InitializeInterface1x();
-            }
+    Result Write(const void *buf, const size_t size) {
+        TransferQueue queue(TransferDirection::Write);
+        const auto rc = queue.Post(const_cast<void*>(buf), size);
+        if(R_FAILED(rc)) {
+            return rc;
         }
+        return queue.WaitAll();
+    }
 
-        Result TransferImpl(void *buf, const size_t size, UsbDsEndpoint *ep) {
-            auto state = UsbState_Detached;
-            usbDsGetState(&state);
-            if(state != UsbState_Configured) {
-                return MAKERESULT(Module_Libnx, LibnxError_BadUsbCommsRead);
-            }
+    TransferQueue::TransferQueue(const TransferDirection dir) : transport(GetTransport()), dir(dir), pending_transfers() {}
 
-            u32 urb_id = 0;
-            auto rc = usbDsEndpoint_PostBufferAsync(ep, buf, size, &urb_id);
-            if(R_SUCCEEDED(rc)) {
-                rc = eventWait(&ep->CompletionEvent, UINT64_MAX);
-                eventClear(&ep->CompletionEvent);
-
-                if(R_SUCCEEDED(rc)) {
-                    UsbDsReportData report_data;
-                    rc = usbDsEndpoint_GetReportData(ep, &report_data);
-                    u32 report_size = 0;
-                    if(R_SUCCEEDED(rc)) {
-                        rc = usbDsParseReportData(&report_data, urb_id, nullptr, &report_size);
-                    }
-                    if(report_size != size) {
-                        return MAKERESULT(Module_Libnx, LibnxError_BadUsbCommsRead);
-                    }
-                }
-            }
+    TransferQueue::~TransferQueue() {
+        // Only when failing halfway: posted buffers may be freed right after this
+        this->Cancel();
+    }
+
+    Result TransferQueue::Post(void *buf, const size_t size, TransferDoneFunction done_fn) {
+        if((this->transport == nullptr) || !this->transport->IsConnected() || (this->pending_transfers.size() >= MaxInFlightTransferCount)) {
+            return MAKERESULT(Module_Libnx, LibnxError_BadUsbCommsRead);
+        }
+
+        u32 transfer_id = 0;
+        const auto rc = this->transport->PostTransfer(this->dir, buf, size, transfer_id);
+        if(R_FAILED(rc)) {
             return rc;
         }
 
-        Result InitializeImpl() {
-            auto rc = rc::ResultSuccess;
-
-            if(!g_Initialized) {
-                rc = usbDsInitialize();
-                
-                if(R_SUCCEEDED(rc)) {
-                    if(hosversionAtLeast(5,0,0)) {
-                        u8 iManufacturer, iProduct, iSerialNumber;
-                        const u16 supported_langs[1] = { 0x0409 };
-                        // Send language descriptor
-                        rc = usbDsAddUsbLanguageStringDescriptor(nullptr, supported_langs, sizeof(supported_langs) / sizeof(u16));
-                        // Send manufacturer
-                        if(R_SUCCEEDED(rc)) {
-                            rc = usbDsAddUsbStringDescriptor(&iManufacturer, "XorTroll");
-                        }
-                        // Send product
-                        if(R_SUCCEEDED(rc)) {
-                            rc = usbDsAddUsbStringDescriptor(&iProduct, "Goldleaf");
-                        }
-                        // Send serial number
-                        if(R_SUCCEEDED(rc)) {
-                            rc = usbDsAddUsbStringDescriptor(&iSerialNumber, GLEAF_VERSION);
-                        }
-                        
-                        // Send device descriptors
-                        struct usb_device_descriptor device_descriptor = {
-                            .bLength = USB_DT_DEVICE_SIZE,
-                            .bDescriptorType = USB_DT_DEVICE,
-                            .bcdUSB = 0x0200,
-                            .bDeviceClass = 0x00,
-                            .bDeviceSubClass = 0x00,
-                            .bDeviceProtocol = 0x00,
-                            .bMaxPacketSize0 = 0x40,
-                            .idVendor = 0x057E,
-                            .idProduct = 0x3000,
-                            .bcdDevice = 0x0100,
-                            .iManufacturer = iManufacturer,
-                            .iProduct = iProduct,
-                            .iSerialNumber = iSerialNumber,
-                            .bNumConfigurations = 0x01,
-                        };
-
-                        /*
-                        // Full Speed is USB 1.1
-                        if(R_SUCCEEDED(rc)) {
-                            rc = usbDsSetUsbDeviceDescriptor(UsbDeviceSpeed_Full, &device_descriptor);
-                        }
-                        */
-                        
-                        // High Speed is USB 2.0
-                        device_descriptor.bcdUSB = 0x0200;
-                        if(R_SUCCEEDED(rc)) {
-                            rc = usbDsSetUsbDeviceDescriptor(UsbDeviceSpeed_High, &device_descriptor);
-                        }
-                        
-                        // Super Speed is USB 3.0
-                        device_descriptor.bcdUSB = 0x0300;
-                        // Upgrade packet size to 512
-                        device_descriptor.bMaxPacketSize0 = 0x09;
-                        if(R_SUCCEEDED(rc)) {
-                            rc = usbDsSetUsbDeviceDescriptor(UsbDeviceSpeed_Super, &device_descriptor);
-                        }
-                        
-                        // Define Binary Object Store
-                        u8 bos[0x16] = {
-                            0x05, // .bLength
-                            USB_DT_BOS, // .bDescriptorType
-                            0x16, 0x00, // .wTotalLength
-                            0x02, // .bNumDeviceCaps
-                            
-                            // USB 2.0
-                            0x07, // .bLength
-                            USB_DT_DEVICE_CAPABILITY, // .bDescriptorType
-                            0x02, // .bDevCapabilityType
-                            0x02, 0x00, 0x00, 0x00, // dev_capability_data
-                            
-                            // USB 3.0
-                            0x0A, // .bLength
-                            USB_DT_DEVICE_CAPABILITY, // .bDescriptorType
-                            0x03, // .bDevCapabilityType
-                            0x00, 0x0C, 0x00, 0x03, 0x00, 0x00, 0x00
-                        };
-                        if(R_SUCCEEDED(rc)) {
-                            rc = usbDsSetBinaryObjectStore(bos, sizeof(bos));
-                        }
-                    }
-                    
-                    if(R_SUCCEEDED(rc)) {
-                        rc = InitializeInterface();
-                    }
-                }
-                
-                if(R_SUCCEEDED(rc) && hosversionAtLeast(5,0,0)) {
-                    rc = usbDsEnable();
-                }
+        this->pending_transfers.push_back({
+            .transfer_id = transfer_id,
+            .buf = reinterpret_cast<u8*>(buf),
+            .size = size,
+            .done_fn = done_fn
+        });
+        return rc::ResultSuccess;
+    }
 
-                if(R_FAILED(rc)) {
-                    diagAbortWithResult(rc);
-                }
-            }
-            
-            if (R_SUCCEEDED(rc)) {
-                g_Initialized = true;
-            }
+    Result TransferQueue::WaitNext() {
+        if(this->pending_transfers.empty()) {
+            return rc::ResultSuccess;
+        }
 
+        // Transfers complete in the order they were posted, so the oldest one is always the next one to be done
+        const auto transfer = this->pending_transfers.front();
+        size_t transferred_size = 0;
+        const auto rc = this->transport->WaitTransfer(this->dir, transfer.transfer_id, transferred_size);
+        if(R_FAILED(rc)) {
             return rc;
         }
 
+        this->pending_transfers.pop_front();
+        if(transferred_size != transfer.size) {
+            return MAKERESULT(Module_Libnx, LibnxError_BadUsbCommsRead);
+        }
+
+        if(transfer.done_fn) {
+            transfer.done_fn(transfer.buf, transfer.size);
+        }
+        return rc::ResultSuccess;
+    }
+
+    Result TransferQueue::WaitAll() {
+        while(!this->pending_transfers.empty()) {
+            const auto rc = this->WaitNext();
+            if(R_FAILED(rc)) {
+                return rc;
+            }
+        }
+        return rc::ResultSuccess;
     }
 
-    Result Initialize() {
-        return InitializeImpl();
+    void TransferQueue::Cancel() {
+        if(!this->pending_transfers.empty()) {
+            this->transport->CancelTransfers(this->dir);
+            this->pending_transfers.clear();
+        }
     }
 
-    void Finalize() {
-        if(g_Initialized) {
-            usbDsExit();
+    Result ReadStream(const size_t size, StreamReadFunction read_fn) {
+        StreamBounceBuffers bufs(size);
+        return TransferStream(TransferDirection::Read, size, bufs.chunk_size, bufs.count, [&](const u32 chunk_idx, const size_t offset, const size_t chunk_size) {
+            return bufs.GetChunkBuffer(chunk_idx);
+        }, [&](u8 *chunk_buf, const size_t chunk_size) {
+            read_fn(chunk_buf, chunk_size);
+        });
+    }
 
-            g_EndpointIn = nullptr;
-            g_EndpointOut = nullptr;
-            g_Interface = nullptr;
+    Result WriteStream(const size_t size, StreamWriteFunction write_fn) {
+        StreamBounceBuffers bufs(size);
+        return TransferStream(TransferDirection::Write, size, bufs.chunk_size, bufs.count, [&](const u32 chunk_idx, const size_t offset, const size_t chunk_size) {
+            auto chunk_buf = bufs.GetChunkBuffer(chunk_idx);
+            write_fn(chunk_buf, chunk_size);
+            return chunk_buf;
+        }, nullptr);
+    }
 
-            g_Initialized = false;
-        }
+    Result ReadStream(void *buf, const size_t size) {
+        auto buf8 = reinterpret_cast<u8*>(buf);
+        return TransferStream(TransferDirection::Read, size, StreamChunkSize, StreamInFlightCount, [&](const u32 chunk_idx, const size_t offset, const size_t chunk_size) {
+            return buf8 + offset;
+        }, nullptr);
     }
 
-    bool IsStateOk() {
-        auto state = UsbState_Detached;
-        usbDsGetState(&state);
-        return state == UsbState_Configured;
+    Result WriteStream(const void *buf, const size_t size) {
+        auto buf8 = reinterpret_cast<u8*>(const_cast<void*>(buf));
+        return TransferStream(TransferDirection::Write, size, StreamChunkSize, StreamInFlightCount, [&](const u32 chunk_idx, const size_t offset, const size_t chunk_size) {
+            return buf8 + offset;
+        }, nullptr);
     }
 
-    Result Read(void *buf, const size_t size) {
-        return TransferImpl(buf, size, g_EndpointOut);
+    Result ReadChunks(const std::vector<size_t> &chunk_sizes, ChunkBufferFunction buf_fn, TransferDoneFunction done_fn) {
+        return TransferChunks(TransferDirection::Read, chunk_sizes.size(), [&](const u32 chunk_idx) {
+            return chunk_sizes.at(chunk_idx);
+        }, StreamInFlightCount, [&](const u32 chunk_idx, const size_t offset, const size_t chunk_size) {
+            return buf_fn(chunk_idx, chunk_size);
+        }, done_fn);
     }
 
-    Result Write(const void *buf, const size_t size) {
-        return TransferImpl(const_cast<void*>(buf), size, g_EndpointIn);
+    Result WriteChunks(const std::vector<size_t> &chunk_sizes, ChunkBufferFunction buf_fn) {
+        return TransferChunks(TransferDirection::Write, chunk_sizes.size(), [&](const u32 chunk_idx) {
+            return chunk_sizes.at(chunk_idx);
+        }, StreamInFlightCount, [&](const u32 chunk_idx, const size_t offset, const size_t chunk_size) {
+            return buf_fn(chunk_idx, chunk_size);
+        }, nullptr);
     }
 
 }
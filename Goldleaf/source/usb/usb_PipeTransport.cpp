@@ -0,0 +1,116 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <usb/usb_PipeTransport.hpp>
+
+namespace usb {
+
+    Pipe::Pipe(const size_t capacity) : capacity(capacity), read_offset(0), data_size(0), closed(false), lock() {
+        this->buf = new u8[capacity];
+        ueventCreate(&this->data_event, true);
+        ueventCreate(&this->space_event, true);
+    }
+
+    Pipe::~Pipe() {
+        delete[] this->buf;
+    }
+
+    Result Pipe::Read(void *buf, const size_t size) {
+        auto buf8 = reinterpret_cast<u8*>(buf);
+        size_t done_size = 0;
+        while(done_size < size) {
+            size_t cur_size = 0;
+            {
+                ScopedLock lk(this->lock);
+                if(this->data_size > 0) {
+                    // Contiguous part of the ring first, then whatever wrapped around
+                    cur_size = std::min(size - done_size, this->data_size);
+                    const auto first_size = std::min(cur_size, this->capacity - this->read_offset);
+                    std::memcpy(buf8 + done_size, this->buf + this->read_offset, first_size);
+                    std::memcpy(buf8 + done_size + first_size, this->buf, cur_size - first_size);
+                    this->read_offset = (this->read_offset + cur_size) % this->capacity;
+                    this->data_size -= cur_size;
+                }
+                else if(this->closed) {
+                    return rc::goldleaf::ResultTransportDisconnected;
+                }
+            }
+
+            if(cur_size > 0) {
+                done_size += cur_size;
+                ueventSignal(&this->space_event);
+            }
+            else {
+                waitSingle(waiterForUEvent(&this->data_event), UINT64_MAX);
+            }
+        }
+
+        GLEAF_RC_SUCCEED;
+    }
+
+    Result Pipe::Write(const void *buf, const size_t size) {
+        auto buf8 = reinterpret_cast<const u8*>(buf);
+        size_t done_size = 0;
+        while(done_size < size) {
+            size_t cur_size = 0;
+            {
+                ScopedLock lk(this->lock);
+                if(this->closed) {
+                    return rc::goldleaf::ResultTransportDisconnected;
+                }
+
+                if(this->data_size < this->capacity) {
+                    cur_size = std::min(size - done_size, this->capacity - this->data_size);
+                    const auto write_offset = (this->read_offset + this->data_size) % this->capacity;
+                    const auto first_size = std::min(cur_size, this->capacity - write_offset);
+                    std::memcpy(this->buf + write_offset, buf8 + done_size, first_size);
+                    std::memcpy(this->buf, buf8 + done_size + first_size, cur_size - first_size);
+                    this->data_size += cur_size;
+                }
+            }
+
+            if(cur_size > 0) {
+                done_size += cur_size;
+                ueventSignal(&this->data_event);
+            }
+            else {
+                waitSingle(waiterForUEvent(&this->space_event), UINT64_MAX);
+            }
+        }
+
+        GLEAF_RC_SUCCEED;
+    }
+
+    void Pipe::Close() {
+        {
+            ScopedLock lk(this->lock);
+            this->closed = true;
+        }
+        ueventSignal(&this->data_event);
+        ueventSignal(&this->space_event);
+    }
+
+    bool Pipe::IsClosed() {
+        ScopedLock lk(this->lock);
+        return this->closed;
+    }
+
+}
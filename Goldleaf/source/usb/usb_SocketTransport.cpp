@@ -0,0 +1,174 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <usb/usb_SocketTransport.hpp>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+
+namespace usb {
+
+    namespace {
+
+        // Broken connections are just reported as failed writes (no signals, like on the console)
+        #ifdef MSG_NOSIGNAL
+        constexpr int SendFlags = MSG_NOSIGNAL;
+        #else
+        constexpr int SendFlags = 0;
+        #endif
+
+        // Payloads are sent in big chunks, so socket buffers are made big enough for a few of them
+        constexpr int SocketBufferSize = 4_MB;
+
+        void ConfigureSocket(const int sock_fd) {
+            const int no_delay = 1;
+            setsockopt(sock_fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+            setsockopt(sock_fd, SOL_SOCKET, SO_SNDBUF, &SocketBufferSize, sizeof(SocketBufferSize));
+            setsockopt(sock_fd, SOL_SOCKET, SO_RCVBUF, &SocketBufferSize, sizeof(SocketBufferSize));
+        }
+
+    }
+
+    SocketTransport::~SocketTransport() {
+        this->Close();
+    }
+
+    Result SocketTransport::ReadBytes(void *buf, const size_t size) {
+        auto buf8 = reinterpret_cast<u8*>(buf);
+        size_t done_size = 0;
+        while(done_size < size) {
+            if(!this->IsConnected()) {
+                return rc::goldleaf::ResultTransportDisconnected;
+            }
+
+            const auto ret = recv(this->sock_fd, buf8 + done_size, size - done_size, 0);
+            if(ret < 0) {
+                if(errno == EINTR) {
+                    continue;
+                }
+
+                GLEAF_WARN_FMT("Socket transport read failed: %s", strerror(errno));
+                this->Close();
+            }
+            else if(ret == 0) {
+                this->Close();
+            }
+            else {
+                done_size += ret;
+            }
+        }
+
+        GLEAF_RC_SUCCEED;
+    }
+
+    Result SocketTransport::WriteBytes(const void *buf, const size_t size) {
+        auto buf8 = reinterpret_cast<const u8*>(buf);
+        size_t done_size = 0;
+        while(done_size < size) {
+            if(!this->IsConnected()) {
+                return rc::goldleaf::ResultTransportDisconnected;
+            }
+
+            const auto ret = send(this->sock_fd, buf8 + done_size, size - done_size, SendFlags);
+            if(ret < 0) {
+                if(errno == EINTR) {
+                    continue;
+                }
+
+                GLEAF_WARN_FMT("Socket transport write failed: %s", strerror(errno));
+                this->Close();
+            }
+            else {
+                done_size += ret;
+            }
+        }
+
+        GLEAF_RC_SUCCEED;
+    }
+
+    void SocketTransport::Close() {
+        if(this->sock_fd >= 0) {
+            close(this->sock_fd);
+            this->sock_fd = -1;
+        }
+    }
+
+    Result ConnectSocketTransport(const std::string &host, const u16 port, std::unique_ptr<SocketTransport> &out_transport) {
+        addrinfo hints = {};
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo *addrs = nullptr;
+        if(getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addrs) != 0) {
+            return rc::goldleaf::ResultTransportConnectionFailed;
+        }
+        ScopeGuard addrs_guard([&]() {
+            freeaddrinfo(addrs);
+        });
+
+        for(auto addr = addrs; addr != nullptr; addr = addr->ai_next) {
+            const auto sock_fd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+            if(sock_fd < 0) {
+                continue;
+            }
+
+            if(connect(sock_fd, addr->ai_addr, addr->ai_addrlen) == 0) {
+                ConfigureSocket(sock_fd);
+                out_transport = std::make_unique<SocketTransport>(sock_fd);
+                GLEAF_RC_SUCCEED;
+            }
+            close(sock_fd);
+        }
+
+        return rc::goldleaf::ResultTransportConnectionFailed;
+    }
+
+    Result AcceptSocketTransport(const u16 port, std::unique_ptr<SocketTransport> &out_transport) {
+        const auto listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+        if(listen_fd < 0) {
+            return rc::goldleaf::ResultTransportConnectionFailed;
+        }
+        ScopeGuard listen_guard([&]() {
+            close(listen_fd);
+        });
+
+        const int reuse_addr = 1;
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse_addr, sizeof(reuse_addr));
+
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(port);
+        if((bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) || (listen(listen_fd, 1) != 0)) {
+            return rc::goldleaf::ResultTransportConnectionFailed;
+        }
+
+        const auto sock_fd = accept(listen_fd, nullptr, nullptr);
+        if(sock_fd < 0) {
+            return rc::goldleaf::ResultTransportConnectionFailed;
+        }
+
+        ConfigureSocket(sock_fd);
+        out_transport = std::make_unique<SocketTransport>(sock_fd);
+        GLEAF_RC_SUCCEED;
+    }
+
+}
@@ -0,0 +1,77 @@
+
+/*
+
+    Goldleaf - Multipurpose homebrew tool for Nintendo Switch
+    Copyright © 2018-2025 XorTroll
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <usb/usb_Transport.hpp>
+
+namespace usb {
+
+    namespace {
+
+        Transport *g_Transport = nullptr;
+
+    }
+
+    Result StreamTransport::PostTransfer(const TransferDirection dir, void *buf, const size_t size, u32 &out_transfer_id) {
+        if(dir == TransferDirection::Write) {
+            GLEAF_RC_TRY(this->WriteBytes(buf, size));
+        }
+
+        out_transfer_id = this->next_transfer_id++;
+        this->GetPendingTransfers(dir).push_back({
+            .transfer_id = out_transfer_id,
+            .buf = reinterpret_cast<u8*>(buf),
+            .size = size
+        });
+        GLEAF_RC_SUCCEED;
+    }
+
+    Result StreamTransport::WaitTransfer(const TransferDirection dir, const u32 transfer_id, size_t &out_transferred_size) {
+        auto &pending_transfers = this->GetPendingTransfers(dir);
+        while(!pending_transfers.empty()) {
+            const auto transfer = pending_transfers.front();
+            pending_transfers.pop_front();
+            if(dir == TransferDirection::Read) {
+                GLEAF_RC_TRY(this->ReadBytes(transfer.buf, transfer.size));
+            }
+
+            if(transfer.transfer_id == transfer_id) {
+                out_transferred_size = transfer.size;
+                GLEAF_RC_SUCCEED;
+            }
+        }
+
+        return rc::goldleaf::ResultTransportDisconnected;
+    }
+
+    void StreamTransport::CancelTransfers(const TransferDirection dir) {
+        // Nothing was actually requested yet for pending reads, and writes are already done
+        this->GetPendingTransfers(dir).clear();
+    }
+
+    void SetTransport(Transport *transport) {
+        g_Transport = transport;
+    }
+
+    Transport *GetTransport() {
+        return g_Transport;
+    }
+
+}
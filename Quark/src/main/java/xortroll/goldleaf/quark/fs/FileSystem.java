@@ -117,6 +117,42 @@ public class FileSystem {
         return files;
     }
 
+    public static List<File> listEntries(String path) {
+        List<File> entries = new ArrayList<File>();
+        File[] all = new File(path).listFiles();
+        for(File f: all) {
+            if(f.isFile() || f.isDirectory()) {
+                entries.add(f);
+            }
+        }
+        return entries;
+    }
+
+    public static class TreeStats {
+        public long size = 0;
+        public long file_count = 0;
+        public long dir_count = 0;
+    }
+
+    // Everything inside the directory (but not itself); symlinked directories are counted but not followed, and unreadable ones are just skipped
+    public static void addTreeStats(File dir, TreeStats stats) {
+        File[] entries = dir.listFiles();
+        if(entries != null) {
+            for(File entry: entries) {
+                if(entry.isDirectory()) {
+                    stats.dir_count++;
+                    if(!Files.isSymbolicLink(entry.toPath())) {
+                        addTreeStats(entry, stats);
+                    }
+                }
+                else if(entry.isFile()) {
+                    stats.size += entry.length();
+                    stats.file_count++;
+                }
+            }
+        }
+    }
+
     public static String normalizePath(String path) {
         String normalized = path.replace('\\', '/').replace("//", "/");
 
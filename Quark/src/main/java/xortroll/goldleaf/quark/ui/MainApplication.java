@@ -207,6 +207,7 @@ public class MainApplication extends Application {
                     CommandBlock block = new CommandBlock(usb_intf);
                     if(!block.isValid()) {
                         usb_intf.finalize();
+                        CommandFramework.resetNegotiatedState();
 
                         usb_intf = showUsbFailReconnectDialogFromTask("Unable to receive data from Goldleaf.", false);
                         updateMessage("Reconnected! Processing USB input from Goldleaf...");
@@ -222,6 +223,7 @@ public class MainApplication extends Application {
                         }
                     }
                     if(!handled) {
+                        CommandFramework.resetNegotiatedState();
                         usb_intf = showUsbFailReconnectDialogFromTask("An invalid command was received from Goldleaf.", false);
                         updateMessage("Reconnected! Processing USB input from Goldleaf...");
                     }
@@ -21,8 +21,14 @@
 
 package xortroll.goldleaf.quark.usb.cf;
 
+import java.io.ByteArrayOutputStream;
 import java.io.File;
 import java.io.RandomAccessFile;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.charset.StandardCharsets;
+import java.security.MessageDigest;
+import java.util.Arrays;
 import java.util.List;
 
 import xortroll.goldleaf.quark.Logging;
@@ -39,6 +45,37 @@ public class CommandFramework {
     public static final int PathTypeInvalid = 0;
     public static final int PathTypeFile = 1;
     public static final int PathTypeDirectory = 2;
+    public static final int PathTypeHandshakeSupported = 3;
+
+    // Goldleaf checks whether the handshake is supported with a StatPath on this path (which no real filesystem can contain)
+    public static final String HandshakeProbePath = "\u0000quark:handshake";
+
+    public static final long FeatureBulkListing = 1L << 0;
+    public static final long FeatureCompression = 1L << 1;
+    public static final long FeaturePipelining = 1L << 2;
+    public static final long FeatureHashing = 1L << 3;
+    public static final long FeatureTreeStats = 1L << 4;
+
+    public static final int ProtocolVersion = 1;
+    public static final long MaxBlockSize = 16 * 1024 * 1024;
+    public static final long SupportedFeatures = FeatureBulkListing | FeatureCompression | FeaturePipelining | FeatureHashing | FeatureTreeStats;
+
+    public static final int HashAlgorithmSha256 = 0;
+    // Hashes are always sent with this size, zero-padded
+    public static final int MaxHashSize = 0x20;
+    public static final int HashBufferSize = 4 * 1024 * 1024;
+
+    // Negotiated in the last handshake (commands from older Goldleaf versions never perform one)
+    public static int negotiated_version = 0;
+    public static long negotiated_max_block_size = MaxBlockSize;
+    public static long negotiated_features = 0;
+
+    public static void resetNegotiatedState() {
+        negotiated_version = 0;
+        negotiated_max_block_size = MaxBlockSize;
+        negotiated_features = 0;
+        CommandBlock.payload_compression = false;
+    }
 
     public static final int FileModeRead = 1;
     public static final int FileModeWrite = 2;
@@ -128,7 +165,21 @@ public class CommandFramework {
 
     public static Command StatPath = new Command(3, new CommandHandler() {
         public void handle(CommandBlock block) {
-            String path = FileSystem.denormalizePath(block.readString());
+            String raw_path = block.readString();
+            if(raw_path.equals(HandshakeProbePath)) {
+                Logging.log("[cf] StatPath(handshake probe)");
+
+                // A new handshake is about to happen, nothing from the previous one applies anymore
+                resetNegotiatedState();
+
+                block.responseStart();
+                block.write32(PathTypeHandshakeSupported);
+                block.write64(0);
+                block.responseEnd();
+                return;
+            }
+
+            String path = FileSystem.denormalizePath(raw_path);
 
             try {
                 File f_path = new File(path);
@@ -271,7 +322,7 @@ public class CommandFramework {
                 block.responseStart();
                 block.write64((long)read);
                 block.responseEnd();
-                block.sendBuffer(data);
+                block.sendPayload(data);
             }
             catch(Exception e) {
                 block.respondFailure(ResultExceptionCaught);
@@ -283,7 +334,7 @@ public class CommandFramework {
         public void handle(CommandBlock block) {
             String path = FileSystem.denormalizePath(block.readString());
             long size = block.read64();
-            byte[] data = block.getBuffer((int)size);
+            byte[] data = block.getPayload((int)size);
 
             try {
                 boolean close_file = false;
@@ -437,6 +488,128 @@ public class CommandFramework {
         }
     });
 
+    public static Command ListDirectory = new Command(18, new CommandHandler() {
+        public void handle(CommandBlock block) {
+            String path = FileSystem.denormalizePath(block.readString());
+
+            try {
+                List<File> entries = FileSystem.listEntries(path);
+
+                // Each entry: type (u32), size (u64), modification time (u64, UNIX seconds), name length (u32), UTF-8 name
+                ByteArrayOutputStream listing = new ByteArrayOutputStream();
+                for(File entry: entries) {
+                    byte[] name = entry.getName().getBytes(StandardCharsets.UTF_8);
+                    ByteBuffer entry_buf = ByteBuffer.allocate(4 + 8 + 8 + 4).order(ByteOrder.LITTLE_ENDIAN);
+                    entry_buf.putInt(entry.isDirectory() ? PathTypeDirectory : PathTypeFile);
+                    entry_buf.putLong(entry.isFile() ? entry.length() : 0);
+                    entry_buf.putLong(entry.lastModified() / 1000);
+                    entry_buf.putInt(name.length);
+                    listing.write(entry_buf.array());
+                    listing.write(name);
+                }
+                byte[] listing_data = listing.toByteArray();
+                Logging.log("[cf] ListDirectory(path: '" + path + "') -> count: " + entries.size() + ", listing_size: " + listing_data.length);
+
+                block.responseStart();
+                block.write32(entries.size());
+                block.write64((long)listing_data.length);
+                block.responseEnd();
+                block.sendBuffer(listing_data);
+            }
+            catch(Exception e) {
+                block.respondFailure(ResultExceptionCaught);
+            }
+        }
+    });
+
+    public static Command Handshake = new Command(19, new CommandHandler() {
+        public void handle(CommandBlock block) {
+            int version = block.read32();
+            long max_block_size = block.read64();
+            long features = block.read64();
+
+            negotiated_version = Math.min(version, ProtocolVersion);
+            negotiated_max_block_size = Math.min(max_block_size, MaxBlockSize);
+            negotiated_features = features & SupportedFeatures;
+            CommandBlock.payload_compression = (negotiated_features & FeatureCompression) != 0;
+            Logging.log("[cf] Handshake(version: " + version + ", max_block_size: " + max_block_size + ", features: " + features + ") -> version: " + negotiated_version + ", max_block_size: " + negotiated_max_block_size + ", features: " + negotiated_features);
+
+            block.responseStart();
+            block.write32(ProtocolVersion);
+            block.write64(MaxBlockSize);
+            block.write64(SupportedFeatures);
+            block.responseEnd();
+        }
+    });
+
+    public static Command HashFile = new Command(20, new CommandHandler() {
+        public void handle(CommandBlock block) {
+            String path = FileSystem.denormalizePath(block.readString());
+            long offset = block.read64();
+            long size = block.read64();
+            int algorithm = block.read32();
+
+            try {
+                if(algorithm != HashAlgorithmSha256) {
+                    throw new Exception("Unsupported hash algorithm " + algorithm);
+                }
+
+                MessageDigest digest = MessageDigest.getInstance("SHA-256");
+                long hashed_size = 0;
+                try(RandomAccessFile file = new RandomAccessFile(path, "r")) {
+                    if(offset > file.length()) {
+                        throw new Exception("Offset past the end of the file");
+                    }
+
+                    byte[] data = new byte[HashBufferSize];
+                    file.seek(offset);
+                    while(hashed_size < size) {
+                        int read = file.read(data, 0, (int)Math.min(data.length, size - hashed_size));
+                        if(read <= 0) {
+                            break;
+                        }
+                        digest.update(data, 0, read);
+                        hashed_size += read;
+                    }
+                }
+                Logging.log("[cf] HashFile(path: '" + path + "', offset: " + offset + ", size: " + size + ", algorithm: " + algorithm + ") -> hashed_size: " + hashed_size);
+
+                block.responseStart();
+                block.writeBytes(Arrays.copyOf(digest.digest(), MaxHashSize));
+                block.responseEnd();
+            }
+            catch(Exception e) {
+                block.respondFailure(ResultExceptionCaught);
+            }
+        }
+    });
+
+    public static Command GetTreeStats = new Command(21, new CommandHandler() {
+        public void handle(CommandBlock block) {
+            String path = FileSystem.denormalizePath(block.readString());
+
+            try {
+                File dir = new File(path);
+                if(!dir.isDirectory()) {
+                    throw new Exception("Not a directory");
+                }
+
+                FileSystem.TreeStats stats = new FileSystem.TreeStats();
+                FileSystem.addTreeStats(dir, stats);
+                Logging.log("[cf] GetTreeStats(path: '" + path + "') -> size: " + stats.size + ", file_count: " + stats.file_count + ", dir_count: " + stats.dir_count);
+
+                block.responseStart();
+                block.write64(stats.size);
+                block.write64(stats.file_count);
+                block.write64(stats.dir_count);
+                block.responseEnd();
+            }
+            catch(Exception e) {
+                block.respondFailure(ResultExceptionCaught);
+            }
+        }
+    });
+
     public static Command[] AvailableCommands = {
         GetDriveCount,
         GetDriveInfo,
@@ -454,6 +627,10 @@ public class CommandFramework {
         Rename,
         GetSpecialPathCount,
         GetSpecialPath,
-        SelectFile
+        SelectFile,
+        ListDirectory,
+        Handshake,
+        HashFile,
+        GetTreeStats
     };
 }
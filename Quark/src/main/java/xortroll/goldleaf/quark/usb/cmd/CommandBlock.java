@@ -21,7 +21,11 @@
 
 package xortroll.goldleaf.quark.usb.cmd;
 
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
 import java.nio.charset.StandardCharsets;
+import java.util.Arrays;
+import com.github.luben.zstd.Zstd;
 import xortroll.goldleaf.quark.Buffer;
 import xortroll.goldleaf.quark.usb.USBInterface;
 
@@ -31,15 +35,28 @@ public class CommandBlock {
     public static final int InputMagic = 0x49434C47; // 'GLCI'
     public static final int OutputMagic = 0x4F434C47; // 'GLCO'
 
+    // Pipelined commands carry a tag (right after the command ID), echoed back right after the result
+    public static final int InputTaggedMagic = 0x49544C47; // 'GLTI'
+    public static final int OutputTaggedMagic = 0x4F544C47; // 'GLTO'
+
     public static final int ResultSuccess = 0;
 
     public static final int InvalidCommandId = 0;
 
+    // Compressed payloads: a table with the stored size of every chunk, followed by each chunk (zstd, or raw if it wouldn't get any smaller)
+    public static final int CompressionChunkSize = 0x100000;
+    public static final int CompressionLevel = 1;
+
+    // Only enabled once negotiated in the handshake
+    public static boolean payload_compression = false;
+
     private byte[] inner_block;
     private byte[] resp_block;
     private Buffer inner_buf;
     private Buffer resp_buf;
     private USBInterface usb_intf;
+    private boolean tagged;
+    private int tag;
 
     public CommandBlock(USBInterface intf) {
         this.usb_intf = intf;
@@ -82,6 +99,10 @@ public class CommandBlock {
         this.resp_buf.writeBytes(raw);
     }
 
+    public void writeBytes(byte[] val) {
+        this.resp_buf.writeBytes(val);
+    }
+
     public void sendBuffer(byte[] buf) {
         this.usb_intf.writeBytes(buf);
     }
@@ -90,20 +111,94 @@ public class CommandBlock {
         return this.usb_intf.readBytes(len);
     }
 
+    private static int getChunkCount(int len) {
+        return (len + CompressionChunkSize - 1) / CompressionChunkSize;
+    }
+
+    public void sendPayload(byte[] buf) {
+        if(!payload_compression || (buf.length == 0)) {
+            this.sendBuffer(buf);
+            return;
+        }
+
+        int chunk_count = getChunkCount(buf.length);
+        byte[][] chunks = new byte[chunk_count][];
+        ByteBuffer table = ByteBuffer.allocate(chunk_count * 4).order(ByteOrder.LITTLE_ENDIAN);
+        for(int i = 0; i < chunk_count; i++) {
+            int offset = i * CompressionChunkSize;
+            byte[] raw_chunk = Arrays.copyOfRange(buf, offset, Math.min(offset + CompressionChunkSize, buf.length));
+            byte[] comp_chunk = Zstd.compress(raw_chunk, CompressionLevel);
+            chunks[i] = (comp_chunk.length < raw_chunk.length) ? comp_chunk : raw_chunk;
+            table.putInt(chunks[i].length);
+        }
+
+        this.sendBuffer(table.array());
+        for(byte[] chunk : chunks) {
+            this.sendBuffer(chunk);
+        }
+    }
+
+    public byte[] getPayload(int len) {
+        if(!payload_compression || (len == 0)) {
+            return this.getBuffer(len);
+        }
+
+        int chunk_count = getChunkCount(len);
+        byte[] table_data = this.getBuffer(chunk_count * 4);
+        if(table_data == null) {
+            return null;
+        }
+
+        ByteBuffer table = ByteBuffer.wrap(table_data).order(ByteOrder.LITTLE_ENDIAN);
+        byte[] buf = new byte[len];
+        for(int i = 0; i < chunk_count; i++) {
+            int offset = i * CompressionChunkSize;
+            int raw_size = Math.min(CompressionChunkSize, len - offset);
+            int stored_size = table.getInt();
+            byte[] chunk = this.getBuffer(stored_size);
+            if(chunk == null) {
+                return null;
+            }
+
+            if(stored_size < raw_size) {
+                chunk = Zstd.decompress(chunk, raw_size);
+            }
+            System.arraycopy(chunk, 0, buf, offset, raw_size);
+        }
+        return buf;
+    }
+
     public int validateCommand() {
         int input_magic = this.read32();
         if(input_magic == InputMagic) {
             int cmd_id = this.read32();
             return cmd_id;
         }
+        else if(input_magic == InputTaggedMagic) {
+            int cmd_id = this.read32();
+            this.tagged = true;
+            this.tag = this.read32();
+            return cmd_id;
+        }
         else {
             return InvalidCommandId;
         }
     }
 
+    private void writeResponseHeader(int rc) {
+        if(this.tagged) {
+            this.resp_buf.write32(OutputTaggedMagic);
+            this.resp_buf.write32(rc);
+            this.resp_buf.write32(this.tag);
+        }
+        else {
+            this.resp_buf.write32(OutputMagic);
+            this.resp_buf.write32(rc);
+        }
+    }
+
     public void responseStart() {
-        this.resp_buf.write32(OutputMagic);
-        this.resp_buf.write32(ResultSuccess);
+        writeResponseHeader(ResultSuccess);
     }
 
     public void responseEnd() {
@@ -111,8 +206,7 @@ public class CommandBlock {
     }
 
     public void respondFailure(int rc) {
-        resp_buf.write32(OutputMagic);
-        resp_buf.write32(rc);
+        writeResponseHeader(rc);
         responseEnd();
     }
 